@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Benchmark of the route lookups of BpCgrRoutingProtocol
+//
+// - A random contact plan of --contacts contacts between --nodes nodes
+//   over one day, with a random one-way light time per node pair, or the
+//   contact plan of --plan in the ION format.
+// - Node 1 looks up the route to every other node once (the route lists
+//   are computed) and then --lookups more times (the route lists are
+//   cached), and prints the mean cost of both.
+// - Usage: bundle-protocol-cgr-benchmark --contacts=20000 --nodes=200
+
+#include <string>
+#include <chrono>
+#include <sstream>
+#include "ns3/core-module.h"
+#include "ns3/bp-endpoint-id.h"
+#include "ns3/bp-cgr-routing-protocol.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BundleProtocolCgrBenchmark");
+
+int
+main (int argc, char *argv[])
+{
+
+  uint32_t nContacts = 10000;
+  uint32_t nNodes = 100;
+  uint32_t nLookups = 1000000;
+  uint32_t maxRoutes = 3;
+  std::string plan = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("contacts", "Number of contacts of the random contact plan", nContacts);
+  cmd.AddValue ("nodes", "Number of nodes of the random contact plan", nNodes);
+  cmd.AddValue ("lookups", "Number of route lookups once the routes are cached", nLookups);
+  cmd.AddValue ("routes", "Number of routes computed per destination", maxRoutes);
+  cmd.AddValue ("plan", "Contact plan file, instead of a random one", plan);
+  cmd.Parse (argc, argv);
+
+  Ptr<BpCgrRoutingProtocol> cgr = CreateObject<BpCgrRoutingProtocol> ();
+  cgr->SetAttribute ("MaxRoutes", UintegerValue (maxRoutes));
+  cgr->SetLocalNode (1);
+
+  if (plan != "")
+    {
+      if (cgr->LoadContactPlan (plan) < 0)
+        {
+          std::cout << "Cannot read " << plan << std::endl;
+          return 1;
+        }
+    }
+  else
+    {
+      Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+      for (uint32_t i = 1; i <= nNodes; i++)
+        {
+          for (uint32_t j = i + 1; j <= nNodes; j++)
+            {
+              cgr->AddRange (0, 86400, i, j, random->GetValue (0.001, 2.0));
+            }
+        }
+      for (uint32_t c = 0; c < nContacts; c++)
+        {
+          uint32_t from = random->GetInteger (1, nNodes);
+          uint32_t to = random->GetInteger (1, nNodes - 1);
+          if (to >= from)
+            to++;
+          double start = random->GetValue (0, 86400 - 600);
+          cgr->AddContact (start, start + random->GetValue (60, 600), from, to, 125000);
+        }
+    }
+  std::cout << "Contact plan of " << cgr->GetNContacts () << " contacts" << std::endl;
+
+  std::vector<BpEndpointId> destinations;
+  for (uint32_t i = 2; i <= nNodes; i++)
+    {
+      std::ostringstream ssp;
+      ssp << i << ".1";
+      destinations.push_back (BpEndpointId ("ipn", ssp.str ()));
+    }
+
+  uint32_t reachable = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < destinations.size (); i++)
+    {
+      if (cgr->GetRoute (destinations[i]) != destinations[i])
+        reachable++;
+    }
+  std::chrono::duration<double> cold = std::chrono::steady_clock::now () - start;
+  std::cout << reachable << " of " << destinations.size () << " destinations reachable, "
+            << cold.count () / destinations.size () * 1e6 << " us per lookup computing the routes" << std::endl;
+
+  start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < nLookups; i++)
+    {
+      cgr->GetRoute (destinations[i % destinations.size ()]);
+    }
+  std::chrono::duration<double> warm = std::chrono::steady_clock::now () - start;
+  std::cout << warm.count () / nLookups * 1e6 << " us per lookup with cached routes" << std::endl;
+
+  Simulator::Destroy ();
+
+}
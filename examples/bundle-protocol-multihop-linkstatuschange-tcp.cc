@@ -33,6 +33,7 @@
 #include "ns3/bp-endpoint-id.h"
 #include "ns3/bundle-protocol.h"
 #include "ns3/bp-static-routing-protocol.h"
+#include "ns3/bp-link-state-routing-protocol.h"
 #include "ns3/bundle-protocol-helper.h"
 #include "ns3/bundle-protocol-container.h"
 
@@ -98,21 +99,17 @@ void Register (Ptr<BundleProtocol> node, BpEndpointId eid, InetSocketAddress l4A
     node->ExternalRegister (eid, 0, true, l4Address);
 }
 
-/*
 void setIfaceDown (Ptr<Ipv4> node, uint32_t i_index)
 {
-    //pv4_node1->SetDown(1)
     std::cout << Simulator::Now ().GetMilliSeconds () << " Setting interface " << i_index << " on node " << node << " to _down_" << std::endl;
     node->SetDown(i_index);
 }
 
 void setIfaceUp (Ptr<Ipv4> node, uint32_t i_index)
 {
-    //pv4_node1->SetDown(1)
     std::cout << Simulator::Now ().GetMilliSeconds () << " Setting interface " << i_index << " on node " << node << " to _up_" << std::endl;
     node->SetUp(i_index);
 }
-*/
 
 void print_Ipv4InterfaceAddress (Ptr<Ipv4Interface> iface_node)
 {
@@ -207,8 +204,10 @@ main (int argc, char *argv[])
   Ptr<BpStaticRoutingProtocol> route_sender = CreateObject<BpStaticRoutingProtocol> (); // static routes for sender
   route_sender->AddRoute (eidRecv, eidForwarder); // dest: recv; next_hop: forwarder
 
-  // set bundle static routing for forwarder
-  Ptr<BpStaticRoutingProtocol> route_forwarder = CreateObject<BpStaticRoutingProtocol> (); // static routes for forwarder
+  // set bundle link-state routing for forwarder: the receiver is watched, and
+  // the bundles towards it are held while its link is down
+  Ptr<BpLinkStateRoutingProtocol> route_forwarder = CreateObject<BpLinkStateRoutingProtocol> (); // link-state routes for forwarder
+  route_forwarder->AddRoute (eidRecv, eidRecv); // dest: recv; next_hop: recv
 
   // set bundle static routing for recv
   Ptr<BpStaticRoutingProtocol> route_recv = CreateObject<BpStaticRoutingProtocol> (); // static routes for recv
@@ -251,12 +250,13 @@ main (int argc, char *argv[])
   Simulator::Schedule (Seconds (0.2), &Register, bpSenders.Get (0), eidForwarder, forwarderL4addr_link1);
   Simulator::Schedule (Seconds (0.2), &Register, bpSenders.Get (0), eidRecv, recvL4addr);
 
-  // Get forwarder's link2 interface and set to down
-  Ptr<Ipv4L3Protocol> ipv4l3_node1 = link2_nodes.Get(0)->GetObject<Ipv4L3Protocol> ();
-  Ptr<Ipv4Interface> iface2_node1 = ipv4l3_node1->GetInterface(2);
+  // Get forwarder's link2 interface and set to down; unlike Ipv4Interface::SetDown,
+  // Ipv4::SetDown tells the routing protocols, so the forwarder holds the bundles
+  // at once instead of waiting for TCP to give up
+  Ptr<Ipv4> ipv4_node1 = link2_nodes.Get(0)->GetObject<Ipv4> ();
 
   // Shutting node1 interface 2 down
-  Simulator::Schedule (Seconds (0.211), &Ipv4Interface::SetDown,iface2_node1);
+  Simulator::Schedule (Seconds (0.211), &setIfaceDown, ipv4_node1, 2);
 
 /*
   char data[] = "Mr. Chairman, this movement is exclusively the work of politicians; "
@@ -295,7 +295,7 @@ char data[] = "The Senate of the United States shall be composed of two Senators
   Simulator::Schedule (Seconds (0.3), &Send_char_array, bpSenders.Get (0), data, eidSender, eidRecv);  
 
   // set forwarder's link2 interface to up
-  Simulator::Schedule (Seconds (1), &Ipv4Interface::SetUp,iface2_node1);
+  Simulator::Schedule (Seconds (1), &setIfaceUp, ipv4_node1, 2);
 
   // receive function
   Simulator::Schedule (Seconds (1.5), &Receive_char_array, bpReceivers.Get (0), eidRecv);
@@ -0,0 +1,184 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Network topology
+//
+//       n0 ----------- n1 ----------- n2
+//            csma           csma
+//          5 Mbps, 2 ms   5 Mbps, 2 ms
+//
+// - Flow from n0 to n2 through n1 using bundle protocol over the
+//   NetDevice convergence layer: the nodes have no Internet stack and
+//   bundles are framed directly on the CSMA devices.
+// - The bundle is larger than the device MTU and is sent as bundle
+//   fragments, which n2 reassembles.
+// - Pcap tracing available when tracing is turned on.
+
+#include <string>
+#include <fstream>
+#include "ns3/core-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/network-module.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/bp-endpoint-id.h"
+#include "ns3/bundle-protocol.h"
+#include "ns3/bp-netdevice-cla-protocol.h"
+#include "ns3/bp-static-routing-protocol.h"
+#include "ns3/bundle-protocol-helper.h"
+#include "ns3/bundle-protocol-container.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BundleProtocolNetDeviceClaExample");
+
+void Send (Ptr<BundleProtocol> sender, uint32_t size, BpEndpointId src, BpEndpointId dst)
+{
+  std::cout << Simulator::Now ().GetMilliSeconds () << " Send a PDU with size " << size << std::endl;
+
+  Ptr<Packet> packet = Create<Packet> (size);
+  sender->Send (packet, src, dst);
+}
+
+void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      std::cout << Simulator::Now ().GetMilliSeconds () << " Receive bundle size " << p->GetSize () << std::endl;
+      p = receiver->Receive (eid);
+    }
+}
+
+void Register (Ptr<BundleProtocol> node, BpEndpointId eid)
+{
+    std::cout << Simulator::Now ().GetMilliSeconds () << " Registering external node " << eid.Uri () << std::endl;
+    // the L4 address is not used by the NetDevice CLA
+    node->ExternalRegister (eid, 0, true, InetSocketAddress (Ipv4Address::GetAny (), 0));
+}
+
+void AddNeighbour (Ptr<BundleProtocol> node, BpEndpointId eid, Ptr<NetDevice> local, Ptr<NetDevice> remote)
+{
+  Ptr<BpNetDeviceClaProtocol> cla = DynamicCast<BpNetDeviceClaProtocol> (node->GetCla ());
+  cla->AddNeighbour (eid, local, remote->GetAddress ());
+}
+
+int
+main (int argc, char *argv[])
+{
+
+  bool tracing = true;
+
+  NS_LOG_INFO ("Create bundle nodes.");
+  NodeContainer nodes, link1_nodes, link2_nodes;
+  nodes.Create (3);
+
+  link1_nodes.Add(nodes.Get(0));
+  link1_nodes.Add(nodes.Get(1));
+
+  link2_nodes.Add(nodes.Get(1));
+  link2_nodes.Add(nodes.Get(2));
+
+  NS_LOG_INFO ("Create channels.");
+
+  // no InternetStackHelper: the bundle protocol is the only protocol on the devices
+  CsmaHelper csma;
+  csma.SetChannelAttribute ("DataRate", StringValue ("5Mbps"));
+  csma.SetChannelAttribute ("Delay", StringValue ("2ms"));
+
+  NetDeviceContainer link1_devices, link2_devices;
+  link1_devices = csma.Install (link1_nodes);
+  link2_devices = csma.Install (link2_nodes);
+
+  NS_LOG_INFO ("Create bundle applications.");
+
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("NetDevice"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (4000));
+
+  // build endpoint ids
+  BpEndpointId eidSender ("dtn", "node0");
+  BpEndpointId eidForwarder ("dtn", "node1");
+  BpEndpointId eidRecv ("dtn", "node2");
+
+  // set bundle static routing for sender
+  Ptr<BpStaticRoutingProtocol> route_sender = CreateObject<BpStaticRoutingProtocol> ();
+  route_sender->AddRoute (eidRecv, eidForwarder); // dest: recv; next_hop: forwarder
+
+  // set bundle static routing for forwarder; both destinations are neighbours
+  Ptr<BpStaticRoutingProtocol> route_forwarder = CreateObject<BpStaticRoutingProtocol> ();
+
+  // set bundle static routing for recv
+  Ptr<BpStaticRoutingProtocol> route_recv = CreateObject<BpStaticRoutingProtocol> ();
+  route_recv->AddRoute (eidSender, eidForwarder); // dest: sender; next_hop: forwarder
+
+  // sender
+  BundleProtocolHelper bpSenderHelper;
+  bpSenderHelper.SetRoutingProtocol (route_sender);
+  bpSenderHelper.SetBpEndpointId (eidSender);
+  BundleProtocolContainer bpSenders = bpSenderHelper.Install (nodes.Get (0));
+  bpSenders.Start (Seconds (0.2));
+  bpSenders.Stop (Seconds (1.0));
+
+  // forwarder
+  BundleProtocolHelper bpForwarderHelper;
+  bpForwarderHelper.SetRoutingProtocol (route_forwarder);
+  bpForwarderHelper.SetBpEndpointId (eidForwarder);
+  BundleProtocolContainer bpForwarders = bpForwarderHelper.Install (nodes.Get (1));
+  bpForwarders.Start (Seconds (0.1));
+  bpForwarders.Stop (Seconds (1.0));
+
+  // receiver
+  BundleProtocolHelper bpReceiverHelper;
+  bpReceiverHelper.SetRoutingProtocol (route_recv);
+  bpReceiverHelper.SetBpEndpointId (eidRecv);
+  BundleProtocolContainer bpReceivers = bpReceiverHelper.Install (nodes.Get (2));
+  bpReceivers.Start (Seconds (0.0));
+  bpReceivers.Stop (Seconds (1.0));
+
+  // link layer addresses of the neighbours
+  AddNeighbour (bpSenders.Get (0), eidForwarder, link1_devices.Get (0), link1_devices.Get (1));
+  AddNeighbour (bpForwarders.Get (0), eidSender, link1_devices.Get (1), link1_devices.Get (0));
+  AddNeighbour (bpForwarders.Get (0), eidRecv, link2_devices.Get (0), link2_devices.Get (1));
+  AddNeighbour (bpReceivers.Get (0), eidForwarder, link2_devices.Get (1), link2_devices.Get (0));
+
+  // register external nodes with each node
+  Simulator::Schedule (Seconds (0.0), &Register, bpSenders.Get (0), eidForwarder);
+  Simulator::Schedule (Seconds (0.0), &Register, bpSenders.Get (0), eidRecv);
+
+  Simulator::Schedule (Seconds (0.0), &Register, bpForwarders.Get (0), eidSender);
+  Simulator::Schedule (Seconds (0.0), &Register, bpForwarders.Get (0), eidRecv);
+
+  Simulator::Schedule (Seconds (0.0), &Register, bpReceivers.Get (0), eidForwarder);
+  Simulator::Schedule (Seconds (0.0), &Register, bpReceivers.Get (0), eidSender);
+
+  // sending bundle
+  Simulator::Schedule (Seconds (0.3), &Send, bpSenders.Get (0), 3000, eidSender, eidRecv);
+
+  // receive function
+  Simulator::Schedule (Seconds (0.8), &Receive, bpReceivers.Get (0), eidRecv);
+
+  if (tracing)
+    {
+      csma.EnablePcapAll ("bundle-protocol-netdevice-cla", false);
+    }
+
+  NS_LOG_INFO ("Run Simulation.");
+  Simulator::Stop (Seconds (1.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_LOG_INFO ("Done.");
+
+}
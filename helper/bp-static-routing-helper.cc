@@ -0,0 +1,427 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#include "bp-static-routing-helper.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/node-list.h"
+#include "ns3/net-device.h"
+#include "ns3/channel.h"
+#include "ns3/ipv4.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/bp-static-routing-protocol.h"
+#include "ns3/bp-forwarding-table.h"
+#include "ns3/bp-netdevice-cla-protocol.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+NS_LOG_COMPONENT_DEFINE ("BpStaticRoutingHelper");
+
+namespace ns3 {
+
+// default port number of the dtn bundle tcp and udp convergence layers
+#define DTN_BUNDLE_PORT 4556
+
+// sources whose routes are computed before they are installed, per thread
+#define ROWS_PER_THREAD 16
+
+/**
+ * \brief An edge of the topology graph: a channel between two devices
+ */
+struct BpTopologyEdge
+{
+  uint32_t to;            /// id of the node at the other end
+  uint32_t localDevice;   /// index of the local device in the device table
+  uint32_t remoteDevice;  /// index of the remote device in the device table
+};
+
+/**
+ * \brief An edge of the distribution tree of a source towards a group
+ */
+struct BpGroupEdge
+{
+  uint32_t src;           /// bundle node index of the source
+  uint32_t group;         /// index of the group
+  uint32_t to;            /// bundle node index of the next hop
+};
+
+/**
+ * Breadth-first search from a source node, keeping for every node the
+ * first bundle node after the source on the path to it, and the last
+ * bundle node before it
+ *
+ * Only plain data is read, so that searches can run in parallel threads.
+ *
+ * \param src the id of the source node
+ * \param adjacency the edges of each node
+ * \param bpOfNode the bundle node index of each node, -1 if none
+ * \param nBp the number of bundle nodes
+ * \param row the next hop (bundle node index) towards each bundle node, -1 if unreachable
+ * \param up the previous bundle node (bundle node index) on the path to
+ * each bundle node, -1 if unreachable: the parents in the shortest path
+ * tree of the source
+ */
+static void
+ComputeNextHops (uint32_t src, const std::vector<std::vector<BpTopologyEdge> > &adjacency,
+                 const std::vector<int32_t> &bpOfNode, uint32_t nBp, std::vector<int32_t> &row,
+                 std::vector<int32_t> &up)
+{
+  // -2: not visited, -1: no bundle node on the path yet
+  std::vector<int32_t> first (adjacency.size (), -2);
+  // the last bundle node before each node
+  std::vector<int32_t> last (adjacency.size (), -1);
+  std::vector<uint32_t> queue;
+  queue.reserve (adjacency.size ());
+  first[src] = -1;
+  queue.push_back (src);
+  for (size_t head = 0; head < queue.size (); head++)
+    {
+      uint32_t u = queue[head];
+      for (std::vector<BpTopologyEdge>::const_iterator it = adjacency[u].begin (); it != adjacency[u].end (); ++it)
+        {
+          uint32_t v = (*it).to;
+          if (first[v] != -2)
+            continue;
+          first[v] = (first[u] >= 0) ? first[u] : bpOfNode[v];
+          last[v] = (bpOfNode[u] >= 0) ? bpOfNode[u] : last[u];
+          queue.push_back (v);
+        }
+    }
+
+  row.assign (nBp, -1);
+  up.assign (nBp, -1);
+  for (uint32_t v = 0; v < adjacency.size (); v++)
+    {
+      if (v != src && bpOfNode[v] >= 0 && first[v] >= 0)
+        {
+          row[bpOfNode[v]] = first[v];
+          up[bpOfNode[v]] = last[v];
+        }
+    }
+}
+
+/**
+ * Get the IPv4 address of a node, preferably the one of a given device
+ *
+ * \return the address, or 0.0.0.0 if the node has no IPv4 address
+ */
+static Ipv4Address
+GetNodeAddress (Ptr<Node> node, Ptr<NetDevice> device)
+{
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  if (ipv4 == NULL)
+    return Ipv4Address::GetAny ();
+
+  if (device != NULL)
+    {
+      int32_t interface = ipv4->GetInterfaceForDevice (device);
+      if (interface >= 0 && ipv4->GetNAddresses (interface) > 0)
+        return ipv4->GetAddress (interface, 0).GetLocal ();
+    }
+
+  // interface 0 is the loopback
+  for (uint32_t i = 1; i < ipv4->GetNInterfaces (); i++)
+    {
+      if (ipv4->GetNAddresses (i) > 0)
+        return ipv4->GetAddress (i, 0).GetLocal ();
+    }
+  return Ipv4Address::GetAny ();
+}
+
+/**
+ * Give the CLA of a bundle node the address of a neighbour bundle node:
+ * its IPv4 address with the given port, or its link layer address for the
+ * NetDevice CLA
+ *
+ * \param bp the bundle node
+ * \param neighbour the neighbour bundle node
+ * \param adjacency the edges of each node
+ * \param devices the device table of the edges
+ * \param port the port of the L4 addresses
+ */
+static void
+AddNeighbourAddress (Ptr<BundleProtocol> bp, Ptr<BundleProtocol> neighbour,
+                     const std::vector<std::vector<BpTopologyEdge> > &adjacency,
+                     const std::vector<Ptr<NetDevice> > &devices, uint16_t port)
+{
+  uint32_t srcNode = bp->GetNode ()->GetId ();
+  uint32_t neighbourNode = neighbour->GetNode ()->GetId ();
+  BpEndpointId eid = bp->GetBpEndpointId ();
+  BpEndpointId neighbourEid = neighbour->GetBpEndpointId ();
+
+  // the channel to the neighbour, if it is adjacent
+  const BpTopologyEdge *edge = NULL;
+  for (std::vector<BpTopologyEdge>::const_iterator it = adjacency[srcNode].begin (); it != adjacency[srcNode].end (); ++it)
+    {
+      if ((*it).to == neighbourNode)
+        {
+          edge = &(*it);
+          break;
+        }
+    }
+
+  Ptr<BpClaProtocol> cla = bp->GetCla ();
+  Ptr<BpNetDeviceClaProtocol> netDeviceCla = DynamicCast<BpNetDeviceClaProtocol> (cla);
+  if (netDeviceCla != NULL)
+    {
+      if (edge == NULL)
+        {
+          NS_LOG_WARN ("Next hop " << neighbourEid.Uri () << " of " << eid.Uri () << " is not on a shared channel, the NetDevice CLA cannot reach it");
+          return;
+        }
+      netDeviceCla->AddNeighbour (neighbourEid, devices[edge->localDevice], devices[edge->remoteDevice]->GetAddress ());
+      return;
+    }
+
+  Ipv4Address address = GetNodeAddress (neighbour->GetNode (), edge ? devices[edge->remoteDevice] : NULL);
+  if (address == Ipv4Address::GetAny ())
+    {
+      NS_LOG_WARN ("Next hop " << neighbourEid.Uri () << " of " << eid.Uri () << " has no IPv4 address");
+      return;
+    }
+  cla->setL4Address (neighbourEid, InetSocketAddress (address, port));
+}
+
+BpStaticRoutingHelper::BpStaticRoutingHelper ()
+  : m_threads (0),
+    m_port (DTN_BUNDLE_PORT)
+{
+}
+
+void
+BpStaticRoutingHelper::SetThreads (uint32_t threads)
+{
+  m_threads = threads;
+}
+
+void
+BpStaticRoutingHelper::SetPort (uint16_t port)
+{
+  m_port = port;
+}
+
+void
+BpStaticRoutingHelper::AddGroupMember (const BpEndpointId &group, Ptr<BundleProtocol> member)
+{
+  NS_LOG_FUNCTION (this << " " << group.Uri () << " " << member);
+  member->JoinGroup (group);
+  m_groups[group].push_back (member);
+}
+
+void
+BpStaticRoutingHelper::PopulateRoutingTables (BundleProtocolContainer bps)
+{
+  NS_LOG_FUNCTION (this << " " << bps.GetN ());
+
+  uint32_t nNodes = NodeList::GetNNodes ();
+  std::vector<Ptr<BundleProtocol> > bpAtNode (nNodes);
+  for (BundleProtocolContainer::Iterator it = bps.Begin (); it != bps.End (); ++it)
+    {
+      uint32_t node = (*it)->GetNode ()->GetId ();
+      if (bpAtNode[node] != NULL)
+        NS_FATAL_ERROR ("BpStaticRoutingHelper::PopulateRoutingTables (): more than one bundle protocol on node " << node);
+      bpAtNode[node] = *it;
+    }
+
+  // the topology graph: one edge per pair of devices sharing a channel
+  std::vector<Ptr<NetDevice> > devices;
+  std::vector<std::vector<BpTopologyEdge> > adjacency (nNodes);
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      Ptr<Node> node = NodeList::GetNode (n);
+      for (uint32_t d = 0; d < node->GetNDevices (); d++)
+        {
+          Ptr<NetDevice> device = node->GetDevice (d);
+          Ptr<Channel> channel = device->GetChannel ();
+          if (channel == NULL)
+            continue;
+          uint32_t local = devices.size ();
+          devices.push_back (device);
+          for (std::size_t j = 0; j < channel->GetNDevices (); j++)
+            {
+              Ptr<NetDevice> remote = channel->GetDevice (j);
+              if (remote == device)
+                continue;
+              BpTopologyEdge edge;
+              edge.to = remote->GetNode ()->GetId ();
+              edge.localDevice = local;
+              edge.remoteDevice = devices.size ();
+              devices.push_back (remote);
+              adjacency[n].push_back (edge);
+            }
+        }
+    }
+
+  // bundle nodes numbered in depth first order of the network: the
+  // destinations reached through the same neighbour get close handles, and
+  // the rows of the forwarding table few runs
+  std::vector<Ptr<BundleProtocol> > bpList;
+  std::vector<bool> visited (nNodes, false);
+  std::vector<std::pair<uint32_t, uint32_t> > stack; // (node, next edge)
+  for (uint32_t root = 0; root < nNodes; root++)
+    {
+      if (visited[root])
+        continue;
+      visited[root] = true;
+      if (bpAtNode[root] != NULL)
+        bpList.push_back (bpAtNode[root]);
+      stack.push_back (std::make_pair (root, 0));
+      while (!stack.empty ())
+        {
+          uint32_t u = stack.back ().first;
+          if (stack.back ().second == adjacency[u].size ())
+            {
+              stack.pop_back ();
+              continue;
+            }
+          uint32_t v = adjacency[u][stack.back ().second++].to;
+          if (visited[v])
+            continue;
+          visited[v] = true;
+          if (bpAtNode[v] != NULL)
+            bpList.push_back (bpAtNode[v]);
+          stack.push_back (std::make_pair (v, 0));
+        }
+    }
+
+  uint32_t nBp = bpList.size ();
+  std::vector<BpEndpointId> eids (nBp);
+  std::vector<int32_t> bpOfNode (nNodes, -1);
+  for (uint32_t i = 0; i < nBp; i++)
+    {
+      eids[i] = bpList[i]->GetBpEndpointId ();
+      bpOfNode[bpList[i]->GetNode ()->GetId ()] = i;
+    }
+  Ptr<BpForwardingTable> table = Create<BpForwardingTable> (eids);
+
+  // the members of each group
+  std::vector<BpEndpointId> groups;
+  std::vector<std::vector<uint32_t> > members;
+  for (std::map<BpEndpointId, std::vector<Ptr<BundleProtocol> > >::iterator it = m_groups.begin (); it != m_groups.end (); ++it)
+    {
+      groups.push_back ((*it).first);
+      members.push_back (std::vector<uint32_t> ());
+      for (std::vector<Ptr<BundleProtocol> >::iterator itMember = (*it).second.begin (); itMember != (*it).second.end (); ++itMember)
+        {
+          int32_t member = bpOfNode[(*itMember)->GetNode ()->GetId ()];
+          if (member < 0)
+            NS_FATAL_ERROR ("BpStaticRoutingHelper::PopulateRoutingTables (): a member of group " << (*it).first.Uri () << " is not in the bundle protocols");
+          members.back ().push_back (member);
+        }
+    }
+  // the edges of the distribution trees, by bundle node index of their start
+  std::vector<std::vector<BpGroupEdge> > groupEdges (groups.empty () ? 0 : nBp);
+  std::vector<Ptr<BpStaticRoutingProtocol> > routeOf (nBp);
+
+  uint32_t threads = m_threads;
+  if (threads == 0)
+    threads = std::max (1u, std::thread::hardware_concurrency ());
+
+  // the searches of a batch of sources run in parallel; the routes are
+  // installed by this thread, since ns-3 objects are not thread-safe
+  uint32_t batch = threads * ROWS_PER_THREAD;
+  std::vector<std::vector<int32_t> > rows (std::min (batch, nBp));
+  std::vector<std::vector<int32_t> > ups (std::min (batch, nBp));
+  for (uint32_t begin = 0; begin < nBp; begin += batch)
+    {
+      uint32_t end = std::min (begin + batch, nBp);
+      std::vector<std::thread> workers;
+      for (uint32_t t = 0; t < threads && begin + t < end; t++)
+        {
+          workers.push_back (std::thread ([&, t] ()
+            {
+              for (uint32_t s = begin + t; s < end; s += threads)
+                ComputeNextHops (bpList[s]->GetNode ()->GetId (), adjacency, bpOfNode, nBp, rows[s - begin], ups[s - begin]);
+            }));
+        }
+      for (uint32_t t = 0; t < workers.size (); t++)
+        workers[t].join ();
+
+      for (uint32_t s = begin; s < end; s++)
+        {
+          const std::vector<int32_t> &row = rows[s - begin];
+          const std::vector<int32_t> &up = ups[s - begin];
+          Ptr<BundleProtocol> bp = bpList[s];
+
+          std::vector<bool> isNextHop (nBp, false);
+          for (uint32_t d = 0; d < nBp; d++)
+            {
+              if (row[d] >= 0)
+                isNextHop[row[d]] = true;
+            }
+          table->AddRow (row);
+
+          Ptr<BpStaticRoutingProtocol> route = CreateObject<BpStaticRoutingProtocol> ();
+          route->SetForwardingTable (table, s);
+          route->SetBundleProtocol (bp);
+          bp->SetRoutingProtocol (route);
+          routeOf[s] = route;
+
+          Ptr<BpClaProtocol> cla = bp->GetCla ();
+          if (DynamicCast<BpNetDeviceClaProtocol> (cla) == NULL)
+            cla->setL4Address (eids[s], InetSocketAddress (GetNodeAddress (bp->GetNode (), NULL), m_port));
+
+          for (uint32_t h = 0; h < nBp; h++)
+            {
+              if (isNextHop[h])
+                AddNeighbourAddress (bp, bpList[h], adjacency, devices, m_port);
+            }
+
+          // the distribution trees of this source: the paths from the
+          // members up to the source, merged where they meet
+          for (uint32_t g = 0; g < groups.size (); g++)
+            {
+              std::vector<uint32_t> onTree;
+              for (std::vector<uint32_t>::iterator it = members[g].begin (); it != members[g].end (); ++it)
+                {
+                  for (uint32_t v = *it; v != s && up[v] >= 0; v = up[v])
+                    {
+                      if (std::find (onTree.begin (), onTree.end (), v) != onTree.end ())
+                        break;
+                      onTree.push_back (v);
+                      BpGroupEdge edge;
+                      edge.src = s;
+                      edge.group = g;
+                      edge.to = v;
+                      groupEdges[up[v]].push_back (edge);
+                    }
+                }
+            }
+        }
+    }
+
+  // the trees cross the nodes of other sources: installed once all routing
+  // protocols exist
+  for (uint32_t b = 0; b < groupEdges.size (); b++)
+    {
+      for (uint32_t g = 0; g < groups.size (); g++)
+        routeOf[b]->AddGroup (groups[g]);
+      for (std::vector<BpGroupEdge>::iterator it = groupEdges[b].begin (); it != groupEdges[b].end (); ++it)
+        {
+          if (routeOf[b]->AddGroupRoute (eids[(*it).src], groups[(*it).group], eids[(*it).to]) == 0)
+            AddNeighbourAddress (bpList[b], bpList[(*it).to], adjacency, devices, m_port);
+        }
+    }
+
+  NS_LOG_INFO ("Installed the routes of " << nBp << " bundle nodes over " << nNodes << " nodes, in a forwarding table of " << table->GetRowBytes () << " bytes");
+}
+
+} // namespace ns3
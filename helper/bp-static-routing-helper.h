@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dizhi Zhou <dizhi.zhou@gmail.com>
+ */
+
+#ifndef BP_STATIC_ROUTING_HELPER_H
+#define BP_STATIC_ROUTING_HELPER_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include "ns3/bundle-protocol-container.h"
+#include "ns3/bundle-protocol.h"
+
+namespace ns3 {
+
+/**
+ * \brief A helper to compute the static bundle routes of a whole topology
+ *
+ * The helper walks the channels of all nodes and computes, for every pair
+ * of bundle nodes, the next bundle node on a shortest path (in hops) by a
+ * breadth-first search from each source, i.e. in O(N (N + E)). The
+ * searches run in parallel threads. Nodes without a bundle protocol are
+ * crossed at the IP layer and need IP routes between the bundle nodes.
+ *
+ * The routes are compiled into one BpForwardingTable, in which the bundle
+ * nodes are numbered in depth first order of the network, and shared by
+ * the new BpStaticRoutingProtocol of every bundle node. Each default CLA
+ * gets the addresses of its own endpoint id and of its next hops: IPv4
+ * addresses with the given port, or link layer neighbours for the
+ * NetDevice CLA. Destinations are not registered; the
+ * bundles towards them are forwarded on their route.
+ */
+class BpStaticRoutingHelper
+{
+public:
+  /**
+   * Create a BpStaticRoutingHelper
+   */
+  BpStaticRoutingHelper ();
+
+  /**
+   * Set the number of threads computing the routes
+   *
+   * \param threads the number of threads; 0 uses one per hardware thread
+   */
+  void SetThreads (uint32_t threads);
+
+  /**
+   * Set the port of the L4 addresses of the bundle nodes
+   *
+   * \param port the port number
+   */
+  void SetPort (uint16_t port);
+
+  /**
+   * Compute the routes between all bundle nodes and install them
+   *
+   * Call it after the bundle protocols are installed and the IPv4
+   * addresses assigned, before the simulation starts.
+   *
+   * \param bps the bundle protocols of all bundle nodes
+   */
+  void PopulateRoutingTables (BundleProtocolContainer bps);
+
+  /**
+   * Make a bundle node a member of a group endpoint id
+   *
+   * The member joins the group (BundleProtocol::JoinGroup ()). For every
+   * bundle node, PopulateRoutingTables () then computes the distribution
+   * tree of the group: the union of its shortest paths to the members, so
+   * that a bundle sent to the group is copied only where the paths split.
+   *
+   * \param group the group endpoint id
+   * \param member the bundle protocol of the member
+   */
+  void AddGroupMember (const BpEndpointId &group, Ptr<BundleProtocol> member);
+
+private:
+  uint32_t m_threads;                        /// number of threads; 0 is one per hardware thread
+  uint16_t m_port;                           /// port of the L4 addresses
+  std::map<BpEndpointId, std::vector<Ptr<BundleProtocol> > > m_groups; /// members of each group
+};
+
+} // namespace ns3
+
+#endif /* BP_STATIC_ROUTING_HELPER_H */
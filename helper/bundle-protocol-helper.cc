@@ -28,7 +28,8 @@ namespace ns3 {
 
 BundleProtocolHelper::BundleProtocolHelper ()
   : m_eid ("dtn:none"),
-    m_routingProtocol (0)
+    m_routingProtocol (0),
+    m_routingPerNode (false)
 {
 }
 
@@ -62,13 +63,16 @@ BundleProtocolHelper::InstallPriv (Ptr<Node> node)
 {
   if (m_eid.Uri () == "dtn:none")
     NS_FATAL_ERROR ("BundleProtocolHelper::InstallPriv (): do not have endpoint id!");
-  if (m_routingProtocol == 0)
+  Ptr<BpRoutingProtocol> route = m_routingProtocol;
+  if (m_routingPerNode)
+    route = m_routingFactory.Create<BpRoutingProtocol> ();
+  if (route == 0)
     NS_FATAL_ERROR ("BundleProtocolHelper::InstallPriv (): do not have bundle routing protocol! " << m_eid.Uri ());
 
   Ptr<BundleProtocol> bundleProtocol = CreateObject<BundleProtocol> ();
   bundleProtocol->Open (node);   
   bundleProtocol->SetBpEndpointId (m_eid);
-  bundleProtocol->SetRoutingProtocol (m_routingProtocol);
+  bundleProtocol->SetRoutingProtocol (route);
   Simulator::Schedule (Seconds (0.0), &BundleProtocol::Initialize, bundleProtocol);
 
   return bundleProtocol;
@@ -84,6 +88,19 @@ void
 BundleProtocolHelper::SetRoutingProtocol (Ptr<BpRoutingProtocol> rt)
 {
   m_routingProtocol = rt;
+  m_routingPerNode = false;
+}
+
+void
+BundleProtocolHelper::SetRoutingProtocol (std::string type,
+                                          std::string n0, const AttributeValue &v0,
+                                          std::string n1, const AttributeValue &v1)
+{
+  m_routingFactory.SetTypeId (type);
+  m_routingFactory.Set (n0, v0);
+  m_routingFactory.Set (n1, v1);
+  m_routingProtocol = 0;
+  m_routingPerNode = true;
 }
 
 
@@ -89,6 +89,20 @@ public:
    */
   void SetRoutingProtocol (Ptr<BpRoutingProtocol> rt);
 
+  /**
+   * Set the type of the bundle routing protocol, of which each node gets
+   * its own instance; needed by the routing protocols keeping per-node state
+   *
+   * \param type the type of the bundle routing protocol
+   * \param n0 the name of the attribute to set
+   * \param v0 the value of the attribute to set
+   * \param n1 the name of the attribute to set
+   * \param v1 the value of the attribute to set
+   */
+  void SetRoutingProtocol (std::string type,
+                           std::string n0 = "", const AttributeValue &v0 = EmptyAttributeValue (),
+                           std::string n1 = "", const AttributeValue &v1 = EmptyAttributeValue ());
+
 private:
   /**
    * \internal
@@ -102,6 +116,8 @@ private:
 private:
   BpEndpointId m_eid;                        /// endpoint id
   Ptr<BpRoutingProtocol> m_routingProtocol;  /// bundle routing protocol
+  ObjectFactory m_routingFactory;            /// factory of the bundle routing protocol of each node
+  bool m_routingPerNode;                     /// each node gets its own bundle routing protocol
 };
 
 } // namespace ns3
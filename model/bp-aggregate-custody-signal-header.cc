@@ -0,0 +1,210 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "bp-aggregate-custody-signal-header.h"
+#include "sdnv.h"
+
+NS_LOG_COMPONENT_DEFINE ("BpAggregateCustodySignalHeader");
+
+namespace ns3 {
+
+BpAggregateCustodySignalHeader::BpAggregateCustodySignalHeader ()
+  : m_succeeded (false),
+    m_reason (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpAggregateCustodySignalHeader::~BpAggregateCustodySignalHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+BpAggregateCustodySignalHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpAggregateCustodySignalHeader")
+                      .SetParent<Header> ()
+                      .AddConstructor<BpAggregateCustodySignalHeader> ();
+
+  return tid;
+}
+
+TypeId
+BpAggregateCustodySignalHeader::GetInstanceTypeId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return GetTypeId ();
+}
+
+bool
+BpAggregateCustodySignalHeader::IsAggregateCustodySignal (Ptr<const Packet> record)
+{
+  if (record->GetSize () < 3)
+    return false;
+
+  uint8_t type;
+  record->CopyData (&type, 1);
+  return (type >> 4) == RECORD_TYPE;
+}
+
+uint32_t
+BpAggregateCustodySignalHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  SDNV sdnv;
+
+  // record type and flags, status
+  uint32_t size = 2;
+  size += sdnv.EncodingLength (m_fills.size ());
+  uint64_t end = 0;
+  for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator it = m_fills.begin (); it != m_fills.end (); ++it)
+    {
+      size += sdnv.EncodingLength ((*it).first - end) + sdnv.EncodingLength ((*it).second);
+      end = (*it).first + (*it).second;
+    }
+
+  return size;
+}
+
+void
+BpAggregateCustodySignalHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  os << (m_succeeded ? "succeeded" : "failed") << " reason " << (uint16_t) m_reason << " fills";
+  for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator it = m_fills.begin (); it != m_fills.end (); ++it)
+    {
+      os << " " << (*it).first << "+" << (*it).second;
+    }
+}
+
+static void
+WriteSdnv (Buffer::Iterator &i, uint64_t val)
+{
+  SDNV sdnv;
+  std::vector<uint8_t> encoded = sdnv.Encode (val);
+  for (std::vector<uint8_t>::iterator it = encoded.begin (); it != encoded.end (); ++it)
+    {
+      i.WriteU8 (*it);
+    }
+}
+
+void
+BpAggregateCustodySignalHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+
+  i.WriteU8 (RECORD_TYPE << 4);
+  i.WriteU8 ((m_succeeded ? 0x80 : 0) | (m_reason & 0x7f));
+  WriteSdnv (i, m_fills.size ());
+  uint64_t end = 0;
+  for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator it = m_fills.begin (); it != m_fills.end (); ++it)
+    {
+      WriteSdnv (i, (*it).first - end);
+      WriteSdnv (i, (*it).second);
+      end = (*it).first + (*it).second;
+    }
+}
+
+uint32_t
+BpAggregateCustodySignalHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  SDNV sdnv;
+
+  i.ReadU8 ();
+  uint8_t status = i.ReadU8 ();
+  m_succeeded = (status & 0x80) != 0;
+  m_reason = status & 0x7f;
+  uint64_t n = sdnv.Decode (i);
+  m_fills.clear ();
+  uint64_t end = 0;
+  for (uint64_t k = 0; k < n; k++)
+    {
+      uint64_t first = end + sdnv.Decode (i);
+      uint64_t length = sdnv.Decode (i);
+      m_fills.push_back (std::make_pair (first, length));
+      end = first + length;
+    }
+
+  return GetSerializedSize ();
+}
+
+void
+BpAggregateCustodySignalHeader::SetStatus (bool succeeded, uint8_t reason)
+{
+  NS_LOG_FUNCTION (this << " " << succeeded << " " << (uint16_t) reason);
+  m_succeeded = succeeded;
+  m_reason = reason;
+}
+
+void
+BpAggregateCustodySignalHeader::AddCustodyId (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  if (!m_fills.empty ())
+    {
+      std::pair<uint64_t, uint64_t> &last = m_fills.back ();
+      NS_ASSERT_MSG (id >= last.first + last.second, "custody ids must be added in order");
+      if (id == last.first + last.second)
+        {
+          last.second++;
+          return;
+        }
+    }
+  m_fills.push_back (std::make_pair (id, 1));
+}
+
+bool
+BpAggregateCustodySignalHeader::IsSucceeded () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_succeeded;
+}
+
+uint8_t
+BpAggregateCustodySignalHeader::GetReason () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_reason;
+}
+
+const std::vector<std::pair<uint64_t, uint64_t> > &
+BpAggregateCustodySignalHeader::GetFills () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_fills;
+}
+
+uint64_t
+BpAggregateCustodySignalHeader::GetNCustodyIds () const
+{
+  NS_LOG_FUNCTION (this);
+  uint64_t n = 0;
+  for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator it = m_fills.begin (); it != m_fills.end (); ++it)
+    {
+      n += (*it).second;
+    }
+  return n;
+}
+
+} // namespace ns3
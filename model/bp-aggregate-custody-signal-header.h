@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_AGGREGATE_CUSTODY_SIGNAL_HEADER_H
+#define BP_AGGREGATE_CUSTODY_SIGNAL_HEADER_H
+
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+#include "ns3/packet.h"
+
+namespace ns3 {
+
+/**
+ * \brief Aggregate custody signal
+ *
+ * The administrative record a node sends to a custodian to accept or
+ * refuse custody of many bundles at once. The bundles are named by the
+ * custody ids the custodian gave them (BpHeader::GetCustodyId ()), in a
+ * fill set: runs of consecutive custody ids, each encoded as the gap
+ * from the end of the previous run (the first id, for the first run) and
+ * the run length. A node accepting the bundles of a custodian in order
+ * acknowledges them with a few bytes per signal.
+ */
+class BpAggregateCustodySignalHeader : public Header
+{
+public:
+  BpAggregateCustodySignalHeader ();
+
+  virtual ~BpAggregateCustodySignalHeader ();
+
+  /**
+   * administrative record type of aggregate custody signals
+   */
+  static const uint8_t RECORD_TYPE = 0x4;
+
+  /**
+   * \brief Is an administrative record an aggregate custody signal?
+   *
+   * \param record the administrative record, without the bundle headers
+   */
+  static bool IsAggregateCustodySignal (Ptr<const Packet> record);
+
+  /**
+   * \brief set the status of the signal, as in BpCustodySignalHeader
+   *
+   * \param succeeded custody was accepted
+   * \param reason the reason code
+   */
+  void SetStatus (bool succeeded, uint8_t reason);
+
+  /**
+   * \brief add a custody id to the fill set
+   *
+   * \param id the custody id, greater than the ones added before
+   */
+  void AddCustodyId (uint64_t id);
+
+  bool IsSucceeded () const;
+  uint8_t GetReason () const;
+
+  /**
+   * \return the runs of the fill set: (first custody id, number of ids)
+   */
+  const std::vector<std::pair<uint64_t, uint64_t> > &GetFills () const;
+
+  /**
+   * \return the number of custody ids in the fill set
+   */
+  uint64_t GetNCustodyIds () const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  bool m_succeeded;                                     /// custody was accepted
+  uint8_t m_reason;                                     /// reason code
+  std::vector<std::pair<uint64_t, uint64_t> > m_fills;  /// fill set: runs (first custody id, number of ids), in order
+};
+
+} // namespace ns3
+
+#endif /* BP_AGGREGATE_CUSTODY_SIGNAL_HEADER_H */
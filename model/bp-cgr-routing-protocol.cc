@@ -0,0 +1,543 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "bp-cgr-routing-protocol.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <limits>
+#include <queue>
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("BpCgrRoutingProtocol");
+
+namespace ns3 {
+
+/**
+ * \brief Parse a time of a contact plan, relative to the start of the
+ * simulation
+ *
+ * \return false if it is not a relative time
+ */
+static bool
+ParseContactPlanTime (const std::string &str, double &time)
+{
+  std::string value = str;
+  if (!value.empty () && value[0] == '+')
+    value = value.substr (1);
+  if (value.empty ())
+    return false;
+
+  char *end = NULL;
+  time = std::strtod (value.c_str (), &end);
+  return *end == '\0';
+}
+
+TypeId
+BpCgrRoutingProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpCgrRoutingProtocol")
+    .SetParent<BpRoutingProtocol> ()
+    .AddConstructor<BpCgrRoutingProtocol> ()
+    .AddAttribute ("LocalNode",
+                   "The node number of this node in the contact plan.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&BpCgrRoutingProtocol::m_localNode),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("MaxRoutes",
+                   "The number of routes computed per destination, best first.",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&BpCgrRoutingProtocol::m_maxRoutes),
+                   MakeUintegerChecker<uint32_t> (1, 64))
+  ;
+  return tid;
+}
+
+BpCgrRoutingProtocol::BpCgrRoutingProtocol ()
+  : m_bp (0),
+    m_localNode (0),
+    m_maxRoutes (3),
+    m_graphValid (false),
+    m_nextExpiry (std::numeric_limits<double>::infinity ())
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpCgrRoutingProtocol::~BpCgrRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpCgrRoutingProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+}
+
+void
+BpCgrRoutingProtocol::SetLocalNode (uint64_t node)
+{
+  NS_LOG_FUNCTION (this << " " << node);
+  m_localNode = node;
+  ContactPlanChanged ();
+}
+
+void
+BpCgrRoutingProtocol::AddNode (uint64_t node, BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << node << " " << eid.Uri ());
+  m_nodeEids[node] = eid;
+  m_eidNodes[eid] = node;
+  // a cached next hop may now resolve to another endpoint id
+  NotifyRouteChange ();
+}
+
+void
+BpCgrRoutingProtocol::AddContact (double start, double stop, uint64_t from, uint64_t to, double rate)
+{
+  NS_LOG_FUNCTION (this << " " << start << " " << stop << " " << from << " " << to << " " << rate);
+  if (stop <= start)
+    {
+      NS_LOG_WARN ("BpCgrRoutingProtocol::AddContact (), ignore a contact that ends before it starts");
+      return;
+    }
+
+  BpCgrContact contact;
+  contact.start = start;
+  contact.stop = stop;
+  contact.from = from;
+  contact.to = to;
+  contact.rate = rate;
+  contact.owlt = 0;
+  m_contacts.push_back (contact);
+  ContactPlanChanged ();
+}
+
+void
+BpCgrRoutingProtocol::AddRange (double start, double stop, uint64_t from, uint64_t to, double owlt)
+{
+  NS_LOG_FUNCTION (this << " " << start << " " << stop << " " << from << " " << to << " " << owlt);
+  BpCgrRange range;
+  range.start = start;
+  range.stop = stop;
+  range.from = from;
+  range.to = to;
+  range.owlt = owlt;
+  m_ranges.push_back (range);
+  ContactPlanChanged ();
+}
+
+int
+BpCgrRoutingProtocol::LoadContactPlan (std::string filename)
+{
+  NS_LOG_FUNCTION (this << " " << filename);
+  std::ifstream file (filename.c_str ());
+  if (!file.is_open ())
+    {
+      NS_LOG_WARN ("BpCgrRoutingProtocol::LoadContactPlan (), cannot open " << filename);
+      return -1;
+    }
+
+  int errors = 0;
+  std::string line;
+  while (std::getline (file, line))
+    {
+      std::istringstream tokens (line);
+      std::string command, type, start, stop;
+      uint64_t from, to;
+      double value;
+      if (!(tokens >> command >> type) || command != "a" || (type != "contact" && type != "range"))
+        continue;
+
+      double startTime, stopTime;
+      if (!(tokens >> start >> stop >> from >> to >> value)
+          || !ParseContactPlanTime (start, startTime)
+          || !ParseContactPlanTime (stop, stopTime))
+        {
+          NS_LOG_WARN ("BpCgrRoutingProtocol::LoadContactPlan (), cannot parse: " << line);
+          errors++;
+          continue;
+        }
+
+      // add the entries directly, the cached routes are dropped once below
+      if (type == "contact" && stopTime > startTime)
+        {
+          BpCgrContact contact;
+          contact.start = startTime;
+          contact.stop = stopTime;
+          contact.from = from;
+          contact.to = to;
+          contact.rate = value;
+          contact.owlt = 0;
+          m_contacts.push_back (contact);
+        }
+      else if (type == "range")
+        {
+          BpCgrRange range;
+          range.start = startTime;
+          range.stop = stopTime;
+          range.from = from;
+          range.to = to;
+          range.owlt = value;
+          m_ranges.push_back (range);
+        }
+    }
+
+  ContactPlanChanged ();
+  return errors;
+}
+
+void
+BpCgrRoutingProtocol::ClearContactPlan ()
+{
+  NS_LOG_FUNCTION (this);
+  m_contacts.clear ();
+  m_ranges.clear ();
+  ContactPlanChanged ();
+}
+
+uint32_t
+BpCgrRoutingProtocol::GetNContacts () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_contacts.size ();
+}
+
+void
+BpCgrRoutingProtocol::ContactPlanChanged ()
+{
+  NS_LOG_FUNCTION (this);
+  m_graphValid = false;
+  m_routeLists.clear ();
+  m_nextExpiry = std::numeric_limits<double>::infinity ();
+  NotifyRouteChange ();
+}
+
+double
+BpCgrRoutingProtocol::GetOwlt (const BpCgrContact &contact,
+                               const std::map<std::pair<uint64_t, uint64_t>, std::vector<const BpCgrRange *> > &ranges) const
+{
+  NS_LOG_FUNCTION (this);
+  // a range of the same direction first, else one of the other direction
+  for (int reverse = 0; reverse < 2; reverse++)
+    {
+      std::map<std::pair<uint64_t, uint64_t>, std::vector<const BpCgrRange *> >::const_iterator it =
+        ranges.find (reverse ? std::make_pair (contact.to, contact.from) : std::make_pair (contact.from, contact.to));
+      if (it == ranges.end ())
+        continue;
+      for (std::vector<const BpCgrRange *>::const_iterator r = (*it).second.begin (); r != (*it).second.end (); ++r)
+        {
+          if ((*r)->start <= contact.start && contact.start < (*r)->stop)
+            return (*r)->owlt;
+        }
+    }
+
+  return 0;
+}
+
+void
+BpCgrRoutingProtocol::BuildContactGraph ()
+{
+  NS_LOG_FUNCTION (this);
+  std::map<std::pair<uint64_t, uint64_t>, std::vector<const BpCgrRange *> > ranges;
+  for (std::vector<BpCgrRange>::const_iterator it = m_ranges.begin (); it != m_ranges.end (); ++it)
+    {
+      ranges[std::make_pair ((*it).from, (*it).to)].push_back (&(*it));
+    }
+
+  m_outContacts.clear ();
+  for (uint32_t i = 0; i < m_contacts.size (); i++)
+    {
+      m_contacts[i].owlt = GetOwlt (m_contacts[i], ranges);
+      m_outContacts[m_contacts[i].from].push_back (i);
+    }
+  m_graphValid = true;
+}
+
+bool
+BpCgrRoutingProtocol::FindBestRoute (uint64_t source, double startTime, uint64_t dst,
+                                     const std::vector<bool> &excludedContacts,
+                                     const std::set<uint64_t> &excludedNodes,
+                                     BpCgrRoute &route)
+{
+  NS_LOG_FUNCTION (this << " " << source << " " << startTime << " " << dst);
+  const double infinity = std::numeric_limits<double>::infinity ();
+  const uint32_t none = std::numeric_limits<uint32_t>::max ();
+
+  // the contacts are the vertices; the cost of a contact is the earliest
+  // arrival at its receiving node
+  std::vector<double> arrival (m_contacts.size (), infinity);
+  std::vector<uint32_t> predecessor (m_contacts.size (), none);
+  std::vector<bool> done (m_contacts.size (), false);
+  typedef std::pair<double, uint32_t> QueueEntry;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+
+  std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator out = m_outContacts.find (source);
+  if (out == m_outContacts.end ())
+    return false;
+  for (std::vector<uint32_t>::const_iterator it = (*out).second.begin (); it != (*out).second.end (); ++it)
+    {
+      const BpCgrContact &contact = m_contacts[*it];
+      if (excludedContacts[*it] || contact.stop <= startTime || excludedNodes.count (contact.to))
+        continue;
+      arrival[*it] = std::max (startTime, contact.start) + contact.owlt;
+      queue.push (QueueEntry (arrival[*it], *it));
+    }
+
+  uint32_t last = none;
+  while (!queue.empty ())
+    {
+      QueueEntry entry = queue.top ();
+      queue.pop ();
+      uint32_t current = entry.second;
+      if (done[current])
+        continue;
+      done[current] = true;
+
+      const BpCgrContact &contact = m_contacts[current];
+      if (contact.to == dst)
+        {
+          last = current;
+          break;
+        }
+
+      out = m_outContacts.find (contact.to);
+      if (out == m_outContacts.end ())
+        continue;
+      for (std::vector<uint32_t>::const_iterator it = (*out).second.begin (); it != (*out).second.end (); ++it)
+        {
+          const BpCgrContact &next = m_contacts[*it];
+          if (done[*it] || excludedContacts[*it] || next.stop <= entry.first
+              || next.to == source || excludedNodes.count (next.to))
+            continue;
+          double nextArrival = std::max (entry.first, next.start) + next.owlt;
+          if (nextArrival < arrival[*it])
+            {
+              arrival[*it] = nextArrival;
+              predecessor[*it] = current;
+              queue.push (QueueEntry (nextArrival, *it));
+            }
+        }
+    }
+
+  if (last == none)
+    return false;
+
+  route.contacts.clear ();
+  for (uint32_t c = last; c != none; c = predecessor[c])
+    {
+      route.contacts.push_back (c);
+    }
+  std::reverse (route.contacts.begin (), route.contacts.end ());
+  return true;
+}
+
+void
+BpCgrRoutingProtocol::CompleteRoute (double startTime, BpCgrRoute &route) const
+{
+  NS_LOG_FUNCTION (this << " " << startTime);
+  const BpCgrContact &first = m_contacts[route.contacts.front ()];
+  route.nextHop = first.to;
+  route.fromTime = first.start;
+  route.toTime = std::numeric_limits<double>::infinity ();
+  double time = startTime;
+  for (std::vector<uint32_t>::const_iterator it = route.contacts.begin (); it != route.contacts.end (); ++it)
+    {
+      const BpCgrContact &contact = m_contacts[*it];
+      time = std::max (time, contact.start) + contact.owlt;
+      route.toTime = std::min (route.toTime, contact.stop);
+    }
+  route.arrivalTime = time;
+}
+
+/**
+ * \brief Order of routes: earliest arrival, then fewest hops
+ */
+static bool
+RouteBefore (const BpCgrRoute &a, const BpCgrRoute &b)
+{
+  if (a.arrivalTime != b.arrivalTime)
+    return a.arrivalTime < b.arrivalTime;
+  return a.contacts.size () < b.contacts.size ();
+}
+
+void
+BpCgrRoutingProtocol::ComputeRoutes (uint64_t dst, double now, std::vector<BpCgrRoute> &routes)
+{
+  NS_LOG_FUNCTION (this << " " << dst << " " << now);
+  if (!m_graphValid)
+    BuildContactGraph ();
+
+  routes.clear ();
+  std::vector<bool> excludedContacts (m_contacts.size (), false);
+  std::set<uint64_t> excludedNodes;
+  excludedNodes.insert (m_localNode);
+
+  BpCgrRoute best;
+  if (!FindBestRoute (m_localNode, now, dst, excludedContacts, excludedNodes, best))
+    return;
+  CompleteRoute (now, best);
+  routes.push_back (best);
+
+  // Yen's k-shortest paths: deviate from each contact of the last route
+  std::vector<BpCgrRoute> candidates;
+  while (routes.size () < m_maxRoutes)
+    {
+      const BpCgrRoute &previous = routes.back ();
+      double rootArrival = now;
+      excludedNodes.clear ();
+      excludedNodes.insert (m_localNode);
+      for (uint32_t i = 0; i < previous.contacts.size (); i++)
+        {
+          // the root is the first i contacts of the previous route
+          std::vector<uint32_t> root (previous.contacts.begin (), previous.contacts.begin () + i);
+          uint64_t spurNode = m_contacts[previous.contacts[i]].from;
+
+          std::fill (excludedContacts.begin (), excludedContacts.end (), false);
+          for (std::vector<BpCgrRoute>::const_iterator it = routes.begin (); it != routes.end (); ++it)
+            {
+              if ((*it).contacts.size () > i && std::equal (root.begin (), root.end (), (*it).contacts.begin ()))
+                excludedContacts[(*it).contacts[i]] = true;
+            }
+
+          BpCgrRoute spur;
+          if (FindBestRoute (spurNode, rootArrival, dst, excludedContacts, excludedNodes, spur))
+            {
+              BpCgrRoute candidate;
+              candidate.contacts = root;
+              candidate.contacts.insert (candidate.contacts.end (), spur.contacts.begin (), spur.contacts.end ());
+              bool known = false;
+              for (std::vector<BpCgrRoute>::const_iterator it = candidates.begin (); it != candidates.end () && !known; ++it)
+                known = (*it).contacts == candidate.contacts;
+              if (!known)
+                {
+                  CompleteRoute (now, candidate);
+                  candidates.push_back (candidate);
+                }
+            }
+
+          const BpCgrContact &contact = m_contacts[previous.contacts[i]];
+          rootArrival = std::max (rootArrival, contact.start) + contact.owlt;
+          excludedNodes.insert (contact.to);
+        }
+
+      if (candidates.empty ())
+        break;
+      std::vector<BpCgrRoute>::iterator next = std::min_element (candidates.begin (), candidates.end (), RouteBefore);
+      routes.push_back (*next);
+      candidates.erase (next);
+    }
+}
+
+bool
+BpCgrRoutingProtocol::GetNodeNumber (const BpEndpointId &eid, uint64_t &node) const
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  std::unordered_map<BpEndpointId, uint64_t, BpEndpointIdHash>::const_iterator it = m_eidNodes.find (eid);
+  if (it != m_eidNodes.end ())
+    {
+      node = (*it).second;
+      return true;
+    }
+
+  // "ipn:node.service"
+  std::string uri = eid.Uri ();
+  if (uri.compare (0, 4, "ipn:") != 0)
+    return false;
+  char *end = NULL;
+  const char *number = uri.c_str () + 4;
+  node = std::strtoull (number, &end, 10);
+  return end != number && (*end == '.' || *end == '\0');
+}
+
+const std::vector<BpCgrRoute> &
+BpCgrRoutingProtocol::GetRoutes (uint64_t dst)
+{
+  NS_LOG_FUNCTION (this << " " << dst);
+  double now = Simulator::Now ().GetSeconds ();
+  std::unordered_map<uint64_t, RouteList>::iterator it = m_routeLists.find (dst);
+  if (it == m_routeLists.end ())
+    {
+      it = m_routeLists.insert (std::make_pair (dst, RouteList ())).first;
+      ComputeRoutes (dst, now, (*it).second.routes);
+      (*it).second.exhausted = (*it).second.routes.empty ();
+    }
+
+  RouteList &list = (*it).second;
+  std::vector<BpCgrRoute>::iterator valid = list.routes.begin ();
+  while (valid != list.routes.end () && (*valid).toTime <= now)
+    {
+      ++valid;
+    }
+  list.routes.erase (list.routes.begin (), valid);
+
+  // contacts only end as time goes on, so a destination without a route
+  // keeps having none until the contact plan changes
+  if (list.routes.empty () && !list.exhausted)
+    {
+      ComputeRoutes (dst, now, list.routes);
+      list.exhausted = list.routes.empty ();
+    }
+
+  return list.routes;
+}
+
+BpEndpointId
+BpCgrRoutingProtocol::GetRoute (BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  uint64_t dst;
+  if (!GetNodeNumber (eid, dst) || dst == m_localNode)
+    return eid;
+
+  const std::vector<BpCgrRoute> &routes = GetRoutes (dst);
+  if (routes.empty ())
+    return eid;
+
+  const BpCgrRoute &route = routes.front ();
+  m_nextExpiry = std::min (m_nextExpiry, route.toTime);
+
+  std::unordered_map<uint64_t, BpEndpointId>::iterator it = m_nodeEids.find (route.nextHop);
+  if (it != m_nodeEids.end ())
+    return (*it).second;
+
+  std::ostringstream ssp;
+  ssp << route.nextHop << ".0";
+  return BpEndpointId ("ipn", ssp.str ());
+}
+
+uint32_t
+BpCgrRoutingProtocol::GetRouteGeneration ()
+{
+  NS_LOG_FUNCTION (this);
+  // a next hop given by GetRoute () holds until its route ends
+  if (Simulator::Now ().GetSeconds () >= m_nextExpiry)
+    {
+      m_nextExpiry = std::numeric_limits<double>::infinity ();
+      NotifyRouteChange ();
+    }
+
+  return BpRoutingProtocol::GetRouteGeneration ();
+}
+
+} // namespace ns3
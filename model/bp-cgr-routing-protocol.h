@@ -0,0 +1,269 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_CGR_ROUTING_PROTOCOL_H
+#define BP_CGR_ROUTING_PROTOCOL_H
+
+#include "bp-routing-protocol.h"
+#include "bundle-protocol.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <utility>
+#include <unordered_map>
+
+namespace ns3 {
+
+/**
+ * \brief A scheduled contact of a contact plan: node "from" can transmit
+ * to node "to" between start and stop
+ */
+struct BpCgrContact
+{
+  double start;         /// start of the contact, in seconds
+  double stop;          /// end of the contact, in seconds
+  uint64_t from;        /// transmitting node number
+  uint64_t to;          /// receiving node number
+  double rate;          /// transmission rate, in bytes per second
+  double owlt;          /// one-way light time, in seconds, from the ranges
+};
+
+/**
+ * \brief A range of a contact plan: the one-way light time between two
+ * nodes between start and stop
+ */
+struct BpCgrRange
+{
+  double start;         /// start of the range, in seconds
+  double stop;          /// end of the range, in seconds
+  uint64_t from;        /// first node number
+  uint64_t to;          /// second node number
+  double owlt;          /// one-way light time, in seconds
+};
+
+/**
+ * \brief A route through the contact graph
+ */
+struct BpCgrRoute
+{
+  uint64_t nextHop;                     /// node number of the receiver of the first contact
+  double fromTime;                      /// start of the first contact
+  double toTime;                        /// the route is usable until the first of its contacts ends
+  double arrivalTime;                   /// earliest arrival time at the destination
+  std::vector<uint32_t> contacts;       /// the contacts of the route, indexes into the contact plan
+};
+
+/**
+ * \brief Contact Graph Routing
+ *
+ * Routes bundles over the scheduled contacts of a contact plan, loaded
+ * from a file in the ION "a contact" / "a range" format or added one by
+ * one. Nodes are identified by their node numbers; the endpoint id of a
+ * node is given by AddNode (), "ipn:N.x" endpoint ids are recognized
+ * without it.
+ *
+ * The best route to a destination is found by a Dijkstra search over the
+ * contact graph, minimizing the arrival time, and the next best ones by
+ * Yen's k-shortest paths. The route list of a destination is computed
+ * once and cached until the contact plan changes; a route that has ended
+ * is dropped from the front of the list, and the list is recomputed only
+ * once all of its routes have ended. Looking up a route to a destination
+ * seen before is a hash lookup.
+ */
+class BpCgrRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpCgrRoutingProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpCgrRoutingProtocol ();
+
+  /**
+   * \brief Set bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \brief Set the node number of this node
+   */
+  void SetLocalNode (uint64_t node);
+
+  /**
+   * \brief Map a node number to the endpoint id of the node
+   */
+  void AddNode (uint64_t node, BpEndpointId eid);
+
+  /**
+   * \brief Add a contact to the contact plan
+   *
+   * \param start start of the contact, in seconds
+   * \param stop end of the contact, in seconds
+   * \param from transmitting node number
+   * \param to receiving node number
+   * \param rate transmission rate, in bytes per second
+   */
+  void AddContact (double start, double stop, uint64_t from, uint64_t to, double rate);
+
+  /**
+   * \brief Add a range to the contact plan
+   *
+   * A range applies in both directions, unless the other direction has a
+   * range of its own.
+   *
+   * \param start start of the range, in seconds
+   * \param stop end of the range, in seconds
+   * \param from first node number
+   * \param to second node number
+   * \param owlt one-way light time, in seconds
+   */
+  void AddRange (double start, double stop, uint64_t from, uint64_t to, double owlt);
+
+  /**
+   * \brief Load a contact plan in the ION format
+   *
+   * The "a contact" and "a range" commands are understood, with times
+   * relative to the start of the simulation ("+3600" or "3600"); other
+   * commands and comments are ignored.
+   *
+   * \param filename the contact plan
+   *
+   * \return the number of contacts and ranges that could not be parsed,
+   * -1 if the file cannot be read
+   */
+  int LoadContactPlan (std::string filename);
+
+  /**
+   * \brief Remove all contacts and ranges
+   */
+  void ClearContactPlan ();
+
+  /**
+   * \return the number of contacts of the contact plan
+   */
+  uint32_t GetNContacts () const;
+
+  /**
+   * \brief Get the routes to a destination that have not ended yet
+   *
+   * \param dst the destination node number
+   *
+   * \return the routes, best first
+   */
+  const std::vector<BpCgrRoute> &GetRoutes (uint64_t dst);
+
+  /**
+   * \return the endpoint id of the next hop of the best route; the
+   * destination itself if there is no route
+   */
+  virtual BpEndpointId GetRoute (BpEndpointId eid);
+
+  /**
+   * \brief Get the route generation, bumped once the first of the routes
+   * given so far ends
+   */
+  virtual uint32_t GetRouteGeneration ();
+
+private:
+  /**
+   * \brief Route list of a destination
+   */
+  struct RouteList
+  {
+    std::vector<BpCgrRoute> routes;     /// the routes, best first
+    bool exhausted;                     /// no route was found, so none can be found later
+  };
+
+  /**
+   * \brief Drop the cached routes after a change of the contact plan
+   */
+  void ContactPlanChanged ();
+
+  /**
+   * \brief Build the adjacency of the contacts and their one-way light times
+   */
+  void BuildContactGraph ();
+
+  /**
+   * \return the one-way light time of a contact from the ranges
+   *
+   * \param contact the contact
+   * \param ranges the ranges, indexed by (from, to) node numbers
+   */
+  double GetOwlt (const BpCgrContact &contact,
+                  const std::map<std::pair<uint64_t, uint64_t>, std::vector<const BpCgrRange *> > &ranges) const;
+
+  /**
+   * \brief Find the route with the earliest arrival, Dijkstra search over
+   * the contacts
+   *
+   * \param source the node the route starts at
+   * \param startTime the time the bundle is at the source
+   * \param dst the destination node number
+   * \param excludedContacts contacts the route may not use
+   * \param excludedNodes nodes the route may not reach
+   * \param route the route found
+   *
+   * \return true if a route is found
+   */
+  bool FindBestRoute (uint64_t source, double startTime, uint64_t dst,
+                      const std::vector<bool> &excludedContacts,
+                      const std::set<uint64_t> &excludedNodes,
+                      BpCgrRoute &route);
+
+  /**
+   * \brief Compute the routes to a destination by Yen's k-shortest paths
+   */
+  void ComputeRoutes (uint64_t dst, double now, std::vector<BpCgrRoute> &routes);
+
+  /**
+   * \brief Fill in the next hop and the times of a route from its contacts
+   */
+  void CompleteRoute (double startTime, BpCgrRoute &route) const;
+
+  /**
+   * \return the node number of an endpoint id, false if it is unknown
+   */
+  bool GetNodeNumber (const BpEndpointId &eid, uint64_t &node) const;
+
+  Ptr<BundleProtocol> m_bp;                                     /// bundle protocol
+  uint64_t m_localNode;                                         /// node number of this node
+  uint32_t m_maxRoutes;                                         /// number of routes computed per destination
+  std::vector<BpCgrContact> m_contacts;                         /// the contacts of the contact plan
+  std::vector<BpCgrRange> m_ranges;                             /// the ranges of the contact plan
+  bool m_graphValid;                                            /// the contact graph matches the contact plan
+  std::unordered_map<uint64_t, std::vector<uint32_t> > m_outContacts; /// map (node number, contacts from it)
+  std::unordered_map<uint64_t, BpEndpointId> m_nodeEids;        /// map (node number, endpoint id)
+  std::unordered_map<BpEndpointId, uint64_t, BpEndpointIdHash> m_eidNodes; /// map (endpoint id, node number)
+  std::unordered_map<uint64_t, RouteList> m_routeLists;         /// cached route lists, per destination node number
+  double m_nextExpiry;                                          /// the first end of the routes given so far
+};
+
+}  // namespace ns3
+
+#endif /* BP_CGR_ROUTING_PROTOCOL_H */
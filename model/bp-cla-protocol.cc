@@ -48,5 +48,11 @@ BpClaProtocol::~BpClaProtocol ()
   NS_LOG_FUNCTION (this);
 }
 
+void
+BpClaProtocol::ReleaseQueuedBundles (const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this);
+}
+
 } // namespace ns3
 
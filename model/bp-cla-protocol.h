@@ -59,9 +59,43 @@ public:
    * send packet to the transport layer
    *
    * \param packet packet to send
+   *
+   * \return -1 if the packet cannot be sent, 1 if it was accepted but the 
+   * CLA queue towards the next hop is congested, otherwise 0
    */
   virtual int SendPacket (Ptr<Packet> packet) = 0;
 
+  /**
+   * send a bundle to a given next hop, e.g. a copy made by a replicating
+   * routing protocol
+   *
+   * Unlike SendPacket (), the bundle is not taken from the bundle storage
+   * of BundleProtocol and its next hop is not looked up; a bundle refused
+   * here is not put back into the storage.
+   *
+   * \param packet the bundle to send
+   * \param nextHop the endpoint id of the neighbour
+   *
+   * \return -1 if the bundle cannot be sent, 1 if it was accepted but the
+   * CLA queue towards the next hop is congested, otherwise 0
+   */
+  virtual int SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop) = 0;
+
+  /**
+   * \return the number of bytes accepted by the CLA but not yet handed to
+   * the transport layer
+   */
+  virtual uint32_t GetTxQueuedBytes () const = 0;
+
+  /**
+   * Give the bundles queued towards a next hop back to the bundle
+   * protocol, e.g. when the link to it went down, so that they can be
+   * routed again. The default CLA keeps no such queue.
+   *
+   * \param nextHop the endpoint id of the neighbour
+   */
+  virtual void ReleaseQueuedBundles (const BpEndpointId &nextHop);
+
   /**
    * Connect BundleProtocol object to CLA
    *
@@ -0,0 +1,290 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "bp-contact-scheduler.h"
+#include "bp-header.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("BpContactScheduler");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BpContactScheduler);
+
+const uint32_t BpContactScheduler::PRIORITIES;
+
+TypeId
+BpContactScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpContactScheduler")
+    .SetParent<Object> ()
+    .AddConstructor<BpContactScheduler> ()
+  ;
+  return tid;
+}
+
+BpContactScheduler::BpContactScheduler ()
+  : m_heldBytes (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpContactScheduler::~BpContactScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpContactScheduler::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.begin (); it != m_neighbours.end (); ++it)
+    {
+      (*it).second.event.Cancel ();
+    }
+  m_neighbours.clear ();
+  m_release = MakeNullCallback<bool, Ptr<Packet>, const BpEndpointId &> ();
+  m_contact = MakeNullCallback<void, const BpEndpointId &, bool> ();
+  Object::DoDispose ();
+}
+
+void
+BpContactScheduler::SetReleaseCallback (Callback<bool, Ptr<Packet>, const BpEndpointId &> release)
+{
+  NS_LOG_FUNCTION (this);
+  m_release = release;
+}
+
+void
+BpContactScheduler::SetContactCallback (Callback<void, const BpEndpointId &, bool> contact)
+{
+  NS_LOG_FUNCTION (this);
+  m_contact = contact;
+}
+
+void
+BpContactScheduler::AddContact (const BpEndpointId &neighbour, Time start, Time stop, double rate)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri () << " " << start.GetSeconds () << " " << stop.GetSeconds () << " " << rate);
+  if (stop <= start || stop <= Simulator::Now ())
+    return;
+
+  Contact contact;
+  contact.start = start;
+  contact.stop = stop;
+  contact.rate = rate;
+
+  std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.find (neighbour);
+  if (it == m_neighbours.end ())
+    {
+      Neighbour state;
+      state.open = false;
+      state.volume = 0;
+      it = m_neighbours.insert (std::make_pair (neighbour, state)).first;
+    }
+  Neighbour &state = (*it).second;
+
+  // the open contact stays first
+  std::vector<Contact>::iterator pos = state.contacts.begin ();
+  if (state.open)
+    ++pos;
+  while (pos != state.contacts.end () && (*pos).start <= start)
+    ++pos;
+  bool first = (pos == state.contacts.begin ());
+  state.contacts.insert (pos, contact);
+
+  if (first)
+    Schedule (neighbour, state);
+}
+
+bool
+BpContactScheduler::IsScheduled (const BpEndpointId &neighbour) const
+{
+  return m_neighbours.find (neighbour) != m_neighbours.end ();
+}
+
+bool
+BpContactScheduler::Admit (const BpEndpointId &neighbour, uint32_t size)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri () << " " << size);
+  std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.find (neighbour);
+  if (it == m_neighbours.end ())
+    return true;
+
+  Neighbour &state = (*it).second;
+  if (!state.open)
+    return false;
+
+  // the bundles held before it go first, as far as the volume allows
+  Release (neighbour, state);
+  if (state.volume < size)
+    return false;
+
+  state.volume -= size;
+  return true;
+}
+
+void
+BpContactScheduler::Hold (const BpEndpointId &neighbour, Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri () << " " << bundle);
+  BpHeader bph;
+  bundle->PeekHeader (bph);
+  uint32_t priority = std::min<uint32_t> (bph.Priority (), PRIORITIES - 1);
+
+  m_neighbours[neighbour].held[priority].push_back (bundle);
+  m_heldBytes += bundle->GetSize ();
+}
+
+void
+BpContactScheduler::Drain (const BpEndpointId &neighbour, std::vector<Ptr<Packet> > &bundles)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri ());
+  std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.find (neighbour);
+  if (it == m_neighbours.end ())
+    return;
+
+  for (uint32_t p = PRIORITIES; p-- > 0; )
+    {
+      std::deque<Ptr<Packet> > &held = (*it).second.held[p];
+      for (std::deque<Ptr<Packet> >::iterator itBundle = held.begin (); itBundle != held.end (); ++itBundle)
+        {
+          m_heldBytes -= (*itBundle)->GetSize ();
+          bundles.push_back (*itBundle);
+        }
+      held.clear ();
+    }
+}
+
+void
+BpContactScheduler::Retry (const BpEndpointId &neighbour)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri ());
+  std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.find (neighbour);
+  if (it == m_neighbours.end () || !(*it).second.open)
+    return;
+
+  Release (neighbour, (*it).second);
+}
+
+uint32_t
+BpContactScheduler::GetHeldBytes () const
+{
+  return m_heldBytes;
+}
+
+void
+BpContactScheduler::Schedule (const BpEndpointId &neighbour, Neighbour &state)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri ());
+  state.event.Cancel ();
+  if (state.contacts.empty ())
+    return;
+
+  Time now = Simulator::Now ();
+  const Contact &first = state.contacts.front ();
+  if (state.open)
+    state.event = Simulator::Schedule (first.stop - now, &BpContactScheduler::Close, this, neighbour);
+  else
+    state.event = Simulator::Schedule (Max (first.start - now, Seconds (0)), &BpContactScheduler::Open, this, neighbour);
+}
+
+void
+BpContactScheduler::Open (BpEndpointId neighbour)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri ());
+  std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.find (neighbour);
+  if (it == m_neighbours.end ())
+    return;
+  Neighbour &state = (*it).second;
+  const Contact &contact = state.contacts.front ();
+
+  // a contact added once started only has the rest of its volume
+  Time now = Simulator::Now ();
+  state.open = true;
+  state.volume = contact.rate * (contact.stop - Max (contact.start, now)).GetSeconds ();
+  Schedule (neighbour, state);
+  NS_LOG_DEBUG ("Contact with " << neighbour.Uri () << " open until " << contact.stop.GetSeconds () << "s, volume " << state.volume);
+  if (!m_contact.IsNull ())
+    m_contact (neighbour, true);
+
+  Release (neighbour, state);
+}
+
+void
+BpContactScheduler::Release (const BpEndpointId &neighbour, Neighbour &state)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri () << " " << state.volume);
+  if (m_release.IsNull () || m_heldBytes == 0)
+    return;
+
+  // release what fits, highest priority first; a bundle larger than the
+  // volume left does not hold back the smaller ones after it, and the
+  // others are put back in their order
+  bool refused = false;
+  for (uint32_t p = PRIORITIES; p-- > 0; )
+    {
+      std::deque<Ptr<Packet> > held;
+      held.swap (state.held[p]);
+      for (std::deque<Ptr<Packet> >::iterator itBundle = held.begin (); itBundle != held.end (); ++itBundle)
+        {
+          uint32_t size = (*itBundle)->GetSize ();
+          if (refused || size > state.volume)
+            {
+              state.held[p].push_back (*itBundle);
+              continue;
+            }
+
+          m_heldBytes -= size;
+          state.volume -= size;
+          if (!m_release (*itBundle, neighbour))
+            {
+              // the CLA cannot reach the neighbour: keep the rest for the
+              // next contact
+              NS_LOG_DEBUG ("CLA refused a bundle to " << neighbour.Uri () << ", holding it");
+              state.volume += size;
+              m_heldBytes += size;
+              state.held[p].push_back (*itBundle);
+              refused = true;
+            }
+        }
+    }
+}
+
+void
+BpContactScheduler::Close (BpEndpointId neighbour)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri ());
+  std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.find (neighbour);
+  if (it == m_neighbours.end ())
+    return;
+  Neighbour &state = (*it).second;
+
+  NS_LOG_DEBUG ("Contact with " << neighbour.Uri () << " closed, " << state.volume << " bytes of volume unused");
+  state.open = false;
+  state.volume = 0;
+  state.contacts.erase (state.contacts.begin ());
+  Schedule (neighbour, state);
+  if (!m_contact.IsNull ())
+    m_contact (neighbour, false);
+}
+
+} // namespace ns3
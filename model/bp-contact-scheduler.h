@@ -0,0 +1,196 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_CONTACT_SCHEDULER_H
+#define BP_CONTACT_SCHEDULER_H
+
+#include "ns3/object.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "bp-endpoint-id.h"
+#include <stdint.h>
+#include <map>
+#include <deque>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Transmission scheduler of a CLA over the contact windows of its
+ * neighbours
+ *
+ * A neighbour with scheduled contacts can only be sent to while one of
+ * them is open, and no more than its volume, the rate times the duration
+ * of the contact. The bundles to a neighbour out of contact, or beyond the
+ * volume left, are held here instead of being handed to the transport
+ * layer. When the next contact opens, they are released to the CLA in
+ * priority order (expedited first, then in the order they came), as long
+ * as they fit in the volume of the contact; the others wait for the next
+ * one. The held bundles are tried again, within the volume left, before
+ * a new bundle is admitted and whenever the CLA calls Retry ().
+ *
+ * Each neighbour has a single pending event: the next opening or closing
+ * of a contact. Neighbours without contacts are always in contact. The
+ * contact callback is told of each opening and closing, e.g. for the CLA
+ * to report the neighbour up or down to the routing protocol.
+ */
+class BpContactScheduler : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpContactScheduler ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpContactScheduler ();
+
+  /**
+   * \brief Set the callback sending a released bundle to a neighbour
+   *
+   * It returns false if the CLA refused the bundle, which is then held
+   * until the next contact.
+   */
+  void SetReleaseCallback (Callback<bool, Ptr<Packet>, const BpEndpointId &> release);
+
+  /**
+   * \brief Set the callback told of the opening (true) and the closing
+   * (false) of the contacts with a neighbour
+   */
+  void SetContactCallback (Callback<void, const BpEndpointId &, bool> contact);
+
+  /**
+   * \brief Add a contact with a neighbour
+   *
+   * \param neighbour the endpoint id of the neighbour
+   * \param start start of the contact
+   * \param stop end of the contact
+   * \param rate transmission rate, in bytes per second
+   */
+  void AddContact (const BpEndpointId &neighbour, Time start, Time stop, double rate);
+
+  /**
+   * \return true if the neighbour has scheduled contacts
+   */
+  bool IsScheduled (const BpEndpointId &neighbour) const;
+
+  /**
+   * \brief Take a share of the volume of the open contact with a neighbour
+   *
+   * \param neighbour the endpoint id of the neighbour
+   * \param size the size of the bundle to send
+   *
+   * The bundles held for the neighbour are released first, as far as the
+   * volume left allows.
+   *
+   * \return true if the bundle can be sent now: the neighbour has no
+   * scheduled contact, or its contact is open with enough volume left
+   */
+  bool Admit (const BpEndpointId &neighbour, uint32_t size);
+
+  /**
+   * \brief Hold a bundle until the next contact with a neighbour
+   */
+  void Hold (const BpEndpointId &neighbour, Ptr<Packet> bundle);
+
+  /**
+   * \brief Release the bundles held for a neighbour that fit in the
+   * volume left of its open contact, e.g. once the CLA sent some data
+   */
+  void Retry (const BpEndpointId &neighbour);
+
+  /**
+   * \brief Take back all the bundles held for a neighbour, e.g. to route
+   * them again
+   *
+   * \param bundles the bundles, appended to in priority order
+   */
+  void Drain (const BpEndpointId &neighbour, std::vector<Ptr<Packet> > &bundles);
+
+  /**
+   * \return the total size of the bundles held
+   */
+  uint32_t GetHeldBytes () const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief A contact window with a neighbour
+   */
+  struct Contact
+  {
+    Time start;                         /// start of the contact
+    Time stop;                          /// end of the contact
+    double rate;                        /// transmission rate, in bytes per second
+  };
+
+  /**
+   * number of priorities of BpHeader::Priority ()
+   */
+  static const uint32_t PRIORITIES = 4;
+
+  /**
+   * \brief Contacts and held bundles of a neighbour
+   */
+  struct Neighbour
+  {
+    std::vector<Contact> contacts;              /// contacts not ended yet, by start
+    bool open;                                  /// the first contact is open
+    double volume;                              /// bytes left in the open contact
+    std::deque<Ptr<Packet> > held[PRIORITIES];  /// bundles held, by priority
+    EventId event;                              /// next opening or closing
+  };
+
+  /**
+   * \brief Schedule the next transition of a neighbour
+   */
+  void Schedule (const BpEndpointId &neighbour, Neighbour &state);
+
+  /**
+   * \brief Open the first contact with a neighbour and release the
+   * bundles held for it
+   */
+  void Open (BpEndpointId neighbour);
+
+  /**
+   * \brief Hand the held bundles that fit in the volume left to the CLA
+   */
+  void Release (const BpEndpointId &neighbour, Neighbour &state);
+
+  /**
+   * \brief Close the first contact with a neighbour
+   */
+  void Close (BpEndpointId neighbour);
+
+  Callback<bool, Ptr<Packet>, const BpEndpointId &> m_release;  /// sends a released bundle
+  Callback<void, const BpEndpointId &, bool> m_contact;         /// told of the contact openings and closings
+  std::map<BpEndpointId, Neighbour> m_neighbours;                /// neighbours with scheduled contacts
+  uint32_t m_heldBytes;                                         /// total size of the bundles held
+};
+
+}  // namespace ns3
+
+#endif /* BP_CONTACT_SCHEDULER_H */
@@ -0,0 +1,273 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "bp-custody-signal-header.h"
+#include "bp-header.h"
+#include "sdnv.h"
+
+NS_LOG_COMPONENT_DEFINE ("BpCustodySignalHeader");
+
+namespace ns3 {
+
+BpCustodySignalHeader::BpCustodySignalHeader ()
+  : m_succeeded (false),
+    m_reason (NO_ADDITIONAL_INFORMATION),
+    m_fragment (false),
+    m_fragOffset (0),
+    m_fragLength (0),
+    m_seconds (0),
+    m_nanoseconds (0),
+    m_createTimestamp (0),
+    m_seq (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpCustodySignalHeader::~BpCustodySignalHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+BpCustodySignalHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpCustodySignalHeader")
+                      .SetParent<Header> ()
+                      .AddConstructor<BpCustodySignalHeader> ();
+
+  return tid;
+}
+
+TypeId
+BpCustodySignalHeader::GetInstanceTypeId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return GetTypeId ();
+}
+
+bool
+BpCustodySignalHeader::IsCustodySignal (Ptr<const Packet> record)
+{
+  if (record->GetSize () < 2)
+    return false;
+
+  uint8_t type;
+  record->CopyData (&type, 1);
+  return (type >> 4) == RECORD_TYPE;
+}
+
+uint32_t
+BpCustodySignalHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  SDNV sdnv;
+
+  // record type and flags, status
+  uint32_t size = 2;
+  if (m_fragment)
+    size += sdnv.EncodingLength (m_fragOffset) + sdnv.EncodingLength (m_fragLength);
+  size += sdnv.EncodingLength (m_seconds) + sdnv.EncodingLength (m_nanoseconds);
+  size += sdnv.EncodingLength (m_createTimestamp) + sdnv.EncodingLength (m_seq);
+  size += sdnv.EncodingLength (m_src.size ()) + m_src.size ();
+
+  return size;
+}
+
+void
+BpCustodySignalHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  os << (m_succeeded ? "succeeded" : "failed") << " reason " << (uint16_t) m_reason
+     << " bundle " << m_src << " " << m_createTimestamp << " " << m_seq;
+  if (m_fragment)
+    os << " fragment " << m_fragOffset << " " << m_fragLength;
+}
+
+static void
+WriteSdnv (Buffer::Iterator &i, uint64_t val)
+{
+  SDNV sdnv;
+  std::vector<uint8_t> encoded = sdnv.Encode (val);
+  for (std::vector<uint8_t>::iterator it = encoded.begin (); it != encoded.end (); ++it)
+    {
+      i.WriteU8 (*it);
+    }
+}
+
+void
+BpCustodySignalHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+
+  i.WriteU8 ((RECORD_TYPE << 4) | (m_fragment ? 1 : 0));
+  i.WriteU8 ((m_succeeded ? 0x80 : 0) | (m_reason & 0x7f));
+  if (m_fragment)
+    {
+      WriteSdnv (i, m_fragOffset);
+      WriteSdnv (i, m_fragLength);
+    }
+  WriteSdnv (i, m_seconds);
+  WriteSdnv (i, m_nanoseconds);
+  WriteSdnv (i, m_createTimestamp);
+  WriteSdnv (i, m_seq);
+  WriteSdnv (i, m_src.size ());
+  for (std::string::const_iterator it = m_src.begin (); it != m_src.end (); ++it)
+    {
+      i.WriteU8 (*it);
+    }
+}
+
+uint32_t
+BpCustodySignalHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  SDNV sdnv;
+
+  m_fragment = (i.ReadU8 () & 1) != 0;
+  uint8_t status = i.ReadU8 ();
+  m_succeeded = (status & 0x80) != 0;
+  m_reason = status & 0x7f;
+  if (m_fragment)
+    {
+      m_fragOffset = sdnv.Decode (i);
+      m_fragLength = sdnv.Decode (i);
+    }
+  m_seconds = sdnv.Decode (i);
+  m_nanoseconds = sdnv.Decode (i);
+  m_createTimestamp = sdnv.Decode (i);
+  m_seq = sdnv.Decode (i);
+  uint64_t length = sdnv.Decode (i);
+  m_src.clear ();
+  for (uint64_t k = 0; k < length; k++)
+    {
+      m_src.push_back (i.ReadU8 ());
+    }
+
+  return GetSerializedSize ();
+}
+
+void
+BpCustodySignalHeader::SetStatus (bool succeeded, uint8_t reason)
+{
+  NS_LOG_FUNCTION (this << " " << succeeded << " " << (uint16_t) reason);
+  m_succeeded = succeeded;
+  m_reason = reason;
+}
+
+void
+BpCustodySignalHeader::SetBundleId (const BpEndpointId &src, std::time_t timestamp, uint32_t seq)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << timestamp << " " << seq);
+  m_src = src.Uri ();
+  m_createTimestamp = timestamp;
+  m_seq = seq;
+}
+
+void
+BpCustodySignalHeader::SetFragment (uint32_t offset, uint32_t length)
+{
+  NS_LOG_FUNCTION (this << " " << offset << " " << length);
+  m_fragment = true;
+  m_fragOffset = offset;
+  m_fragLength = length;
+}
+
+void
+BpCustodySignalHeader::SetSignalTime (Time time)
+{
+  NS_LOG_FUNCTION (this << " " << time.GetSeconds ());
+  int64_t nanoseconds = time.GetNanoSeconds ();
+  m_seconds = nanoseconds / 1000000000;
+  m_nanoseconds = nanoseconds % 1000000000;
+}
+
+bool
+BpCustodySignalHeader::IsSucceeded () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_succeeded;
+}
+
+uint8_t
+BpCustodySignalHeader::GetReason () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_reason;
+}
+
+bool
+BpCustodySignalHeader::IsFragment () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_fragment;
+}
+
+uint32_t
+BpCustodySignalHeader::GetFragOffset () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_fragOffset;
+}
+
+uint32_t
+BpCustodySignalHeader::GetFragLength () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_fragLength;
+}
+
+Time
+BpCustodySignalHeader::GetSignalTime () const
+{
+  NS_LOG_FUNCTION (this);
+  return Seconds (m_seconds) + NanoSeconds (m_nanoseconds);
+}
+
+BpEndpointId
+BpCustodySignalHeader::GetSourceEid () const
+{
+  NS_LOG_FUNCTION (this);
+  return BpEndpointId (m_src);
+}
+
+std::time_t
+BpCustodySignalHeader::GetCreateTimestamp () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_createTimestamp;
+}
+
+uint32_t
+BpCustodySignalHeader::GetSequenceNumber () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_seq;
+}
+
+uint64_t
+BpCustodySignalHeader::GetBundleIdHash () const
+{
+  NS_LOG_FUNCTION (this);
+  return BpHeader::GetBundleIdHash (m_src, m_createTimestamp, m_seq, m_fragment, m_fragOffset);
+}
+
+} // namespace ns3
@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_CUSTODY_SIGNAL_HEADER_H
+#define BP_CUSTODY_SIGNAL_HEADER_H
+
+#include <stdint.h>
+#include <ctime>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+#include "ns3/packet.h"
+#include "bp-endpoint-id.h"
+
+namespace ns3 {
+
+/**
+ * \brief Custody signal
+ *
+ * The administrative record a node sends to the custodian of a bundle
+ * when it accepts or refuses custody of the bundle, section 6.1.2 of
+ * RFC 5050: a status (succeeded, reason), the offset and length of the
+ * bundle if it is a fragment, the time of the signal and the bundle id.
+ */
+class BpCustodySignalHeader : public Header
+{
+public:
+  BpCustodySignalHeader ();
+
+  virtual ~BpCustodySignalHeader ();
+
+  /**
+   * administrative record type of custody signals
+   */
+  static const uint8_t RECORD_TYPE = 0x2;
+
+  /**
+   * reason codes, section 6.1.2 of RFC 5050
+   */
+  typedef enum {
+    NO_ADDITIONAL_INFORMATION      = 0x00,
+    REDUNDANT_RECEPTION            = 0x03,
+    DEPLETED_STORAGE               = 0x04,
+    DESTINATION_UNINTELLIGIBLE     = 0x05,
+    NO_KNOWN_ROUTE                 = 0x06,
+    NO_TIMELY_CONTACT              = 0x07,
+    BLOCK_UNINTELLIGIBLE           = 0x08
+  } Reason;
+
+  /**
+   * \brief Is an administrative record a custody signal?
+   *
+   * \param record the administrative record, without the bundle headers
+   */
+  static bool IsCustodySignal (Ptr<const Packet> record);
+
+  /**
+   * \brief set the status of the signal
+   *
+   * \param succeeded custody was accepted
+   * \param reason the reason code
+   */
+  void SetStatus (bool succeeded, uint8_t reason);
+
+  /**
+   * \brief set the id of the bundle, taken from its primary header
+   *
+   * \param src the source endpoint id
+   * \param timestamp the creation timestamp
+   * \param seq the creation sequence number
+   */
+  void SetBundleId (const BpEndpointId &src, std::time_t timestamp, uint32_t seq);
+
+  /**
+   * \brief the bundle is a fragment
+   *
+   * \param offset the offset of the fragment
+   * \param length the length of its payload
+   */
+  void SetFragment (uint32_t offset, uint32_t length);
+
+  /**
+   * \brief set the time of the signal, in seconds
+   */
+  void SetSignalTime (Time time);
+
+  bool IsSucceeded () const;
+  uint8_t GetReason () const;
+  bool IsFragment () const;
+  uint32_t GetFragOffset () const;
+  uint32_t GetFragLength () const;
+  Time GetSignalTime () const;
+  BpEndpointId GetSourceEid () const;
+  std::time_t GetCreateTimestamp () const;
+  uint32_t GetSequenceNumber () const;
+
+  /**
+   * \return the hash of the bundle id, as BpHeader::GetBundleIdHash ()
+   */
+  uint64_t GetBundleIdHash () const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  bool m_succeeded;                   /// custody was accepted
+  uint8_t m_reason;                   /// reason code
+  bool m_fragment;                    /// the bundle is a fragment
+  uint32_t m_fragOffset;              /// offset of the fragment
+  uint32_t m_fragLength;              /// payload length of the fragment
+  uint64_t m_seconds;                 /// time of the signal: seconds
+  uint32_t m_nanoseconds;             /// time of the signal: nanoseconds
+  std::time_t m_createTimestamp;      /// creation timestamp of the bundle
+  uint32_t m_seq;                     /// creation sequence number of the bundle
+  std::string m_src;                  /// source endpoint id of the bundle
+};
+
+} // namespace ns3
+
+#endif /* BP_CUSTODY_SIGNAL_HEADER_H */
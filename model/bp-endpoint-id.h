@@ -23,6 +23,7 @@
 
 #include<string>
 #include<iostream>
+#include<functional>
 namespace ns3 {
 
 /**
@@ -135,6 +136,8 @@ private:
    */
   friend bool operator < (BpEndpointId const &a, BpEndpointId const &b);
 
+  friend struct BpEndpointIdHash;
+
 private:
   std::string m_uri;  /// the endpoint id is represented by an URI in BP protocol
 
@@ -157,6 +160,17 @@ inline bool operator < (const BpEndpointId &a, const BpEndpointId &b)
   return (a.m_uri < b.m_uri);
 }
 
+/**
+ * \brief Hash of an endpoint id, for unordered containers
+ */
+struct BpEndpointIdHash
+{
+  std::size_t operator () (const BpEndpointId &eid) const
+  {
+    return std::hash<std::string> () (eid.m_uri);
+  }
+};
+
 
 } // namespace ns3
 
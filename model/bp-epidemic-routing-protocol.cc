@@ -0,0 +1,284 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "bp-epidemic-routing-protocol.h"
+#include "bp-routing-record-header.h"
+#include "bp-header.h"
+#include "bp-payload-header.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <vector>
+
+NS_LOG_COMPONENT_DEFINE ("BpEpidemicRoutingProtocol");
+
+namespace ns3 {
+
+TypeId
+BpEpidemicRoutingProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpEpidemicRoutingProtocol")
+    .SetParent<BpRoutingProtocol> ()
+    .AddConstructor<BpEpidemicRoutingProtocol> ()
+    .AddAttribute ("SeenSetSize",
+                   "The number of bundle ids remembered as seen.",
+                   UintegerValue (131072),
+                   MakeUintegerAccessor (&BpEpidemicRoutingProtocol::m_maxSeen),
+                   MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+    .AddAttribute ("MaxBundles",
+                   "The number of bundles kept for replication; the oldest one is dropped first.",
+                   UintegerValue (100000),
+                   MakeUintegerAccessor (&BpEpidemicRoutingProtocol::m_maxBundles),
+                   MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+    .AddAttribute ("AnnounceDelay",
+                   "The delay batching the announcements of new bundle ids to the neighbours.",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&BpEpidemicRoutingProtocol::m_announceDelay),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+BpEpidemicRoutingProtocol::BpEpidemicRoutingProtocol ()
+  : m_bp (0),
+    m_maxSeen (131072),
+    m_maxBundles (100000),
+    m_announceDelay (MilliSeconds (100)),
+    m_seenCount (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpEpidemicRoutingProtocol::~BpEpidemicRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpEpidemicRoutingProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_announceEvent.Cancel ();
+  m_buffer.clear ();
+  m_bufferOrder.clear ();
+  m_neighbours.clear ();
+  m_bp = 0;
+  BpRoutingProtocol::DoDispose ();
+}
+
+void
+BpEpidemicRoutingProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  NS_ASSERT_MSG (m_bp == 0 || m_bp == bundleProtocol, "BpEpidemicRoutingProtocol::SetBundleProtocol (): one routing protocol instance per node");
+  m_bp = bundleProtocol;
+}
+
+BpEndpointId
+BpEpidemicRoutingProtocol::GetRoute (BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  return eid;
+}
+
+uint32_t
+BpEpidemicRoutingProtocol::GetNBufferedBundles () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_buffer.size ();
+}
+
+void
+BpEpidemicRoutingProtocol::Remember (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  m_seen.insert (id);
+  m_seenOrder.push_back (id);
+  m_seenCount++;
+  while (m_seenOrder.size () > m_maxSeen)
+    {
+      m_seen.erase (m_seenOrder.front ());
+      m_seenOrder.pop_front ();
+    }
+}
+
+void
+BpEpidemicRoutingProtocol::Store (uint64_t id, Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << id << " " << bundle);
+  m_buffer.insert (std::make_pair (id, bundle));
+  m_bufferOrder.push_back (id);
+  while (m_bufferOrder.size () > m_maxBundles)
+    {
+      NS_LOG_DEBUG ("Buffer full, dropping bundle " << m_bufferOrder.front ());
+      m_buffer.erase (m_bufferOrder.front ());
+      m_bufferOrder.pop_front ();
+    }
+}
+
+void
+BpEpidemicRoutingProtocol::Replicate (uint64_t id, Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  for (std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.begin (); it != m_neighbours.end (); ++it)
+    {
+      // until its summary vector comes, a neighbour may have anything
+      if (!(*it).second.summaryReceived || (*it).second.known.count (id))
+        continue;
+      // copies share the payload buffer of the bundle
+      if (m_bp->ForwardBundleTo (bundle->Copy (), (*it).first) >= 0)
+        (*it).second.known.insert (id);
+    }
+}
+
+bool
+BpEpidemicRoutingProtocol::HandleBundle (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bpHeader;
+  bundle->PeekHeader (bpHeader);
+  uint64_t id = bpHeader.GetBundleIdHash ();
+
+  if (m_seen.count (id) || m_buffer.count (id))
+    {
+      // a copy of a bundle already here, or already delivered
+      NS_LOG_DEBUG ("Dropping bundle " << id << " seen before");
+      return true;
+    }
+
+  Remember (id);
+  if (!m_announceEvent.IsRunning () && !m_neighbours.empty ())
+    m_announceEvent = Simulator::Schedule (m_announceDelay, &BpEpidemicRoutingProtocol::Announce, this);
+
+  if (bpHeader.GetDestinationEid () == m_bp->GetBpEndpointId ())
+    return false;
+
+  Store (id, bundle);
+  Replicate (id, bundle);
+  return true;
+}
+
+bool
+BpEpidemicRoutingProtocol::HandleAdminRecord (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  Ptr<Packet> record = bundle->Copy ();
+  BpHeader bpHeader;
+  BpPayloadHeader bppHeader;
+  record->RemoveHeader (bpHeader);
+  record->RemoveHeader (bppHeader);
+  if (!BpRoutingRecordHeader::IsRoutingRecord (record))
+    return false;
+
+  BpRoutingRecordHeader header;
+  record->RemoveHeader (header);
+  if (header.GetKind () != SUMMARY_VECTOR && header.GetKind () != SUMMARY_DELTA)
+    return false;
+
+  // a summary vector is the first sign of a contact seen from the other side
+  BpEndpointId eid = bpHeader.GetSourceEid ();
+  if (m_neighbours.find (eid) == m_neighbours.end ())
+    NotifyNeighbourUp (eid);
+  Neighbour &neighbour = m_neighbours[eid];
+
+  const std::vector<uint64_t> &ids = header.GetValues ();
+  neighbour.known.insert (ids.begin (), ids.end ());
+  NS_LOG_DEBUG ("Summary of " << ids.size () << " bundle ids from " << eid.Uri ());
+
+  if (header.GetKind () == SUMMARY_VECTOR)
+    {
+      // send the bundles it is missing, oldest first
+      neighbour.summaryReceived = true;
+      for (std::deque<uint64_t>::iterator it = m_bufferOrder.begin (); it != m_bufferOrder.end (); ++it)
+        {
+          if (neighbour.known.count (*it))
+            continue;
+          if (m_bp->ForwardBundleTo (m_buffer[*it]->Copy (), eid) < 0)
+            break;
+          neighbour.known.insert (*it);
+        }
+    }
+
+  return true;
+}
+
+void
+BpEpidemicRoutingProtocol::NotifyNeighbourUp (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  if (m_neighbours.find (eid) != m_neighbours.end ())
+    return;
+
+  Neighbour &neighbour = m_neighbours[eid];
+  SendSummary (eid, neighbour, true);
+}
+
+void
+BpEpidemicRoutingProtocol::NotifyNeighbourDown (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  m_neighbours.erase (eid);
+}
+
+void
+BpEpidemicRoutingProtocol::SendSummary (const BpEndpointId &eid, Neighbour &neighbour, bool full)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << full);
+  // the seen set keeps its insertion order: the ids seen since the last
+  // summary are at its end
+  uint64_t first = m_seenCount - m_seenOrder.size ();
+  uint64_t from = full ? first : std::max (neighbour.announced, first);
+  std::vector<uint64_t> ids (m_seenOrder.begin () + (from - first), m_seenOrder.end ());
+  if (full)
+    {
+      // bundles still buffered whose id was evicted from the seen set
+      for (std::deque<uint64_t>::iterator it = m_bufferOrder.begin (); it != m_bufferOrder.end (); ++it)
+        {
+          if (!m_seen.count (*it))
+            ids.push_back (*it);
+        }
+    }
+  std::sort (ids.begin (), ids.end ());
+  ids.erase (std::unique (ids.begin (), ids.end ()), ids.end ());
+
+  BpRoutingRecordHeader header;
+  header.SetKind (full ? SUMMARY_VECTOR : SUMMARY_DELTA);
+  header.SetValues (ids, true);
+  Ptr<Packet> record = Create<Packet> ();
+  record->AddHeader (header);
+
+  NS_LOG_DEBUG ("Summary of " << ids.size () << " bundle ids to " << eid.Uri () << " in " << record->GetSize () << " bytes");
+  m_bp->SendAdminRecord (record, eid);
+  neighbour.announced = m_seenCount;
+}
+
+void
+BpEpidemicRoutingProtocol::Announce ()
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.begin (); it != m_neighbours.end (); ++it)
+    {
+      if ((*it).second.announced < m_seenCount)
+        SendSummary ((*it).first, (*it).second, false);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,181 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_EPIDEMIC_ROUTING_PROTOCOL_H
+#define BP_EPIDEMIC_ROUTING_PROTOCOL_H
+
+#include "bp-routing-protocol.h"
+#include "bundle-protocol.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include <stdint.h>
+#include <map>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ns3 {
+
+/**
+ * \brief Epidemic routing
+ *
+ * Every bundle is replicated to every neighbour which does not have it
+ * yet. When a contact starts (BundleProtocol::NotifyNeighbourUp ()), the
+ * two neighbours exchange summary vectors: the sorted, delta-encoded
+ * hashes of the bundle ids they have seen, in a routing control record.
+ * Each of them then sends the other only the bundles missing from its
+ * summary vector. During the contact, new bundles are sent at once to the
+ * neighbours not known to have them, and the hashes seen since the last
+ * summary vector are announced as a delta, so a summary vector is sent
+ * in full once per contact.
+ *
+ * The bundle ids seen are kept in a bounded set, oldest evicted first,
+ * so that a bundle coming back is not forwarded again; the buffer of
+ * bundles to replicate is bounded as well.
+ */
+class BpEpidemicRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpEpidemicRoutingProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpEpidemicRoutingProtocol ();
+
+  /**
+   * \brief Set bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \return the endpoint id itself: bundles are sent to the neighbours
+   * by replication, not along routes
+   */
+  virtual BpEndpointId GetRoute (BpEndpointId eid);
+
+  /**
+   * \brief Keep a bundle not addressed to this node and replicate it
+   *
+   * \return true unless the bundle is addressed to this node and was not
+   * seen before
+   */
+  virtual bool HandleBundle (Ptr<Packet> bundle);
+
+  /**
+   * \brief Take the summary vectors of the neighbours
+   */
+  virtual bool HandleAdminRecord (Ptr<Packet> bundle);
+
+  /**
+   * \brief Send the summary vector to a new neighbour
+   */
+  virtual void NotifyNeighbourUp (const BpEndpointId &eid);
+
+  /**
+   * \brief Forget what a neighbour has
+   */
+  virtual void NotifyNeighbourDown (const BpEndpointId &eid);
+
+  /**
+   * \return the number of bundles kept for replication
+   */
+  uint32_t GetNBufferedBundles () const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * kinds of the routing control records
+   */
+  enum RecordKind
+  {
+    SUMMARY_VECTOR = 1,         /// all bundle ids seen
+    SUMMARY_DELTA = 2           /// bundle ids seen since the last summary vector
+  };
+
+  /**
+   * \brief State of a neighbour in contact
+   */
+  struct Neighbour
+  {
+    Neighbour ()
+      : announced (0),
+        summaryReceived (false)
+    {
+    }
+
+    std::unordered_set<uint64_t> known; /// hashes of the bundle ids the neighbour has
+    uint64_t announced;                 /// count of bundle ids seen when the last summary was sent to it
+    bool summaryReceived;               /// its full summary vector has been received
+  };
+
+  /**
+   * \brief Add a bundle id to the seen set, evicting the oldest one if full
+   */
+  void Remember (uint64_t id);
+
+  /**
+   * \brief Keep a bundle for replication, dropping the oldest one if full
+   */
+  void Store (uint64_t id, Ptr<Packet> bundle);
+
+  /**
+   * \brief Send a bundle to the neighbours not known to have it
+   */
+  void Replicate (uint64_t id, Ptr<Packet> bundle);
+
+  /**
+   * \brief Send a summary vector, or the delta since the last one
+   *
+   * \param eid the endpoint id of the neighbour
+   * \param neighbour the state of the neighbour
+   * \param full send all bundle ids seen
+   */
+  void SendSummary (const BpEndpointId &eid, Neighbour &neighbour, bool full);
+
+  /**
+   * \brief Send the bundle ids seen since the last summary to all neighbours
+   */
+  void Announce ();
+
+  Ptr<BundleProtocol> m_bp;                             /// bundle protocol
+  uint32_t m_maxSeen;                                   /// size of the seen set
+  uint32_t m_maxBundles;                                /// size of the buffer
+  Time m_announceDelay;                                 /// delay batching the announcements of new bundle ids
+
+  std::unordered_set<uint64_t> m_seen;                  /// hashes of the bundle ids seen
+  std::deque<uint64_t> m_seenOrder;                     /// the seen set, oldest first
+  uint64_t m_seenCount;                                 /// number of bundle ids ever added to the seen set
+  std::unordered_map<uint64_t, Ptr<Packet> > m_buffer;  /// bundles kept for replication: map (bundle id hash, bundle)
+  std::deque<uint64_t> m_bufferOrder;                   /// the buffer, oldest first
+  std::map<BpEndpointId, Neighbour> m_neighbours;       /// neighbours in contact
+  EventId m_announceEvent;                              /// pending announcement
+};
+
+}  // namespace ns3
+
+#endif /* BP_EPIDEMIC_ROUTING_PROTOCOL_H */
@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "bp-forwarding-table.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("BpForwardingTable");
+
+namespace ns3 {
+
+const uint32_t BpForwardingTable::NO_ROUTE;
+
+BpForwardingTable::BpForwardingTable (const std::vector<BpEndpointId> &eids)
+  : m_eids (eids)
+{
+  NS_LOG_FUNCTION (this << " " << eids.size ());
+  m_handles.reserve (m_eids.size ());
+  for (uint32_t i = 0; i < m_eids.size (); i++)
+    m_handles.insert (std::make_pair (m_eids[i], i));
+  m_rowStart.reserve (m_eids.size () + 1);
+  m_rowStart.push_back (0);
+}
+
+uint32_t
+BpForwardingTable::GetN () const
+{
+  return m_eids.size ();
+}
+
+const BpEndpointId &
+BpForwardingTable::GetEid (uint32_t handle) const
+{
+  NS_ASSERT (handle < m_eids.size ());
+  return m_eids[handle];
+}
+
+bool
+BpForwardingTable::GetHandle (const BpEndpointId &eid, uint32_t &handle) const
+{
+  std::unordered_map<BpEndpointId, uint32_t, BpEndpointIdHash>::const_iterator it = m_handles.find (eid);
+  if (it == m_handles.end ())
+    return false;
+  handle = (*it).second;
+  return true;
+}
+
+void
+BpForwardingTable::AddRow (const std::vector<int32_t> &nextHops)
+{
+  NS_LOG_FUNCTION (this << " " << GetNRows ());
+  NS_ASSERT (nextHops.size () == m_eids.size ());
+  NS_ASSERT (GetNRows () < m_eids.size ());
+
+  uint32_t previous = NO_ROUTE;
+  for (uint32_t d = 0; d < nextHops.size (); d++)
+    {
+      uint32_t nextHop = (nextHops[d] < 0) ? NO_ROUTE : nextHops[d];
+      // a row always starts with a run, so that Lookup () finds one
+      if (d > 0 && nextHop == previous)
+        continue;
+      m_runDst.push_back (d);
+      m_runNextHop.push_back (nextHop);
+      previous = nextHop;
+    }
+  m_rowStart.push_back (m_runDst.size ());
+}
+
+uint32_t
+BpForwardingTable::GetNRows () const
+{
+  return m_rowStart.size () - 1;
+}
+
+uint32_t
+BpForwardingTable::Lookup (uint32_t node, uint32_t dst) const
+{
+  NS_LOG_FUNCTION (this << " " << node << " " << dst);
+  if (node >= GetNRows () || dst >= m_eids.size ())
+    return NO_ROUTE;
+
+  // the last run starting at or before the destination
+  std::vector<uint32_t>::const_iterator begin = m_runDst.begin () + m_rowStart[node];
+  std::vector<uint32_t>::const_iterator end = m_runDst.begin () + m_rowStart[node + 1];
+  std::vector<uint32_t>::const_iterator it = std::upper_bound (begin, end, dst);
+  return m_runNextHop[(it - m_runDst.begin ()) - 1];
+}
+
+uint64_t
+BpForwardingTable::GetRowBytes () const
+{
+  return m_rowStart.capacity () * sizeof (uint32_t)
+         + m_runDst.capacity () * sizeof (uint32_t)
+         + m_runNextHop.capacity () * sizeof (uint32_t);
+}
+
+} // namespace ns3
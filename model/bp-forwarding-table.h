@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_FORWARDING_TABLE_H
+#define BP_FORWARDING_TABLE_H
+
+#include "ns3/simple-ref-count.h"
+#include "bp-endpoint-id.h"
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+namespace ns3 {
+
+/**
+ * \brief Next hops of all bundle nodes towards all bundle nodes, compiled
+ * once and shared by the routing protocols of all nodes
+ *
+ * The bundle nodes are numbered by handles, 0 to N - 1, used both for the
+ * node holding a route and for its destination. The table is a compressed
+ * sparse row layout: the row of a node is a run of consecutive
+ * destination handles per next hop, so a node whose destinations are
+ * numbered in topological order (e.g. a depth first order of the network)
+ * holds a few runs per neighbour instead of N entries. A run takes 8
+ * bytes; a lookup is a binary search in the row.
+ *
+ * The table is filled row by row, in the order of the node handles, and
+ * is not changed afterwards: it is shared as a Ptr<const BpForwardingTable>.
+ * A node changing its own routes keeps them aside, see
+ * BpStaticRoutingProtocol::AddRoute ().
+ */
+class BpForwardingTable : public SimpleRefCount<BpForwardingTable>
+{
+public:
+  /**
+   * \brief Next hop of a destination which cannot be reached
+   */
+  static const uint32_t NO_ROUTE = 0xffffffff;
+
+  /**
+   * Constructor
+   *
+   * \param eids the endpoint ids of the bundle nodes, by handle
+   */
+  BpForwardingTable (const std::vector<BpEndpointId> &eids);
+
+  /**
+   * \return the number of bundle nodes
+   */
+  uint32_t GetN () const;
+
+  /**
+   * \return the endpoint id of a handle
+   */
+  const BpEndpointId &GetEid (uint32_t handle) const;
+
+  /**
+   * \brief Look up the handle of an endpoint id
+   *
+   * \return false if the endpoint id is not a bundle node of the table
+   */
+  bool GetHandle (const BpEndpointId &eid, uint32_t &handle) const;
+
+  /**
+   * \brief Add the row of the next node handle
+   *
+   * \param nextHops the next hop handle towards each destination handle:
+   * the destination itself for a neighbour, a negative value if it cannot
+   * be reached
+   */
+  void AddRow (const std::vector<int32_t> &nextHops);
+
+  /**
+   * \return the number of rows added
+   */
+  uint32_t GetNRows () const;
+
+  /**
+   * \brief Look up the next hop of a node towards a destination
+   *
+   * \return the handle of the next hop, NO_ROUTE if there is none
+   */
+  uint32_t Lookup (uint32_t node, uint32_t dst) const;
+
+  /**
+   * \return the bytes taken by the rows
+   */
+  uint64_t GetRowBytes () const;
+
+private:
+  std::vector<BpEndpointId> m_eids;                                     /// endpoint ids by handle
+  std::unordered_map<BpEndpointId, uint32_t, BpEndpointIdHash> m_handles; /// map (endpoint id, handle)
+  std::vector<uint32_t> m_rowStart;                                     /// first run of each row; the last one ends the last row
+  std::vector<uint32_t> m_runDst;                                       /// first destination handle of each run
+  std::vector<uint32_t> m_runNextHop;                                   /// next hop handle of each run
+};
+
+}  // namespace ns3
+
+#endif /* BP_FORWARDING_TABLE_H */
@@ -63,7 +63,8 @@ BpHeader::BpHeader ()
     m_dictLength (0),
     m_dictionary (""),
     m_fragOffset (0),
-    m_aduLength (0)
+    m_aduLength (0),
+    m_custodyId (0)
 {
   NS_LOG_FUNCTION (this);
 
@@ -123,9 +124,13 @@ BpHeader::GetSerializedSize (void) const
   headerLength += sdnv.EncodingLength(m_srcSspOffset.length);
 
   headerLength += sdnv.EncodingLength(m_reportSchemeOffset.offset);
+  headerLength += sdnv.EncodingLength(m_reportSchemeOffset.length);
   headerLength += sdnv.EncodingLength(m_reportSspOffset.offset);
+  headerLength += sdnv.EncodingLength(m_reportSspOffset.length);
   headerLength += sdnv.EncodingLength(m_custSchemeOffset.offset);
+  headerLength += sdnv.EncodingLength(m_custSchemeOffset.length);
   headerLength += sdnv.EncodingLength(m_custSspOffset.offset);
+  headerLength += sdnv.EncodingLength(m_custSspOffset.length);
   headerLength += sdnv.EncodingLength(m_createTimestamp);
   headerLength += sdnv.EncodingLength(m_timestampSeqNum.GetValue());
   headerLength += sdnv.EncodingLength(m_lifeTime);
@@ -135,6 +140,9 @@ BpHeader::GetSerializedSize (void) const
     headerLength += sdnv.EncodingLength(m_fragOffset);
     headerLength += sdnv.EncodingLength(m_aduLength);
   }
+  if (m_processingFlags & BUNDLE_CUSTODY_XFER_REQUESTED) {
+    headerLength += sdnv.EncodingLength(m_custodyId);
+  }
 
   // Calculate total length
   size = 0;
@@ -203,18 +211,36 @@ BpHeader::Serialize (Buffer::Iterator start) const
   headerLength += reportSchemeOffset.size();
   headerBody.insert (headerBody.end (), reportSchemeOffset.begin (), reportSchemeOffset.end ());
 
+  // the report-to endpoint id is read back by the nodes sending status reports
+  std::vector<uint8_t> reportSchemeLength = sdnv.Encode (m_reportSchemeOffset.length);
+  headerLength += reportSchemeLength.size();
+  headerBody.insert (headerBody.end (), reportSchemeLength.begin (), reportSchemeLength.end ());
+
   std::vector<uint8_t> reportSspOffset = sdnv.Encode (m_reportSspOffset.offset);
   headerLength += reportSspOffset.size();
   headerBody.insert (headerBody.end (), reportSspOffset.begin (), reportSspOffset.end ());
 
+  std::vector<uint8_t> reportSspLength = sdnv.Encode (m_reportSspOffset.length);
+  headerLength += reportSspLength.size();
+  headerBody.insert (headerBody.end (), reportSspLength.begin (), reportSspLength.end ());
+
   std::vector<uint8_t> custSchemeOffset = sdnv.Encode (m_custSchemeOffset.offset);
   headerLength += custSchemeOffset.size();
   headerBody.insert (headerBody.end (), custSchemeOffset.begin (), custSchemeOffset.end ());
 
+  // the custodian is read back by the next hop to send custody signals
+  std::vector<uint8_t> custSchemeLength = sdnv.Encode (m_custSchemeOffset.length);
+  headerLength += custSchemeLength.size();
+  headerBody.insert (headerBody.end (), custSchemeLength.begin (), custSchemeLength.end ());
+
   std::vector<uint8_t> custSspOffset = sdnv.Encode (m_custSspOffset.offset);
   headerLength += custSspOffset.size();
   headerBody.insert (headerBody.end (), custSspOffset.begin (), custSspOffset.end ());
 
+  std::vector<uint8_t> custSspLength = sdnv.Encode (m_custSspOffset.length);
+  headerLength += custSspLength.size();
+  headerBody.insert (headerBody.end (), custSspLength.begin (), custSspLength.end ());
+
   std::vector<uint8_t> createTimestamp = sdnv.Encode (m_createTimestamp);
   headerLength += createTimestamp.size();
   headerBody.insert (headerBody.end (), createTimestamp.begin (), createTimestamp.end ());
@@ -247,6 +273,13 @@ BpHeader::Serialize (Buffer::Iterator start) const
     headerBody.insert (headerBody.end (), aduLength.begin (), aduLength.end ());
   }
 
+  // ACS: custody id of the bundle, acknowledged in aggregate custody signals
+  if (m_processingFlags & BUNDLE_CUSTODY_XFER_REQUESTED) {
+    std::vector<uint8_t> custodyId = sdnv.Encode (m_custodyId);
+    headerLength += custodyId.size();
+    headerBody.insert (headerBody.end (), custodyId.begin (), custodyId.end ());
+  }
+
   // Version
   i.WriteU8 (m_version);
 
@@ -285,6 +318,73 @@ BpHeader::Serialize (Buffer::Iterator start) const
   }
 }
 
+/**
+ * \brief Read an SDNV from a byte array, without reading past its end
+ *
+ * \return false if the array ends before the SDNV does
+ */
+static bool
+PeekSdnv (const std::vector<uint8_t> &data, uint32_t &pos, uint64_t &val)
+{
+  SDNV sdnv;
+  std::vector<uint8_t> encoded;
+  while (pos < data.size ())
+    {
+      encoded.push_back (data[pos++]);
+      if (!(encoded.back () & 0x80))
+        {
+          val = sdnv.Decode (encoded);
+          return true;
+        }
+    }
+  return false;
+}
+
+uint32_t
+BpHeader::PeekSerializedSize (const std::vector<uint8_t> &data)
+{
+  NS_LOG_FUNCTION (data.size ());
+  uint32_t size = data.size ();
+  if (size == 0)
+    return 0;
+
+  // the fields read by Deserialize (), in the same order
+  uint32_t pos = 1; // version
+  uint64_t flags, val;
+  if (!PeekSdnv (data, pos, flags) || !PeekSdnv (data, pos, val)) // proc. flags, block length
+    return 0;
+
+  // dictionary offsets and lengths of the destination, source, report-to
+  // and custodian endpoint ids
+  for (uint32_t k = 0; k < 16; k++)
+    {
+      if (!PeekSdnv (data, pos, val))
+        return 0;
+    }
+  // creation timestamp, sequence number, lifetime
+  for (uint32_t k = 0; k < 3; k++)
+    {
+      if (!PeekSdnv (data, pos, val))
+        return 0;
+    }
+  if (!PeekSdnv (data, pos, val)) // dictionary length
+    return 0;
+  if (val > size - pos)
+    return 0;
+  pos += val;
+  if (flags & BUNDLE_IS_FRAGMENT)
+    {
+      if (!PeekSdnv (data, pos, val) || !PeekSdnv (data, pos, val)) // fragment offset, ADU length
+        return 0;
+    }
+  if (flags & BUNDLE_CUSTODY_XFER_REQUESTED)
+    {
+      if (!PeekSdnv (data, pos, val)) // custody id
+        return 0;
+    }
+  return pos;
+}
+
 uint32_t
 BpHeader::Deserialize (Buffer::Iterator start)
 {
@@ -293,7 +393,7 @@ BpHeader::Deserialize (Buffer::Iterator start)
   SDNV sdnv;
 
   m_version = i.ReadU8 ();
-  m_processingFlags = (uint8_t) sdnv.Decode (i);
+  m_processingFlags = (uint32_t) sdnv.Decode (i);
 
   m_blockLength = (uint32_t) sdnv.Decode (i);
 
@@ -310,9 +410,13 @@ BpHeader::Deserialize (Buffer::Iterator start)
 // ACS
   m_srcSspOffset.length = (uint16_t) sdnv.Decode (i);
   m_reportSchemeOffset.offset = (uint16_t) sdnv.Decode (i);
+  m_reportSchemeOffset.length = (uint16_t) sdnv.Decode (i);
   m_reportSspOffset.offset = (uint16_t) sdnv.Decode (i);
+  m_reportSspOffset.length = (uint16_t) sdnv.Decode (i);
   m_custSchemeOffset.offset = (uint16_t) sdnv.Decode (i);
+  m_custSchemeOffset.length = (uint16_t) sdnv.Decode (i);
   m_custSspOffset.offset = (uint16_t) sdnv.Decode (i);
+  m_custSspOffset.length = (uint16_t) sdnv.Decode (i);
   m_createTimestamp = (double) sdnv.Decode (i);
   m_timestampSeqNum = (uint32_t) sdnv.Decode (i);
   m_lifeTime = (uint64_t) sdnv.Decode (i);
@@ -335,6 +439,12 @@ BpHeader::Deserialize (Buffer::Iterator start)
     m_aduLength = 0;
   }
 
+  if (m_processingFlags & BUNDLE_CUSTODY_XFER_REQUESTED) {
+    m_custodyId = sdnv.Decode (i);
+  } else {
+    m_custodyId = 0;
+  }
+
   return GetSerializedSize ();
 }
 
@@ -403,6 +513,8 @@ void
 BpHeader::SetPriority (const uint8_t pri)
 {
   NS_LOG_FUNCTION (this << " " << (uint16_t)pri);
+  m_processingFlags &= (~(UNUSED));
+  m_processingFlags |= ((uint32_t)(pri & 0x03)) << 7;
 }
 
 void
@@ -502,7 +614,7 @@ uint8_t
 BpHeader::Priority () const
 {
   NS_LOG_FUNCTION (this);
-  return BULK;
+  return (uint8_t)((m_processingFlags & UNUSED) >> 7);
 }
 
 bool
@@ -711,6 +823,49 @@ BpHeader::GetAduLength () const
   return m_aduLength;
 }
 
+void
+BpHeader::SetCustodyId (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  m_custodyId = id;
+}
+
+uint64_t
+BpHeader::GetCustodyId () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_custodyId;
+}
+
+uint64_t
+BpHeader::GetBundleIdHash () const
+{
+  NS_LOG_FUNCTION (this);
+  return GetBundleIdHash (GetSourceEid ().Uri (), m_createTimestamp, m_timestampSeqNum.GetValue (), IsFragment (), m_fragOffset);
+}
+
+uint64_t
+BpHeader::GetBundleIdHash (const std::string &src, std::time_t timestamp, uint32_t seq, bool fragment, uint32_t fragOffset)
+{
+  // FNV-1a over the fields of the bundle id
+  const uint64_t prime = 0x100000001b3ULL;
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (std::string::const_iterator it = src.begin (); it != src.end (); ++it)
+    {
+      hash = (hash ^ (uint8_t) *it) * prime;
+    }
+
+  uint64_t fields[3] = { (uint64_t) timestamp, seq, fragment ? fragOffset + 1ULL : 0 };
+  for (int i = 0; i < 3; i++)
+    {
+      for (int byte = 0; byte < 8; byte++)
+        {
+          hash = (hash ^ ((fields[i] >> (8 * byte)) & 0xff)) * prime;
+        }
+    }
+  return hash;
+}
+
 void
 BpHeader::SetBlockLength (uint32_t len)
 {
@@ -27,6 +27,7 @@
 #include "ns3/header.h"
 #include "ns3/nstime.h"
 #include "ns3/buffer.h"
+#include <vector>
 #include "ns3/sequence-number.h"
 #include "bp-endpoint-id.h"
 
@@ -93,7 +94,7 @@ public:
   /**
    * \brief Set priority field
    *
-   * \param pri priority of bundle
+   * \param pri priority of bundle: 0 bulk, 1 normal, 2 expedited
    */
   void SetPriority (const uint8_t pri);
 
@@ -202,6 +203,14 @@ public:
    */
   void SetAduLength (uint32_t len);
 
+  /**
+   * \brief set the custody id given by the custodian, carried only when
+   * custody transfer is requested
+   *
+   * \param id the custody id, 0 for none
+   */
+  void SetCustodyId (uint64_t id);
+
 
   // Getters
   /**
@@ -237,7 +246,7 @@ public:
   /**
    * \brief Get priority of bundle
    *
-   * \return priority of bundle
+   * \return priority of bundle: 0 bulk, 1 normal, 2 expedited
    */
   uint8_t Priority () const;  
 
@@ -321,6 +330,41 @@ public:
    */
   uint32_t GetAduLength () const;
 
+  /**
+   * \return the custody id given by the custodian, used to acknowledge
+   * the bundle in an aggregate custody signal; 0 for none
+   */
+  uint64_t GetCustodyId () const;
+
+  /**
+   * \return a 64-bit hash of the bundle id: the source endpoint id, the
+   * creation timestamp and sequence number and, for a fragment, its offset
+   */
+  uint64_t GetBundleIdHash () const;
+
+  /**
+   * \return the hash of a bundle id given by its fields, as
+   * GetBundleIdHash ()
+   *
+   * \param src the URI of the source endpoint id
+   * \param timestamp the creation timestamp
+   * \param seq the creation sequence number
+   * \param fragment the bundle is a fragment
+   * \param fragOffset the offset of the fragment
+   */
+  static uint64_t GetBundleIdHash (const std::string &src, std::time_t timestamp, uint32_t seq, bool fragment, uint32_t fragOffset);
+
+  /**
+   * \brief Size of the primary bundle header at the start of a byte
+   * stream, read without reading past the end of the stream
+   *
+   * \param data the first bytes received so far
+   *
+   * \return the serialized size of the header, 0 if the bytes end
+   * before it does
+   */
+  static uint32_t PeekSerializedSize (const std::vector<uint8_t> &data);
+
   static TypeId GetTypeId (void);
   virtual TypeId GetInstanceTypeId (void) const;
   virtual void Print (std::ostream &os) const;
@@ -377,6 +421,7 @@ private:
   std::string m_dictionary;               /// dictionary
   uint32_t m_fragOffset;                  /// fragementation offset
   uint32_t m_aduLength;                   /// application data unit length
+  uint64_t m_custodyId;                   /// custody id given by the custodian
 
   uint32_t AddDictionaryEntry(const std::string &entry);
 };
@@ -0,0 +1,359 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "bp-link-state-routing-protocol.h"
+#include "bp-cla-protocol.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/net-device.h"
+#include "ns3/simulator.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/output-stream-wrapper.h"
+#include "ns3/inet-socket-address.h"
+#include <limits>
+
+NS_LOG_COMPONENT_DEFINE ("BpLinkStateRoutingProtocol");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BpLinkStateMonitor);
+
+TypeId
+BpLinkStateMonitor::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpLinkStateMonitor")
+    .SetParent<Ipv4RoutingProtocol> ()
+    .AddConstructor<BpLinkStateMonitor> ()
+  ;
+  return tid;
+}
+
+BpLinkStateMonitor::BpLinkStateMonitor ()
+  : m_ipv4 (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpLinkStateMonitor::~BpLinkStateMonitor ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpLinkStateMonitor::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_changeEvent.Cancel ();
+  m_linkChange = MakeNullCallback<void> ();
+  m_ipv4 = 0;
+  Ipv4RoutingProtocol::DoDispose ();
+}
+
+void
+BpLinkStateMonitor::SetLinkChangeCallback (Callback<void> callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_linkChange = callback;
+}
+
+bool
+BpLinkStateMonitor::IsReachable (Ipv4Address address) const
+{
+  NS_LOG_FUNCTION (this << " " << address);
+  if (!m_ipv4)
+    return true;
+
+  Ptr<Packet> packet = Create<Packet> ();
+  Ipv4Header header;
+  header.SetDestination (address);
+  Socket::SocketErrno sockerr;
+  Ptr<Ipv4Route> route = m_ipv4->GetRoutingProtocol ()->RouteOutput (packet, header, 0, sockerr);
+  if (!route)
+    return false;
+
+  Ptr<NetDevice> device = route->GetOutputDevice ();
+  int32_t interface = m_ipv4->GetInterfaceForDevice (device);
+  return interface >= 0 && m_ipv4->IsUp (interface) && device->IsLinkUp ();
+}
+
+Ptr<Ipv4Route>
+BpLinkStateMonitor::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+{
+  sockerr = Socket::ERROR_NOROUTETOHOST;
+  return 0;
+}
+
+bool
+BpLinkStateMonitor::RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+                                UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                                LocalDeliverCallback lcb, ErrorCallback ecb)
+{
+  return false;
+}
+
+void
+BpLinkStateMonitor::NotifyInterfaceUp (uint32_t interface)
+{
+  NS_LOG_FUNCTION (this << " " << interface);
+  HookDevices ();
+  Changed ();
+}
+
+void
+BpLinkStateMonitor::NotifyInterfaceDown (uint32_t interface)
+{
+  NS_LOG_FUNCTION (this << " " << interface);
+  Changed ();
+}
+
+void
+BpLinkStateMonitor::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
+{
+  NS_LOG_FUNCTION (this << " " << interface);
+  Changed ();
+}
+
+void
+BpLinkStateMonitor::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
+{
+  NS_LOG_FUNCTION (this << " " << interface);
+  Changed ();
+}
+
+void
+BpLinkStateMonitor::SetIpv4 (Ptr<Ipv4> ipv4)
+{
+  NS_LOG_FUNCTION (this << " " << ipv4);
+  m_ipv4 = ipv4;
+  HookDevices ();
+}
+
+void
+BpLinkStateMonitor::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
+{
+  *stream->GetStream () << "BpLinkStateMonitor: no routes" << std::endl;
+}
+
+void
+BpLinkStateMonitor::HookDevices ()
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_ipv4)
+    return;
+
+  for (uint32_t interface = 0; interface < m_ipv4->GetNInterfaces (); interface++)
+    {
+      if (!m_hooked.insert (interface).second)
+        continue;
+      Ptr<NetDevice> device = m_ipv4->GetNetDevice (interface);
+      if (device)
+        device->AddLinkChangeCallback (MakeCallback (&BpLinkStateMonitor::Changed, this));
+    }
+}
+
+void
+BpLinkStateMonitor::Changed ()
+{
+  NS_LOG_FUNCTION (this);
+  // the other routing protocols may be told of the change after this one
+  if (!m_changeEvent.IsRunning ())
+    m_changeEvent = Simulator::ScheduleNow (&BpLinkStateMonitor::NotifyChange, this);
+}
+
+void
+BpLinkStateMonitor::NotifyChange ()
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_linkChange.IsNull ())
+    m_linkChange ();
+}
+
+NS_OBJECT_ENSURE_REGISTERED (BpLinkStateRoutingProtocol);
+
+TypeId
+BpLinkStateRoutingProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpLinkStateRoutingProtocol")
+    .SetParent<BpRoutingProtocol> ()
+    .AddConstructor<BpLinkStateRoutingProtocol> ()
+  ;
+  return tid;
+}
+
+BpLinkStateRoutingProtocol::BpLinkStateRoutingProtocol ()
+  : m_bp (0),
+    m_monitor (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpLinkStateRoutingProtocol::~BpLinkStateRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpLinkStateRoutingProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_monitor)
+    m_monitor->SetLinkChangeCallback (MakeNullCallback<void> ());
+  m_monitor = 0;
+  m_bp = 0;
+  BpRoutingProtocol::DoDispose ();
+}
+
+void
+BpLinkStateRoutingProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  NS_ASSERT_MSG (m_bp == 0 || m_bp == bundleProtocol, "BpLinkStateRoutingProtocol::SetBundleProtocol (): one routing protocol instance per node");
+  m_bp = bundleProtocol;
+  if (m_monitor || !m_bp->GetNode ())
+    return;
+
+  Ptr<Ipv4> ipv4 = m_bp->GetNode ()->GetObject<Ipv4> ();
+  Ptr<Ipv4ListRouting> list = ipv4 ? DynamicCast<Ipv4ListRouting> (ipv4->GetRoutingProtocol ()) : 0;
+  if (!list)
+    {
+      NS_LOG_WARN ("BpLinkStateRoutingProtocol::SetBundleProtocol (): the node has no Ipv4ListRouting, link changes are not watched");
+      return;
+    }
+
+  // told of the interface changes after every other routing protocol
+  m_monitor = CreateObject<BpLinkStateMonitor> ();
+  m_monitor->SetLinkChangeCallback (MakeCallback (&BpLinkStateRoutingProtocol::LinkStateChanged, this));
+  list->AddRoutingProtocol (m_monitor, std::numeric_limits<int16_t>::min ());
+}
+
+int
+BpLinkStateRoutingProtocol::AddRoute (BpEndpointId eid, BpEndpointId nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << nextHop.Uri ());
+  std::vector<BpEndpointId> &nextHops = m_routes[eid];
+  for (std::vector<BpEndpointId>::iterator it = nextHops.begin (); it != nextHops.end (); ++it)
+    {
+      if (*it == nextHop)
+        return -1;
+    }
+
+  nextHops.push_back (nextHop);
+  NotifyRouteChange ();
+  return 0;
+}
+
+BpEndpointId
+BpLinkStateRoutingProtocol::GetRoute (BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  std::map<BpEndpointId, std::vector<BpEndpointId> >::iterator it = m_routes.find (eid);
+  if (it == m_routes.end ())
+    return m_down.count (eid) ? BpEndpointId () : eid;
+
+  for (std::vector<BpEndpointId>::iterator itHop = (*it).second.begin (); itHop != (*it).second.end (); ++itHop)
+    {
+      if (!m_down.count (*itHop))
+        return *itHop;
+    }
+
+  // held in the bundle storage until a next hop comes back
+  return BpEndpointId ();
+}
+
+bool
+BpLinkStateRoutingProtocol::IsDown (const BpEndpointId &eid) const
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  return m_down.count (eid) != 0;
+}
+
+bool
+BpLinkStateRoutingProtocol::SetDown (const BpEndpointId &eid, bool down)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << down);
+  if (down)
+    return m_down.insert (eid).second;
+  return m_down.erase (eid) != 0;
+}
+
+void
+BpLinkStateRoutingProtocol::NotifyNeighbourUp (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  if (!SetDown (eid, false))
+    return;
+  NotifyRouteChange ();
+  m_bp->RerouteBundles (eid);
+}
+
+void
+BpLinkStateRoutingProtocol::NotifyNeighbourDown (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  if (!SetDown (eid, true))
+    return;
+  NotifyRouteChange ();
+  m_bp->RerouteBundles (eid);
+}
+
+void
+BpLinkStateRoutingProtocol::LinkStateChanged ()
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_bp || !m_monitor)
+    return;
+
+  std::set<BpEndpointId> nextHops;
+  for (std::map<BpEndpointId, std::vector<BpEndpointId> >::iterator it = m_routes.begin (); it != m_routes.end (); ++it)
+    {
+      nextHops.insert ((*it).second.begin (), (*it).second.end ());
+    }
+
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  std::vector<BpEndpointId> changed;
+  for (std::set<BpEndpointId>::iterator it = nextHops.begin (); it != nextHops.end (); ++it)
+    {
+      Ptr<BpClaProtocol> cla = m_bp->GetNeighbourCla (*it);
+      if (!cla)
+        continue;
+      InetSocketAddress address = cla->getL4Address (*it);
+      if (address == badAddr)
+        continue;
+
+      bool down = !m_monitor->IsReachable (address.GetIpv4 ());
+      if (SetDown (*it, down))
+        {
+          NS_LOG_DEBUG ("Next hop " << (*it).Uri () << (down ? " down" : " up"));
+          changed.push_back (*it);
+        }
+    }
+
+  if (changed.empty ())
+    return;
+
+  NotifyRouteChange ();
+  for (std::vector<BpEndpointId>::iterator it = changed.begin (); it != changed.end (); ++it)
+    {
+      m_bp->RerouteBundles (*it);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,214 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_LINK_STATE_ROUTING_PROTOCOL_H
+#define BP_LINK_STATE_ROUTING_PROTOCOL_H
+
+#include "bp-routing-protocol.h"
+#include "bundle-protocol.h"
+#include "ns3/ipv4.h"
+#include "ns3/ipv4-routing-protocol.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include <map>
+#include <set>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Listener of the interface changes of a node
+ *
+ * An IPv4 routing protocol which routes nothing: added with the lowest
+ * priority to the Ipv4ListRouting of the node, it is told of every
+ * interface going up or down (Ipv4::SetUp (), Ipv4::SetDown ()) and of
+ * every address change after the other routing protocols updated their
+ * routes. The net devices of the node report their link changes to it as
+ * well. Each change calls the link change callback once, at the end of
+ * the current event.
+ */
+class BpLinkStateMonitor : public Ipv4RoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpLinkStateMonitor ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpLinkStateMonitor ();
+
+  /**
+   * \brief Set the callback called when an interface or a link changed
+   */
+  void SetLinkChangeCallback (Callback<void> callback);
+
+  /**
+   * \brief Check that a neighbour can be reached by IP
+   *
+   * \param address the IPv4 address of the neighbour
+   *
+   * \return true if the node has a route to the address through an
+   * interface which is up, on a device whose link is up
+   */
+  bool IsReachable (Ipv4Address address) const;
+
+  // Ipv4RoutingProtocol: no route is ever given
+
+  virtual Ptr<Ipv4Route> RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr);
+  virtual bool RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+                           UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                           LocalDeliverCallback lcb, ErrorCallback ecb);
+  virtual void NotifyInterfaceUp (uint32_t interface);
+  virtual void NotifyInterfaceDown (uint32_t interface);
+  virtual void NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address);
+  virtual void NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address);
+  virtual void SetIpv4 (Ptr<Ipv4> ipv4);
+  virtual void PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief Call the link change callback at the end of the current event,
+   * once for all the changes of the event
+   */
+  void Changed ();
+
+  /**
+   * \brief Call the link change callback
+   */
+  void NotifyChange ();
+
+  /**
+   * \brief Ask the net devices of the interfaces not seen yet to report
+   * their link changes
+   */
+  void HookDevices ();
+
+  Ptr<Ipv4> m_ipv4;                     /// IPv4 of the node
+  Callback<void> m_linkChange;          /// called when an interface or a link changed
+  EventId m_changeEvent;                /// pending call of m_linkChange
+  std::set<uint32_t> m_hooked;          /// interfaces whose device reports its link changes
+};
+
+/**
+ * \brief Static bundle routing reacting to the state of the links
+ *
+ * Each destination has a list of next hops, the first one preferred, the
+ * others used when it cannot be reached. The routing protocol installs a
+ * BpLinkStateMonitor on the node: when an interface goes up or down, the
+ * IP reachability of every next hop is checked at once. The results of
+ * GetRoute () are invalidated as soon as a next hop changed, and the
+ * bundles queued in the CLA towards a next hop which went down are routed
+ * again along the next alternative (BundleProtocol::RerouteBundles ()).
+ * Bundles for a destination whose next hops are all down stay in the
+ * bundle storage until one of them comes back, instead of waiting for
+ * the transport layer to time out.
+ *
+ * A next hop can also be marked down and up by the neighbour
+ * notifications of the bundle protocol.
+ */
+class BpLinkStateRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpLinkStateRoutingProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpLinkStateRoutingProtocol ();
+
+  /**
+   * \brief Set bundle protocol, and install the link state monitor on its
+   * node
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \brief Add a next hop towards a destination
+   *
+   * The next hops of a destination are used in the order they were added.
+   * A neighbour is only watched if it is the next hop of a route, e.g. of
+   * a route to itself.
+   *
+   * \return -1 if the next hop is already a next hop of the destination,
+   * otherwise 0
+   */
+  virtual int AddRoute (BpEndpointId eid, BpEndpointId nextHop);
+
+  /**
+   * \return the first next hop of the destination which is not down; the
+   * destination itself if it has no next hop and is not down; an empty
+   * endpoint id, which no CLA can resolve, if every next hop is down
+   */
+  virtual BpEndpointId GetRoute (BpEndpointId eid);
+
+  /**
+   * \brief A next hop can be reached again
+   */
+  virtual void NotifyNeighbourUp (const BpEndpointId &eid);
+
+  /**
+   * \brief A next hop cannot be reached
+   */
+  virtual void NotifyNeighbourDown (const BpEndpointId &eid);
+
+  /**
+   * \return true if a next hop is known to be down
+   */
+  bool IsDown (const BpEndpointId &eid) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief Check the reachability of every next hop after an interface or
+   * a link changed
+   */
+  void LinkStateChanged ();
+
+  /**
+   * \brief Mark a next hop up or down
+   *
+   * \return true if the state of the next hop changed
+   */
+  bool SetDown (const BpEndpointId &eid, bool down);
+
+  Ptr<BundleProtocol> m_bp;                                     /// bundle protocol
+  Ptr<BpLinkStateMonitor> m_monitor;                            /// listener of the interfaces of the node
+  std::map<BpEndpointId, std::vector<BpEndpointId> > m_routes;  /// routing table: map (destination, next hops by preference)
+  std::set<BpEndpointId> m_down;                                /// next hops which cannot be reached
+};
+
+}  // namespace ns3
+
+#endif /* BP_LINK_STATE_ROUTING_PROTOCOL_H */
@@ -0,0 +1,905 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/assert.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/socket-factory.h"
+#include "ns3/uinteger.h"
+
+#include "bp-ltp-cla-protocol.h"
+#include "bp-cla-protocol.h"
+#include "bundle-protocol.h"
+#include "bp-header.h"
+#include "bp-endpoint-id.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+
+// well-known port number of LTP over UDP, section 5 of RFC 5326
+#define LTP_UDP_PORT 1113
+
+// LTP client service id of the bundle protocol
+#define LTP_CLIENT_SERVICE_BUNDLE_PROTOCOL 1
+
+// cancel segment reason code: retransmission limit exceeded, section 3.2.4 of RFC 5326
+#define LTP_CANCEL_RLEXC 2
+
+// size of the IPv4 and UDP headers in front of a segment
+#define UDP_IPV4_HEADER_SIZE 28
+
+NS_LOG_COMPONENT_DEFINE ("BpLtpClaProtocol");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BpLtpClaProtocol);
+
+TypeId
+BpLtpClaProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpLtpClaProtocol")
+    .SetParent<BpClaProtocol> ()
+    .AddConstructor<BpLtpClaProtocol> ()
+    .AddAttribute ("RedPartLength",
+                   "Maximum number of bytes at the start of a block which are sent reliably (red); the rest is green",
+                   UintegerValue (0xffffffff),
+                   MakeUintegerAccessor (&BpLtpClaProtocol::m_redPartLength),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxSegmentSize",
+                   "Maximum number of block bytes carried by one segment",
+                   UintegerValue (1400),
+                   MakeUintegerAccessor (&BpLtpClaProtocol::m_maxSegmentSize),
+                   MakeUintegerChecker<uint32_t> (1, 65000))
+    .AddAttribute ("MaxSessionsPerSpan",
+                   "Number of export sessions in progress towards one receiving engine",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&BpLtpClaProtocol::m_maxSessionsPerSpan),
+                   MakeUintegerChecker<uint32_t> (1, 1024))
+    .AddAttribute ("MaxQueuedBytes",
+                   "Size of a span queue above which SendPacket reports backpressure",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&BpLtpClaProtocol::m_maxQueuedBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RetransmissionTimeout",
+                   "Time to wait for the answer to a checkpoint or report; should exceed the round trip time",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&BpLtpClaProtocol::m_retransmissionTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxRetransmissions",
+                   "Retransmissions of a checkpoint before the session is cancelled",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&BpLtpClaProtocol::m_maxRetransmissions),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("DataRate",
+                   "Rate at which segments are sent; 0 sends them at once",
+                   DataRateValue (DataRate (0)),
+                   MakeDataRateAccessor (&BpLtpClaProtocol::m_dataRate),
+                   MakeDataRateChecker ())
+  ;
+  return tid;
+}
+
+BpLtpClaProtocol::BpLtpClaProtocol ()
+  :m_bp (0),
+   m_socket (0),
+   m_bpRouting (0),
+   m_nextSessionNumber (1),
+   m_txQueuedBytes (0),
+   m_redPartLength (0xffffffff),
+   m_maxSegmentSize (1400),
+   m_maxSessionsPerSpan (8),
+   m_maxQueuedBytes (65536),
+   m_maxRetransmissions (10)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpLtpClaProtocol::~BpLtpClaProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpLtpClaProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<uint64_t, Ptr<BpLtpExportSession> >::iterator it = m_exportSessions.begin (); it != m_exportSessions.end (); ++it)
+    {
+      (*it).second->m_checkpointTimer.Cancel ();
+    }
+  for (std::map<std::pair<uint64_t, uint64_t>, Ptr<BpLtpImportSession> >::iterator it = m_importSessions.begin (); it != m_importSessions.end (); ++it)
+    {
+      (*it).second->m_reportTimer.Cancel ();
+      (*it).second->m_expireEvent.Cancel ();
+    }
+  m_txEvent.Cancel ();
+  m_exportSessions.clear ();
+  m_importSessions.clear ();
+  m_spans.clear ();
+  m_txSegments.clear ();
+  m_socket = 0;
+  m_listeners.clear ();
+  m_recvRegistrations.clear ();
+  m_bp = 0;
+  m_bpRouting = 0;
+  m_routeCache.Clear ();
+  BpClaProtocol::DoDispose ();
+}
+
+void
+BpLtpClaProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+}
+
+InetSocketAddress
+BpLtpClaProtocol::GetNextHopAddress (const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpLtpClaProtocol::GetNextHopAddress (): cannot find bundle routing protocol");
+
+  // resolved once per destination while the routes do not change
+  uint32_t generation = m_bpRouting->GetRouteGeneration ();
+  InetSocketAddress *cached = m_routeCache.Lookup (dst, generation);
+  if (cached)
+    return *cached;
+
+  // check route for destination endpoint id
+  BpEndpointId next_hop = m_bpRouting->GetRoute (dst);
+  InetSocketAddress address = getL4Address (next_hop);
+
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (address == badAddr)
+    {
+      NS_LOG_DEBUG ("BpLtpClaProtocol::GetNextHopAddress (): no L4 address for next hop " << next_hop.Uri () << " towards " << dst.Uri ());
+      return InetSocketAddress ("127.0.0.1", 0);
+    }
+
+  m_routeCache.Insert (dst, generation, address);
+  return address;
+}
+
+uint64_t
+BpLtpClaProtocol::GetEngineId () const
+{
+  return m_bp->GetNode ()->GetId ();
+}
+
+Ptr<Socket>
+BpLtpClaProtocol::GetL4Socket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (GetNextHopAddress (bph.GetDestinationEid ()) == defaultAddr)
+    return NULL;
+
+  return GetTxSocket ();
+}
+
+Ptr<Socket>
+BpLtpClaProtocol::GetTxSocket ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_socket == NULL)
+    {
+      m_socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+      if (m_socket->Bind () < 0)
+        {
+          m_socket = 0;
+          return NULL;
+        }
+      // report segments of the export sessions come back on this socket
+      m_socket->SetRecvCallback (MakeCallback (&BpLtpClaProtocol::DataRecv, this));
+    }
+
+  return m_socket;
+}
+
+int
+BpLtpClaProtocol::SendPacket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+  BpEndpointId src = bph.GetSourceEid ();
+  BpEndpointId dst = bph.GetDestinationEid ();
+
+  InetSocketAddress address = GetNextHopAddress (dst);
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (address == defaultAddr)
+    return -1;
+
+  if (GetL4Socket (packet) == NULL)
+    return -1;
+
+  Ptr<Packet> pkt = m_bp->GetBundle (src);  // this is retrieved again here in order to pop the packet from the SendBundleStore!
+  if (!pkt)
+    {
+      NS_LOG_FUNCTION (this << " Unable to get bundle for eid: " << src.Uri ());
+      return -1;
+    }
+
+  return SendBundle (address, pkt);
+}
+
+int
+BpLtpClaProtocol::SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << packet << " " << nextHop.Uri ());
+  InetSocketAddress address = getL4Address (nextHop);
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (address == badAddr)
+    {
+      NS_LOG_DEBUG ("BpLtpClaProtocol::SendPacketTo (): no L4 address for next hop " << nextHop.Uri ());
+      return -1;
+    }
+
+  if (GetTxSocket () == NULL)
+    return -1;
+
+  return SendBundle (address, packet);
+}
+
+int
+BpLtpClaProtocol::SendBundle (InetSocketAddress address, Ptr<Packet> pkt)
+{
+  NS_LOG_FUNCTION (this << " " << address << " " << pkt);
+  BpLtpSpan &span = m_spans[address];
+  if (span.m_activeSessions < m_maxSessionsPerSpan)
+    {
+      StartExportSession (address, pkt);
+      return 0;
+    }
+
+  // all sessions of the span are busy, wait for one of them to complete
+  NS_LOG_FUNCTION (this << " Span to " << address << " has " << span.m_activeSessions << " sessions, queueing bundle");
+  span.m_pending.push_back (pkt);
+  span.m_pendingBytes += pkt->GetSize ();
+  m_txQueuedBytes += pkt->GetSize ();
+
+  return (span.m_pendingBytes > m_maxQueuedBytes) ? 1 : 0;
+}
+
+uint32_t
+BpLtpClaProtocol::GetTxQueuedBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_txQueuedBytes;
+}
+
+void
+BpLtpClaProtocol::StartExportSession (const InetSocketAddress &remote, Ptr<Packet> block)
+{
+  NS_LOG_FUNCTION (this << " " << remote << " " << block->GetSize ());
+  Ptr<BpLtpExportSession> session = Create<BpLtpExportSession> (m_nextSessionNumber++, remote, block);
+  session->m_redLength = std::min (block->GetSize (), m_redPartLength);
+  m_exportSessions.insert (std::pair<uint64_t, Ptr<BpLtpExportSession> > (session->m_sessionNumber, session));
+  m_spans[remote].m_activeSessions++;
+
+  if (session->m_redLength > 0)
+    SendRedRange (session, 0, session->m_redLength, 0, true);
+
+  // the green part is sent once and never acknowledged
+  uint64_t offset = session->m_redLength;
+  while (offset < block->GetSize ())
+    {
+      uint64_t length = std::min<uint64_t> (m_maxSegmentSize, block->GetSize () - offset);
+      BpLtpHeader::SegmentType type = (offset + length == block->GetSize ()) ? BpLtpHeader::GREEN_DATA_EOB : BpLtpHeader::GREEN_DATA;
+      SendSegment (m_socket, BuildDataSegment (session, type, offset, length, 0, 0), remote);
+      offset += length;
+    }
+
+  if (session->m_redLength == 0)
+    {
+      // nothing to wait for
+      CloseExportSession (session);
+    }
+}
+
+Ptr<Packet>
+BpLtpClaProtocol::BuildDataSegment (Ptr<BpLtpExportSession> session, BpLtpHeader::SegmentType type,
+                                    uint64_t offset, uint64_t length, uint64_t checkpointSerial, uint64_t reportSerial)
+{
+  NS_LOG_FUNCTION (this << " " << session->m_sessionNumber << " " << (uint16_t) type << " " << offset << " " << length);
+  Ptr<Packet> segment = session->m_block->CreateFragment (offset, length);
+
+  BpLtpHeader header;
+  header.SetSegmentType (type);
+  header.SetSessionId (GetEngineId (), session->m_sessionNumber);
+  header.SetClientServiceId (LTP_CLIENT_SERVICE_BUNDLE_PROTOCOL);
+  header.SetDataRange (offset, length);
+  header.SetCheckpointSerial (checkpointSerial);
+  header.SetReportSerial (reportSerial);
+  segment->AddHeader (header);
+
+  return segment;
+}
+
+void
+BpLtpClaProtocol::SendRedRange (Ptr<BpLtpExportSession> session, uint64_t start, uint64_t end, uint64_t reportSerial, bool checkpoint)
+{
+  NS_LOG_FUNCTION (this << " " << session->m_sessionNumber << " " << start << " " << end);
+  uint64_t offset = start;
+  while (offset < end)
+    {
+      uint64_t length = std::min<uint64_t> (m_maxSegmentSize, end - offset);
+      if (!checkpoint || offset + length < end)
+        {
+          SendSegment (m_socket, BuildDataSegment (session, BpLtpHeader::RED_DATA, offset, length, 0, 0), session->m_remote);
+          offset += length;
+          continue;
+        }
+
+      // the last segment is a checkpoint; it also carries the end of the
+      // red part, so that it is not lost with an earlier segment
+      BpLtpHeader::SegmentType type = BpLtpHeader::RED_DATA_CP;
+      if (end == session->m_redLength)
+        {
+          type = (session->m_redLength == session->m_block->GetSize ()) ? BpLtpHeader::RED_DATA_CP_EORP_EOB : BpLtpHeader::RED_DATA_CP_EORP;
+        }
+      session->m_checkpointSerial++;
+      Ptr<Packet> segment = BuildDataSegment (session, type, offset, length, session->m_checkpointSerial, reportSerial);
+      session->m_checkpoint = segment->Copy ();
+      session->m_retries = 0;
+      session->m_checkpointTimer.Cancel ();
+      session->m_checkpointTimer = Simulator::Schedule (m_retransmissionTimeout, &BpLtpClaProtocol::CheckpointTimeout, this, session);
+      SendSegment (m_socket, segment, session->m_remote);
+      offset += length;
+    }
+}
+
+void
+BpLtpClaProtocol::CheckpointTimeout (Ptr<BpLtpExportSession> session)
+{
+  NS_LOG_FUNCTION (this << " " << session->m_sessionNumber << " retries " << session->m_retries);
+  if (m_exportSessions.find (session->m_sessionNumber) == m_exportSessions.end ())
+    return;
+
+  if (session->m_retries >= m_maxRetransmissions)
+    {
+      // give up: tell the receiver and hand the bundle back to the bundle store
+      NS_LOG_FUNCTION (this << " Cancelling session " << session->m_sessionNumber << " to " << session->m_remote << " after " << session->m_retries << " retransmissions");
+      BpLtpHeader cancel;
+      cancel.SetSegmentType (BpLtpHeader::CANCEL_FROM_SENDER);
+      cancel.SetSessionId (GetEngineId (), session->m_sessionNumber);
+      cancel.SetCancelReason (LTP_CANCEL_RLEXC);
+      Ptr<Packet> segment = Create<Packet> (0);
+      segment->AddHeader (cancel);
+      SendSegment (m_socket, segment, session->m_remote);
+
+      m_bp->RestoreBundle (session->m_block);
+      CloseExportSession (session);
+      return;
+    }
+
+  session->m_retries++;
+  SendSegment (m_socket, session->m_checkpoint->Copy (), session->m_remote);
+  session->m_checkpointTimer = Simulator::Schedule (m_retransmissionTimeout, &BpLtpClaProtocol::CheckpointTimeout, this, session);
+}
+
+void
+BpLtpClaProtocol::CloseExportSession (Ptr<BpLtpExportSession> session)
+{
+  NS_LOG_FUNCTION (this << " " << session->m_sessionNumber);
+  session->m_checkpointTimer.Cancel ();
+  m_exportSessions.erase (session->m_sessionNumber);
+
+  BpLtpSpan &span = m_spans[session->m_remote];
+  span.m_activeSessions--;
+
+  // start the bundles waiting for a session of this span
+  while (!span.m_pending.empty () && span.m_activeSessions < m_maxSessionsPerSpan)
+    {
+      Ptr<Packet> block = span.m_pending.front ();
+      span.m_pending.pop_front ();
+      span.m_pendingBytes -= block->GetSize ();
+      m_txQueuedBytes -= block->GetSize ();
+      StartExportSession (session->m_remote, block);
+    }
+}
+
+void
+BpLtpClaProtocol::ReceiveReport (Ptr<Socket> socket, const Address &from, const BpLtpHeader &header)
+{
+  NS_LOG_FUNCTION (this << " " << header.GetSessionNumber () << " report " << header.GetReportSerial ());
+
+  // acknowledge every report, even of a session which is already closed
+  BpLtpHeader ack;
+  ack.SetSegmentType (BpLtpHeader::REPORT_ACK);
+  ack.SetSessionId (header.GetEngineId (), header.GetSessionNumber ());
+  ack.SetReportSerial (header.GetReportSerial ());
+  Ptr<Packet> segment = Create<Packet> (0);
+  segment->AddHeader (ack);
+  SendSegment (socket, segment, from);
+
+  if (header.GetEngineId () != GetEngineId ())
+    return;
+  std::map<uint64_t, Ptr<BpLtpExportSession> >::iterator it = m_exportSessions.find (header.GetSessionNumber ());
+  if (it == m_exportSessions.end ())
+    return;
+  Ptr<BpLtpExportSession> session = (*it).second;
+
+  bool current = (header.GetCheckpointSerial () == session->m_checkpointSerial);
+  if (current)
+    session->m_checkpointTimer.Cancel ();
+
+  // merge the claims into the acknowledged ranges
+  const std::vector<std::pair<uint64_t, uint64_t> > &claims = header.GetClaims ();
+  for (uint32_t i = 0; i < claims.size (); i++)
+    {
+      uint64_t start = header.GetLowerBound () + claims[i].first;
+      uint64_t end = start + claims[i].second;
+      std::map<uint64_t, uint64_t>::iterator itClaim = session->m_claimed.find (start);
+      if (itClaim == session->m_claimed.end () || (*itClaim).second < end)
+        session->m_claimed[start] = end;
+    }
+  std::map<uint64_t, uint64_t> merged;
+  for (std::map<uint64_t, uint64_t>::iterator itClaim = session->m_claimed.begin (); itClaim != session->m_claimed.end (); ++itClaim)
+    {
+      if (!merged.empty () && (*itClaim).first <= merged.rbegin ()->second)
+        merged.rbegin ()->second = std::max (merged.rbegin ()->second, (*itClaim).second);
+      else
+        merged.insert (*itClaim);
+    }
+  session->m_claimed = merged;
+
+  if (!merged.empty () && merged.begin ()->first == 0 && merged.begin ()->second >= session->m_redLength)
+    {
+      NS_LOG_FUNCTION (this << " Red part of session " << session->m_sessionNumber << " acknowledged");
+      CloseExportSession (session);
+      return;
+    }
+
+  if (!current)
+    {
+      // a late report of an earlier checkpoint; its gaps were already retransmitted
+      return;
+    }
+
+  // retransmit the gaps within the report bounds; if the report claims all of
+  // them, the rest of the red part was not reported at all
+  uint64_t lower = header.GetLowerBound ();
+  uint64_t upper = std::min<uint64_t> (header.GetUpperBound (), session->m_redLength);
+  std::vector<std::pair<uint64_t, uint64_t> > gaps;
+  for (uint32_t pass = 0; pass < 2 && gaps.empty (); pass++)
+    {
+      if (pass == 1)
+        {
+          lower = 0;
+          upper = session->m_redLength;
+        }
+      uint64_t pos = lower;
+      for (std::map<uint64_t, uint64_t>::iterator itClaim = merged.begin (); itClaim != merged.end () && pos < upper; ++itClaim)
+        {
+          if ((*itClaim).second <= pos)
+            continue;
+          if ((*itClaim).first > pos)
+            gaps.push_back (std::make_pair (pos, std::min ((*itClaim).first, upper)));
+          pos = (*itClaim).second;
+        }
+      if (pos < upper)
+        gaps.push_back (std::make_pair (pos, upper));
+    }
+
+  for (uint32_t i = 0; i < gaps.size (); i++)
+    {
+      NS_LOG_FUNCTION (this << " Retransmitting " << gaps[i].first << "-" << gaps[i].second << " of session " << session->m_sessionNumber);
+      SendRedRange (session, gaps[i].first, gaps[i].second, header.GetReportSerial (), i + 1 == gaps.size ());
+    }
+}
+
+void
+BpLtpClaProtocol::ReceiveDataSegment (Ptr<Socket> socket, const Address &from, const BpLtpHeader &header, Ptr<Packet> data)
+{
+  NS_LOG_FUNCTION (this << " " << header.GetEngineId () << ":" << header.GetSessionNumber () << " " << header.GetOffset () << " " << header.GetLength ());
+  std::pair<uint64_t, uint64_t> key (header.GetEngineId (), header.GetSessionNumber ());
+  std::map<std::pair<uint64_t, uint64_t>, Ptr<BpLtpImportSession> >::iterator it = m_importSessions.find (key);
+  if (it == m_importSessions.end ())
+    {
+      Ptr<BpLtpImportSession> newSession = Create<BpLtpImportSession> ();
+      newSession->m_socket = socket;
+      newSession->m_from = from;
+      it = m_importSessions.insert (std::pair<std::pair<uint64_t, uint64_t>, Ptr<BpLtpImportSession> > (key, newSession)).first;
+    }
+  Ptr<BpLtpImportSession> session = (*it).second;
+
+  // forget the session once the sender has gone quiet for longer than it retries
+  session->m_expireEvent.Cancel ();
+  session->m_expireEvent = Simulator::Schedule (Seconds (m_retransmissionTimeout.GetSeconds () * (m_maxRetransmissions + 1)),
+                                                &BpLtpClaProtocol::ExpireImportSession, this, key);
+
+  if (!session->m_delivered)
+    {
+      if (session->m_segments.find (header.GetOffset ()) == session->m_segments.end ())
+        session->m_segments.insert (std::pair<uint64_t, Ptr<Packet> > (header.GetOffset (), data));
+      if (header.IsEndOfRedPart ())
+        {
+          session->m_redLength = header.GetOffset () + header.GetLength ();
+          session->m_redKnown = true;
+        }
+      if (header.IsEndOfBlock ())
+        {
+          session->m_blockLength = header.GetOffset () + header.GetLength ();
+          session->m_blockKnown = true;
+        }
+    }
+
+  if (header.IsCheckpoint ())
+    SendReport (session, header);
+
+  TryDeliverBlock (session);
+}
+
+void
+BpLtpClaProtocol::SendReport (Ptr<BpLtpImportSession> session, const BpLtpHeader &header)
+{
+  NS_LOG_FUNCTION (this << " " << header.GetSessionNumber () << " checkpoint " << header.GetCheckpointSerial ());
+  uint64_t upper = header.GetOffset () + header.GetLength ();
+
+  BpLtpHeader report;
+  report.SetSegmentType (BpLtpHeader::REPORT);
+  report.SetSessionId (header.GetEngineId (), header.GetSessionNumber ());
+  report.SetReportSerial (++session->m_reportSerial);
+  report.SetCheckpointSerial (header.GetCheckpointSerial ());
+  report.SetReportBounds (0, upper);
+  if (session->m_delivered)
+    {
+      // the block is complete, this checkpoint was retransmitted because our report was lost
+      report.AddClaim (0, upper);
+    }
+  else
+    {
+      std::vector<std::pair<uint64_t, uint64_t> > ranges = GetReceivedRanges (session, upper);
+      for (uint32_t i = 0; i < ranges.size (); i++)
+        report.AddClaim (ranges[i].first, ranges[i].second - ranges[i].first);
+    }
+
+  Ptr<Packet> segment = Create<Packet> (0);
+  segment->AddHeader (report);
+  session->m_report = segment->Copy ();
+  session->m_retries = 0;
+  session->m_reportTimer.Cancel ();
+  session->m_reportTimer = Simulator::Schedule (m_retransmissionTimeout, &BpLtpClaProtocol::ReportTimeout, this, session);
+  SendSegment (session->m_socket, segment, session->m_from);
+}
+
+void
+BpLtpClaProtocol::ReportTimeout (Ptr<BpLtpImportSession> session)
+{
+  NS_LOG_FUNCTION (this << " retries " << session->m_retries);
+  if (session->m_retries >= m_maxRetransmissions)
+    {
+      // the sender retransmits its checkpoint, which is answered by a new report
+      NS_LOG_FUNCTION (this << " Report not acknowledged after " << session->m_retries << " retransmissions");
+      return;
+    }
+  session->m_retries++;
+  SendSegment (session->m_socket, session->m_report->Copy (), session->m_from);
+  session->m_reportTimer = Simulator::Schedule (m_retransmissionTimeout, &BpLtpClaProtocol::ReportTimeout, this, session);
+}
+
+std::vector<std::pair<uint64_t, uint64_t> >
+BpLtpClaProtocol::GetReceivedRanges (Ptr<BpLtpImportSession> session, uint64_t end)
+{
+  std::vector<std::pair<uint64_t, uint64_t> > ranges;
+  for (std::map<uint64_t, Ptr<Packet> >::iterator it = session->m_segments.begin (); it != session->m_segments.end () && (*it).first < end; ++it)
+    {
+      uint64_t start = (*it).first;
+      uint64_t stop = std::min<uint64_t> (start + (*it).second->GetSize (), end);
+      if (!ranges.empty () && start <= ranges.back ().second)
+        ranges.back ().second = std::max (ranges.back ().second, stop);
+      else
+        ranges.push_back (std::make_pair (start, stop));
+    }
+  return ranges;
+}
+
+void
+BpLtpClaProtocol::TryDeliverBlock (Ptr<BpLtpImportSession> session)
+{
+  NS_LOG_FUNCTION (this);
+  if (session->m_delivered || !session->m_blockKnown)
+    return;
+
+  std::vector<std::pair<uint64_t, uint64_t> > ranges = GetReceivedRanges (session, session->m_blockLength);
+  if (ranges.size () != 1 || ranges[0].first != 0 || ranges[0].second < session->m_blockLength)
+    return;
+
+  // rebuild the block; retransmitted segments may overlap the original ones
+  Ptr<Packet> block = Create<Packet> (0);
+  uint64_t pos = 0;
+  for (std::map<uint64_t, Ptr<Packet> >::iterator it = session->m_segments.begin (); it != session->m_segments.end () && pos < session->m_blockLength; ++it)
+    {
+      uint64_t start = (*it).first;
+      uint64_t size = (*it).second->GetSize ();
+      if (start + size <= pos)
+        continue;
+      Ptr<Packet> data = (*it).second;
+      if (start < pos)
+        data = data->CreateFragment (pos - start, size - (pos - start));
+      block->AddAtEnd (data);
+      pos = start + size;
+    }
+
+  session->m_delivered = true;
+  session->m_segments.clear ();
+  NS_LOG_FUNCTION (this << " Delivering block of " << block->GetSize () << " bytes");
+  m_bp->ReceiveBundle (block);
+}
+
+void
+BpLtpClaProtocol::ExpireImportSession (std::pair<uint64_t, uint64_t> key)
+{
+  NS_LOG_FUNCTION (this << " " << key.first << ":" << key.second);
+  std::map<std::pair<uint64_t, uint64_t>, Ptr<BpLtpImportSession> >::iterator it = m_importSessions.find (key);
+  if (it == m_importSessions.end ())
+    return;
+  if (!(*it).second->m_delivered)
+    NS_LOG_DEBUG ("Discarding incomplete LTP block of session " << key.first << ":" << key.second);
+  (*it).second->m_reportTimer.Cancel ();
+  (*it).second->m_expireEvent.Cancel ();
+  m_importSessions.erase (it);
+}
+
+void
+BpLtpClaProtocol::SendSegment (Ptr<Socket> socket, Ptr<Packet> segment, const Address &to)
+{
+  NS_LOG_FUNCTION (this << " " << socket << " " << segment->GetSize ());
+  if (m_dataRate.GetBitRate () == 0)
+    {
+      if (socket->SendTo (segment, 0, to) < 0)
+        NS_LOG_FUNCTION (this << " Socket error sending segment");
+      return;
+    }
+
+  BpLtpTxSegment tx;
+  tx.m_socket = socket;
+  tx.m_segment = segment;
+  tx.m_to = to;
+  m_txSegments.push_back (tx);
+  if (!m_txEvent.IsRunning ())
+    TransmitNextSegment ();
+}
+
+void
+BpLtpClaProtocol::TransmitNextSegment ()
+{
+  NS_LOG_FUNCTION (this << " " << m_txSegments.size ());
+  if (m_txSegments.empty ())
+    return;
+
+  BpLtpTxSegment tx = m_txSegments.front ();
+  m_txSegments.pop_front ();
+  if (tx.m_socket->SendTo (tx.m_segment, 0, tx.m_to) < 0)
+    NS_LOG_FUNCTION (this << " Socket error sending segment");
+
+  Time txTime = m_dataRate.CalculateBytesTxTime (tx.m_segment->GetSize () + UDP_IPV4_HEADER_SIZE);
+  m_txEvent = Simulator::Schedule (txTime, &BpLtpClaProtocol::TransmitNextSegment, this);
+}
+
+void
+BpLtpClaProtocol::DataRecv (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+   {
+     if (packet->GetSize () == 0)
+       continue;
+
+     BpLtpHeader header;
+     packet->RemoveHeader (header);
+     if (header.IsData ())
+       {
+         ReceiveDataSegment (socket, from, header, packet);
+         continue;
+       }
+
+     switch (header.GetSegmentType ())
+       {
+       case BpLtpHeader::REPORT:
+         ReceiveReport (socket, from, header);
+         break;
+       case BpLtpHeader::REPORT_ACK:
+         {
+           std::pair<uint64_t, uint64_t> key (header.GetEngineId (), header.GetSessionNumber ());
+           std::map<std::pair<uint64_t, uint64_t>, Ptr<BpLtpImportSession> >::iterator it = m_importSessions.find (key);
+           if (it != m_importSessions.end () && (*it).second->m_reportSerial == header.GetReportSerial ())
+             (*it).second->m_reportTimer.Cancel ();
+           break;
+         }
+       case BpLtpHeader::CANCEL_FROM_SENDER:
+         {
+           std::pair<uint64_t, uint64_t> key (header.GetEngineId (), header.GetSessionNumber ());
+           ExpireImportSession (key);
+           BpLtpHeader ack;
+           ack.SetSegmentType (BpLtpHeader::CANCEL_ACK_TO_SENDER);
+           ack.SetSessionId (header.GetEngineId (), header.GetSessionNumber ());
+           Ptr<Packet> segment = Create<Packet> (0);
+           segment->AddHeader (ack);
+           SendSegment (socket, segment, from);
+           break;
+         }
+       case BpLtpHeader::CANCEL_FROM_RECEIVER:
+         {
+           std::map<uint64_t, Ptr<BpLtpExportSession> >::iterator it = m_exportSessions.find (header.GetSessionNumber ());
+           if (header.GetEngineId () == GetEngineId () && it != m_exportSessions.end ())
+             {
+               Ptr<BpLtpExportSession> session = (*it).second;
+               m_bp->RestoreBundle (session->m_block);
+               CloseExportSession (session);
+             }
+           BpLtpHeader ack;
+           ack.SetSegmentType (BpLtpHeader::CANCEL_ACK_TO_RECEIVER);
+           ack.SetSessionId (header.GetEngineId (), header.GetSessionNumber ());
+           Ptr<Packet> segment = Create<Packet> (0);
+           segment->AddHeader (ack);
+           SendSegment (socket, segment, from);
+           break;
+         }
+       default:
+         // cancel acknowledgments need no action
+         break;
+       }
+   }
+}
+
+int
+BpLtpClaProtocol::EnableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  BpEndpointId next_hop = m_bpRouting->GetRoute (local);
+  InetSocketAddress addr = getL4Address (next_hop);
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (addr == badAddr)
+    return -1;
+
+  uint16_t port;
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (addr == defaultAddr)
+    port = LTP_UDP_PORT;
+  else
+    port = addr.GetPort ();
+
+  std::map<BpEndpointId, uint16_t>::iterator it = m_recvRegistrations.find (local);
+  if (it != m_recvRegistrations.end ())
+    return -1;
+
+  // one socket per node and port; blocks arriving on it are demultiplexed
+  // to the registrations by the destination endpoint id of the bundle
+  if (m_listeners.find (port) == m_listeners.end ())
+    {
+      InetSocketAddress address (Ipv4Address::GetAny (), port);
+
+      Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+      if (socket->Bind (address) < 0)
+        return -1;
+      socket->SetRecvCallback (MakeCallback (&BpLtpClaProtocol::DataRecv, this));
+      m_listeners.insert (std::pair<uint16_t, Ptr<Socket> > (port, socket));
+    }
+  else
+    {
+      NS_LOG_FUNCTION (this << " Sharing socket on port " << port << " with " << local.Uri ());
+    }
+
+  m_recvRegistrations.insert (std::pair<BpEndpointId, uint16_t> (local, port));
+
+  return 0;
+}
+
+int
+BpLtpClaProtocol::DisableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  std::map<BpEndpointId, uint16_t>::iterator it = m_recvRegistrations.find (local);
+  if (it == m_recvRegistrations.end ())
+    {
+      return -1;
+    }
+
+  uint16_t port = (*it).second;
+  m_recvRegistrations.erase (it);
+
+  // keep the socket while other registrations still receive through it
+  for (it = m_recvRegistrations.begin (); it != m_recvRegistrations.end (); ++it)
+    {
+      if ((*it).second == port)
+        return 0;
+    }
+
+  std::map<uint16_t, Ptr<Socket> >::iterator itListener = m_listeners.find (port);
+  if (itListener == m_listeners.end ())
+    return -1;
+  Ptr<Socket> socket = (*itListener).second;
+  m_listeners.erase (itListener);
+  return socket->Close ();
+}
+
+int
+BpLtpClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri ());
+  InetSocketAddress address = GetNextHopAddress (dst);
+
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (address == defaultAddr)
+    {
+      NS_LOG_DEBUG ("BpLtpClaProtocol::EnableSend (): cannot find route for destination endpoint id " << dst.Uri ());
+      return -1;
+    }
+
+  // sessions are opened per bundle, nothing to set up
+  return 0;
+}
+
+int
+BpLtpClaProtocol::setL4Address (BpEndpointId eid, InetSocketAddress l4Address)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri() << " " << l4Address.GetIpv4());
+
+  std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.find (eid);
+  if (it == m_l4Addresses.end ())
+    m_l4Addresses.insert (std::pair<BpEndpointId, InetSocketAddress>(eid, l4Address));
+  else
+    return -1;
+
+  // a next hop which had no address may have one now
+  m_routeCache.Clear ();
+
+  return 0;
+}
+
+InetSocketAddress
+BpLtpClaProtocol::getL4Address (BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri());
+
+  std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.find (eid);
+  if (it == m_l4Addresses.end ())
+  {
+    InetSocketAddress badAddr ("1.0.0.1", 0);
+    return badAddr;
+  }
+  else
+    return ((*it).second);
+}
+
+void
+BpLtpClaProtocol::SetRoutingProtocol (Ptr<BpRoutingProtocol> route)
+{
+  NS_LOG_FUNCTION (this << " " << route);
+  m_bpRouting = route;
+}
+
+Ptr<BpRoutingProtocol>
+BpLtpClaProtocol::GetRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+  return m_bpRouting;
+}
+
+} // namespace ns3
@@ -0,0 +1,422 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BP_LTP_CLA_PROTOCOL_H
+#define BP_LTP_CLA_PROTOCOL_H
+
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/object-factory.h"
+#include "bp-cla-protocol.h"
+#include "bp-endpoint-id.h"
+#include "bp-ltp-header.h"
+#include "ns3/socket.h"
+#include "ns3/packet.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+#include "bundle-protocol.h"
+#include "bp-routing-protocol.h"
+#include <map>
+#include <deque>
+#include <utility>
+
+namespace ns3 {
+
+/**
+ * \brief The sending side of an LTP session: one bundle (block) towards one span
+ */
+class BpLtpExportSession : public SimpleRefCount<BpLtpExportSession>
+{
+public:
+  BpLtpExportSession (uint64_t sessionNumber, const InetSocketAddress &remote, Ptr<Packet> block)
+    : m_sessionNumber (sessionNumber),
+      m_remote (remote),
+      m_block (block),
+      m_redLength (0),
+      m_checkpointSerial (0),
+      m_retries (0)
+    {
+    }
+
+  uint64_t m_sessionNumber;             /// session number, unique for this engine
+  InetSocketAddress m_remote;           /// L4 address of the receiving engine
+  Ptr<Packet> m_block;                  /// the bundle sent in this session
+  uint32_t m_redLength;                 /// length of the red part of the block
+  std::map<uint64_t, uint64_t> m_claimed; /// red data acknowledged by reports: map (start, end)
+  uint64_t m_checkpointSerial;          /// serial number of the pending checkpoint
+  Ptr<Packet> m_checkpoint;             /// the pending checkpoint segment, kept for retransmission
+  uint32_t m_retries;                   /// retransmissions of the pending checkpoint
+  EventId m_checkpointTimer;            /// retransmission timer of the pending checkpoint
+};
+
+/**
+ * \brief The receiving side of an LTP session
+ */
+class BpLtpImportSession : public SimpleRefCount<BpLtpImportSession>
+{
+public:
+  BpLtpImportSession ()
+    : m_redLength (0),
+      m_redKnown (false),
+      m_blockLength (0),
+      m_blockKnown (false),
+      m_reportSerial (0),
+      m_retries (0),
+      m_delivered (false)
+    {
+    }
+
+  Ptr<Socket> m_socket;                 /// socket the session arrived on, used for replies
+  Address m_from;                       /// L4 address of the sending engine
+  std::map<uint64_t, Ptr<Packet> > m_segments; /// received data: map (block offset, data)
+  uint64_t m_redLength;                 /// length of the red part, once the end of red part was received
+  bool m_redKnown;                      /// is m_redLength known?
+  uint64_t m_blockLength;               /// length of the block, once the end of block was received
+  bool m_blockKnown;                    /// is m_blockLength known?
+  uint64_t m_reportSerial;              /// serial number of the last report sent
+  Ptr<Packet> m_report;                 /// the last report segment, kept until acknowledged
+  uint32_t m_retries;                   /// retransmissions of m_report
+  EventId m_reportTimer;                /// retransmission timer of m_report
+  bool m_delivered;                     /// the block was handed to the bundle protocol
+  EventId m_expireEvent;                /// removal of the session once it is idle
+};
+
+/**
+ * \ingroup bundleprotocol
+ *
+ * \brief Licklider Transmission Protocol (RFC 5326) convergence layer adapter
+ *
+ * Each bundle is sent as one LTP block over UDP. The first RedPartLength
+ * bytes of the block are red: they are retransmitted until the receiver
+ * acknowledges them. The last red segment is a checkpoint, answered by a
+ * report segment which claims the received data. Only the gaps between
+ * the claims are retransmitted, ending with a new checkpoint. The rest of
+ * the block is green and sent once. Up to MaxSessionsPerSpan blocks are in
+ * transit towards one receiving engine at a time, so a long round trip
+ * does not idle the link. There is no congestion control; DataRate paces
+ * the segments instead.
+ */
+class BpLtpClaProtocol : public BpClaProtocol
+{
+public:
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  BpLtpClaProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpLtpClaProtocol ();
+
+  /**
+   * send packet to the transport layer
+   *
+   * The bundle is sent in a new export session, or queued until one of the
+   * sessions to its span completes.
+   *
+   * \param packet packet to sent
+   *
+   * \return -1 if the bundle cannot be sent, 1 if it was queued but the
+   * span queue exceeds MaxQueuedBytes (backpressure), otherwise 0
+   */
+  virtual int SendPacket (Ptr<Packet> packet);
+
+  /**
+   * send a bundle to a given next hop, in an export session to its span
+   *
+   * \param packet the bundle to send
+   * \param nextHop the endpoint id of the neighbour
+   *
+   * \return -1 if the bundle cannot be sent, 1 if it was queued but the
+   * span queue exceeds MaxQueuedBytes (backpressure), otherwise 0
+   */
+  virtual int SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop);
+
+  /**
+   * \return the total size in bytes of the bundles waiting for an export session
+   */
+  virtual uint32_t GetTxQueuedBytes () const;
+
+  /**
+   * Bind a UDP socket to the port of the registration
+   *
+   * All registrations using the same port share one socket.
+   *
+   * \param local the local endpoint id
+   */
+  virtual int EnableReceive (const BpEndpointId &local);
+
+  /**
+   * Close the UDP socket with the last registration using it
+   *
+   * \param local the endpoint id of registration
+   */
+  virtual int DisableReceive (const BpEndpointId &local);
+
+  /**
+   * Enable this bundle node to send bundles at the transport layer
+   *
+   * \param src the source endpoint id
+   * \param dst the destination endpoint id
+   *
+   * \return -1 if there is no route to the destination, otherwise 0
+   */
+  virtual int EnableSend (const BpEndpointId &src, const BpEndpointId &dst);
+
+  /**
+   * \brief Get the transport layer socket
+   *
+   * All segments of the export sessions are sent on one UDP socket, which
+   * also receives their report segments.
+   *
+   * \param packet the bundle required to be transmitted
+   *
+   * \return NULL if the next hop of the bundle cannot be resolved,
+   * otherwise the socket
+   */
+  virtual Ptr<Socket> GetL4Socket (Ptr<Packet> packet);
+
+  /**
+   * Connect to routing protocol
+   *
+   * \param route routing protocol
+   */
+  void SetRoutingProtocol (Ptr<BpRoutingProtocol> route);
+
+  /**
+   * Get routing protocol
+   *
+   * \return routing protocol
+   */
+  virtual Ptr<BpRoutingProtocol> GetRoutingProtocol ();
+
+  /**
+   * Connect to bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \brief data receive callback; dispatches the segments by their type
+   */
+  void DataRecv (Ptr<Socket> socket);
+
+  virtual int setL4Address (BpEndpointId eid, InetSocketAddress l4Address);
+
+  virtual InetSocketAddress getL4Address (BpEndpointId eid);
+
+private:
+
+  /**
+   * \brief the bundles of one span which wait for an export session
+   */
+  struct BpLtpSpan
+  {
+    BpLtpSpan ()
+      : m_activeSessions (0),
+        m_pendingBytes (0)
+    {
+    }
+
+    uint32_t m_activeSessions;            /// export sessions in progress
+    std::deque<Ptr<Packet> > m_pending;   /// bundles waiting for a session
+    uint32_t m_pendingBytes;              /// total size of m_pending
+  };
+
+  /**
+   * \brief a segment waiting for its transmission slot
+   */
+  struct BpLtpTxSegment
+  {
+    Ptr<Socket> m_socket;                 /// socket to send on
+    Ptr<Packet> m_segment;                /// the segment
+    Address m_to;                         /// L4 address of the peer engine
+  };
+
+  /**
+   * Resolve the L4 address of the next hop towards a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   *
+   * \return the L4 address of the next hop; 127.0.0.1:0 if there is no route
+   */
+  virtual InetSocketAddress GetNextHopAddress (const BpEndpointId &dst);
+
+  /**
+   * Get the socket of the export sessions, created on first use
+   *
+   * \return the socket, NULL if it cannot be bound
+   */
+  Ptr<Socket> GetTxSocket ();
+
+  /**
+   * Start an export session for a bundle, or queue it until a session of
+   * its span completes
+   *
+   * \param address the L4 address of the span
+   * \param bundle the bundle
+   *
+   * \return 1 if the span queue exceeds MaxQueuedBytes, otherwise 0
+   */
+  int SendBundle (InetSocketAddress address, Ptr<Packet> bundle);
+
+  /**
+   * \return this node's LTP engine id
+   */
+  uint64_t GetEngineId () const;
+
+  /**
+   * Start an export session for a bundle and send all of its segments
+   *
+   * \param remote the L4 address of the receiving engine
+   * \param block the bundle
+   */
+  void StartExportSession (const InetSocketAddress &remote, Ptr<Packet> block);
+
+  /**
+   * Send a range of the red part of a block
+   *
+   * \param session the export session
+   * \param start offset of the first byte to send
+   * \param end offset after the last byte to send
+   * \param reportSerial serial number of the report this range answers, 0 if none
+   * \param checkpoint make the last segment the pending checkpoint of the session
+   */
+  void SendRedRange (Ptr<BpLtpExportSession> session, uint64_t start, uint64_t end, uint64_t reportSerial, bool checkpoint);
+
+  /**
+   * Build a data segment of a block
+   */
+  Ptr<Packet> BuildDataSegment (Ptr<BpLtpExportSession> session, BpLtpHeader::SegmentType type,
+                                uint64_t offset, uint64_t length, uint64_t checkpointSerial, uint64_t reportSerial);
+
+  /**
+   * Retransmit the pending checkpoint of a session, or cancel the session
+   * after MaxRetransmissions attempts
+   *
+   * \param session the export session
+   */
+  void CheckpointTimeout (Ptr<BpLtpExportSession> session);
+
+  /**
+   * Finish an export session and start the next queued bundle of its span
+   *
+   * \param session the export session
+   */
+  void CloseExportSession (Ptr<BpLtpExportSession> session);
+
+  /**
+   * Handle a report segment for one of our export sessions
+   */
+  void ReceiveReport (Ptr<Socket> socket, const Address &from, const BpLtpHeader &header);
+
+  /**
+   * Handle a data segment of an import session
+   */
+  void ReceiveDataSegment (Ptr<Socket> socket, const Address &from, const BpLtpHeader &header, Ptr<Packet> data);
+
+  /**
+   * Send a report segment for the red data received up to a checkpoint
+   *
+   * \param session the import session
+   * \param header the checkpoint segment header
+   */
+  void SendReport (Ptr<BpLtpImportSession> session, const BpLtpHeader &header);
+
+  /**
+   * Retransmit the last report of an import session
+   *
+   * \param session the import session
+   */
+  void ReportTimeout (Ptr<BpLtpImportSession> session);
+
+  /**
+   * Hand the block of an import session to the bundle protocol once all
+   * of its data was received
+   *
+   * \param session the import session
+   */
+  void TryDeliverBlock (Ptr<BpLtpImportSession> session);
+
+  /**
+   * Forget an idle import session
+   *
+   * \param key the session id: (engine id, session number)
+   */
+  void ExpireImportSession (std::pair<uint64_t, uint64_t> key);
+
+  /**
+   * Get the contiguous ranges of received data of an import session
+   *
+   * \param session the import session
+   * \param end ignore data after this offset
+   *
+   * \return the ranges: (start, end)
+   */
+  static std::vector<std::pair<uint64_t, uint64_t> > GetReceivedRanges (Ptr<BpLtpImportSession> session, uint64_t end);
+
+  /**
+   * Send a segment, paced by DataRate
+   */
+  void SendSegment (Ptr<Socket> socket, Ptr<Packet> segment, const Address &to);
+
+  /**
+   * Send the next paced segment
+   */
+  void TransmitNextSegment ();
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  Ptr<BundleProtocol> m_bp;                             /// bundle protocol
+  Ptr<Socket> m_socket;                                 /// socket of the export sessions
+  std::map<uint16_t, Ptr<Socket> > m_listeners;         /// receiving sockets: map (port, socket)
+  std::map<BpEndpointId, uint16_t> m_recvRegistrations; /// registrations enabled to receive: map (endpoint id, port)
+  std::map<BpEndpointId, InetSocketAddress> m_l4Addresses; /// the registered node socket addresses
+  Ptr<BpRoutingProtocol> m_bpRouting;                   /// bundle routing protocol
+  BpRouteCache<InetSocketAddress> m_routeCache;         /// next hop address of each destination
+
+  std::map<InetSocketAddress, BpLtpSpan> m_spans;       /// spans to the receiving engines: map (L4 address, span)
+  std::map<uint64_t, Ptr<BpLtpExportSession> > m_exportSessions; /// export sessions: map (session number, session)
+  std::map<std::pair<uint64_t, uint64_t>, Ptr<BpLtpImportSession> > m_importSessions; /// import sessions: map ((engine id, session number), session)
+  uint64_t m_nextSessionNumber;                         /// number of the next export session
+  uint32_t m_txQueuedBytes;                             /// total size of the bundles waiting in all spans
+
+  std::deque<BpLtpTxSegment> m_txSegments;              /// segments waiting for their transmission slot
+  EventId m_txEvent;                                    /// next paced transmission
+
+  uint32_t m_redPartLength;                             /// maximum length of the red part of a block
+  uint32_t m_maxSegmentSize;                            /// maximum data bytes per segment
+  uint32_t m_maxSessionsPerSpan;                        /// concurrent export sessions per span
+  uint32_t m_maxQueuedBytes;                            /// span queue size above which SendPacket reports backpressure
+  Time m_retransmissionTimeout;                         /// time to wait for a report or report-ack
+  uint32_t m_maxRetransmissions;                        /// retransmissions of a checkpoint or report before giving up
+  DataRate m_dataRate;                                  /// pacing rate of the segments, 0 to send at once
+};
+
+} // namespace ns3
+
+#endif /* BP_LTP_CLA_PROTOCOL_H */
@@ -0,0 +1,415 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "bp-ltp-header.h"
+#include "sdnv.h"
+#include <vector>
+
+NS_LOG_COMPONENT_DEFINE ("BpLtpHeader");
+
+namespace ns3 {
+
+BpLtpHeader::BpLtpHeader ()
+  : m_version (0),
+    m_type (RED_DATA),
+    m_engineId (0),
+    m_sessionNumber (0),
+    m_clientServiceId (0),
+    m_offset (0),
+    m_length (0),
+    m_checkpointSerial (0),
+    m_reportSerial (0),
+    m_upperBound (0),
+    m_lowerBound (0),
+    m_cancelReason (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpLtpHeader::~BpLtpHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+BpLtpHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpLtpHeader")
+                      .SetParent<Header> ()
+                      .AddConstructor<BpLtpHeader> ();
+
+  return tid;
+}
+
+TypeId
+BpLtpHeader::GetInstanceTypeId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return GetTypeId ();
+}
+
+uint32_t
+BpLtpHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  SDNV sdnv;
+
+  // version and type, session id, extension counts
+  uint32_t size = 1;
+  size += sdnv.EncodingLength (m_engineId);
+  size += sdnv.EncodingLength (m_sessionNumber);
+  size += 1;
+
+  if (IsData ())
+    {
+      size += sdnv.EncodingLength (m_clientServiceId);
+      size += sdnv.EncodingLength (m_offset);
+      size += sdnv.EncodingLength (m_length);
+      if (IsCheckpoint ())
+        {
+          size += sdnv.EncodingLength (m_checkpointSerial);
+          size += sdnv.EncodingLength (m_reportSerial);
+        }
+    }
+  else if (m_type == REPORT)
+    {
+      size += sdnv.EncodingLength (m_reportSerial);
+      size += sdnv.EncodingLength (m_checkpointSerial);
+      size += sdnv.EncodingLength (m_upperBound);
+      size += sdnv.EncodingLength (m_lowerBound);
+      size += sdnv.EncodingLength (m_claims.size ());
+      for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator it = m_claims.begin (); it != m_claims.end (); ++it)
+        {
+          size += sdnv.EncodingLength ((*it).first);
+          size += sdnv.EncodingLength ((*it).second);
+        }
+    }
+  else if (m_type == REPORT_ACK)
+    {
+      size += sdnv.EncodingLength (m_reportSerial);
+    }
+  else if (m_type == CANCEL_FROM_SENDER || m_type == CANCEL_FROM_RECEIVER)
+    {
+      size += 1;
+    }
+
+  return size;
+}
+
+void
+BpLtpHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  os << "type " << (uint16_t) m_type << " session " << m_engineId << ":" << m_sessionNumber;
+  if (IsData ())
+    os << " offset " << m_offset << " length " << m_length;
+  if (m_type == REPORT)
+    os << " bounds " << m_lowerBound << "-" << m_upperBound << " claims " << m_claims.size ();
+}
+
+static void
+WriteSdnv (Buffer::Iterator &i, uint64_t val)
+{
+  SDNV sdnv;
+  std::vector<uint8_t> encoded = sdnv.Encode (val);
+  for (std::vector<uint8_t>::iterator it = encoded.begin (); it != encoded.end (); ++it)
+    {
+      i.WriteU8 (*it);
+    }
+}
+
+void
+BpLtpHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+
+  i.WriteU8 ((m_version << 4) | (m_type & 0x0f));
+  WriteSdnv (i, m_engineId);
+  WriteSdnv (i, m_sessionNumber);
+  i.WriteU8 (0); // no header or trailer extensions
+
+  if (IsData ())
+    {
+      WriteSdnv (i, m_clientServiceId);
+      WriteSdnv (i, m_offset);
+      WriteSdnv (i, m_length);
+      if (IsCheckpoint ())
+        {
+          WriteSdnv (i, m_checkpointSerial);
+          WriteSdnv (i, m_reportSerial);
+        }
+    }
+  else if (m_type == REPORT)
+    {
+      WriteSdnv (i, m_reportSerial);
+      WriteSdnv (i, m_checkpointSerial);
+      WriteSdnv (i, m_upperBound);
+      WriteSdnv (i, m_lowerBound);
+      WriteSdnv (i, m_claims.size ());
+      for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator it = m_claims.begin (); it != m_claims.end (); ++it)
+        {
+          WriteSdnv (i, (*it).first);
+          WriteSdnv (i, (*it).second);
+        }
+    }
+  else if (m_type == REPORT_ACK)
+    {
+      WriteSdnv (i, m_reportSerial);
+    }
+  else if (m_type == CANCEL_FROM_SENDER || m_type == CANCEL_FROM_RECEIVER)
+    {
+      i.WriteU8 (m_cancelReason);
+    }
+}
+
+uint32_t
+BpLtpHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  SDNV sdnv;
+
+  uint8_t versionType = i.ReadU8 ();
+  m_version = versionType >> 4;
+  m_type = (SegmentType) (versionType & 0x0f);
+  m_engineId = sdnv.Decode (i);
+  m_sessionNumber = sdnv.Decode (i);
+  i.ReadU8 (); // extension counts, always 0
+
+  m_claims.clear ();
+  if (IsData ())
+    {
+      m_clientServiceId = sdnv.Decode (i);
+      m_offset = sdnv.Decode (i);
+      m_length = sdnv.Decode (i);
+      if (IsCheckpoint ())
+        {
+          m_checkpointSerial = sdnv.Decode (i);
+          m_reportSerial = sdnv.Decode (i);
+        }
+    }
+  else if (m_type == REPORT)
+    {
+      m_reportSerial = sdnv.Decode (i);
+      m_checkpointSerial = sdnv.Decode (i);
+      m_upperBound = sdnv.Decode (i);
+      m_lowerBound = sdnv.Decode (i);
+      uint64_t count = sdnv.Decode (i);
+      for (uint64_t k = 0; k < count; k++)
+        {
+          uint64_t offset = sdnv.Decode (i);
+          uint64_t length = sdnv.Decode (i);
+          m_claims.push_back (std::make_pair (offset, length));
+        }
+    }
+  else if (m_type == REPORT_ACK)
+    {
+      m_reportSerial = sdnv.Decode (i);
+    }
+  else if (m_type == CANCEL_FROM_SENDER || m_type == CANCEL_FROM_RECEIVER)
+    {
+      m_cancelReason = i.ReadU8 ();
+    }
+
+  return GetSerializedSize ();
+}
+
+void
+BpLtpHeader::SetSegmentType (SegmentType type)
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) type);
+  m_type = type;
+}
+
+void
+BpLtpHeader::SetSessionId (uint64_t engineId, uint64_t sessionNumber)
+{
+  NS_LOG_FUNCTION (this << " " << engineId << " " << sessionNumber);
+  m_engineId = engineId;
+  m_sessionNumber = sessionNumber;
+}
+
+void
+BpLtpHeader::SetClientServiceId (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  m_clientServiceId = id;
+}
+
+void
+BpLtpHeader::SetDataRange (uint64_t offset, uint64_t length)
+{
+  NS_LOG_FUNCTION (this << " " << offset << " " << length);
+  m_offset = offset;
+  m_length = length;
+}
+
+void
+BpLtpHeader::SetCheckpointSerial (uint64_t serial)
+{
+  NS_LOG_FUNCTION (this << " " << serial);
+  m_checkpointSerial = serial;
+}
+
+void
+BpLtpHeader::SetReportSerial (uint64_t serial)
+{
+  NS_LOG_FUNCTION (this << " " << serial);
+  m_reportSerial = serial;
+}
+
+void
+BpLtpHeader::SetReportBounds (uint64_t lowerBound, uint64_t upperBound)
+{
+  NS_LOG_FUNCTION (this << " " << lowerBound << " " << upperBound);
+  m_lowerBound = lowerBound;
+  m_upperBound = upperBound;
+}
+
+void
+BpLtpHeader::AddClaim (uint64_t offset, uint64_t length)
+{
+  NS_LOG_FUNCTION (this << " " << offset << " " << length);
+  m_claims.push_back (std::make_pair (offset, length));
+}
+
+void
+BpLtpHeader::SetCancelReason (uint8_t reason)
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) reason);
+  m_cancelReason = reason;
+}
+
+BpLtpHeader::SegmentType
+BpLtpHeader::GetSegmentType () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_type;
+}
+
+uint64_t
+BpLtpHeader::GetEngineId () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_engineId;
+}
+
+uint64_t
+BpLtpHeader::GetSessionNumber () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_sessionNumber;
+}
+
+uint64_t
+BpLtpHeader::GetClientServiceId () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_clientServiceId;
+}
+
+uint64_t
+BpLtpHeader::GetOffset () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_offset;
+}
+
+uint64_t
+BpLtpHeader::GetLength () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_length;
+}
+
+uint64_t
+BpLtpHeader::GetCheckpointSerial () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_checkpointSerial;
+}
+
+uint64_t
+BpLtpHeader::GetReportSerial () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_reportSerial;
+}
+
+uint64_t
+BpLtpHeader::GetLowerBound () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_lowerBound;
+}
+
+uint64_t
+BpLtpHeader::GetUpperBound () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_upperBound;
+}
+
+const std::vector<std::pair<uint64_t, uint64_t> > &
+BpLtpHeader::GetClaims () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_claims;
+}
+
+uint8_t
+BpLtpHeader::GetCancelReason () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_cancelReason;
+}
+
+bool
+BpLtpHeader::IsData () const
+{
+  return m_type <= GREEN_DATA_EOB;
+}
+
+bool
+BpLtpHeader::IsRed () const
+{
+  return m_type <= RED_DATA_CP_EORP_EOB;
+}
+
+bool
+BpLtpHeader::IsCheckpoint () const
+{
+  return m_type >= RED_DATA_CP && m_type <= RED_DATA_CP_EORP_EOB;
+}
+
+bool
+BpLtpHeader::IsEndOfRedPart () const
+{
+  return m_type == RED_DATA_CP_EORP || m_type == RED_DATA_CP_EORP_EOB;
+}
+
+bool
+BpLtpHeader::IsEndOfBlock () const
+{
+  return m_type == RED_DATA_CP_EORP_EOB || m_type == GREEN_DATA_EOB;
+}
+
+} // namespace ns3
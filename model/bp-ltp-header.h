@@ -0,0 +1,178 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_LTP_HEADER_H
+#define BP_LTP_HEADER_H
+
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+
+namespace ns3 {
+
+/**
+ * \brief LTP segment header
+ *
+ * The segment header and the segment content fields defined in section 3
+ * of RFC 5326, except the client service data of data segments, which
+ * follows the header in the packet. Header and trailer extensions are
+ * not supported.
+ */
+class BpLtpHeader : public Header
+{
+public:
+  BpLtpHeader ();
+
+  virtual ~BpLtpHeader ();
+
+  /**
+   * segment type flags, section 3.1.1 of RFC 5326
+   */
+  typedef enum {
+    RED_DATA                  = 0x0,  /// red data, not a checkpoint
+    RED_DATA_CP               = 0x1,  /// red data, checkpoint
+    RED_DATA_CP_EORP          = 0x2,  /// red data, checkpoint, end of red part
+    RED_DATA_CP_EORP_EOB      = 0x3,  /// red data, checkpoint, end of red part, end of block
+    GREEN_DATA                = 0x4,  /// green data
+    GREEN_DATA_EOB            = 0x7,  /// green data, end of block
+    REPORT                    = 0x8,  /// report segment
+    REPORT_ACK                = 0x9,  /// report-acknowledgment segment
+    CANCEL_FROM_SENDER        = 0xc,  /// cancel segment from block sender
+    CANCEL_ACK_TO_SENDER      = 0xd,  /// cancel-acknowledgment segment to block sender
+    CANCEL_FROM_RECEIVER      = 0xe,  /// cancel segment from block receiver
+    CANCEL_ACK_TO_RECEIVER    = 0xf   /// cancel-acknowledgment segment to block receiver
+  } SegmentType;
+
+  // Setters
+
+  /**
+   * \brief set the segment type
+   */
+  void SetSegmentType (SegmentType type);
+
+  /**
+   * \brief set the session id: the engine id of the session originator and its session number
+   */
+  void SetSessionId (uint64_t engineId, uint64_t sessionNumber);
+
+  /**
+   * \brief set the client service id of a data segment
+   */
+  void SetClientServiceId (uint64_t id);
+
+  /**
+   * \brief set the block offset and the length of the data of a data segment
+   */
+  void SetDataRange (uint64_t offset, uint64_t length);
+
+  /**
+   * \brief set the checkpoint serial number of a checkpoint or report segment
+   */
+  void SetCheckpointSerial (uint64_t serial);
+
+  /**
+   * \brief set the report serial number of a checkpoint, report or report-ack segment
+   */
+  void SetReportSerial (uint64_t serial);
+
+  /**
+   * \brief set the bounds of the block range covered by a report segment
+   */
+  void SetReportBounds (uint64_t lowerBound, uint64_t upperBound);
+
+  /**
+   * \brief add a reception claim to a report segment
+   *
+   * \param offset the offset of the received data from the lower bound
+   * \param length the length of the received data
+   */
+  void AddClaim (uint64_t offset, uint64_t length);
+
+  /**
+   * \brief set the reason code of a cancel segment
+   */
+  void SetCancelReason (uint8_t reason);
+
+  // Getters
+
+  SegmentType GetSegmentType () const;
+  uint64_t GetEngineId () const;
+  uint64_t GetSessionNumber () const;
+  uint64_t GetClientServiceId () const;
+  uint64_t GetOffset () const;
+  uint64_t GetLength () const;
+  uint64_t GetCheckpointSerial () const;
+  uint64_t GetReportSerial () const;
+  uint64_t GetLowerBound () const;
+  uint64_t GetUpperBound () const;
+  const std::vector<std::pair<uint64_t, uint64_t> > &GetClaims () const;
+  uint8_t GetCancelReason () const;
+
+  /**
+   * \return Is this a red or green data segment?
+   */
+  bool IsData () const;
+
+  /**
+   * \return Is this a red data segment?
+   */
+  bool IsRed () const;
+
+  /**
+   * \return Is this a checkpoint?
+   */
+  bool IsCheckpoint () const;
+
+  /**
+   * \return Does this data segment end the red part?
+   */
+  bool IsEndOfRedPart () const;
+
+  /**
+   * \return Does this data segment end the block?
+   */
+  bool IsEndOfBlock () const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint8_t m_version;                  /// LTP version, 0
+  SegmentType m_type;                 /// segment type flags
+  uint64_t m_engineId;                /// engine id of the session originator
+  uint64_t m_sessionNumber;           /// session number
+  uint64_t m_clientServiceId;         /// client service id of data segments
+  uint64_t m_offset;                  /// block offset of the data of a data segment
+  uint64_t m_length;                  /// length of the data of a data segment
+  uint64_t m_checkpointSerial;        /// checkpoint serial number
+  uint64_t m_reportSerial;            /// report serial number
+  uint64_t m_upperBound;              /// upper bound of a report segment
+  uint64_t m_lowerBound;              /// lower bound of a report segment
+  std::vector<std::pair<uint64_t, uint64_t> > m_claims; /// reception claims of a report segment: (offset, length)
+  uint8_t m_cancelReason;             /// reason code of a cancel segment
+};
+
+} // namespace ns3
+
+#endif /* BP_LTP_HEADER_H */
@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "bp-netdevice-cla-header.h"
+
+NS_LOG_COMPONENT_DEFINE ("BpNetDeviceClaHeader");
+
+namespace ns3 {
+
+BpNetDeviceClaHeader::BpNetDeviceClaHeader ()
+  : m_type (DATA),
+    m_seq (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpNetDeviceClaHeader::~BpNetDeviceClaHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+BpNetDeviceClaHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpNetDeviceClaHeader")
+                      .SetParent<Header> ()
+                      .AddConstructor<BpNetDeviceClaHeader> ();
+
+  return tid;
+}
+
+TypeId
+BpNetDeviceClaHeader::GetInstanceTypeId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return GetTypeId ();
+}
+
+uint32_t
+BpNetDeviceClaHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  // type and sequence number
+  return 5;
+}
+
+void
+BpNetDeviceClaHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  os << (m_type == DATA ? "data" : "ack") << " seq " << m_seq;
+}
+
+void
+BpNetDeviceClaHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  i.WriteU8 (m_type);
+  i.WriteHtonU32 (m_seq);
+}
+
+uint32_t
+BpNetDeviceClaHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  m_type = (FrameType) i.ReadU8 ();
+  m_seq = i.ReadNtohU32 ();
+
+  return GetSerializedSize ();
+}
+
+void
+BpNetDeviceClaHeader::SetFrameType (FrameType type)
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) type);
+  m_type = type;
+}
+
+void
+BpNetDeviceClaHeader::SetSequenceNumber (uint32_t seq)
+{
+  NS_LOG_FUNCTION (this << " " << seq);
+  m_seq = seq;
+}
+
+BpNetDeviceClaHeader::FrameType
+BpNetDeviceClaHeader::GetFrameType () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_type;
+}
+
+uint32_t
+BpNetDeviceClaHeader::GetSequenceNumber () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_seq;
+}
+
+} // namespace ns3
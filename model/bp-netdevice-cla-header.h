@@ -0,0 +1,81 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_NETDEVICE_CLA_HEADER_H
+#define BP_NETDEVICE_CLA_HEADER_H
+
+#include <stdint.h>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+
+namespace ns3 {
+
+/**
+ * \brief Link layer frame header of the NetDevice convergence layer adapter
+ *
+ * A data frame carries one bundle or bundle fragment after the header;
+ * an acknowledgment frame carries nothing and echoes the sequence number
+ * of the data frame it acknowledges.
+ */
+class BpNetDeviceClaHeader : public Header
+{
+public:
+  BpNetDeviceClaHeader ();
+
+  virtual ~BpNetDeviceClaHeader ();
+
+  /**
+   * frame types
+   */
+  typedef enum {
+    DATA = 0,  /// bundle data
+    ACK  = 1   /// acknowledgment of a data frame
+  } FrameType;
+
+  // Setters
+
+  /**
+   * \brief set the frame type
+   */
+  void SetFrameType (FrameType type);
+
+  /**
+   * \brief set the sequence number of the data frame
+   */
+  void SetSequenceNumber (uint32_t seq);
+
+  // Getters
+
+  FrameType GetFrameType () const;
+  uint32_t GetSequenceNumber () const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  FrameType m_type;                   /// frame type
+  uint32_t m_seq;                     /// sequence number of the data frame
+};
+
+} // namespace ns3
+
+#endif /* BP_NETDEVICE_CLA_HEADER_H */
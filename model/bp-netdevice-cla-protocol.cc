@@ -0,0 +1,517 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/assert.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/net-device.h"
+
+#include "bp-netdevice-cla-protocol.h"
+#include "bp-netdevice-cla-header.h"
+#include "bp-cla-protocol.h"
+#include "bundle-protocol.h"
+#include "bp-header.h"
+#include "bp-endpoint-id.h"
+#include "ns3/inet-socket-address.h"
+
+// IEEE 802 local experimental EtherType 1
+#define BP_NETDEVICE_CLA_ETHERTYPE 0x88B5
+
+NS_LOG_COMPONENT_DEFINE ("BpNetDeviceClaProtocol");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BpNetDeviceClaProtocol);
+
+TypeId
+BpNetDeviceClaProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpNetDeviceClaProtocol")
+    .SetParent<BpClaProtocol> ()
+    .AddConstructor<BpNetDeviceClaProtocol> ()
+    .AddAttribute ("ProtocolNumber",
+                   "Protocol number (EtherType) of the bundle frames",
+                   UintegerValue (BP_NETDEVICE_CLA_ETHERTYPE),
+                   MakeUintegerAccessor (&BpNetDeviceClaProtocol::m_protocolNumber),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("MaxQueuedBytes",
+                   "Size of a link queue above which SendPacket reports backpressure",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&BpNetDeviceClaProtocol::m_maxQueuedBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RetransmissionTimeout",
+                   "Time to wait for the acknowledgment of a frame; should exceed the round trip time of the link",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&BpNetDeviceClaProtocol::m_retransmissionTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxRetransmissions",
+                   "Retransmissions of a frame before its bundle is given back to the bundle store",
+                   UintegerValue (5),
+                   MakeUintegerAccessor (&BpNetDeviceClaProtocol::m_maxRetransmissions),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+  return tid;
+}
+
+BpNetDeviceClaProtocol::BpNetDeviceClaProtocol ()
+  :m_bp (0),
+   m_handlerInstalled (false),
+   m_bpRouting (0),
+   m_txQueuedBytes (0),
+   m_protocolNumber (BP_NETDEVICE_CLA_ETHERTYPE),
+   m_maxQueuedBytes (65536),
+   m_maxRetransmissions (5)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpNetDeviceClaProtocol::~BpNetDeviceClaProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpNetDeviceClaProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<Address, Ptr<BpNetDeviceClaLink> >::iterator it = m_links.begin (); it != m_links.end (); ++it)
+    {
+      (*it).second->m_rtxTimer.Cancel ();
+    }
+  m_links.clear ();
+  m_neighbours.clear ();
+  m_linkCallbacks.clear ();
+  m_routeCache.Clear ();
+  m_recvRegistrations.clear ();
+  if (m_handlerInstalled)
+    {
+      m_bp->GetNode ()->UnregisterProtocolHandler (MakeCallback (&BpNetDeviceClaProtocol::ReceiveFrame, this));
+      m_handlerInstalled = false;
+    }
+  m_bp = 0;
+  m_bpRouting = 0;
+  BpClaProtocol::DoDispose ();
+}
+
+void
+BpNetDeviceClaProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+}
+
+void
+BpNetDeviceClaProtocol::InstallProtocolHandler ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_handlerInstalled)
+    return;
+
+  // a null device installs the handler on all devices of the node
+  m_bp->GetNode ()->RegisterProtocolHandler (MakeCallback (&BpNetDeviceClaProtocol::ReceiveFrame, this),
+                                             m_protocolNumber, 0);
+  m_handlerInstalled = true;
+}
+
+Ptr<BpNetDeviceClaLink>
+BpNetDeviceClaProtocol::GetLink (Ptr<NetDevice> device, const Address &address)
+{
+  NS_LOG_FUNCTION (this << " " << device << " " << address);
+  std::map<Address, Ptr<BpNetDeviceClaLink> >::iterator it = m_links.find (address);
+  if (it != m_links.end ())
+    return (*it).second;
+
+  Ptr<BpNetDeviceClaLink> link = Create<BpNetDeviceClaLink> (device, address);
+  m_links.insert (std::pair<Address, Ptr<BpNetDeviceClaLink> > (address, link));
+  return link;
+}
+
+int
+BpNetDeviceClaProtocol::AddNeighbour (const BpEndpointId &eid, Ptr<NetDevice> device, const Address &address)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << device << " " << address);
+  if (m_neighbours.find (eid) != m_neighbours.end ())
+    return -1;
+
+  m_neighbours.insert (std::pair<BpEndpointId, Ptr<BpNetDeviceClaLink> > (eid, GetLink (device, address)));
+  // a next hop which was not a neighbour may be one now
+  m_routeCache.Clear ();
+
+  if (m_linkCallbacks.find (device) == m_linkCallbacks.end ())
+    {
+      device->AddLinkChangeCallback (MakeBoundCallback (&BpNetDeviceClaProtocol::LinkChanged, Ptr<BpNetDeviceClaProtocol> (this), device));
+      m_linkCallbacks[device] = true;
+    }
+  // neighbours are usually added before the routing protocol is set
+  if (device->IsLinkUp ())
+    Simulator::ScheduleNow (&BpNetDeviceClaProtocol::NotifyNeighbour, this, eid, true);
+  return 0;
+}
+
+void
+BpNetDeviceClaProtocol::NotifyNeighbour (BpEndpointId eid, bool up)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << up);
+  if (!m_bp)
+    return;
+
+  if (up)
+    m_bp->NotifyNeighbourUp (eid);
+  else
+    m_bp->NotifyNeighbourDown (eid);
+}
+
+void
+BpNetDeviceClaProtocol::LinkChanged (Ptr<BpNetDeviceClaProtocol> cla, Ptr<NetDevice> device)
+{
+  NS_LOG_FUNCTION (cla << " " << device << " " << device->IsLinkUp ());
+  for (std::map<BpEndpointId, Ptr<BpNetDeviceClaLink> >::iterator it = cla->m_neighbours.begin (); it != cla->m_neighbours.end (); ++it)
+    {
+      if ((*it).second->m_device == device)
+        cla->NotifyNeighbour ((*it).first, device->IsLinkUp ());
+    }
+}
+
+Ptr<BpNetDeviceClaLink>
+BpNetDeviceClaProtocol::GetNextHopLink (const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpNetDeviceClaProtocol::GetNextHopLink (): cannot find bundle routing protocol");
+
+  // resolved once per destination while the routes do not change
+  uint32_t generation = m_bpRouting->GetRouteGeneration ();
+  Ptr<BpNetDeviceClaLink> *cached = m_routeCache.Lookup (dst, generation);
+  if (cached)
+    return *cached;
+
+  // check route for destination endpoint id
+  BpEndpointId next_hop = m_bpRouting->GetRoute (dst);
+
+  std::map<BpEndpointId, Ptr<BpNetDeviceClaLink> >::iterator it = m_neighbours.find (next_hop);
+  if (it == m_neighbours.end ())
+    {
+      NS_LOG_DEBUG ("BpNetDeviceClaProtocol::GetNextHopLink (): next hop " << next_hop.Uri () << " towards " << dst.Uri () << " is not a neighbour");
+      return NULL;
+    }
+
+  m_routeCache.Insert (dst, generation, (*it).second);
+  return (*it).second;
+}
+
+Ptr<Socket>
+BpNetDeviceClaProtocol::GetL4Socket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  return NULL;
+}
+
+int
+BpNetDeviceClaProtocol::SendPacket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+  BpEndpointId src = bph.GetSourceEid ();
+  BpEndpointId dst = bph.GetDestinationEid ();
+
+  Ptr<BpNetDeviceClaLink> link = GetNextHopLink (dst);
+  if (link == NULL)
+    return -1;
+
+  Ptr<Packet> pkt = m_bp->GetBundle (src);  // this is retrieved again here in order to pop the packet from the SendBundleStore!
+  if (!pkt)
+    {
+      NS_LOG_FUNCTION (this << " Unable to get bundle for eid: " << src.Uri ());
+      return -1;
+    }
+
+  return SendBundle (link, pkt);
+}
+
+int
+BpNetDeviceClaProtocol::SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << packet << " " << nextHop.Uri ());
+  std::map<BpEndpointId, Ptr<BpNetDeviceClaLink> >::iterator it = m_neighbours.find (nextHop);
+  if (it == m_neighbours.end ())
+    {
+      NS_LOG_DEBUG ("BpNetDeviceClaProtocol::SendPacketTo (): " << nextHop.Uri () << " is not a neighbour");
+      return -1;
+    }
+
+  return SendBundle ((*it).second, packet);
+}
+
+int
+BpNetDeviceClaProtocol::SendBundle (Ptr<BpNetDeviceClaLink> link, Ptr<Packet> pkt)
+{
+  NS_LOG_FUNCTION (this << " " << link->m_address << " " << pkt);
+  // the acknowledgments come back through the protocol handler
+  InstallProtocolHandler ();
+
+  link->m_pending.push_back (pkt);
+  link->m_pendingBytes += pkt->GetSize ();
+  m_txQueuedBytes += pkt->GetSize ();
+  SendNextBundle (link);
+
+  return (link->m_pendingBytes > m_maxQueuedBytes) ? 1 : 0;
+}
+
+uint32_t
+BpNetDeviceClaProtocol::GetTxQueuedBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_txQueuedBytes;
+}
+
+void
+BpNetDeviceClaProtocol::SendNextBundle (Ptr<BpNetDeviceClaLink> link)
+{
+  NS_LOG_FUNCTION (this << " " << link->m_address);
+  BpNetDeviceClaHeader header;
+  while (link->m_bundle == NULL && !link->m_pending.empty ())
+    {
+      Ptr<Packet> bundle = link->m_pending.front ();
+      link->m_pending.pop_front ();
+      link->m_pendingBytes -= bundle->GetSize ();
+      m_txQueuedBytes -= bundle->GetSize ();
+
+      uint32_t mtu = link->m_device->GetMtu ();
+      std::vector<Ptr<Packet> > fragments;
+      if (mtu > header.GetSerializedSize ())
+        fragments = BundleProtocol::FragmentBundle (bundle, mtu - header.GetSerializedSize ());
+      if (fragments.empty ())
+        {
+          NS_LOG_FUNCTION (this << " Device MTU " << mtu << " towards " << link->m_address << " is too small for the bundle headers");
+          m_bp->RestoreBundle (bundle);
+          continue;
+        }
+
+      link->m_bundle = bundle;
+      link->m_frames.assign (fragments.begin (), fragments.end ());
+      SendFrame (link);
+    }
+}
+
+void
+BpNetDeviceClaProtocol::SendFrame (Ptr<BpNetDeviceClaLink> link)
+{
+  NS_LOG_FUNCTION (this << " " << link->m_address << " seq " << link->m_txSeq << " retries " << link->m_retries);
+  BpNetDeviceClaHeader header;
+  header.SetFrameType (BpNetDeviceClaHeader::DATA);
+  header.SetSequenceNumber (link->m_txSeq);
+  Ptr<Packet> frame = link->m_frames.front ()->Copy ();
+  frame->AddHeader (header);
+
+  link->m_rtxTimer.Cancel ();
+  link->m_rtxTimer = Simulator::Schedule (m_retransmissionTimeout, &BpNetDeviceClaProtocol::RetransmissionTimeout, this, link);
+
+  // a frame dropped by the device is recovered by the retransmission timer
+  if (!link->m_device->Send (frame, link->m_address, m_protocolNumber))
+    NS_LOG_FUNCTION (this << " Device refused frame " << link->m_txSeq << " to " << link->m_address);
+}
+
+void
+BpNetDeviceClaProtocol::RetransmissionTimeout (Ptr<BpNetDeviceClaLink> link)
+{
+  NS_LOG_FUNCTION (this << " " << link->m_address << " seq " << link->m_txSeq << " retries " << link->m_retries);
+  if (link->m_bundle == NULL)
+    return;
+
+  if (link->m_retries >= m_maxRetransmissions)
+    {
+      // give up: hand the bundle back to the bundle store; when it is
+      // resent, the fragments the neighbour already has are overlapped
+      // and skipped at reassembly
+      NS_LOG_FUNCTION (this << " Giving up bundle to " << link->m_address << " after " << link->m_retries << " retransmissions");
+      m_bp->RestoreBundle (link->m_bundle);
+      link->m_bundle = 0;
+      link->m_frames.clear ();
+      link->m_retries = 0;
+      link->m_txSeq++;
+      SendNextBundle (link);
+      return;
+    }
+
+  link->m_retries++;
+  SendFrame (link);
+}
+
+void
+BpNetDeviceClaProtocol::HandleAck (Ptr<BpNetDeviceClaLink> link, uint32_t seq)
+{
+  NS_LOG_FUNCTION (this << " " << link->m_address << " seq " << seq);
+  if (link->m_bundle == NULL || seq != link->m_txSeq)
+    {
+      // late acknowledgment of a retransmitted frame
+      return;
+    }
+
+  link->m_rtxTimer.Cancel ();
+  link->m_frames.pop_front ();
+  link->m_retries = 0;
+  link->m_txSeq++;
+
+  if (!link->m_frames.empty ())
+    {
+      SendFrame (link);
+      return;
+    }
+
+  link->m_bundle = 0;
+  SendNextBundle (link);
+}
+
+void
+BpNetDeviceClaProtocol::ReceiveFrame (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                                      const Address &from, const Address &to, NetDevice::PacketType packetType)
+{
+  NS_LOG_FUNCTION (this << " " << device << " " << packet << " " << from);
+  if (packetType == NetDevice::PACKET_OTHERHOST)
+    return;
+
+  Ptr<Packet> frame = packet->Copy ();
+  BpNetDeviceClaHeader header;
+  frame->RemoveHeader (header);
+  Ptr<BpNetDeviceClaLink> link = GetLink (device, from);
+
+  if (header.GetFrameType () == BpNetDeviceClaHeader::ACK)
+    {
+      HandleAck (link, header.GetSequenceNumber ());
+      return;
+    }
+
+  // without registrations the frame is left unacknowledged, like a
+  // datagram to a closed port
+  if (m_recvRegistrations.empty ())
+    return;
+
+  BpNetDeviceClaHeader ack;
+  ack.SetFrameType (BpNetDeviceClaHeader::ACK);
+  ack.SetSequenceNumber (header.GetSequenceNumber ());
+  Ptr<Packet> ackFrame = Create<Packet> (0);
+  ackFrame->AddHeader (ack);
+  device->Send (ackFrame, from, m_protocolNumber);
+
+  // stop-and-wait: a frame with the sequence number of the last one is a
+  // retransmission whose acknowledgment was lost
+  if (link->m_rxSeqValid && link->m_rxSeq == header.GetSequenceNumber ())
+    {
+      NS_LOG_FUNCTION (this << " Duplicate frame " << header.GetSequenceNumber () << " from " << from);
+      return;
+    }
+  link->m_rxSeq = header.GetSequenceNumber ();
+  link->m_rxSeqValid = true;
+
+  if (frame->GetSize () == 0)
+    return;
+  m_bp->ReceiveBundle (frame);
+}
+
+int
+BpNetDeviceClaProtocol::EnableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  if (m_recvRegistrations.find (local) != m_recvRegistrations.end ())
+    return -1;
+
+  // one handler per node; bundles arriving on it are demultiplexed to the
+  // registrations by their destination endpoint id
+  InstallProtocolHandler ();
+  m_recvRegistrations.insert (std::pair<BpEndpointId, bool> (local, true));
+
+  return 0;
+}
+
+int
+BpNetDeviceClaProtocol::DisableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  std::map<BpEndpointId, bool>::iterator it = m_recvRegistrations.find (local);
+  if (it == m_recvRegistrations.end ())
+    {
+      return -1;
+    }
+
+  m_recvRegistrations.erase (it);
+  return 0;
+}
+
+int
+BpNetDeviceClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri ());
+  if (GetNextHopLink (dst) == NULL)
+    {
+      NS_LOG_DEBUG ("BpNetDeviceClaProtocol::EnableSend (): cannot find neighbour for destination endpoint id " << dst.Uri ());
+      return -1;
+    }
+
+  // links need no setup
+  return 0;
+}
+
+int
+BpNetDeviceClaProtocol::setL4Address (BpEndpointId eid, InetSocketAddress l4Address)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri() << " " << l4Address.GetIpv4());
+
+  std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.find (eid);
+  if (it == m_l4Addresses.end ())
+    m_l4Addresses.insert (std::pair<BpEndpointId, InetSocketAddress>(eid, l4Address));
+  else
+    return -1;
+
+  return 0;
+}
+
+InetSocketAddress
+BpNetDeviceClaProtocol::getL4Address (BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri());
+
+  std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.find (eid);
+  if (it == m_l4Addresses.end ())
+  {
+    InetSocketAddress badAddr ("1.0.0.1", 0);
+    return badAddr;
+  }
+  else
+    return ((*it).second);
+}
+
+void
+BpNetDeviceClaProtocol::SetRoutingProtocol (Ptr<BpRoutingProtocol> route)
+{
+  NS_LOG_FUNCTION (this << " " << route);
+  m_bpRouting = route;
+}
+
+Ptr<BpRoutingProtocol>
+BpNetDeviceClaProtocol::GetRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+  return m_bpRouting;
+}
+
+} // namespace ns3
@@ -0,0 +1,301 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BP_NETDEVICE_CLA_PROTOCOL_H
+#define BP_NETDEVICE_CLA_PROTOCOL_H
+
+#include "ns3/ptr.h"
+#include "ns3/object-factory.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/address.h"
+#include "ns3/net-device.h"
+#include "bp-cla-protocol.h"
+#include "bp-endpoint-id.h"
+#include "ns3/socket.h"
+#include "ns3/packet.h"
+#include "bundle-protocol.h"
+#include "bp-routing-protocol.h"
+#include <map>
+#include <deque>
+
+namespace ns3 {
+
+/**
+ * \brief A link to a neighbour bundle node on one NetDevice
+ *
+ * Bundles towards the neighbour are sent one at a time, each split into
+ * frames that fit the device MTU; every frame is acknowledged before the
+ * next one is sent (stop-and-wait).
+ */
+class BpNetDeviceClaLink : public SimpleRefCount<BpNetDeviceClaLink>
+{
+public:
+  BpNetDeviceClaLink (Ptr<NetDevice> device, const Address &address)
+    : m_device (device),
+      m_address (address),
+      m_pendingBytes (0),
+      m_txSeq (0),
+      m_retries (0),
+      m_rxSeq (0),
+      m_rxSeqValid (false)
+    {
+    }
+
+  Ptr<NetDevice> m_device;              /// the device the neighbour is reached on
+  Address m_address;                    /// link layer address of the neighbour
+  std::deque<Ptr<Packet> > m_pending;   /// bundles waiting for the link
+  uint32_t m_pendingBytes;              /// bytes of the bundles waiting for the link
+  Ptr<Packet> m_bundle;                 /// the bundle being sent, kept until all its frames are acknowledged
+  std::deque<Ptr<Packet> > m_frames;    /// frames of the bundle being sent, the front one is unacknowledged
+  uint32_t m_txSeq;                     /// sequence number of the unacknowledged frame
+  uint32_t m_retries;                   /// retransmissions of the unacknowledged frame
+  EventId m_rtxTimer;                   /// retransmission timer of the unacknowledged frame
+  uint32_t m_rxSeq;                     /// sequence number of the last frame received from the neighbour
+  bool m_rxSeqValid;                    /// has a frame been received from the neighbour?
+};
+
+/**
+ * \ingroup bundleprotocol
+ *
+ * \brief NetDevice convergence layer adapter
+ *
+ * Bundles are framed directly on the NetDevices of the node with their
+ * own protocol number (EtherType), so that a node running only the
+ * bundle protocol does not need an Internet stack. A bundle larger than
+ * the device MTU is split into bundle fragments, which the destination
+ * bundle node reassembles. Every frame is acknowledged by the neighbour
+ * and retransmitted until it is (hop-by-hop ARQ); a bundle whose frame
+ * cannot be delivered is given back to the bundle store.
+ *
+ * The next hop of a bundle is taken from the bundle routing protocol,
+ * and the link layer address of each next hop must be given with
+ * AddNeighbour (). The device must carry arbitrary protocol numbers,
+ * e.g. CsmaNetDevice, WifiNetDevice or SimpleNetDevice; the
+ * PointToPointNetDevice only carries IPv4 and IPv6.
+ */
+class BpNetDeviceClaProtocol : public BpClaProtocol
+{
+public:
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  BpNetDeviceClaProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpNetDeviceClaProtocol ();
+
+  /**
+   * send packet to the link layer
+   *
+   * The bundle is queued on the link to its next hop and sent when the
+   * bundles before it are acknowledged.
+   *
+   * \param packet packet to sent
+   *
+   * \return -1 if the next hop is not a known neighbour, 1 if the link
+   * queue exceeds MaxQueuedBytes, otherwise 0
+   */
+  virtual int SendPacket (Ptr<Packet> packet);
+
+  /**
+   * send a bundle to a given next hop, queued on the link to it
+   *
+   * \param packet the bundle to send
+   * \param nextHop the endpoint id of the neighbour
+   *
+   * \return -1 if the next hop is not a known neighbour, 1 if the link
+   * queue exceeds MaxQueuedBytes, otherwise 0
+   */
+  virtual int SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop);
+
+  /**
+   * \return the number of bytes of the bundles waiting for their link
+   */
+  virtual uint32_t GetTxQueuedBytes () const;
+
+  /**
+   * Install the protocol handler on all devices of the node
+   *
+   * \param local the local endpoint id
+   */
+  virtual int EnableReceive (const BpEndpointId &local);
+
+  /**
+   * Stop accepting bundles with the last registration; the handler stays
+   * installed for the acknowledgments of the bundles this node sends
+   *
+   * \param local the endpoint id of registration
+   */
+  virtual int DisableReceive (const BpEndpointId &local);
+
+  /**
+   * Enable this bundle node to send bundles at the link layer
+   *
+   * \param src the source endpoint id
+   * \param dst the destination endpoint id
+   *
+   * \return -1 if the next hop is not a known neighbour, otherwise 0
+   */
+  virtual int EnableSend (const BpEndpointId &src, const BpEndpointId &dst);
+
+  /**
+   * \return always NULL, there are no transport layer sockets
+   */
+  virtual Ptr<Socket> GetL4Socket (Ptr<Packet> packet);
+
+  /**
+   * Connect to routing protocol
+   *
+   * \param route routing protocol
+   */
+  void SetRoutingProtocol (Ptr<BpRoutingProtocol> route);
+
+  /**
+   * Get routing protocol
+   *
+   * \return routing protocol
+   */
+  virtual Ptr<BpRoutingProtocol> GetRoutingProtocol ();
+
+  /**
+   * Connect to bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * Record the L4 address of an endpoint id; it is not used by this CLA,
+   * which only needs the link layer addresses given by AddNeighbour ()
+   */
+  virtual int setL4Address (BpEndpointId eid, InetSocketAddress l4Address);
+
+  virtual InetSocketAddress getL4Address (BpEndpointId eid);
+
+  /**
+   * Make a bundle node reachable as a next hop
+   *
+   * The routing protocol is told the neighbour is up if the link of the
+   * device is, and whenever the link goes down or up again afterwards.
+   *
+   * \param eid the endpoint id of the neighbour
+   * \param device the local device attached to the neighbour
+   * \param address the link layer address of the neighbour on that device
+   *
+   * \return -1 if the endpoint id already has a neighbour address, otherwise 0
+   */
+  int AddNeighbour (const BpEndpointId &eid, Ptr<NetDevice> device, const Address &address);
+
+  /**
+   * \brief protocol handler of the frames received on the devices of the node
+   */
+  void ReceiveFrame (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                     const Address &from, const Address &to, NetDevice::PacketType packetType);
+
+private:
+
+  /**
+   * Resolve the link to the next hop towards a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   *
+   * \return the link, or NULL if there is no route or the next hop is not a neighbour
+   */
+  Ptr<BpNetDeviceClaLink> GetNextHopLink (const BpEndpointId &dst);
+
+  /**
+   * Queue a bundle on a link
+   *
+   * \param link the link
+   * \param bundle the bundle
+   *
+   * \return 1 if the link queue exceeds MaxQueuedBytes, otherwise 0
+   */
+  int SendBundle (Ptr<BpNetDeviceClaLink> link, Ptr<Packet> bundle);
+
+  /**
+   * Get the link to a neighbour, creating it if needed
+   */
+  Ptr<BpNetDeviceClaLink> GetLink (Ptr<NetDevice> device, const Address &address);
+
+  /**
+   * Install the protocol handler on all devices of the node, once
+   */
+  void InstallProtocolHandler ();
+
+  /**
+   * Start sending the next waiting bundle if the link is idle
+   */
+  void SendNextBundle (Ptr<BpNetDeviceClaLink> link);
+
+  /**
+   * Send the unacknowledged frame of a link and start its retransmission timer
+   */
+  void SendFrame (Ptr<BpNetDeviceClaLink> link);
+
+  /**
+   * Retransmission timer of a link expired
+   */
+  void RetransmissionTimeout (Ptr<BpNetDeviceClaLink> link);
+
+  /**
+   * Handle the acknowledgment of a data frame
+   */
+  void HandleAck (Ptr<BpNetDeviceClaLink> link, uint32_t seq);
+
+  /**
+   * Tell the bundle protocol that a neighbour went up or down
+   */
+  void NotifyNeighbour (BpEndpointId eid, bool up);
+
+  /**
+   * Link change callback of a device with neighbours
+   */
+  static void LinkChanged (Ptr<BpNetDeviceClaProtocol> cla, Ptr<NetDevice> device);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  Ptr<BundleProtocol> m_bp;                             /// bundle protocol
+  bool m_handlerInstalled;                              /// is the protocol handler installed on the node?
+  std::map<Address, Ptr<BpNetDeviceClaLink> > m_links;  /// links to the neighbours: map (link layer address, link)
+  std::map<BpEndpointId, Ptr<BpNetDeviceClaLink> > m_neighbours; /// next hops: map (endpoint id, link)
+  std::map<Ptr<NetDevice>, bool> m_linkCallbacks;       /// devices whose link changes are followed
+  std::map<BpEndpointId, bool> m_recvRegistrations;     /// registrations enabled to receive
+  std::map<BpEndpointId, InetSocketAddress> m_l4Addresses; /// the registered node socket addresses
+  Ptr<BpRoutingProtocol> m_bpRouting;                   /// bundle routing protocol
+  BpRouteCache<Ptr<BpNetDeviceClaLink> > m_routeCache;  /// link to the next hop of each destination
+  uint32_t m_txQueuedBytes;                             /// bytes waiting on all links
+  uint16_t m_protocolNumber;                            /// protocol number (EtherType) of the frames
+  uint32_t m_maxQueuedBytes;                            /// link queue size above which SendPacket reports backpressure
+  Time m_retransmissionTimeout;                         /// time to wait for the acknowledgment of a frame
+  uint32_t m_maxRetransmissions;                        /// retransmissions of a frame before the bundle is given back
+};
+
+} // namespace ns3
+
+#endif /* BP_NETDEVICE_CLA_PROTOCOL_H */
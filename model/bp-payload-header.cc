@@ -119,6 +119,29 @@ BpPayloadHeader::Serialize (Buffer::Iterator start) const
   // ACS end
 }
 
+uint32_t
+BpPayloadHeader::PeekSerializedSize (const std::vector<uint8_t> &data, uint32_t offset, uint32_t &blockLength)
+{
+  NS_LOG_FUNCTION (offset);
+  // block type, then the processing flags and block length SDNVs
+  uint32_t pos = offset + 1;
+  for (uint32_t k = 0; k < 2; k++)
+    {
+      uint32_t start = pos;
+      while (pos < data.size () && (data[pos] & 0x80))
+        pos++;
+      if (pos >= data.size ())
+        return 0;
+      pos++;
+      if (k == 1)
+        {
+          SDNV sdnv;
+          blockLength = (uint32_t) sdnv.Decode (std::vector<uint8_t> (data.begin () + start, data.begin () + pos));
+        }
+    }
+  return pos - offset;
+}
+
 uint32_t
 BpPayloadHeader::Deserialize (Buffer::Iterator start)
 {
@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include "ns3/header.h"
 #include "ns3/buffer.h"
+#include <vector>
 
 namespace ns3 {
 
@@ -147,6 +148,19 @@ public:
    */
   uint32_t GetBlockLength () const;
 
+  /**
+   * \brief Size of a payload block header in a byte stream, read without
+   * reading past the end of the stream
+   *
+   * \param data the first bytes received so far
+   * \param offset the start of the header in data
+   * \param blockLength set to the length of the payload following it
+   *
+   * \return the serialized size of the header, 0 if the bytes end
+   * before it does
+   */
+  static uint32_t PeekSerializedSize (const std::vector<uint8_t> &data, uint32_t offset, uint32_t &blockLength);
+
   static TypeId GetTypeId (void);
   virtual TypeId GetInstanceTypeId (void) const;
   virtual void Print (std::ostream &os) const;
@@ -0,0 +1,355 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "bp-prophet-routing-protocol.h"
+#include "bp-routing-record-header.h"
+#include "bp-header.h"
+#include "bp-payload-header.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("BpProphetRoutingProtocol");
+
+namespace ns3 {
+
+/// scale of the predictabilities in the predictability vectors
+static const double PROPHET_QUANTUM = 65535.0;
+
+/// predictabilities below this one are not sent
+static const double PROPHET_MIN_PREDICTABILITY = 1.0 / PROPHET_QUANTUM;
+
+TypeId
+BpProphetRoutingProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpProphetRoutingProtocol")
+    .SetParent<BpRoutingProtocol> ()
+    .AddConstructor<BpProphetRoutingProtocol> ()
+    .AddAttribute ("PEncounter",
+                   "P_encounter: raise of the predictability of a neighbour at each encounter.",
+                   DoubleValue (0.7),
+                   MakeDoubleAccessor (&BpProphetRoutingProtocol::m_encounter),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("Delta",
+                   "delta: a predictability never exceeds 1 - delta.",
+                   DoubleValue (0.01),
+                   MakeDoubleAccessor (&BpProphetRoutingProtocol::m_delta),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("Beta",
+                   "beta: weight of the transitive predictabilities.",
+                   DoubleValue (0.9),
+                   MakeDoubleAccessor (&BpProphetRoutingProtocol::m_beta),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("Gamma",
+                   "gamma: aging of the predictabilities per time unit.",
+                   DoubleValue (0.999),
+                   MakeDoubleAccessor (&BpProphetRoutingProtocol::m_gamma),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("TimeUnit",
+                   "The time unit of the aging of the predictabilities.",
+                   TimeValue (Seconds (30)),
+                   MakeTimeAccessor (&BpProphetRoutingProtocol::m_timeUnit),
+                   MakeTimeChecker ())
+    .AddAttribute ("SeenSetSize",
+                   "The number of bundle ids remembered as seen.",
+                   UintegerValue (131072),
+                   MakeUintegerAccessor (&BpProphetRoutingProtocol::m_maxSeen),
+                   MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+    .AddAttribute ("MaxBundles",
+                   "The number of bundles kept for forwarding; the oldest one is dropped first.",
+                   UintegerValue (100000),
+                   MakeUintegerAccessor (&BpProphetRoutingProtocol::m_maxBundles),
+                   MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+  ;
+  return tid;
+}
+
+BpProphetRoutingProtocol::BpProphetRoutingProtocol ()
+  : m_bp (0),
+    m_encounter (0.7),
+    m_delta (0.01),
+    m_beta (0.9),
+    m_gamma (0.999),
+    m_timeUnit (Seconds (30)),
+    m_maxSeen (131072),
+    m_maxBundles (100000)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpProphetRoutingProtocol::~BpProphetRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpProphetRoutingProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_buffer.clear ();
+  m_bufferOrder.clear ();
+  m_neighbours.clear ();
+  m_bp = 0;
+  BpRoutingProtocol::DoDispose ();
+}
+
+void
+BpProphetRoutingProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  NS_ASSERT_MSG (m_bp == 0 || m_bp == bundleProtocol, "BpProphetRoutingProtocol::SetBundleProtocol (): one routing protocol instance per node");
+  m_bp = bundleProtocol;
+}
+
+BpEndpointId
+BpProphetRoutingProtocol::GetRoute (BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  return eid;
+}
+
+uint32_t
+BpProphetRoutingProtocol::GetNBufferedBundles () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_buffer.size ();
+}
+
+uint32_t
+BpProphetRoutingProtocol::Intern (uint64_t node)
+{
+  NS_LOG_FUNCTION (this << " " << node);
+  std::unordered_map<uint64_t, uint32_t>::iterator it = m_nodeIndexes.find (node);
+  if (it != m_nodeIndexes.end ())
+    return (*it).second;
+
+  uint32_t index = m_nodes.size ();
+  m_nodeIndexes.insert (std::make_pair (node, index));
+  m_nodes.push_back (node);
+  Predictability predictability;
+  predictability.value = 0;
+  predictability.aged = Simulator::Now ().GetSeconds ();
+  m_predictability.push_back (predictability);
+  return index;
+}
+
+double
+BpProphetRoutingProtocol::Age (uint32_t index)
+{
+  NS_LOG_FUNCTION (this << " " << index);
+  // P = P_old * gamma^k, k the time units elapsed since the last aging;
+  // the fraction of a time unit left is kept for the next aging
+  Predictability &predictability = m_predictability[index];
+  double units = std::floor ((Simulator::Now ().GetSeconds () - predictability.aged) / m_timeUnit.GetSeconds ());
+  if (units >= 1)
+    {
+      predictability.value *= std::pow (m_gamma, units);
+      predictability.aged += units * m_timeUnit.GetSeconds ();
+    }
+  return predictability.value;
+}
+
+double
+BpProphetRoutingProtocol::GetPredictability (uint64_t node)
+{
+  NS_LOG_FUNCTION (this << " " << node);
+  std::unordered_map<uint64_t, uint32_t>::iterator it = m_nodeIndexes.find (node);
+  if (it == m_nodeIndexes.end ())
+    return 0;
+  return Age ((*it).second);
+}
+
+double
+BpProphetRoutingProtocol::GetPredictability (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  return GetPredictability ((uint64_t) BpEndpointIdHash () (eid));
+}
+
+bool
+BpProphetRoutingProtocol::Offer (uint64_t id, const BufferedBundle &bundle, const BpEndpointId &eid, Neighbour &neighbour)
+{
+  NS_LOG_FUNCTION (this << " " << id << " " << eid.Uri ());
+  if (neighbour.sent.count (id))
+    return true;
+
+  // GRTR: the destination itself, or a better carrier than this node
+  if (bundle.dst != (uint64_t) BpEndpointIdHash () (eid))
+    {
+      std::unordered_map<uint64_t, double>::iterator it = neighbour.predictability.find (bundle.dst);
+      if (it == neighbour.predictability.end () || (*it).second <= GetPredictability (bundle.dst))
+        return true;
+    }
+
+  // copies share the payload buffer of the bundle
+  if (m_bp->ForwardBundleTo (bundle.bundle->Copy (), eid) < 0)
+    return false;
+  neighbour.sent.insert (id);
+  return true;
+}
+
+bool
+BpProphetRoutingProtocol::HandleBundle (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bpHeader;
+  bundle->PeekHeader (bpHeader);
+  uint64_t id = bpHeader.GetBundleIdHash ();
+
+  if (m_seen.count (id) || m_buffer.count (id))
+    {
+      NS_LOG_DEBUG ("Dropping bundle " << id << " seen before");
+      return true;
+    }
+
+  m_seen.insert (id);
+  m_seenOrder.push_back (id);
+  while (m_seenOrder.size () > m_maxSeen)
+    {
+      m_seen.erase (m_seenOrder.front ());
+      m_seenOrder.pop_front ();
+    }
+
+  BpEndpointId dst = bpHeader.GetDestinationEid ();
+  if (dst == m_bp->GetBpEndpointId ())
+    return false;
+
+  BufferedBundle buffered;
+  buffered.bundle = bundle;
+  buffered.dst = BpEndpointIdHash () (dst);
+  m_buffer.insert (std::make_pair (id, buffered));
+  m_bufferOrder.push_back (id);
+  while (m_bufferOrder.size () > m_maxBundles)
+    {
+      NS_LOG_DEBUG ("Buffer full, dropping bundle " << m_bufferOrder.front ());
+      m_buffer.erase (m_bufferOrder.front ());
+      m_bufferOrder.pop_front ();
+    }
+
+  for (std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.begin (); it != m_neighbours.end (); ++it)
+    {
+      if ((*it).second.vectorReceived)
+        Offer (id, buffered, (*it).first, (*it).second);
+    }
+  return true;
+}
+
+bool
+BpProphetRoutingProtocol::HandleAdminRecord (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  Ptr<Packet> record = bundle->Copy ();
+  BpHeader bpHeader;
+  BpPayloadHeader bppHeader;
+  record->RemoveHeader (bpHeader);
+  record->RemoveHeader (bppHeader);
+  if (!BpRoutingRecordHeader::IsRoutingRecord (record))
+    return false;
+
+  BpRoutingRecordHeader header;
+  record->RemoveHeader (header);
+  if (header.GetKind () != PREDICTABILITY_VECTOR)
+    return false;
+
+  // a predictability vector is the first sign of a contact seen from the other side
+  BpEndpointId eid = bpHeader.GetSourceEid ();
+  if (m_neighbours.find (eid) == m_neighbours.end ())
+    NotifyNeighbourUp (eid);
+  Neighbour &neighbour = m_neighbours[eid];
+
+  // transitivity: P(a,c) = max (P(a,c)_old, P(a,b) * P(b,c) * beta)
+  uint64_t self = BpEndpointIdHash () (m_bp->GetBpEndpointId ());
+  double encountered = Age (Intern (BpEndpointIdHash () (eid)));
+  const std::vector<uint64_t> &values = header.GetValues ();
+  neighbour.predictability.clear ();
+  for (uint32_t i = 0; i + 1 < values.size (); i += 2)
+    {
+      double predictability = values[i + 1] / PROPHET_QUANTUM;
+      neighbour.predictability[values[i]] = predictability;
+      if (values[i] == self)
+        continue;
+
+      uint32_t index = Intern (values[i]);
+      double transitive = encountered * predictability * m_beta;
+      if (transitive > Age (index))
+        m_predictability[index].value = transitive;
+    }
+  neighbour.vectorReceived = true;
+  NS_LOG_DEBUG ("Predictabilities of " << neighbour.predictability.size () << " nodes from " << eid.Uri ());
+
+  for (std::deque<uint64_t>::iterator it = m_bufferOrder.begin (); it != m_bufferOrder.end (); ++it)
+    {
+      if (!Offer (*it, m_buffer[*it], eid, neighbour))
+        break;
+    }
+
+  return true;
+}
+
+void
+BpProphetRoutingProtocol::NotifyNeighbourUp (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  if (m_neighbours.find (eid) != m_neighbours.end ())
+    return;
+  m_neighbours[eid];
+
+  // P(a,b) = P(a,b)_old + (1 - delta - P(a,b)_old) * P_encounter
+  uint32_t index = Intern (BpEndpointIdHash () (eid));
+  double old = Age (index);
+  m_predictability[index].value = old + std::max (0.0, 1 - m_delta - old) * m_encounter;
+
+  SendPredictabilities (eid);
+}
+
+void
+BpProphetRoutingProtocol::NotifyNeighbourDown (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  m_neighbours.erase (eid);
+}
+
+void
+BpProphetRoutingProtocol::SendPredictabilities (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  std::vector<uint64_t> values;
+  values.reserve (2 * m_nodes.size ());
+  for (uint32_t index = 0; index < m_nodes.size (); index++)
+    {
+      double predictability = Age (index);
+      if (predictability < PROPHET_MIN_PREDICTABILITY)
+        continue;
+      values.push_back (m_nodes[index]);
+      values.push_back ((uint64_t) (predictability * PROPHET_QUANTUM + 0.5));
+    }
+
+  BpRoutingRecordHeader header;
+  header.SetKind (PREDICTABILITY_VECTOR);
+  header.SetValues (values, false);
+  Ptr<Packet> record = Create<Packet> ();
+  record->AddHeader (header);
+  m_bp->SendAdminRecord (record, eid);
+}
+
+} // namespace ns3
@@ -0,0 +1,212 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_PROPHET_ROUTING_PROTOCOL_H
+#define BP_PROPHET_ROUTING_PROTOCOL_H
+
+#include "bp-routing-protocol.h"
+#include "bundle-protocol.h"
+#include "ns3/nstime.h"
+#include <stdint.h>
+#include <map>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ns3 {
+
+/**
+ * \brief Probabilistic Routing Protocol using History of Encounters and
+ * Transitivity (PRoPHET, RFC 6693)
+ *
+ * Each node keeps the delivery predictability of every node it knows of.
+ * When a contact starts (BundleProtocol::NotifyNeighbourUp ()), the
+ * predictability of the neighbour is raised and the two neighbours
+ * exchange their predictability vectors, from which the predictabilities
+ * of the nodes reachable through the neighbour are raised by
+ * transitivity. A copy of a bundle is given to the neighbour only if it is
+ * the destination, or if its predictability for the destination is higher
+ * than ours (the GRTR strategy), so that far fewer copies are made than
+ * with epidemic routing.
+ *
+ * The nodes are interned: the predictability table is an array indexed
+ * by a node index, found from the hash of the endpoint id. The
+ * predictabilities decay with time; instead of sweeping the table on a
+ * timer, an entry is aged when it is read, by the time units elapsed
+ * since it was last aged.
+ */
+class BpProphetRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpProphetRoutingProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpProphetRoutingProtocol ();
+
+  /**
+   * \brief Set bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \return the endpoint id itself: bundles are handed to the neighbours
+   * at contacts, not along routes
+   */
+  virtual BpEndpointId GetRoute (BpEndpointId eid);
+
+  /**
+   * \brief Keep a bundle not addressed to this node and offer it to the
+   * neighbours
+   *
+   * \return true unless the bundle is addressed to this node and was not
+   * seen before
+   */
+  virtual bool HandleBundle (Ptr<Packet> bundle);
+
+  /**
+   * \brief Take the predictability vectors of the neighbours
+   */
+  virtual bool HandleAdminRecord (Ptr<Packet> bundle);
+
+  /**
+   * \brief Raise the predictability of a new neighbour and send it the
+   * predictability vector
+   */
+  virtual void NotifyNeighbourUp (const BpEndpointId &eid);
+
+  /**
+   * \brief Forget the predictability vector of a neighbour
+   */
+  virtual void NotifyNeighbourDown (const BpEndpointId &eid);
+
+  /**
+   * \return the delivery predictability of a node, aged to now
+   */
+  double GetPredictability (const BpEndpointId &eid);
+
+  /**
+   * \return the number of bundles kept for forwarding
+   */
+  uint32_t GetNBufferedBundles () const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * kinds of the routing control records
+   */
+  enum RecordKind
+  {
+    PREDICTABILITY_VECTOR = 3   /// pairs (endpoint id hash, quantized predictability)
+  };
+
+  /**
+   * \brief Delivery predictability of a node
+   */
+  struct Predictability
+  {
+    double value;               /// the predictability
+    double aged;                /// the time it was last aged, in seconds
+  };
+
+  /**
+   * \brief A bundle kept for forwarding
+   */
+  struct BufferedBundle
+  {
+    Ptr<Packet> bundle;         /// the bundle
+    uint64_t dst;               /// hash of its destination endpoint id
+  };
+
+  /**
+   * \brief State of a neighbour in contact
+   */
+  struct Neighbour
+  {
+    Neighbour ()
+      : vectorReceived (false)
+    {
+    }
+
+    std::unordered_map<uint64_t, double> predictability; /// its predictabilities: map (endpoint id hash, predictability)
+    std::unordered_set<uint64_t> sent;                   /// hashes of the bundle ids sent to it
+    bool vectorReceived;                                 /// its predictability vector has been received
+  };
+
+  /**
+   * \return the index of a node in the predictability table, added if needed
+   */
+  uint32_t Intern (uint64_t node);
+
+  /**
+   * \return the predictability of a node index, aged to now
+   */
+  double Age (uint32_t index);
+
+  /**
+   * \return the predictability of a node known by the hash of its
+   * endpoint id, 0 if it is unknown
+   */
+  double GetPredictability (uint64_t node);
+
+  /**
+   * \brief Give a bundle to a neighbour if it is a better carrier
+   *
+   * \return false if the CLA refused the bundle
+   */
+  bool Offer (uint64_t id, const BufferedBundle &bundle, const BpEndpointId &eid, Neighbour &neighbour);
+
+  /**
+   * \brief Send the predictability vector to a neighbour
+   */
+  void SendPredictabilities (const BpEndpointId &eid);
+
+  Ptr<BundleProtocol> m_bp;                                     /// bundle protocol
+  double m_encounter;                                           /// P_encounter, raise of the predictability of a neighbour
+  double m_delta;                                               /// delta, upper margin of a predictability
+  double m_beta;                                                /// beta, weight of transitivity
+  double m_gamma;                                               /// gamma, aging factor per time unit
+  Time m_timeUnit;                                              /// the time unit of aging
+  uint32_t m_maxSeen;                                           /// size of the seen set
+  uint32_t m_maxBundles;                                        /// size of the buffer
+
+  std::unordered_map<uint64_t, uint32_t> m_nodeIndexes;         /// map (endpoint id hash, node index)
+  std::vector<uint64_t> m_nodes;                                /// endpoint id hash of each node index
+  std::vector<Predictability> m_predictability;                 /// predictability of each node index
+
+  std::unordered_set<uint64_t> m_seen;                          /// hashes of the bundle ids seen
+  std::deque<uint64_t> m_seenOrder;                             /// the seen set, oldest first
+  std::unordered_map<uint64_t, BufferedBundle> m_buffer;        /// bundles kept for forwarding: map (bundle id hash, bundle)
+  std::deque<uint64_t> m_bufferOrder;                           /// the buffer, oldest first
+  std::map<BpEndpointId, Neighbour> m_neighbours;               /// neighbours in contact
+};
+
+}  // namespace ns3
+
+#endif /* BP_PROPHET_ROUTING_PROTOCOL_H */
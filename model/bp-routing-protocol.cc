@@ -35,6 +35,7 @@ BpRoutingProtocol::GetTypeId (void)
 }
 
 BpRoutingProtocol::BpRoutingProtocol ()
+  : m_routeGeneration (0)
 { 
   NS_LOG_FUNCTION (this);
 }
@@ -44,4 +45,50 @@ BpRoutingProtocol::~BpRoutingProtocol ()
   NS_LOG_FUNCTION (this);
 }
 
+uint32_t
+BpRoutingProtocol::GetRouteGeneration ()
+{
+  return m_routeGeneration;
+}
+
+bool
+BpRoutingProtocol::HandleBundle (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  return false;
+}
+
+bool
+BpRoutingProtocol::HandleAdminRecord (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  return false;
+}
+
+void
+BpRoutingProtocol::NotifyNeighbourUp (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+}
+
+void
+BpRoutingProtocol::NotifyNeighbourDown (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+}
+
+bool
+BpRoutingProtocol::GetGroupRoutes (const BpEndpointId &src, const BpEndpointId &group, std::vector<BpEndpointId> &nextHops)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << group.Uri ());
+  return false;
+}
+
+void
+BpRoutingProtocol::NotifyRouteChange ()
+{
+  NS_LOG_FUNCTION (this);
+  m_routeGeneration++;
+}
+
 } // namespace ns3
@@ -21,6 +21,11 @@
 #define BP_ROUTING_PROTOCOL_H
 
 #include "ns3/object.h"
+#include "ns3/packet.h"
+#include "bp-endpoint-id.h"
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace ns3 {
 
@@ -48,9 +53,159 @@ public:
   /**
    * Set bundle protocol
    *
+   * A routing protocol keeping per-node state (replicas, delivery
+   * predictabilities, link state) is bound to one bundle protocol: give
+   * each node its own instance. A stateless one such as static routing may
+   * be shared by several nodes.
+   *
    * \param bundleProtocol bundle protocol
    */
   virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol) = 0;
+
+  /**
+   * \brief Look up the next hop towards a destination
+   *
+   * \param eid the destination endpoint id
+   *
+   * \return the endpoint id of the next hop; the destination itself if
+   * there is no route, i.e. it is assumed to be a neighbour
+   */
+  virtual BpEndpointId GetRoute (BpEndpointId eid) = 0;
+
+  /**
+   * \brief Get the route generation
+   *
+   * The generation changes whenever a route may have changed. A result of
+   * GetRoute () remains valid as long as the generation is the same, so
+   * that it can be cached by the convergence layer. A routing protocol
+   * whose routes expire with time may bump it here, lazily.
+   *
+   * \return the route generation
+   */
+  virtual uint32_t GetRouteGeneration ();
+
+  /**
+   * \brief Give the routing protocol a data bundle before the bundle
+   * protocol forwards or delivers it
+   *
+   * Called for the bundles originated by this node and for the bundles it
+   * receives. A routing protocol which replicates bundles keeps them and
+   * sends the copies itself, see BundleProtocol::ForwardBundleTo ().
+   *
+   * \param bundle the bundle, with its headers
+   *
+   * \return true if the routing protocol took or dropped the bundle; false
+   * to let the bundle protocol forward or deliver it. The default takes
+   * no bundle.
+   */
+  virtual bool HandleBundle (Ptr<Packet> bundle);
+
+  /**
+   * \brief Give the routing protocol an administrative record addressed to
+   * this node, e.g. a routing control record of a neighbour
+   *
+   * \param bundle the administrative bundle, with its headers
+   *
+   * \return true if the record was for the routing protocol. The default
+   * takes no record.
+   */
+  virtual bool HandleAdminRecord (Ptr<Packet> bundle);
+
+  /**
+   * \brief A neighbour can be reached from now on
+   *
+   * \param eid the endpoint id of the neighbour
+   */
+  virtual void NotifyNeighbourUp (const BpEndpointId &eid);
+
+  /**
+   * \brief A neighbour cannot be reached any more
+   *
+   * \param eid the endpoint id of the neighbour
+   */
+  virtual void NotifyNeighbourDown (const BpEndpointId &eid);
+
+  /**
+   * \brief Look up the next hops of a bundle sent to a group endpoint id
+   *
+   * A bundle to a group follows the distribution tree of its source: each
+   * node sends one copy to each of its next hops in the tree, so that the
+   * bundle is only replicated where the tree branches.
+   *
+   * \param src the source endpoint id of the bundle
+   * \param group the destination endpoint id
+   * \param nextHops the next hops of the bundle, appended to
+   *
+   * \return true if the destination is a group known to the routing
+   * protocol. The default knows no group.
+   */
+  virtual bool GetGroupRoutes (const BpEndpointId &src, const BpEndpointId &group, std::vector<BpEndpointId> &nextHops);
+
+protected:
+  /**
+   * \brief Invalidate all results of GetRoute () given so far
+   */
+  void NotifyRouteChange ();
+
+private:
+  uint32_t m_routeGeneration;   /// the route generation
+};
+
+/**
+ * \brief Cache of the route resolution of each destination endpoint id
+ *
+ * Each entry keeps what a convergence layer resolved for a destination
+ * (e.g. the address of its next hop) with the route generation it was
+ * resolved in; an entry of an older generation is a miss.
+ */
+template <typename T>
+class BpRouteCache
+{
+public:
+  /**
+   * \param dst the destination endpoint id
+   * \param generation the current route generation
+   *
+   * \return the cached resolution, NULL if there is none for this generation
+   */
+  T *Lookup (const BpEndpointId &dst, uint32_t generation)
+  {
+    typename std::unordered_map<BpEndpointId, std::pair<uint32_t, T>, BpEndpointIdHash>::iterator it = m_entries.find (dst);
+    if (it == m_entries.end () || (*it).second.first != generation)
+      return NULL;
+    return &(*it).second.second;
+  }
+
+  /**
+   * \brief Cache the resolution of a destination, replacing any older one
+   *
+   * \return the cached resolution
+   */
+  T *Insert (const BpEndpointId &dst, uint32_t generation, const T &value)
+  {
+    typename std::unordered_map<BpEndpointId, std::pair<uint32_t, T>, BpEndpointIdHash>::iterator it = m_entries.find (dst);
+    if (it == m_entries.end ())
+      {
+        it = m_entries.insert (std::make_pair (dst, std::make_pair (generation, value))).first;
+      }
+    else
+      {
+        (*it).second.first = generation;
+        (*it).second.second = value;
+      }
+    return &(*it).second.second;
+  }
+
+  /**
+   * \brief Drop all entries, e.g. when a neighbour address changes
+   */
+  void Clear ()
+  {
+    m_entries.clear ();
+  }
+
+private:
+  std::unordered_map<BpEndpointId, std::pair<uint32_t, T>, BpEndpointIdHash> m_entries; /// map (destination endpoint id, (generation, resolution))
 };
 
 
@@ -0,0 +1,185 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "bp-routing-record-header.h"
+#include "sdnv.h"
+
+NS_LOG_COMPONENT_DEFINE ("BpRoutingRecordHeader");
+
+namespace ns3 {
+
+BpRoutingRecordHeader::BpRoutingRecordHeader ()
+  : m_kind (0),
+    m_delta (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpRoutingRecordHeader::~BpRoutingRecordHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+BpRoutingRecordHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpRoutingRecordHeader")
+                      .SetParent<Header> ()
+                      .AddConstructor<BpRoutingRecordHeader> ();
+
+  return tid;
+}
+
+TypeId
+BpRoutingRecordHeader::GetInstanceTypeId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return GetTypeId ();
+}
+
+bool
+BpRoutingRecordHeader::IsRoutingRecord (Ptr<const Packet> record)
+{
+  if (record->GetSize () < 3)
+    return false;
+
+  uint8_t type;
+  record->CopyData (&type, 1);
+  return (type >> 4) == RECORD_TYPE;
+}
+
+uint32_t
+BpRoutingRecordHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  SDNV sdnv;
+
+  // record type, kind, flags
+  uint32_t size = 3;
+  size += sdnv.EncodingLength (m_values.size ());
+  uint64_t previous = 0;
+  for (std::vector<uint64_t>::const_iterator it = m_values.begin (); it != m_values.end (); ++it)
+    {
+      size += sdnv.EncodingLength (m_delta ? *it - previous : *it);
+      previous = *it;
+    }
+
+  return size;
+}
+
+void
+BpRoutingRecordHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  os << "kind " << (uint16_t) m_kind << " values " << m_values.size () << (m_delta ? " delta" : "");
+}
+
+static void
+WriteSdnv (Buffer::Iterator &i, uint64_t val)
+{
+  SDNV sdnv;
+  std::vector<uint8_t> encoded = sdnv.Encode (val);
+  for (std::vector<uint8_t>::iterator it = encoded.begin (); it != encoded.end (); ++it)
+    {
+      i.WriteU8 (*it);
+    }
+}
+
+void
+BpRoutingRecordHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+
+  i.WriteU8 (RECORD_TYPE << 4);
+  i.WriteU8 (m_kind);
+  i.WriteU8 (m_delta ? 1 : 0);
+  WriteSdnv (i, m_values.size ());
+  uint64_t previous = 0;
+  for (std::vector<uint64_t>::const_iterator it = m_values.begin (); it != m_values.end (); ++it)
+    {
+      WriteSdnv (i, m_delta ? *it - previous : *it);
+      previous = *it;
+    }
+}
+
+uint32_t
+BpRoutingRecordHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  SDNV sdnv;
+
+  i.ReadU8 (); // record type
+  m_kind = i.ReadU8 ();
+  m_delta = (i.ReadU8 () & 1) != 0;
+  uint64_t count = sdnv.Decode (i);
+  m_values.clear ();
+  m_values.reserve (count);
+  uint64_t previous = 0;
+  for (uint64_t k = 0; k < count; k++)
+    {
+      uint64_t value = sdnv.Decode (i);
+      if (m_delta)
+        value += previous;
+      m_values.push_back (value);
+      previous = value;
+    }
+
+  return GetSerializedSize ();
+}
+
+void
+BpRoutingRecordHeader::SetKind (uint8_t kind)
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) kind);
+  m_kind = kind;
+}
+
+void
+BpRoutingRecordHeader::SetValues (const std::vector<uint64_t> &values, bool delta)
+{
+  NS_LOG_FUNCTION (this << " " << values.size () << " " << delta);
+  m_values = values;
+  m_delta = delta;
+}
+
+uint8_t
+BpRoutingRecordHeader::GetKind () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_kind;
+}
+
+const std::vector<uint64_t> &
+BpRoutingRecordHeader::GetValues () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_values;
+}
+
+bool
+BpRoutingRecordHeader::IsDeltaEncoded () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_delta;
+}
+
+} // namespace ns3
@@ -0,0 +1,96 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_ROUTING_RECORD_HEADER_H
+#define BP_ROUTING_RECORD_HEADER_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+#include "ns3/packet.h"
+
+namespace ns3 {
+
+/**
+ * \brief Routing control record
+ *
+ * The payload of the administrative bundles routing protocols exchange
+ * between neighbours, e.g. the summary vectors of epidemic routing. The
+ * record type field (section 6.1 of RFC 5050) holds a type not used by
+ * the bundle protocol itself; the record carries a kind, defined by the
+ * routing protocol, and a list of SDNV-encoded values. A sorted list may
+ * be delta encoded: each value is sent as its difference to the previous
+ * one, which keeps the SDNVs of dense value sets short.
+ */
+class BpRoutingRecordHeader : public Header
+{
+public:
+  BpRoutingRecordHeader ();
+
+  virtual ~BpRoutingRecordHeader ();
+
+  /**
+   * administrative record type of routing control records
+   */
+  static const uint8_t RECORD_TYPE = 0xe;
+
+  /**
+   * \brief Is an administrative record a routing control record?
+   *
+   * \param record the administrative record, without the bundle headers
+   */
+  static bool IsRoutingRecord (Ptr<const Packet> record);
+
+  /**
+   * \brief set the kind of record, defined by the routing protocol
+   */
+  void SetKind (uint8_t kind);
+
+  /**
+   * \brief set the values of the record
+   *
+   * \param values the values
+   * \param delta delta encode the values, which must be sorted
+   */
+  void SetValues (const std::vector<uint64_t> &values, bool delta);
+
+  uint8_t GetKind () const;
+  const std::vector<uint64_t> &GetValues () const;
+
+  /**
+   * \return Are the values delta encoded?
+   */
+  bool IsDeltaEncoded () const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint8_t m_kind;                     /// kind of record
+  bool m_delta;                       /// the values are delta encoded
+  std::vector<uint64_t> m_values;     /// the values, decoded
+};
+
+} // namespace ns3
+
+#endif /* BP_ROUTING_RECORD_HEADER_H */
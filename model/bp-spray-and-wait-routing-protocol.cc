@@ -0,0 +1,323 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "bp-spray-and-wait-routing-protocol.h"
+#include "bp-routing-record-header.h"
+#include "bp-header.h"
+#include "bp-payload-header.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+
+NS_LOG_COMPONENT_DEFINE ("BpSprayAndWaitRoutingProtocol");
+
+namespace ns3 {
+
+TypeId
+BpSprayAndWaitRoutingProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpSprayAndWaitRoutingProtocol")
+    .SetParent<BpRoutingProtocol> ()
+    .AddConstructor<BpSprayAndWaitRoutingProtocol> ()
+    .AddAttribute ("InitialCopies",
+                   "The copy tokens of a bundle created on this node.",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&BpSprayAndWaitRoutingProtocol::m_initialCopies),
+                   MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+    .AddAttribute ("SeenSetSize",
+                   "The number of bundle ids remembered as seen.",
+                   UintegerValue (131072),
+                   MakeUintegerAccessor (&BpSprayAndWaitRoutingProtocol::m_maxSeen),
+                   MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+    .AddAttribute ("MaxBundles",
+                   "The number of bundles kept for forwarding; the oldest one is dropped first.",
+                   UintegerValue (100000),
+                   MakeUintegerAccessor (&BpSprayAndWaitRoutingProtocol::m_maxBundles),
+                   MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+  ;
+  return tid;
+}
+
+BpSprayAndWaitRoutingProtocol::BpSprayAndWaitRoutingProtocol ()
+  : m_bp (0),
+    m_initialCopies (8),
+    m_maxSeen (131072),
+    m_maxBundles (100000)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpSprayAndWaitRoutingProtocol::~BpSprayAndWaitRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpSprayAndWaitRoutingProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_pendingCopies.clear ();
+  m_buffer.clear ();
+  m_bufferOrder.clear ();
+  m_neighbours.clear ();
+  m_bp = 0;
+  BpRoutingProtocol::DoDispose ();
+}
+
+void
+BpSprayAndWaitRoutingProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  NS_ASSERT_MSG (m_bp == 0 || m_bp == bundleProtocol, "BpSprayAndWaitRoutingProtocol::SetBundleProtocol (): one routing protocol instance per node");
+  m_bp = bundleProtocol;
+}
+
+BpEndpointId
+BpSprayAndWaitRoutingProtocol::GetRoute (BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  return eid;
+}
+
+uint32_t
+BpSprayAndWaitRoutingProtocol::GetNBufferedBundles () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_buffer.size ();
+}
+
+void
+BpSprayAndWaitRoutingProtocol::Remember (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  m_seen.insert (id);
+  m_seenOrder.push_back (id);
+  while (m_seenOrder.size () > m_maxSeen)
+    {
+      m_seen.erase (m_seenOrder.front ());
+      m_seenOrder.pop_front ();
+    }
+}
+
+void
+BpSprayAndWaitRoutingProtocol::Drop (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  m_buffer.erase (id);
+  // the id stays in the buffer order until it is compacted
+  if (m_bufferOrder.size () > 2 * m_buffer.size () + 64)
+    {
+      std::deque<uint64_t> order;
+      for (std::deque<uint64_t>::iterator it = m_bufferOrder.begin (); it != m_bufferOrder.end (); ++it)
+        {
+          if (m_buffer.count (*it))
+            order.push_back (*it);
+        }
+      m_bufferOrder.swap (order);
+    }
+}
+
+bool
+BpSprayAndWaitRoutingProtocol::Offer (uint64_t id, BufferedBundle &bundle, const BpEndpointId &eid,
+                                      Neighbour &neighbour, std::vector<uint64_t> &tokens)
+{
+  NS_LOG_FUNCTION (this << " " << id << " " << eid.Uri ());
+  if (neighbour.sent.count (id))
+    return true;
+
+  bool destination = bundle.dst == (uint64_t) BpEndpointIdHash () (eid);
+  if (!destination && bundle.copies < 2)
+    return true; // wait phase
+
+  // copies share the payload buffer of the bundle
+  if (m_bp->ForwardBundleTo (bundle.bundle->Copy (), eid) < 0)
+    return false;
+  neighbour.sent.insert (id);
+
+  if (destination)
+    {
+      NS_LOG_DEBUG ("Bundle " << id << " handed to its destination " << eid.Uri ());
+      Drop (id);
+      return true;
+    }
+
+  // binary spray: hand over half of the tokens
+  uint32_t given = bundle.copies / 2;
+  bundle.copies -= given;
+  tokens.push_back (id);
+  tokens.push_back (given);
+  return true;
+}
+
+void
+BpSprayAndWaitRoutingProtocol::SendTokens (const BpEndpointId &eid, const std::vector<uint64_t> &tokens)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << tokens.size ());
+  if (tokens.empty ())
+    return;
+
+  BpRoutingRecordHeader header;
+  header.SetKind (COPY_TOKENS);
+  header.SetValues (tokens, false);
+  Ptr<Packet> record = Create<Packet> ();
+  record->AddHeader (header);
+  m_bp->SendAdminRecord (record, eid);
+}
+
+void
+BpSprayAndWaitRoutingProtocol::Spray (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  for (std::map<BpEndpointId, Neighbour>::iterator it = m_neighbours.begin (); it != m_neighbours.end (); ++it)
+    {
+      std::unordered_map<uint64_t, BufferedBundle>::iterator bundle = m_buffer.find (id);
+      if (bundle == m_buffer.end ())
+        return; // delivered to its destination
+
+      std::vector<uint64_t> tokens;
+      Offer (id, (*bundle).second, (*it).first, (*it).second, tokens);
+      SendTokens ((*it).first, tokens);
+    }
+}
+
+bool
+BpSprayAndWaitRoutingProtocol::HandleBundle (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bpHeader;
+  bundle->PeekHeader (bpHeader);
+  uint64_t id = bpHeader.GetBundleIdHash ();
+
+  if (m_seen.count (id) || m_buffer.count (id))
+    {
+      NS_LOG_DEBUG ("Dropping bundle " << id << " seen before");
+      return true;
+    }
+
+  Remember (id);
+
+  BpEndpointId dst = bpHeader.GetDestinationEid ();
+  if (dst == m_bp->GetBpEndpointId ())
+    return false;
+
+  BufferedBundle buffered;
+  buffered.bundle = bundle;
+  buffered.dst = BpEndpointIdHash () (dst);
+  buffered.copies = 1;
+  if (bpHeader.GetSourceEid () == m_bp->GetBpEndpointId ())
+    buffered.copies = m_initialCopies;
+  else
+    {
+      // the tokens may have come before the bundle
+      std::unordered_map<uint64_t, uint32_t>::iterator it = m_pendingCopies.find (id);
+      if (it != m_pendingCopies.end ())
+        {
+          buffered.copies = (*it).second;
+          m_pendingCopies.erase (it);
+        }
+    }
+
+  m_buffer.insert (std::make_pair (id, buffered));
+  m_bufferOrder.push_back (id);
+  while (m_buffer.size () > m_maxBundles)
+    {
+      NS_LOG_DEBUG ("Buffer full, dropping bundle " << m_bufferOrder.front ());
+      m_buffer.erase (m_bufferOrder.front ());
+      m_bufferOrder.pop_front ();
+    }
+
+  Spray (id);
+  return true;
+}
+
+bool
+BpSprayAndWaitRoutingProtocol::HandleAdminRecord (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  Ptr<Packet> record = bundle->Copy ();
+  BpHeader bpHeader;
+  BpPayloadHeader bppHeader;
+  record->RemoveHeader (bpHeader);
+  record->RemoveHeader (bppHeader);
+  if (!BpRoutingRecordHeader::IsRoutingRecord (record))
+    return false;
+
+  BpRoutingRecordHeader header;
+  record->RemoveHeader (header);
+  if (header.GetKind () != COPY_TOKENS)
+    return false;
+
+  // the neighbour handing tokens over holds the bundle: none of them are
+  // to be given back to it
+  std::map<BpEndpointId, Neighbour>::iterator from = m_neighbours.find (bpHeader.GetSourceEid ());
+  const std::vector<uint64_t> &values = header.GetValues ();
+  for (uint32_t i = 0; i + 1 < values.size (); i += 2)
+    {
+      uint64_t id = values[i];
+      uint32_t copies = values[i + 1];
+      if (from != m_neighbours.end ())
+        (*from).second.sent.insert (id);
+      std::unordered_map<uint64_t, BufferedBundle>::iterator it = m_buffer.find (id);
+      if (it != m_buffer.end ())
+        {
+          // the bundle came first and holds the single default token
+          (*it).second.copies = copies;
+          Spray (id);
+        }
+      else if (!m_seen.count (id))
+        {
+          if (m_pendingCopies.size () >= m_maxSeen)
+            m_pendingCopies.clear ();
+          m_pendingCopies[id] = copies;
+        }
+      // else the bundle was a duplicate here, or was delivered: the tokens
+      // are dropped with it
+    }
+
+  return true;
+}
+
+void
+BpSprayAndWaitRoutingProtocol::NotifyNeighbourUp (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  if (m_neighbours.find (eid) != m_neighbours.end ())
+    return;
+
+  Neighbour &neighbour = m_neighbours[eid];
+  std::vector<uint64_t> tokens;
+  std::vector<uint64_t> order (m_bufferOrder.begin (), m_bufferOrder.end ());
+  for (std::vector<uint64_t>::iterator it = order.begin (); it != order.end (); ++it)
+    {
+      std::unordered_map<uint64_t, BufferedBundle>::iterator bundle = m_buffer.find (*it);
+      if (bundle == m_buffer.end ())
+        continue;
+      if (!Offer (*it, (*bundle).second, eid, neighbour, tokens))
+        break;
+    }
+  SendTokens (eid, tokens);
+}
+
+void
+BpSprayAndWaitRoutingProtocol::NotifyNeighbourDown (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  m_neighbours.erase (eid);
+}
+
+} // namespace ns3
@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_SPRAY_AND_WAIT_ROUTING_PROTOCOL_H
+#define BP_SPRAY_AND_WAIT_ROUTING_PROTOCOL_H
+
+#include "bp-routing-protocol.h"
+#include "bundle-protocol.h"
+#include <stdint.h>
+#include <map>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ns3 {
+
+/**
+ * \brief Binary Spray-and-Wait routing
+ *
+ * A bundle created on this node starts with InitialCopies copy tokens.
+ * While a node holds more than one token for a bundle (spray phase), it
+ * gives a copy of the bundle and half of its tokens to each neighbour met
+ * which does not have it. With a single token left (wait phase), the
+ * bundle is only given to its destination.
+ *
+ * The tokens are node-local metadata: after handing a copy of the bundle
+ * over, the sender tells the neighbour how many tokens came with it in a
+ * routing control record. A bundle received without its tokens holds a
+ * single one until the record comes. All the copies held on a node are
+ * Packet::Copy () of the bundle received, sharing its payload buffer.
+ */
+class BpSprayAndWaitRoutingProtocol : public BpRoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   */
+  BpSprayAndWaitRoutingProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpSprayAndWaitRoutingProtocol ();
+
+  /**
+   * \brief Set bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  virtual void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \return the endpoint id itself: bundles are handed to the neighbours
+   * at contacts, not along routes
+   */
+  virtual BpEndpointId GetRoute (BpEndpointId eid);
+
+  /**
+   * \brief Keep a bundle not addressed to this node and spray it to the
+   * neighbours
+   *
+   * \return true unless the bundle is addressed to this node and was not
+   * seen before
+   */
+  virtual bool HandleBundle (Ptr<Packet> bundle);
+
+  /**
+   * \brief Take the copy tokens handed over by the neighbours
+   */
+  virtual bool HandleAdminRecord (Ptr<Packet> bundle);
+
+  /**
+   * \brief Spray the bundles kept to a new neighbour
+   */
+  virtual void NotifyNeighbourUp (const BpEndpointId &eid);
+
+  /**
+   * \brief Forget what was sent to a neighbour
+   */
+  virtual void NotifyNeighbourDown (const BpEndpointId &eid);
+
+  /**
+   * \return the number of bundles kept for forwarding
+   */
+  uint32_t GetNBufferedBundles () const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * kinds of the routing control records
+   */
+  enum RecordKind
+  {
+    COPY_TOKENS = 4             /// pairs (bundle id hash, copy tokens handed over)
+  };
+
+  /**
+   * \brief A bundle kept for forwarding
+   */
+  struct BufferedBundle
+  {
+    Ptr<Packet> bundle;         /// the bundle
+    uint64_t dst;               /// hash of its destination endpoint id
+    uint32_t copies;            /// the copy tokens held
+  };
+
+  /**
+   * \brief State of a neighbour in contact
+   */
+  struct Neighbour
+  {
+    std::unordered_set<uint64_t> sent;  /// hashes of the bundle ids sent to it
+  };
+
+  /**
+   * \brief Add a bundle id to the seen set, evicting the oldest one if full
+   */
+  void Remember (uint64_t id);
+
+  /**
+   * \brief Give a bundle to a neighbour: to the destination in any phase,
+   * to any other with half of the copy tokens in the spray phase
+   *
+   * \param tokens the pairs (bundle id hash, copy tokens) handed over,
+   * appended to
+   * \return false if the CLA refused the bundle
+   */
+  bool Offer (uint64_t id, BufferedBundle &bundle, const BpEndpointId &eid, Neighbour &neighbour, std::vector<uint64_t> &tokens);
+
+  /**
+   * \brief Tell a neighbour the copy tokens handed over with the bundles
+   */
+  void SendTokens (const BpEndpointId &eid, const std::vector<uint64_t> &tokens);
+
+  /**
+   * \brief Offer a bundle to all neighbours in contact
+   */
+  void Spray (uint64_t id);
+
+  /**
+   * \brief Drop a bundle from the buffer
+   */
+  void Drop (uint64_t id);
+
+  Ptr<BundleProtocol> m_bp;                                     /// bundle protocol
+  uint32_t m_initialCopies;                                     /// copy tokens of a bundle created on this node
+  uint32_t m_maxSeen;                                           /// size of the seen set
+  uint32_t m_maxBundles;                                        /// size of the buffer
+
+  std::unordered_set<uint64_t> m_seen;                          /// hashes of the bundle ids seen
+  std::deque<uint64_t> m_seenOrder;                             /// the seen set, oldest first
+  std::unordered_map<uint64_t, uint32_t> m_pendingCopies;       /// tokens received before their bundle: map (bundle id hash, copies)
+  std::unordered_map<uint64_t, BufferedBundle> m_buffer;        /// bundles kept for forwarding: map (bundle id hash, bundle)
+  std::deque<uint64_t> m_bufferOrder;                           /// the buffer, oldest first; may hold ids already dropped
+  std::map<BpEndpointId, Neighbour> m_neighbours;               /// neighbours in contact
+};
+
+}  // namespace ns3
+
+#endif /* BP_SPRAY_AND_WAIT_ROUTING_PROTOCOL_H */
@@ -20,6 +20,7 @@
 
 #include "bp-static-routing-protocol.h"
 #include "ns3/log.h"
+#include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE ("BpStaticRoutingProtocol");
 
@@ -36,7 +37,9 @@ BpStaticRoutingProtocol::GetTypeId (void)
 }
 
 BpStaticRoutingProtocol::BpStaticRoutingProtocol ()
-  : m_bp (0)
+  : m_table (0),
+    m_node (0),
+    m_bp (0)
 { 
   NS_LOG_FUNCTION (this);
 }
@@ -61,6 +64,7 @@ BpStaticRoutingProtocol::AddRoute (BpEndpointId eid, BpEndpointId next_hop) // -
   if (it == m_routeMap.end ())
     {
       m_routeMap.insert (std::pair<BpEndpointId, BpEndpointId>(eid, next_hop));
+      NotifyRouteChange ();
     }
   else
     {
@@ -71,20 +75,85 @@ BpStaticRoutingProtocol::AddRoute (BpEndpointId eid, BpEndpointId next_hop) // -
   return 0;
 }
 
+void
+BpStaticRoutingProtocol::SetForwardingTable (Ptr<const BpForwardingTable> table, uint32_t node)
+{
+  NS_LOG_FUNCTION (this << " " << node);
+  m_table = table;
+  m_node = node;
+  NotifyRouteChange ();
+}
+
+uint32_t
+BpStaticRoutingProtocol::AddRoutes (const std::vector<std::pair<BpEndpointId, BpEndpointId> > &routes)
+{
+  NS_LOG_FUNCTION (this << " " << routes.size ());
+  uint32_t duplicates = 0;
+  std::map <BpEndpointId, BpEndpointId>::iterator hint = m_routeMap.end ();
+  for (std::vector<std::pair<BpEndpointId, BpEndpointId> >::const_iterator it = routes.begin (); it != routes.end (); ++it)
+    {
+      size_t size = m_routeMap.size ();
+      hint = m_routeMap.insert (hint, *it);
+      if (m_routeMap.size () == size)
+        duplicates++;
+      // the next destination is expected after this one
+      ++hint;
+    }
+  NotifyRouteChange ();
+
+  return duplicates;
+}
+
 //InetSocketAddress 
 BpEndpointId
 BpStaticRoutingProtocol::GetRoute (BpEndpointId eid)
 { 
   NS_LOG_FUNCTION (this << " " << eid.Uri ());
   std::map <BpEndpointId, BpEndpointId>::iterator it = m_routeMap.find (eid);
-  if (it == m_routeMap.end ())
-    {
-      return eid;
-    }
-  else
+  if (it != m_routeMap.end ())
+    return (*it).second;
+
+  uint32_t dst;
+  if (m_table && m_table->GetHandle (eid, dst))
     {
-      return (*it).second;
+      uint32_t nextHop = m_table->Lookup (m_node, dst);
+      if (nextHop != BpForwardingTable::NO_ROUTE)
+        return m_table->GetEid (nextHop);
     }
+
+  return eid;
+}
+
+void
+BpStaticRoutingProtocol::AddGroup (BpEndpointId group)
+{
+  NS_LOG_FUNCTION (this << " " << group.Uri ());
+  m_groups.insert (group);
+}
+
+int
+BpStaticRoutingProtocol::AddGroupRoute (BpEndpointId src, BpEndpointId group, BpEndpointId next_hop)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << group.Uri () << " " << next_hop.Uri ());
+  m_groups.insert (group);
+  std::vector<BpEndpointId> &nextHops = m_groupRoutes[std::make_pair (src, group)];
+  if (std::find (nextHops.begin (), nextHops.end (), next_hop) != nextHops.end ())
+    return -1;
+  nextHops.push_back (next_hop);
+  return 0;
+}
+
+bool
+BpStaticRoutingProtocol::GetGroupRoutes (const BpEndpointId &src, const BpEndpointId &group, std::vector<BpEndpointId> &nextHops)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << group.Uri ());
+  if (m_groups.find (group) == m_groups.end ())
+    return false;
+
+  std::map <std::pair<BpEndpointId, BpEndpointId>, std::vector<BpEndpointId> >::iterator it = m_groupRoutes.find (std::make_pair (src, group));
+  if (it != m_groupRoutes.end ())
+    nextHops.insert (nextHops.end (), (*it).second.begin (), (*it).second.end ());
+  return true;
 }
 
 } // namespace ns3
@@ -22,6 +22,10 @@
 
 #include "bp-routing-protocol.h"
 #include "bundle-protocol.h"
+#include "bp-forwarding-table.h"
+#include <vector>
+#include <set>
+#include <utility>
 //#include "ns3/inet-socket-address.h"  // -- Bundle protocol doesn't worry about lower layers
 
 namespace ns3 {
@@ -54,17 +58,68 @@ public:
 
   /**
    * \brief Add a static route 
+   *
+   * The route is kept by this node only and takes precedence over the
+   * shared forwarding table, which is never changed.
+   *
+   * \return -1 if the destination already has a route of this node,
+   * otherwise 0
    */
   virtual int AddRoute (BpEndpointId eid, BpEndpointId next_hop);
 
   /**
-   *  \return the internet socket address of matched eid; If there is no 
-   *  match route, return the 127.0.0.1 with port 0
+   * \brief Use the row of a node in a forwarding table shared by all nodes
+   *
+   * \param table the forwarding table
+   * \param node the handle of this node in the table
+   */
+  void SetForwardingTable (Ptr<const BpForwardingTable> table, uint32_t node);
+
+  /**
+   * \brief Add many static routes at once
+   *
+   * The routes are inserted in one pass and invalidate the cached routes
+   * once; sorting them by destination makes the insertion linear.
+   *
+   * \param routes the routes: vector of (destination, next hop)
+   *
+   * \return the number of routes not added because the destination
+   * already has one
+   */
+  virtual uint32_t AddRoutes (const std::vector<std::pair<BpEndpointId, BpEndpointId> > &routes);
+
+  /**
+   *  \return the next hop of the route added to this node, else of the
+   *  forwarding table; the destination itself if there is none
    */
   virtual BpEndpointId GetRoute (BpEndpointId eid);
 
+  /**
+   * \brief Make a group endpoint id known, e.g. on a node of no branch of
+   * its distribution trees
+   */
+  virtual void AddGroup (BpEndpointId group);
+
+  /**
+   * \brief Add a next hop of the distribution tree of a source towards a
+   * group
+   *
+   * \return -1 if it is already a next hop of the tree, otherwise 0
+   */
+  virtual int AddGroupRoute (BpEndpointId src, BpEndpointId group, BpEndpointId next_hop);
+
+  /**
+   * \return true if the group is known, with the next hops of the tree of
+   * the source on this node
+   */
+  virtual bool GetGroupRoutes (const BpEndpointId &src, const BpEndpointId &group, std::vector<BpEndpointId> &nextHops);
+
 private:
-  std::map <BpEndpointId, BpEndpointId> m_routeMap; /// routing table
+  std::map <BpEndpointId, BpEndpointId> m_routeMap; /// routing table of this node, before the forwarding table
+  Ptr<const BpForwardingTable> m_table;             /// forwarding table shared by all nodes
+  uint32_t m_node;                                  /// handle of this node in the forwarding table
+  std::set <BpEndpointId> m_groups;                 /// group endpoint ids known
+  std::map <std::pair<BpEndpointId, BpEndpointId>, std::vector<BpEndpointId> > m_groupRoutes; /// distribution trees: map ((source, group), next hops)
   Ptr<BundleProtocol> m_bp;                              /// bundle protocol
 };
 
@@ -0,0 +1,297 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "bp-status-report-header.h"
+#include "sdnv.h"
+
+NS_LOG_COMPONENT_DEFINE ("BpStatusReportHeader");
+
+namespace ns3 {
+
+BpStatusReportHeader::BpStatusReportHeader ()
+  : m_status (0),
+    m_reason (NO_ADDITIONAL_INFORMATION),
+    m_fragment (false),
+    m_fragOffset (0),
+    m_fragLength (0),
+    m_createTimestamp (0),
+    m_seq (0)
+{
+  NS_LOG_FUNCTION (this);
+  for (int k = 0; k < N_STATUS; k++)
+    {
+      m_seconds[k] = 0;
+      m_nanoseconds[k] = 0;
+    }
+}
+
+BpStatusReportHeader::~BpStatusReportHeader ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+BpStatusReportHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpStatusReportHeader")
+                      .SetParent<Header> ()
+                      .AddConstructor<BpStatusReportHeader> ();
+
+  return tid;
+}
+
+TypeId
+BpStatusReportHeader::GetInstanceTypeId (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return GetTypeId ();
+}
+
+bool
+BpStatusReportHeader::IsStatusReport (Ptr<const Packet> record)
+{
+  if (record->GetSize () < 3)
+    return false;
+
+  uint8_t type;
+  record->CopyData (&type, 1);
+  return (type >> 4) == RECORD_TYPE;
+}
+
+uint32_t
+BpStatusReportHeader::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION (this);
+  SDNV sdnv;
+
+  // record type and flags, status flags, reason code
+  uint32_t size = 3;
+  if (m_fragment)
+    size += sdnv.EncodingLength (m_fragOffset) + sdnv.EncodingLength (m_fragLength);
+  for (int k = 0; k < N_STATUS; k++)
+    {
+      if (m_status & (1 << k))
+        size += sdnv.EncodingLength (m_seconds[k]) + sdnv.EncodingLength (m_nanoseconds[k]);
+    }
+  size += sdnv.EncodingLength (m_createTimestamp) + sdnv.EncodingLength (m_seq);
+  size += sdnv.EncodingLength (m_src.size ()) + m_src.size ();
+
+  return size;
+}
+
+void
+BpStatusReportHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  os << "status " << (uint16_t) m_status << " reason " << (uint16_t) m_reason
+     << " bundle " << m_src << " " << m_createTimestamp << " " << m_seq;
+  if (m_fragment)
+    os << " fragment " << m_fragOffset << " " << m_fragLength;
+}
+
+static void
+WriteSdnv (Buffer::Iterator &i, uint64_t val)
+{
+  SDNV sdnv;
+  std::vector<uint8_t> encoded = sdnv.Encode (val);
+  for (std::vector<uint8_t>::iterator it = encoded.begin (); it != encoded.end (); ++it)
+    {
+      i.WriteU8 (*it);
+    }
+}
+
+void
+BpStatusReportHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+
+  i.WriteU8 ((RECORD_TYPE << 4) | (m_fragment ? 1 : 0));
+  i.WriteU8 (m_status);
+  i.WriteU8 (m_reason);
+  if (m_fragment)
+    {
+      WriteSdnv (i, m_fragOffset);
+      WriteSdnv (i, m_fragLength);
+    }
+  for (int k = 0; k < N_STATUS; k++)
+    {
+      if (m_status & (1 << k))
+        {
+          WriteSdnv (i, m_seconds[k]);
+          WriteSdnv (i, m_nanoseconds[k]);
+        }
+    }
+  WriteSdnv (i, m_createTimestamp);
+  WriteSdnv (i, m_seq);
+  WriteSdnv (i, m_src.size ());
+  for (std::string::const_iterator it = m_src.begin (); it != m_src.end (); ++it)
+    {
+      i.WriteU8 (*it);
+    }
+}
+
+uint32_t
+BpStatusReportHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this);
+  Buffer::Iterator i = start;
+  SDNV sdnv;
+
+  m_fragment = (i.ReadU8 () & 1) != 0;
+  m_status = i.ReadU8 ();
+  m_reason = i.ReadU8 ();
+  if (m_fragment)
+    {
+      m_fragOffset = sdnv.Decode (i);
+      m_fragLength = sdnv.Decode (i);
+    }
+  for (int k = 0; k < N_STATUS; k++)
+    {
+      m_seconds[k] = 0;
+      m_nanoseconds[k] = 0;
+      if (m_status & (1 << k))
+        {
+          m_seconds[k] = sdnv.Decode (i);
+          m_nanoseconds[k] = sdnv.Decode (i);
+        }
+    }
+  m_createTimestamp = sdnv.Decode (i);
+  m_seq = sdnv.Decode (i);
+  uint64_t length = sdnv.Decode (i);
+  m_src.clear ();
+  for (uint64_t k = 0; k < length; k++)
+    {
+      m_src.push_back (i.ReadU8 ());
+    }
+
+  return GetSerializedSize ();
+}
+
+void
+BpStatusReportHeader::SetStatus (uint8_t status, Time time)
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) status << " " << time.GetSeconds ());
+  int64_t nanoseconds = time.GetNanoSeconds ();
+  for (int k = 0; k < N_STATUS; k++)
+    {
+      if (status & (1 << k))
+        {
+          m_seconds[k] = nanoseconds / 1000000000;
+          m_nanoseconds[k] = nanoseconds % 1000000000;
+        }
+    }
+  m_status |= status & ((1 << N_STATUS) - 1);
+}
+
+void
+BpStatusReportHeader::SetReason (uint8_t reason)
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) reason);
+  m_reason = reason;
+}
+
+void
+BpStatusReportHeader::SetBundleId (const BpEndpointId &src, std::time_t timestamp, uint32_t seq)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << timestamp << " " << seq);
+  m_src = src.Uri ();
+  m_createTimestamp = timestamp;
+  m_seq = seq;
+}
+
+void
+BpStatusReportHeader::SetFragment (uint32_t offset, uint32_t length)
+{
+  NS_LOG_FUNCTION (this << " " << offset << " " << length);
+  m_fragment = true;
+  m_fragOffset = offset;
+  m_fragLength = length;
+}
+
+uint8_t
+BpStatusReportHeader::GetStatus () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_status;
+}
+
+uint8_t
+BpStatusReportHeader::GetReason () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_reason;
+}
+
+bool
+BpStatusReportHeader::IsFragment () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_fragment;
+}
+
+uint32_t
+BpStatusReportHeader::GetFragOffset () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_fragOffset;
+}
+
+uint32_t
+BpStatusReportHeader::GetFragLength () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_fragLength;
+}
+
+BpEndpointId
+BpStatusReportHeader::GetSourceEid () const
+{
+  NS_LOG_FUNCTION (this);
+  return BpEndpointId (m_src);
+}
+
+std::time_t
+BpStatusReportHeader::GetCreateTimestamp () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_createTimestamp;
+}
+
+uint32_t
+BpStatusReportHeader::GetSequenceNumber () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_seq;
+}
+
+Time
+BpStatusReportHeader::GetStatusTime (uint8_t status) const
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) status);
+  for (int k = 0; k < N_STATUS; k++)
+    {
+      if ((status & (1 << k)) && (m_status & (1 << k)))
+        return Seconds (m_seconds[k]) + NanoSeconds (m_nanoseconds[k]);
+    }
+  return Seconds (0);
+}
+
+} // namespace ns3
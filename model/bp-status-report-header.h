@@ -0,0 +1,155 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BP_STATUS_REPORT_HEADER_H
+#define BP_STATUS_REPORT_HEADER_H
+
+#include <stdint.h>
+#include <ctime>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "bp-endpoint-id.h"
+
+namespace ns3 {
+
+/**
+ * \brief Bundle status report
+ *
+ * The administrative record a node sends to the report-to endpoint of a
+ * bundle when it received, forwarded, delivered or deleted the bundle,
+ * section 6.1.1 of RFC 5050: the status flags, a reason code, the offset
+ * and length of the bundle if it is a fragment, the time of each status
+ * and the bundle id. Several reports may follow each other in one
+ * administrative bundle.
+ */
+class BpStatusReportHeader : public Header
+{
+public:
+  BpStatusReportHeader ();
+
+  virtual ~BpStatusReportHeader ();
+
+  /**
+   * administrative record type of status reports
+   */
+  static const uint8_t RECORD_TYPE = 0x1;
+
+  /**
+   * status flags, section 6.1.1 of RFC 5050
+   */
+  typedef enum {
+    RECEIVED                       = 1 << 0,
+    CUSTODY_ACCEPTED               = 1 << 1,
+    FORWARDED                      = 1 << 2,
+    DELIVERED                      = 1 << 3,
+    DELETED                        = 1 << 4
+  } Status;
+
+  /**
+   * reason codes, section 6.1.1 of RFC 5050
+   */
+  typedef enum {
+    NO_ADDITIONAL_INFORMATION      = 0x00,
+    LIFETIME_EXPIRED               = 0x01,
+    FORWARDED_UNIDIRECTIONAL_LINK  = 0x02,
+    TRANSMISSION_CANCELED          = 0x03,
+    DEPLETED_STORAGE               = 0x04,
+    DESTINATION_UNINTELLIGIBLE     = 0x05,
+    NO_KNOWN_ROUTE                 = 0x06,
+    NO_TIMELY_CONTACT              = 0x07,
+    BLOCK_UNINTELLIGIBLE           = 0x08
+  } Reason;
+
+  /**
+   * \brief Is an administrative record a status report?
+   *
+   * \param record the administrative record, without the bundle headers
+   */
+  static bool IsStatusReport (Ptr<const Packet> record);
+
+  /**
+   * \brief set a status of the bundle
+   *
+   * \param status one of the status flags
+   * \param time the time the bundle got the status
+   */
+  void SetStatus (uint8_t status, Time time);
+
+  /**
+   * \brief set the reason code
+   */
+  void SetReason (uint8_t reason);
+
+  /**
+   * \brief set the id of the bundle, taken from its primary header
+   *
+   * \param src the source endpoint id
+   * \param timestamp the creation timestamp
+   * \param seq the creation sequence number
+   */
+  void SetBundleId (const BpEndpointId &src, std::time_t timestamp, uint32_t seq);
+
+  /**
+   * \brief the bundle is a fragment
+   *
+   * \param offset the offset of the fragment
+   * \param length the length of its payload
+   */
+  void SetFragment (uint32_t offset, uint32_t length);
+
+  uint8_t GetStatus () const;
+  uint8_t GetReason () const;
+  bool IsFragment () const;
+  uint32_t GetFragOffset () const;
+  uint32_t GetFragLength () const;
+  BpEndpointId GetSourceEid () const;
+  std::time_t GetCreateTimestamp () const;
+  uint32_t GetSequenceNumber () const;
+
+  /**
+   * \return the time the bundle got a status, zero if it does not have it
+   */
+  Time GetStatusTime (uint8_t status) const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  static const int N_STATUS = 5;      /// number of status flags
+
+  uint8_t m_status;                   /// status flags
+  uint8_t m_reason;                   /// reason code
+  bool m_fragment;                    /// the bundle is a fragment
+  uint32_t m_fragOffset;              /// offset of the fragment
+  uint32_t m_fragLength;              /// payload length of the fragment
+  uint64_t m_seconds[N_STATUS];       /// time of each status: seconds
+  uint32_t m_nanoseconds[N_STATUS];   /// time of each status: nanoseconds
+  std::time_t m_createTimestamp;      /// creation timestamp of the bundle
+  uint32_t m_seq;                     /// creation sequence number of the bundle
+  std::string m_src;                  /// source endpoint id of the bundle
+};
+
+} // namespace ns3
+
+#endif /* BP_STATUS_REPORT_HEADER_H */
@@ -33,16 +33,18 @@
 
 #include "ns3/config.h" // added by AlexK. to allow modifying default TCP values
 #include "ns3/uinteger.h"
+#include "ns3/double.h"
 
 #include "bp-tcp-cla-protocol.h"
 #include "bp-cla-protocol.h"
 #include "bundle-protocol.h"
-#include "bp-static-routing-protocol.h"
 #include "bp-header.h"
 #include "bp-endpoint-id.h"
 #include "ns3/tcp-socket-factory.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/packet.h"
+#include "bp-payload-header.h"
+#include <algorithm>
 
 // default port number of dtn bundle tcp convergence layer, which is 
 // defined in draft-irtf--dtnrg-tcp-clayer-0.6
@@ -60,6 +62,46 @@ BpTcpClaProtocol::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::BpTcpClaProtocol")
     .SetParent<BpClaProtocol> ()
     .AddConstructor<BpTcpClaProtocol> ()
+    .AddAttribute ("MaxQueuedBytes", 
+                   "Size of a session queue above which SendPacket reports backpressure",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&BpTcpClaProtocol::m_maxQueuedBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ReconnectBaseDelay", 
+                   "Delay before the first attempt to reconnect a failed session",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&BpTcpClaProtocol::m_reconnectBaseDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("ReconnectMaxDelay", 
+                   "Upper bound of the exponentially growing reconnect delay",
+                   TimeValue (Seconds (10)),
+                   MakeTimeAccessor (&BpTcpClaProtocol::m_reconnectMaxDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("ReconnectJitter", 
+                   "Maximum random jitter added to a reconnect delay, as a fraction of that delay",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&BpTcpClaProtocol::m_reconnectJitter),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("MaxReconnectAttempts", 
+                   "Reconnect attempts before the queued bundles are handed back to the bundle store",
+                   UintegerValue (5),
+                   MakeUintegerAccessor (&BpTcpClaProtocol::m_maxReconnectAttempts),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SessionsPerPeer", 
+                   "Number of parallel TCP sessions to each next hop; the destinations are spread across them, the bundles to one destination keep to one session",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&BpTcpClaProtocol::m_sessionsPerPeer),
+                   MakeUintegerChecker<uint32_t> (1, 64))
+    .AddAttribute ("CoalesceBytes", 
+                   "Maximum bytes of consecutive bundles written to the socket at once; 0 writes each bundle on its own",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&BpTcpClaProtocol::m_coalesceBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CoalesceDelay", 
+                   "Maximum time a bundle is held back waiting for CoalesceBytes to be queued",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&BpTcpClaProtocol::m_coalesceDelay),
+                   MakeTimeChecker ())
   ;
   return tid;
 }
@@ -67,9 +109,17 @@ BpTcpClaProtocol::GetTypeId (void)
 
 BpTcpClaProtocol::BpTcpClaProtocol ()
   :m_bp (0),
-   m_bpRouting (0)
+   m_bpRouting (0),
+   m_maxQueuedBytes (65536),
+   m_txQueuedBytes (0),
+   m_reconnectJitter (0.5),
+   m_maxReconnectAttempts (5),
+   m_sessionsPerPeer (1),
+   m_coalesceBytes (0),
+   m_contacts (0)
 { 
   NS_LOG_FUNCTION (this);
+  m_reconnectRng = CreateObject<UniformRandomVariable> ();
   //Added by AlexK.  - Config not within NS3 namespace as documentation stated it would be
   //int tcpSegmentSize = 1000; //to account for bundle fragment sizes exceeding ns-3 default tcp packet size (512)
   //Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (tcpSegmentSize));
@@ -80,6 +130,33 @@ BpTcpClaProtocol::~BpTcpClaProtocol ()
   NS_LOG_FUNCTION (this);
 }
 
+void
+BpTcpClaProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<InetSocketAddress, std::vector<Ptr<BpTcpClaSession> > >::iterator it = m_sessions.begin (); it != m_sessions.end (); ++it)
+    {
+      for (uint32_t i = 0; i < (*it).second.size (); i++)
+        {
+          (*it).second[i]->m_reconnectEvent.Cancel ();
+          (*it).second[i]->m_flushEvent.Cancel ();
+        }
+    }
+  m_sessions.clear ();
+  m_socketSessions.clear ();
+  m_rxBuffers.clear ();
+  m_listeners.clear ();
+  m_recvRegistrations.clear ();
+  m_bp = 0;
+  m_bpRouting = 0;
+  m_routeCache.Clear ();
+  m_reconnectRng = 0;
+  if (m_contacts)
+    m_contacts->Dispose ();
+  m_contacts = 0;
+  BpClaProtocol::DoDispose ();
+}
+
 void 
 BpTcpClaProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
 { 
@@ -87,6 +164,73 @@ BpTcpClaProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
   m_bp = bundleProtocol;
 }
 
+InetSocketAddress
+BpTcpClaProtocol::GetNextHopAddress (const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpTcpClaProtocol::GetNextHopAddress (): cannot find bundle routing protocol");
+
+  // resolved once per destination while the routes do not change
+  uint32_t generation = m_bpRouting->GetRouteGeneration ();
+  InetSocketAddress *cached = m_routeCache.Lookup (dst, generation);
+  if (cached)
+    return *cached;
+
+  // check route for destination endpoint id
+  BpEndpointId next_hop = m_bpRouting->GetRoute (dst);
+  InetSocketAddress address = getL4Address (next_hop);
+
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (address == badAddr)
+    {
+      NS_LOG_DEBUG ("BpTcpClaProtocol::GetNextHopAddress (): no L4 address for next hop " << next_hop.Uri () << " towards " << dst.Uri ());
+      return InetSocketAddress ("127.0.0.1", 0);
+    }
+
+  m_routeCache.Insert (dst, generation, address);
+  return address;
+}
+
+std::vector<Ptr<BpTcpClaSession> > &
+BpTcpClaProtocol::GetPeerSessions (const InetSocketAddress &address)
+{
+  NS_LOG_FUNCTION (this << " " << address);
+  std::map<InetSocketAddress, std::vector<Ptr<BpTcpClaSession> > >::iterator it = m_sessions.find (address);
+  if (it == m_sessions.end ())
+    {
+      // first bundle towards this next hop; the sockets are opened on demand
+      std::vector<Ptr<BpTcpClaSession> > sessions;
+      for (uint32_t i = 0; i < m_sessionsPerPeer; i++)
+        sessions.push_back (Create<BpTcpClaSession> (address));
+      it = m_sessions.insert (std::pair<InetSocketAddress, std::vector<Ptr<BpTcpClaSession> > > (address, sessions)).first;
+    }
+  return (*it).second;
+}
+
+Ptr<BpTcpClaSession>
+BpTcpClaProtocol::GetSession (const InetSocketAddress &address, const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << address << " " << dst.Uri ());
+  std::vector<Ptr<BpTcpClaSession> > &sessions = GetPeerSessions (address);
+
+  // TCP keeps the order within a session only: pin each destination to one
+  return sessions[BpEndpointIdHash () (dst) % sessions.size ()];
+}
+
+Ptr<BpTcpClaSession>
+BpTcpClaProtocol::GetSession (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  std::map<Ptr<Socket>, Ptr<BpTcpClaSession> >::iterator it = m_socketSessions.find (socket);
+  if (it == m_socketSessions.end ())
+    {
+      NS_LOG_FUNCTION (this << " No session recorded for this socket");
+      return NULL;
+    }
+  return (*it).second;
+}
+
 Ptr<Socket>
 BpTcpClaProtocol::GetL4Socket (Ptr<Packet> packet)
 { 
@@ -96,176 +240,264 @@ BpTcpClaProtocol::GetL4Socket (Ptr<Packet> packet)
   BpEndpointId dst = bph.GetDestinationEid ();
   BpEndpointId src = bph.GetSourceEid ();
 
-  std::map<BpEndpointId, Ptr<Socket> >::iterator it = m_l4SendSockets.find (src);
-  if (it == m_l4SendSockets.end ())
-  {
-      // enable a tcp connection from the src endpoint id to the dst endpoint id
-      if (EnableSend (src, dst) < 0)
-        return NULL;
+  InetSocketAddress address = GetNextHopAddress (dst);
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (address == defaultAddr)
+    return NULL;
 
-      // update because EnableSende () add new socket into m_l4SendSockets
-      it = m_l4SendSockets.find (src);
-  }
+  Ptr<BpTcpClaSession> session = GetSession (address, dst);
+  if (session->m_socket == NULL)
+    {
+      // enable a tcp connection to the next hop towards the dst endpoint id
+      if (OpenSession (session) < 0)
+        return NULL;
+    }
 
-  return ((*it).second);
+  return session->m_socket;
 }
 
 bool
 BpTcpClaProtocol::RemoveL4Socket (Ptr<Socket> socket)
 {
   NS_LOG_FUNCTION (this << " " << socket);
-  bool status = false;
-  for (auto &it : m_l4SendSockets)
-  {
-    if (it.second == socket)
+  std::map<Ptr<Socket>, Ptr<BpTcpClaSession> >::iterator it = m_socketSessions.find (socket);
+  if (it == m_socketSessions.end ())
     {
-      m_l4SendSockets.erase (it.first);
-      status = true;
-      break;
+      return false;
     }
-  }
-  if (!status)
-  {
-    return false;
-  }
-  status = false;
-  std::map<Ptr<Socket>, u_int16_t>::iterator iter = m_l4SocketStatus.find (socket);
-  if (iter != m_l4SocketStatus.end ())
-  {
-    m_l4SocketStatus.erase(socket);
-    status = true;
-  }
-  if (!status)
-  {
-    return false;
-  }
-  status = false;
-  std::map<Ptr<Socket>, InetSocketAddress>::iterator iterate = m_SendSocketL4Addresses.find (socket);
-  if (iterate != m_SendSocketL4Addresses.end ())
-  {
-    m_SendSocketL4Addresses.erase(socket);
-    status = true;
-  }
-  return status;
+
+  Ptr<BpTcpClaSession> session = (*it).second;
+  m_socketSessions.erase (it);
+  if (session->m_socket == socket)
+    {
+      session->m_socket = NULL;
+    }
+  return true;
 }
 
-InetSocketAddress
-BpTcpClaProtocol::GetSendSocketAddress(Ptr<Socket> socket)
+void
+BpTcpClaProtocol::RetrySocketConn (Ptr<BpTcpClaSession> session)
 {
-  NS_LOG_FUNCTION (this << " " << socket);
+  NS_LOG_FUNCTION (this << " " << session->m_remote);
+  // redo the connection without interacting with BpSendStore
 
-  std::map<Ptr<Socket>, InetSocketAddress>::iterator it = m_SendSocketL4Addresses.find (socket);
-  if (it == m_SendSocketL4Addresses.end ())
+  if (session->m_socket != NULL)
   {
-    //entry doesn't exist, so return bad addy
-    return InetSocketAddress ("127.0.0.1", 0);
-    NS_LOG_FUNCTION (this << " No L4 address recorded for this socket");
+    // a connection was opened meanwhile, e.g. by a new bundle
+    return;
   }
-  else
+
+  if (OpenSession (session) < 0)
   {
-    return (*it).second;
+    NS_LOG_FUNCTION (this << " Unable to create new socket for address: " << session->m_remote);
+    ScheduleReconnect (session);
   }
 }
 
 void
-BpTcpClaProtocol::SetSendSocketAddress(Ptr<Socket> socket, InetSocketAddress address)
+BpTcpClaProtocol::ScheduleReconnect (Ptr<BpTcpClaSession> session)
 {
-  NS_LOG_FUNCTION (this << " " << socket << " " << address);
+  NS_LOG_FUNCTION (this << " " << session->m_remote << " retries " << session->m_retries);
 
-  std::map<Ptr<Socket>, InetSocketAddress>::iterator it = m_SendSocketL4Addresses.find (socket);
-  if (it == m_SendSocketL4Addresses.end ())
-  {
-    //entry doesn't exist, so make one
-    m_SendSocketL4Addresses.insert(std::pair<Ptr<Socket>, InetSocketAddress>(socket, address));
-  }
-  else
-  {
-    // update entry
-    (*it).second = address;
-  }
-  return;
+  if (session->m_reconnectEvent.IsRunning ())
+    return;
+
+  if (session->m_retries >= m_maxReconnectAttempts)
+    {
+      NS_LOG_FUNCTION (this << " Giving up on address: " << session->m_remote << " after " << session->m_retries << " attempts");
+      session->m_retries = 0;
+      ReleaseSessionQueue (session);
+      return;
+    }
+
+  Time delay = m_reconnectBaseDelay;
+  for (uint32_t i = 0; i < session->m_retries && delay < m_reconnectMaxDelay; i++)
+    {
+      delay = delay + delay;
+    }
+  delay = Min (delay, m_reconnectMaxDelay);
+  delay = delay + Seconds (m_reconnectRng->GetValue (0.0, m_reconnectJitter * delay.GetSeconds ()));
+
+  session->m_retries++;
+  NS_LOG_FUNCTION (this << " Reconnecting to address: " << session->m_remote << " in " << delay.GetSeconds () << "s, attempt " << session->m_retries);
+  session->m_reconnectEvent = Simulator::Schedule (delay, &BpTcpClaProtocol::RetrySocketConn, this, session);
 }
 
 void
-BpTcpClaProtocol::RetrySocketConn (Ptr<Packet> packet)
+BpTcpClaProtocol::ReleaseSessionQueue (Ptr<BpTcpClaSession> session)
 {
-  NS_LOG_FUNCTION (this << " " << packet);
-  // redo the SendPacket without interacting with BpSendStore
+  NS_LOG_FUNCTION (this << " " << session->m_remote << " " << session->m_txQueue.size ());
 
-  Ptr<Socket> socket = GetL4Socket (packet);
-  if (socket == NULL)
-  {
-    NS_LOG_FUNCTION (this << " Unable to create new socket for packet: " << packet);
-    return;
-  }
+  session->m_flushEvent.Cancel ();
+  while (!session->m_txQueue.empty ())
+    {
+      Ptr<Packet> packet = session->m_txQueue.front ();
+      session->m_txQueue.pop_front ();
+      session->m_txQueueBytes -= packet->GetSize ();
+      m_txQueuedBytes -= packet->GetSize ();
+      m_bp->RestoreBundle (packet);
+    }
 }
 
 int
 BpTcpClaProtocol::SendPacket (Ptr<Packet> packet)
 { 
   NS_LOG_FUNCTION (this << " " << packet);
-  Ptr<Socket> socket = GetL4Socket (packet);
-
-  if ( socket == NULL)
-    return -1;
-
   // retreive bundles from queue in BundleProtocol
   BpHeader bph;
   packet->PeekHeader (bph);
   BpEndpointId src = bph.GetSourceEid ();
   BpEndpointId dst = bph.GetDestinationEid ();
+
+  InetSocketAddress address = GetNextHopAddress (dst);
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (address == defaultAddr)
+    return -1;
+
+  if (m_contacts)
+    {
+      BpEndpointId nextHop = m_bpRouting->GetRoute (dst);
+      if (!m_contacts->Admit (nextHop, packet->GetSize ()))
+        {
+          // no connection is attempted out of contact
+          Ptr<Packet> pkt = m_bp->GetBundle (src);
+          if (!pkt)
+            return -1;
+          NS_LOG_DEBUG ("Holding bundle from " << src.Uri () << " until the next contact with " << nextHop.Uri ());
+          m_contacts->Hold (nextHop, pkt);
+          return 0;
+        }
+    }
+
+  Ptr<BpTcpClaSession> session = GetSession (address, dst);
+  if (session->m_socket == NULL && OpenSession (session) < 0)
+    return -1;
+
   Ptr<Packet> pkt = m_bp->GetBundle (src);  // this is retrieved again here in order to pop the packet from the SendBundleStore!
  
   if (pkt)
     {
-      if (GetL4SocketStatus (socket) == 0)
-      {
-        // tcp session g2g, send immediately
-        NS_LOG_FUNCTION (this << " Sending packet sent from eid: " << src.Uri () << " to eid: " << dst.Uri () << " immediately");
-        if (socket->Send (pkt) < 0)
-        {
-          // socket error sending packet
-          NS_LOG_FUNCTION (this << " Socket error sending packet");
-          return 1;
-        }
-        return 0;
-      }
-      else // tcp session not yet ready, store for later sending
-      {
-        InetSocketAddress address = GetSendSocketAddress (socket);
-        // !! TEST FOR BAD ADDRESS
-        
-        NS_LOG_FUNCTION (this << " BpNode " << m_bp << " with eid " << m_bp->GetBpEndpointId ().Uri () << " Placing packet sent from eid: " << src.Uri () << " to eid: " << dst.Uri () << " into queue for later sending with address: " << address);
-        NS_LOG_FUNCTION (this << " checking map at location: " << &SocketAddressSendQueue << "with size of: " << SocketAddressSendQueue.size());
-
-        std::map<InetSocketAddress, std::queue<Ptr<Packet> > >::iterator it = SocketAddressSendQueue.find(address);
-        if ( it == SocketAddressSendQueue.end ())
+      NS_LOG_FUNCTION (this << " Sending packet sent from eid: " << src.Uri () << " to eid: " << dst.Uri () << " with address: " << address);
+      return SendBundle (session, pkt);
+    }
+  NS_LOG_FUNCTION (this << " Unable to get bundle for eid: " << src.Uri ());
+  return -1;
+}
+
+int
+BpTcpClaProtocol::SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << packet << " " << nextHop.Uri ());
+  InetSocketAddress address = getL4Address (nextHop);
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (address == badAddr)
+    {
+      NS_LOG_DEBUG ("BpTcpClaProtocol::SendPacketTo (): no L4 address for next hop " << nextHop.Uri ());
+      return -1;
+    }
+
+  if (m_contacts && !m_contacts->Admit (nextHop, packet->GetSize ()))
+    {
+      m_contacts->Hold (nextHop, packet);
+      return 0;
+    }
+
+  BpHeader bph;
+  packet->PeekHeader (bph);
+  Ptr<BpTcpClaSession> session = GetSession (address, bph.GetDestinationEid ());
+  if (session->m_socket == NULL && OpenSession (session) < 0)
+    return -1;
+
+  return SendBundle (session, packet);
+}
+
+bool
+BpTcpClaProtocol::SendHeldBundle (Ptr<Packet> bundle, const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << bundle << " " << nextHop.Uri ());
+  InetSocketAddress address = getL4Address (nextHop);
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (address == badAddr)
+    return false;
+
+  BpHeader bph;
+  bundle->PeekHeader (bph);
+  Ptr<BpTcpClaSession> session = GetSession (address, bph.GetDestinationEid ());
+  if (session->m_socket == NULL && OpenSession (session) < 0)
+    return false;
+
+  SendBundle (session, bundle);
+  return true;
+}
+
+Ptr<BpContactScheduler>
+BpTcpClaProtocol::GetContactScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_contacts)
+    {
+      m_contacts = CreateObject<BpContactScheduler> ();
+      m_contacts->SetReleaseCallback (MakeCallback (&BpTcpClaProtocol::SendHeldBundle, this));
+      m_contacts->SetContactCallback (MakeCallback (&BpTcpClaProtocol::NotifyContact, this));
+    }
+  return m_contacts;
+}
+
+int
+BpTcpClaProtocol::SendBundle (Ptr<BpTcpClaSession> session, Ptr<Packet> pkt)
+{
+  NS_LOG_FUNCTION (this << " " << pkt);
+  BpHeader bph;
+  pkt->PeekHeader (bph);
+
+  if (m_coalesceBytes == 0
+      && session->m_state == BpTcpClaSession::CONNECTED
+      && session->m_txQueue.empty ()
+      && session->m_socket->GetTxAvailable () >= pkt->GetSize ())
+  {
+    // tcp session g2g and the bundle fits in the send buffer, send immediately
+    NS_LOG_FUNCTION (this << " Sending bundle immediately");
+    if (session->m_socket->Send (pkt) >= 0)
+    {
+      return 0;
+    }
+    // socket error sending packet, keep it for the next attempt
+    NS_LOG_FUNCTION (this << " Socket error sending packet, queueing it");
+  }
+
+  // tcp session or send buffer not yet ready, store for later sending
+  NS_LOG_FUNCTION (this << " BpNode " << m_bp << " with eid " << m_bp->GetBpEndpointId ().Uri () << " Placing bundle into queue for later sending");
+  session->m_txQueue.push_back (pkt);
+  session->m_txQueueBytes += pkt->GetSize ();
+  m_txQueuedBytes += pkt->GetSize ();
+  NS_LOG_FUNCTION (this << " queue now has " << session->m_txQueue.size () << " items, " << session->m_txQueueBytes << " bytes");
+
+  if (session->m_state == BpTcpClaSession::CONNECTED)
+    {
+      if (m_coalesceBytes == 0
+          || session->m_txQueueBytes >= m_coalesceBytes
+          || bph.Priority () == 2
+          || m_coalesceDelay.IsZero ())
         {
-          // this is the first packet being sent to this address
-          std::queue<Ptr<Packet> > qu;
-          qu.push (pkt);
-          SocketAddressSendQueue.insert (std::pair<InetSocketAddress, std::queue<Ptr<Packet> > > (address, qu) );
-          NS_LOG_FUNCTION (this << " built new queue for target address.  Queue address: " << &qu);
+          // the write is full, or an expedited bundle must not wait
+          session->m_flushEvent.Cancel ();
+          m_send (session);
         }
-      else
+      else if (!session->m_flushEvent.IsRunning ())
         {
-          // ongoing packet
-          (*it).second.push (pkt);
-          NS_LOG_FUNCTION (this << " queue now has " << ((*it).second).size () << " items at address: " << &((*it).second));
+          session->m_flushEvent = Simulator::Schedule (m_coalesceDelay, &BpTcpClaProtocol::FlushSession, this, session);
         }
-      }
     }
-  NS_LOG_FUNCTION (this << " Unable to get bundle for eid: " << src.Uri ());
-  return -1;
+
+  return (session->m_txQueueBytes > m_maxQueuedBytes) ? 1 : 0;
 }
 
 int
 BpTcpClaProtocol::EnableReceive (const BpEndpointId &local)
 { 
   NS_LOG_FUNCTION (this << " " << local.Uri ());
-  Ptr<BpStaticRoutingProtocol> route = DynamicCast <BpStaticRoutingProtocol> (m_bpRouting);
   //InetSocketAddress addr = route->GetRoute (local);
-  BpEndpointId next_hop = route->GetRoute (local);
+  BpEndpointId next_hop = m_bpRouting->GetRoute (local);
   InetSocketAddress addr = getL4Address(next_hop);
   InetSocketAddress badAddr ("1.0.0.1", 0);
   if (addr == badAddr)
@@ -278,27 +510,34 @@ BpTcpClaProtocol::EnableReceive (const BpEndpointId &local)
   else
     port = addr.GetPort ();
 
-  InetSocketAddress address (Ipv4Address::GetAny (), port);
-
-  // set tcp socket in listen state
-  Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), TcpSocketFactory::GetTypeId ());
-  if (socket->Bind (address) < 0)
-    return -1;
-  if (socket->Listen () < 0)
+  std::map<BpEndpointId, uint16_t>::iterator it = m_recvRegistrations.find (local);
+  if (it != m_recvRegistrations.end ())
     return -1;
-  if (socket->ShutdownSend () < 0)
-    return -1; 
 
-  SetL4SocketCallbacks (socket);
- 
-  // store the sending socket so that the convergence layer can dispatch the hundles to different tcp connections
-  std::map<BpEndpointId, Ptr<Socket> >::iterator it = m_l4RecvSockets.end ();
-  it = m_l4RecvSockets.find (local);
-  if (it == m_l4RecvSockets.end ())
-    m_l4RecvSockets.insert (std::pair<BpEndpointId, Ptr<Socket> >(local, socket));  
+  // one listening socket per node and port; bundles arriving on it are
+  // demultiplexed to the registrations by their destination endpoint id
+  if (m_listeners.find (port) == m_listeners.end ())
+    {
+      InetSocketAddress address (Ipv4Address::GetAny (), port);
+
+      // set tcp socket in listen state
+      Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), TcpSocketFactory::GetTypeId ());
+      if (socket->Bind (address) < 0)
+        return -1;
+      if (socket->Listen () < 0)
+        return -1;
+      // the send side is left open: accepted sockets inherit it from the listener
+      // and are reused as outbound sessions towards the connecting neighbour
+
+      SetL4SocketCallbacks (socket);
+      m_listeners.insert (std::pair<uint16_t, Ptr<Socket> > (port, socket));
+    }
   else
-    return -1;
+    {
+      NS_LOG_FUNCTION (this << " Sharing listener on port " << port << " with " << local.Uri ());
+    }
 
+  m_recvRegistrations.insert (std::pair<BpEndpointId, uint16_t> (local, port));
 
   return 0;
 }
@@ -307,33 +546,36 @@ int
 BpTcpClaProtocol::DisableReceive (const BpEndpointId &local)
 { 
   NS_LOG_FUNCTION (this << " " << local.Uri ());
-   std::map<BpEndpointId, Ptr<Socket> >::iterator it = m_l4RecvSockets.end ();
-  it = m_l4RecvSockets.find (local);
-  if (it == m_l4RecvSockets.end ())
+  std::map<BpEndpointId, uint16_t>::iterator it = m_recvRegistrations.find (local);
+  if (it == m_recvRegistrations.end ())
     {
       return -1;
     }
-  else
+
+  uint16_t port = (*it).second;
+  m_recvRegistrations.erase (it);
+
+  // keep the listener while other registrations still receive through it
+  for (it = m_recvRegistrations.begin (); it != m_recvRegistrations.end (); ++it)
     {
-      // close the tcp conenction
-      return ((*it).second)->Close ();
+      if ((*it).second == port)
+        return 0;
     }
 
-  return 0;
+  // close the tcp conenction
+  std::map<uint16_t, Ptr<Socket> >::iterator itListener = m_listeners.find (port);
+  if (itListener == m_listeners.end ())
+    return -1;
+  Ptr<Socket> socket = (*itListener).second;
+  m_listeners.erase (itListener);
+  return socket->Close ();
 }
 
 int 
 BpTcpClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
 { 
   NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri ());
-  if (!m_bpRouting)
-    NS_FATAL_ERROR ("BpTcpClaProtocol::SendPacket (): cannot find bundle routing protocol");
-
-  // TBD: do not use dynamicast here
-  // check route for destination endpoint id
-  Ptr<BpStaticRoutingProtocol> route = DynamicCast <BpStaticRoutingProtocol> (m_bpRouting);
-  BpEndpointId next_hop = route->GetRoute (dst);
-  InetSocketAddress address = getL4Address(next_hop);
+  InetSocketAddress address = GetNextHopAddress (dst);
 
   InetSocketAddress defaultAddr ("127.0.0.1", 0);
   if (address == defaultAddr)
@@ -342,6 +584,21 @@ BpTcpClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
       return -1;
     }
 
+  Ptr<BpTcpClaSession> session = GetSession (address, dst);
+  if (session->m_socket != NULL)
+    {
+      // one connection per neighbour
+      return 0;
+    }
+
+  return OpenSession (session);
+}
+
+int
+BpTcpClaProtocol::OpenSession (Ptr<BpTcpClaSession> session)
+{
+  NS_LOG_FUNCTION (this << " " << session->m_remote);
+
   // start a tcp connection
   Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), TcpSocketFactory::GetTypeId ());
   if (socket->Bind () < 0)
@@ -349,32 +606,20 @@ BpTcpClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
     NS_LOG_FUNCTION (this << " " << "Unable to create socket, cannot bind");
     return -1;
   }
-  if (socket->Connect (address) < 0)
+  if (socket->Connect (session->m_remote) < 0)
   {
     NS_LOG_FUNCTION (this << " " << "Unable to create socket, cannot connect to address ");
     return -1;
   }
-  NS_LOG_FUNCTION (this << " Requesting connection to address: " << address);
-  if (socket->ShutdownRecv () < 0)
-  {
-    NS_LOG_FUNCTION (this << " " << "Unable to create socket, received shutdown");
-    return -1;
-  }
+  NS_LOG_FUNCTION (this << " Requesting connection to address: " << session->m_remote);
+  // the receive side is left open so that the neighbour can send bundles back on this session
 
   SetL4SocketCallbacks (socket);
 
   // store the sending socket so that the convergence layer can dispatch the bundles to different tcp connections
-  std::map<BpEndpointId, Ptr<Socket> >::iterator it = m_l4SendSockets.find (src);
-  if (it == m_l4SendSockets.end ())
-    m_l4SendSockets.insert (std::pair<BpEndpointId, Ptr<Socket> >(src, socket));  
-  else
-    return -1;
-
-  // store initial state of sending socket
-  SetL4SocketStatus(socket, 1);
-
-  // store the remote address this socket is connecting to
-  SetSendSocketAddress(socket, address);
+  session->m_socket = socket;
+  session->m_state = BpTcpClaSession::CONNECTING;
+  m_socketSessions[socket] = session;
 
   return 0;
 }
@@ -410,80 +655,93 @@ BpTcpClaProtocol::ConnectionSucceeded (Ptr<Socket> socket)
 { 
   NS_LOG_FUNCTION (this << " " << socket << " BpNode " << m_bp << " eid " << m_bp->GetBpEndpointId ().Uri ());
 
-  SetL4SocketStatus(socket, 0);
+  Ptr<BpTcpClaSession> session = GetSession (socket);
+  if (session == NULL)
+    return;
 
-  InetSocketAddress address = GetSendSocketAddress(socket);
-  // !! TEST IF GIVEN BAD ADDRESS
+  bool up = IsPeerConnected (session->m_remote);
+  session->m_state = BpTcpClaSession::CONNECTED;
+  session->m_txBufferSize = socket->GetTxAvailable ();
+  session->m_retries = 0;
+  session->m_reconnectEvent.Cancel ();
 
-  if (!SocketAddressSendQueueEmpty (address))
+  if (!session->m_txQueue.empty ())
   {
     // still have packets to send to this address
-    NS_LOG_FUNCTION (this << " sending packet to address" << address);
-    m_send(socket); // send any waiting packets
+    NS_LOG_FUNCTION (this << " sending packet to address" << session->m_remote);
+    m_send (session); // send any waiting packets
   }
+  if (!up)
+    NotifyPeer (session->m_remote, true);
 } 
 
 void 
 BpTcpClaProtocol::ConnectionFailed (Ptr<Socket> socket)
 { 
   NS_LOG_FUNCTION (this << " " << socket);
-  SetL4SocketStatus(socket, 2);
-
-  InetSocketAddress address = GetSendSocketAddress(socket);
-  // !! TEST IF GIVEN BAD ADDRESS
-  
-  NS_LOG_FUNCTION(this << " was intended for address: " << address);
-  std::map<InetSocketAddress, std::queue<Ptr<Packet> > >::iterator it = SocketAddressSendQueue.find (address); 
-  if ( it == SocketAddressSendQueue.end ())
-  {
-    NS_LOG_FUNCTION (this << " Did not find packet in SocketAddressSendQueue for address: " << address);
+  Ptr<BpTcpClaSession> session = GetSession (socket);
+  if (session == NULL)
     return;
-  }
 
-  if ( ((*it).second).size () == 0)
+  session->m_state = BpTcpClaSession::CONNECTION_FAILED;
+  NS_LOG_FUNCTION(this << " was intended for address: " << session->m_remote);
+
+  // socket is already being closed by ns-3; errors-out if attempt to manually close
+  RemoveL4Socket (socket);
+
+  if (session->m_txQueue.empty ())
   {
-    NS_LOG_FUNCTION (this << " Found queue in SocketAddressSendQueue for address: " << address << " but is empty");
+    NS_LOG_FUNCTION (this << " No packets queued for address: " << session->m_remote);
     return;
   }
-  Ptr<Packet> packet = ((*it).second).front ();
-  // retrieved packet from socket send queue, now ok to remove records of socket and close
-  NS_LOG_FUNCTION (this << " packets remaining to send, clearing out old socket and attempting resend");
-  if (!RemoveL4Socket (socket))
-  {
-    NS_LOG_FUNCTION (this << " unable to remove socket from records");
-  }
 
-  //socket->Close(); // Socket already being closed by ns-3; errors-out if attempt to manually close
-  
-  // socket records removed, now try to resend
-  //ResendPacket(packet);
-  RetrySocketConn (packet);
+  // session records kept, now try to resend
+  NS_LOG_FUNCTION (this << " packets remaining to send, clearing out old socket and attempting resend");
+  ScheduleReconnect (session);
 }
 
 void 
 BpTcpClaProtocol::NormalClose (Ptr<Socket> socket)
 { 
   NS_LOG_FUNCTION (this << " " << socket);
-  SetL4SocketStatus(socket, 3);
+  m_rxBuffers.erase (socket);
+  Ptr<BpTcpClaSession> session = GetSession (socket);
+  if (session == NULL)
+    return;
+
+  // the neighbour may have closed a session we were also sending on
+  bool up = IsPeerConnected (session->m_remote);
+  session->m_state = BpTcpClaSession::CLOSED;
+  RemoveL4Socket (socket);
+  if (up && !IsPeerConnected (session->m_remote))
+    NotifyPeer (session->m_remote, false);
+  if (!session->m_txQueue.empty ())
+    ScheduleReconnect (session);
 }
 
 void 
 BpTcpClaProtocol::ErrorClose (Ptr<Socket> socket)
 { 
   NS_LOG_FUNCTION (this << " " << socket);
-  SetL4SocketStatus(socket, 4);
+  m_rxBuffers.erase (socket);
+  Ptr<BpTcpClaSession> session = GetSession (socket);
+  if (session == NULL)
+    return;
 
-  InetSocketAddress address = GetSendSocketAddress (socket);
-  // !! TEST FOR BAD ADDRESS
-  if (!SocketAddressSendQueueEmpty (address))
-  {
-    // still have packets to send to this address
-    NS_LOG_FUNCTION (this << " still have remaining packets to send to address" << address);
-  }
+  bool up = IsPeerConnected (session->m_remote);
+  session->m_state = BpTcpClaSession::CLOSED_BY_ERROR;
   if (!RemoveL4Socket (socket))
   {
     NS_LOG_FUNCTION (this << " unable to remove socket from records");
   }
+  if (up && !IsPeerConnected (session->m_remote))
+    NotifyPeer (session->m_remote, false);
+  if (!session->m_txQueue.empty ())
+  {
+    // still have packets to send to this address
+    NS_LOG_FUNCTION (this << " still have remaining packets to send to address" << session->m_remote);
+    ScheduleReconnect (session);
+  }
 }
 
 bool
@@ -498,12 +756,116 @@ BpTcpClaProtocol::NewConnectionCreated (Ptr<Socket> socket, const Address &addre
 { 
   NS_LOG_FUNCTION (this << " " << socket << " " << address << " BpNode " << m_bp << " eid " << m_bp->GetBpEndpointId ().Uri ());
   SetL4SocketCallbacks (socket);  // reset the callbacks due to fork in TcpSocketBase
+
+  // register the accepted socket as the outbound session towards the neighbour,
+  // unless a connection towards it already exists
+  if (!InetSocketAddress::IsMatchingType (address))
+    return;
+  InetSocketAddress from = InetSocketAddress::ConvertFrom (address);
+  InetSocketAddress peer = from;
+  if (!GetPeerAddress (from.GetIpv4 (), peer))
+    {
+      NS_LOG_FUNCTION (this << " No single neighbour registered at " << from.GetIpv4 () << "; accepted socket only receives");
+      return;
+    }
+  std::vector<Ptr<BpTcpClaSession> > &sessions = GetPeerSessions (peer);
+  Ptr<BpTcpClaSession> session = NULL;
+  for (uint32_t i = 0; i < sessions.size (); i++)
+    {
+      if (sessions[i]->m_socket == NULL)
+        {
+          session = sessions[i];
+          break;
+        }
+    }
+  if (session == NULL)
+    {
+      NS_LOG_FUNCTION (this << " All sessions to " << sessions[0]->m_remote << " already have a socket; accepted socket only receives");
+      return;
+    }
+
+  NS_LOG_FUNCTION (this << " Reusing accepted socket as session to " << session->m_remote);
+  bool up = IsPeerConnected (session->m_remote);
+  session->m_socket = socket;
+  session->m_state = BpTcpClaSession::CONNECTED;
+  session->m_txBufferSize = socket->GetTxAvailable ();
+  session->m_retries = 0;
+  session->m_reconnectEvent.Cancel ();
+  m_socketSessions[socket] = session;
+
+  if (!session->m_txQueue.empty ())
+    m_send (session);
+  if (!up)
+    NotifyPeer (session->m_remote, true);
+}
+
+bool
+BpTcpClaProtocol::IsPeerConnected (const InetSocketAddress &address)
+{
+  NS_LOG_FUNCTION (this << " " << address);
+  std::vector<Ptr<BpTcpClaSession> > &sessions = GetPeerSessions (address);
+  for (uint32_t i = 0; i < sessions.size (); i++)
+    {
+      if (sessions[i]->m_socket != NULL && sessions[i]->m_state == BpTcpClaSession::CONNECTED)
+        return true;
+    }
+  return false;
+}
+
+void
+BpTcpClaProtocol::NotifyPeer (const InetSocketAddress &address, bool up)
+{
+  NS_LOG_FUNCTION (this << " " << address << " " << up);
+  for (std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.begin (); it != m_l4Addresses.end (); ++it)
+    {
+      if (!((*it).second == address) || (*it).first == m_bp->GetBpEndpointId ())
+        continue;
+      // the contacts of a scheduled neighbour tell when it is up
+      if (m_contacts && m_contacts->IsScheduled ((*it).first))
+        continue;
+
+      if (up)
+        m_bp->NotifyNeighbourUp ((*it).first);
+      else
+        m_bp->NotifyNeighbourDown ((*it).first);
+    }
+}
+
+void
+BpTcpClaProtocol::NotifyContact (const BpEndpointId &neighbour, bool open)
+{
+  NS_LOG_FUNCTION (this << " " << neighbour.Uri () << " " << open);
+  if (open)
+    m_bp->NotifyNeighbourUp (neighbour);
+  else
+    m_bp->NotifyNeighbourDown (neighbour);
+}
+
+bool
+BpTcpClaProtocol::GetPeerAddress (const Ipv4Address &ip, InetSocketAddress &address)
+{
+  NS_LOG_FUNCTION (this << " " << ip);
+  // endpoint ids registered at the same L4 address share its sessions;
+  // two L4 addresses on the IP address cannot be told apart
+  bool found = false;
+  for (std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.begin (); it != m_l4Addresses.end (); ++it)
+    {
+      if (!((*it).second.GetIpv4 () == ip))
+        continue;
+      if (found && !((*it).second == address))
+        return false;
+      address = (*it).second;
+      found = true;
+    }
+
+  return found;
 }
 
 void 
 BpTcpClaProtocol::DataSent (Ptr<Socket> socket, uint32_t size)
 { 
   NS_LOG_FUNCTION (this << " " << socket << " " << size);
+  ResumeSession (socket);
 }
 
 void 
@@ -511,6 +873,27 @@ BpTcpClaProtocol::Sent (Ptr<Socket> socket, uint32_t size)
 { 
   BpEndpointId eid = m_bp->GetBpEndpointId ();
   NS_LOG_FUNCTION (this << " Socket:" << socket << " Size:" << size << " From node uri: " << eid.Uri ());
+  ResumeSession (socket);
+}
+
+void
+BpTcpClaProtocol::ResumeSession (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  Ptr<BpTcpClaSession> session = GetSession (socket);
+  if (session == NULL || session->m_state != BpTcpClaSession::CONNECTED)
+    return;
+
+  m_send (session);
+  if (m_contacts && m_contacts->GetHeldBytes () > 0)
+    {
+      // bundles held because the session could not take them may go now
+      for (std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.begin (); it != m_l4Addresses.end (); ++it)
+        {
+          if ((*it).second == session->m_remote)
+            m_contacts->Retry ((*it).first);
+        }
+    }
 }
 
 
@@ -520,10 +903,55 @@ BpTcpClaProtocol::DataRecv (Ptr<Socket> socket)
   NS_LOG_FUNCTION (this << " " << socket);
   Ptr<Packet> packet;
   Address from;
+
+  // each session is a separate byte stream, so bundles are reassembled per socket
+  std::map<Ptr<Socket>, Ptr<Packet> >::iterator it = m_rxBuffers.find (socket);
+  if (it == m_rxBuffers.end ())
+    it = m_rxBuffers.insert (std::pair<Ptr<Socket>, Ptr<Packet> > (socket, Create<Packet> (0))).first;
+  Ptr<Packet> buffer = (*it).second;
+
   while ((packet = socket->RecvFrom (from)))
    {
-     m_bp->ReceivePacket (packet);
+     buffer->AddAtEnd (packet);
    }
+
+  uint32_t size;
+  while ((size = GetBundleSize (buffer)) > 0)
+    {
+      Ptr<Packet> bundle = buffer->CreateFragment (0, size);
+      buffer->RemoveAtStart (size);
+      m_bp->ReceiveBundle (bundle);
+    }
+}
+
+uint32_t
+BpTcpClaProtocol::GetBundleSize (Ptr<Packet> buffer)
+{
+  NS_LOG_FUNCTION (buffer);
+  uint32_t size = buffer->GetSize ();
+  if (size == 0)
+    return 0;
+
+  // the headers are read from a copy of the start of the stream only,
+  // grown when a long dictionary does not fit in it
+  uint32_t prefix = std::min<uint32_t> (size, 256);
+  while (true)
+    {
+      std::vector<uint8_t> data (prefix);
+      buffer->CopyData (&data[0], prefix);
+
+      uint32_t bpSize = BpHeader::PeekSerializedSize (data);
+      uint32_t blockLength = 0;
+      uint32_t bppSize = bpSize ? BpPayloadHeader::PeekSerializedSize (data, bpSize, blockLength) : 0;
+      if (bppSize)
+        {
+          uint64_t total = (uint64_t) bpSize + bppSize + blockLength;
+          return (total > size) ? 0 : (uint32_t) total;
+        }
+      if (prefix == size)
+        return 0;
+      prefix = std::min<uint32_t> (size, 2 * prefix);
+    }
 }
 
 int
@@ -536,6 +964,9 @@ BpTcpClaProtocol::setL4Address (BpEndpointId eid, InetSocketAddress l4Address)
     m_l4Addresses.insert (std::pair<BpEndpointId, InetSocketAddress>(eid, l4Address));  
   else
     return -1;
+
+  // a next hop which had no address may have one now
+  m_routeCache.Clear ();
   
   return 0;
 }
@@ -555,39 +986,6 @@ BpTcpClaProtocol::getL4Address (BpEndpointId eid)
     return ((*it).second); 
 }
 
-void 
-BpTcpClaProtocol::SetL4SocketStatus (Ptr<Socket> socket, u_int16_t status)
-{
-  NS_LOG_FUNCTION (this << " " << socket << " " << status);
-
-  std::map<Ptr<Socket>, u_int16_t>::iterator it = m_l4SocketStatus.find (socket);
-  if (it == m_l4SocketStatus.end ())
-  {
-    m_l4SocketStatus.insert(std::pair<Ptr<Socket>, u_int16_t>(socket, status));
-  }
-  else
-  {
-    (*it).second = status;
-  }
-  return;
-}
-
-u_int16_t
-BpTcpClaProtocol::GetL4SocketStatus (Ptr<Socket> socket)
-{
-  NS_LOG_FUNCTION (this << " " << socket);
-
-  std::map<Ptr<Socket>, u_int16_t>::iterator it = m_l4SocketStatus.find (socket);
-  if (it == m_l4SocketStatus.end ())
-  {
-    return 5;
-  }
-  else
-  {
-    return ((*it).second);
-  }
-}
-
 void
 BpTcpClaProtocol::SetRoutingProtocol (Ptr<BpRoutingProtocol> route)
 { 
@@ -603,61 +1001,125 @@ BpTcpClaProtocol::GetRoutingProtocol ()
 }
 
 void
-BpTcpClaProtocol::m_send (Ptr<Socket> socket)
+BpTcpClaProtocol::m_send (Ptr<BpTcpClaSession> session)
 {
-  NS_LOG_FUNCTION (this << " " << socket);
+  NS_LOG_FUNCTION (this << " " << session->m_remote);
 
-  InetSocketAddress address = GetSendSocketAddress (socket);
-  // !! TEST FOR BAD ADDRESS
+  if (session->m_flushEvent.IsRunning () && session->m_txQueueBytes < m_coalesceBytes)
+  {
+    // still filling a coalesced write; FlushSession () sends it
+    return;
+  }
 
-  while (true)
+  while (!session->m_txQueue.empty ())
   {
-    std::map<InetSocketAddress, std::queue<Ptr<Packet> > >::iterator it = SocketAddressSendQueue.find (address); 
-    if ( it == SocketAddressSendQueue.end ())
+    // take as many consecutive bundles as fit in one write and in the send buffer
+    uint32_t available = session->m_socket->GetTxAvailable ();
+    uint32_t count = 0;
+    uint32_t bytes = 0;
+    while (count < session->m_txQueue.size ())
     {
-      NS_LOG_FUNCTION (this << " Did not find packet in SocketAddressSendQueue for address: " << address);
-      return;
+      uint32_t size = session->m_txQueue[count]->GetSize ();
+      if (bytes + size > available || (count > 0 && bytes + size > m_coalesceBytes))
+        break;
+      bytes += size;
+      count++;
     }
-    else
+    if (count == 0 && session->m_txBufferSize > 0
+        && session->m_txQueue.front ()->GetSize () > session->m_txBufferSize)
     {
-      if ( ((*it).second).size () == 0)
+      // the head bundle never fits in the send buffer, split it into fragments that do
+      Ptr<Packet> bundle = session->m_txQueue.front ();
+      std::vector<Ptr<Packet> > fragments = BundleProtocol::FragmentBundle (bundle, session->m_txBufferSize);
+      session->m_txQueue.pop_front ();
+      session->m_txQueueBytes -= bundle->GetSize ();
+      m_txQueuedBytes -= bundle->GetSize ();
+      if (fragments.empty ())
       {
-        NS_LOG_FUNCTION (this << " Found queue in SocketAddressSendQueue for address: " << address << " but is empty");
-        return;
+        // give it back like a bundle the session could not deliver
+        NS_LOG_FUNCTION (this << " Send buffer of " << session->m_txBufferSize << " bytes is too small for the bundle headers");
+        m_bp->RestoreBundle (bundle);
+        continue;
       }
-      Ptr<Packet> packet = ((*it).second).front ();
-      ((*it).second).pop (); // remove packet from queue
-      NS_LOG_FUNCTION (this << " Sending packet to address: " << address << " immediately");
-      if (socket->Send (packet) < 0)
+      NS_LOG_FUNCTION (this << " Splitting bundle of " << bundle->GetSize () << " bytes into " << fragments.size () << " fragments");
+      for (uint32_t i = fragments.size (); i > 0; i--)
       {
-        // socket error sending packet
-        NS_LOG_FUNCTION (this << " Socket error sending packet");
+        session->m_txQueue.push_front (fragments[i - 1]);
+        session->m_txQueueBytes += fragments[i - 1]->GetSize ();
+        m_txQueuedBytes += fragments[i - 1]->GetSize ();
       }
+      continue;
+    }
+    if (count == 0)
+    {
+      // send buffer full; Sent () resumes once TCP frees some space
+      NS_LOG_FUNCTION (this << " Send buffer full for address: " << session->m_remote << ", " << session->m_txQueue.size () << " packets left in queue");
+      return;
+    }
+
+    // bundles are sent back to back, the receiver splits them by their headers
+    Ptr<Packet> packet = session->m_txQueue.front ();
+    if (count > 1)
+    {
+      packet = packet->Copy ();
+      for (uint32_t i = 1; i < count; i++)
+        packet->AddAtEnd (session->m_txQueue[i]);
     }
+    NS_LOG_FUNCTION (this << " Sending " << count << " bundles, " << bytes << " bytes to address: " << session->m_remote);
+    if (session->m_socket->Send (packet) < 0)
+    {
+      // socket error sending packet, leave the bundles at the head of the queue
+      NS_LOG_FUNCTION (this << " Socket error sending packet");
+      return;
+    }
+    for (uint32_t i = 0; i < count; i++)
+      session->m_txQueue.pop_front (); // remove packet from queue
+    session->m_txQueueBytes -= bytes;
+    m_txQueuedBytes -= bytes;
   }
 }
 
-bool
-BpTcpClaProtocol::SocketAddressSendQueueEmpty (InetSocketAddress address)
+void
+BpTcpClaProtocol::FlushSession (Ptr<BpTcpClaSession> session)
 {
-  NS_LOG_FUNCTION (this << " " << address << " checking map at location: " << &SocketAddressSendQueue << "with size of: " << SocketAddressSendQueue.size());
+  NS_LOG_FUNCTION (this << " " << session->m_remote << " " << session->m_txQueueBytes);
+  if (session->m_socket != NULL && session->m_state == BpTcpClaSession::CONNECTED)
+    m_send (session);
+}
 
-  std::map<InetSocketAddress, std::queue<Ptr<Packet> > >::iterator it = SocketAddressSendQueue.find (address); 
-  if ( it == SocketAddressSendQueue.end ())
-  {
-    NS_LOG_FUNCTION (this << " Did not find packet in SocketAddressSendQueue for address: " << address);
-    return true;
-  }
-  else
-  {
-    if ( ((*it).second).size () == 0)
+uint32_t
+BpTcpClaProtocol::GetTxQueuedBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_txQueuedBytes;
+}
+
+void
+BpTcpClaProtocol::ReleaseQueuedBundles (const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << nextHop.Uri ());
+  if (m_contacts)
     {
-      NS_LOG_FUNCTION (this << " Found queue in SocketAddressSendQueue for address: " << address << " but is empty");
-      return true;
+      std::vector<Ptr<Packet> > held;
+      m_contacts->Drain (nextHop, held);
+      for (std::vector<Ptr<Packet> >::iterator it = held.begin (); it != held.end (); ++it)
+        {
+          m_bp->RestoreBundle (*it);
+        }
+    }
+
+  std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.find (nextHop);
+  if (it == m_l4Addresses.end ())
+    return;
+
+  std::map<InetSocketAddress, std::vector<Ptr<BpTcpClaSession> > >::iterator itSessions = m_sessions.find ((*it).second);
+  if (itSessions == m_sessions.end ())
+    return;
+
+  for (std::vector<Ptr<BpTcpClaSession> >::iterator itSession = (*itSessions).second.begin (); itSession != (*itSessions).second.end (); ++itSession)
+    {
+      ReleaseSessionQueue (*itSession);
     }
-    NS_LOG_FUNCTION (this << " Found queue in SocketAddressSendQueue for address: " << address << " with this number of packets: " << ((*it).second).size () << " at address: " << &((*it).second));
-    return false;
-  }
 }
 
 } // namespace ns3
@@ -22,14 +22,21 @@
 #define BP_TCP_CLA_PROTOCOL_H
 
 #include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
 #include "ns3/object-factory.h"
 #include "bp-cla-protocol.h"
 #include "bp-endpoint-id.h"
 #include "ns3/socket.h"
 #include "ns3/packet.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
 #include "bundle-protocol.h"
 #include "bp-routing-protocol.h"
+#include "bp-contact-scheduler.h"
 #include <map>
+#include <deque>
+#include <vector>
 
 namespace ns3 {
 
@@ -37,6 +44,51 @@ class Node;
 //class Socket;
 //class BpSocket;
 
+/**
+ * \brief A TCP session towards one next-hop bundle node
+ *
+ * A session keeps the socket, its connection state, the L4 address of the
+ * neighbour and the bundles waiting for the connection together, so that
+ * sending a bundle needs a single lookup by next-hop address. The socket
+ * is either opened by this node or accepted from the neighbour, and 
+ * carries bundles in both directions.
+ */
+class BpTcpClaSession : public SimpleRefCount<BpTcpClaSession>
+{
+public:
+  /**
+   * connection state of the session socket: ok to send _only_ when CONNECTED
+   */
+  typedef enum {
+    CONNECTED = 0,        /// New connection created, ok to send
+    CONNECTING = 1,       /// Connection request sent, waiting for response
+    CONNECTION_FAILED = 2,/// Connection attempt failed, not ok to send
+    CLOSED = 3,           /// Connection closed normally
+    CLOSED_BY_ERROR = 4,  /// Connection closed by error
+    NO_STATUS = 5         /// No socket opened yet
+  } State;
+
+  BpTcpClaSession (const InetSocketAddress &remote)
+    : m_socket (0),
+      m_state (NO_STATUS),
+      m_remote (remote),
+      m_txQueueBytes (0),
+      m_txBufferSize (0),
+      m_retries (0)
+    {
+    }
+
+  Ptr<Socket> m_socket;                 /// the transport layer socket of this session
+  State m_state;                        /// connection state of m_socket
+  InetSocketAddress m_remote;           /// L4 address of the next-hop bundle node
+  std::deque<Ptr<Packet> > m_txQueue;   /// bundles waiting for the TCP session or its send buffer to be ready
+  uint32_t m_txQueueBytes;              /// total size of the bundles in m_txQueue
+  uint32_t m_txBufferSize;              /// free send buffer space of m_socket right after it connected
+  uint32_t m_retries;                   /// reconnect attempts since the last successful connection
+  EventId m_reconnectEvent;             /// pending reconnect attempt
+  EventId m_flushEvent;                 /// pending flush of a partially filled write
+};
+
 class BpTcpClaProtocol : public BpClaProtocol
 {
 public:
@@ -56,13 +108,61 @@ public:
   /**
    * send packet to the transport layer
    *
+   * The bundle is written to the TCP socket only if it fits in the socket
+   * send buffer; otherwise it is kept in the session queue and written
+   * once the socket reports free buffer space.
+   *
    * \param packet packet to sent
+   *
+   * \return -1 if the bundle cannot be sent, 1 if it was queued but the 
+   * session queue exceeds MaxQueuedBytes (backpressure), otherwise 0
    */
   virtual int SendPacket (Ptr<Packet> packet);
 
+  /**
+   * send a bundle to a given next hop, on a session to it
+   *
+   * \param packet the bundle to send
+   * \param nextHop the endpoint id of the neighbour
+   *
+   * \return -1 if the bundle cannot be sent, 1 if it was queued but the
+   * session queue exceeds MaxQueuedBytes (backpressure), otherwise 0
+   */
+  virtual int SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop);
+
+  /**
+   * \return the total size in bytes of the bundles waiting in the session queues
+   */
+  virtual uint32_t GetTxQueuedBytes () const;
+
+  /**
+   * Give the bundles waiting in the session queues to a next hop, or held
+   * until a contact with it, back to the bundle protocol; bundles already
+   * written to the sockets are left to TCP
+   *
+   * \param nextHop the endpoint id of the neighbour
+   */
+  virtual void ReleaseQueuedBundles (const BpEndpointId &nextHop);
+
+  /**
+   * Get the scheduler of the contacts with the neighbours, created on
+   * first use
+   *
+   * Once it exists, a bundle to a neighbour with scheduled contacts is
+   * only handed to a session while a contact is open and has volume left;
+   * otherwise it is held, and no connection is attempted, until the next
+   * contact opens.
+   *
+   * \return the contact scheduler
+   */
+  Ptr<BpContactScheduler> GetContactScheduler ();
+
   /**
    * Set the TCP socket in listen state;
    *
+   * All registrations using the same port share one listening socket, which
+   * is created by the first of them.
+   *
    * \param local the local endpoint id
    */
   virtual int EnableReceive (const BpEndpointId &local);
@@ -70,6 +170,8 @@ public:
   /**
    * Close the TCP connection
    *
+   * The shared listening socket is closed with the last registration using it.
+   *
    * \param local the endpoint id of registration
    */
   virtual int DisableReceive (const BpEndpointId &local);
@@ -88,19 +190,26 @@ public:
   /**
    * \brief Get the transport layer socket
    *
-   * This method finds the socket by the source endpoint id of the bundle. 
-   * If it cannot find, which means that this bundle is the first bundle required
-   * to be transmitted for this source endpoint id, it start a tcp connection with
-   * the destination endpoint id.
+   * This method finds the session to the next hop towards the destination
+   * endpoint id of the bundle. If it cannot find one, which means that this
+   * bundle is the first bundle required to be transmitted to that neighbour,
+   * it starts a tcp connection with the next hop.
    *
    * \param packet the bundle required to be transmitted
    *
-   * \return return NULL if it cannot find a socket for the source endpoing id of 
-   * the bunle. Otherwise, it returns the socket.
+   * \return return NULL if the next hop of the bundle cannot be resolved or 
+   * the connection cannot be started. Otherwise, it returns the socket.
    */
   virtual Ptr<Socket> GetL4Socket (Ptr<Packet> packet);
 
-  
+  /**
+   * Detach the socket from its session; the session and its queued
+   * bundles are kept so that a new connection can pick them up
+   *
+   * \param socket the transport layer socket
+   *
+   * \return true if the socket belonged to a session
+   */
   virtual bool RemoveL4Socket (Ptr<Socket> socket);
 
   /**
@@ -160,16 +269,20 @@ public:
 
   /**
    * \brief new connection created callback
+   *
+   * The accepted socket is registered as the session towards the connecting
+   * neighbour, so that bundles flow in both directions on one connection.
    */
   void NewConnectionCreated (Ptr<Socket>, const Address &);
 
   /**
-   * \brief data sent callback
+   * \brief data sent callback; resumes draining the session queue
    */
   void DataSent (Ptr<Socket>,uint32_t size);
 
   /**
-   * \brief sent callback
+   * \brief sent callback, called when send buffer space becomes available;
+   * resumes draining the session queue
    */
   void Sent (Ptr<Socket>,uint32_t size);
 
@@ -191,33 +304,205 @@ private:
    */
   virtual void SetL4SocketCallbacks (Ptr<Socket> socket);
 
-  virtual void SetL4SocketStatus (Ptr<Socket> socket, u_int16_t status);
-  virtual u_int16_t GetL4SocketStatus (Ptr<Socket> socket);
-  virtual InetSocketAddress GetSendSocketAddress(Ptr<Socket> socket);
-  virtual void SetSendSocketAddress(Ptr<Socket> socket, InetSocketAddress address);
+  /**
+   * Resolve the L4 address of the next hop towards a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   *
+   * \return the L4 address of the next hop; 127.0.0.1:0 if there is no route
+   */
+  virtual InetSocketAddress GetNextHopAddress (const BpEndpointId &dst);
+
+  /**
+   * Write a bundle to a session, or queue it until the session can take it
+   *
+   * \param session the session
+   * \param bundle the bundle
+   *
+   * \return 1 if the session queue exceeds MaxQueuedBytes, otherwise 0
+   */
+  int SendBundle (Ptr<BpTcpClaSession> session, Ptr<Packet> bundle);
+
+  /**
+   * Resume a session once TCP has sent data or freed send buffer space:
+   * drain its queue and retry the bundles the contact scheduler holds for
+   * its peer
+   *
+   * \param socket the socket of the session
+   */
+  void ResumeSession (Ptr<Socket> socket);
+
+  /**
+   * Find the sessions to a next-hop L4 address, creating SessionsPerPeer
+   * of them if needed
+   *
+   * \param address the L4 address of the next hop
+   *
+   * \return the sessions to the next hop
+   */
+  virtual std::vector<Ptr<BpTcpClaSession> > &GetPeerSessions (const InetSocketAddress &address);
+
+  /**
+   * Find the session to a next-hop L4 address carrying the bundles to a
+   * destination
+   *
+   * The destinations are spread across the parallel sessions by the hash
+   * of their endpoint id; all the bundles to one destination go on the same
+   * session, so they arrive in the order they were sent.
+   *
+   * \param address the L4 address of the next hop
+   * \param dst the destination endpoint id of the bundle
+   *
+   * \return the session
+   */
+  virtual Ptr<BpTcpClaSession> GetSession (const InetSocketAddress &address, const BpEndpointId &dst);
+
+  /**
+   * Find the session a socket belongs to
+   *
+   * \param socket the transport layer socket
+   *
+   * \return the session, or NULL if the socket is not an outbound socket
+   */
+  virtual Ptr<BpTcpClaSession> GetSession (Ptr<Socket> socket);
+
+  /**
+   * Find the registered L4 address of a neighbour from the address of a
+   * connection it opened
+   *
+   * The connecting side uses an ephemeral port, so only the IP address
+   * can be matched; several registered L4 addresses on that IP address
+   * are ambiguous.
+   *
+   * \param ip the IP address of the neighbour
+   * \param address set to the registered L4 address with the same IP address
+   *
+   * \return false if no registered L4 address, or more than one, has this
+   * IP address
+   */
+  virtual bool GetPeerAddress (const Ipv4Address &ip, InetSocketAddress &address);
+
+  /**
+   * Start a tcp connection for a session which has no socket yet
+   *
+   * \param session the session
+   *
+   * \return 0 on success, -1 if the socket cannot be bound or connected
+   */
+  virtual int OpenSession (Ptr<BpTcpClaSession> session);
+
+  /**
+   * Send the queued bundles of a session on its socket, as long as they
+   * fit in the socket send buffer
+   *
+   * Consecutive bundles are written together, up to CoalesceBytes per
+   * write. While a flush is pending and less than CoalesceBytes are 
+   * queued, nothing is sent.
+   *
+   * \param session the session
+   */
+  virtual void m_send (Ptr<BpTcpClaSession> session);
 
-  virtual void m_send (Ptr<Socket> socket);
-  virtual bool SocketAddressSendQueueEmpty (InetSocketAddress address);
+  /**
+   * Send the bundles held back for coalescing once CoalesceDelay expired
+   *
+   * \param session the session
+   */
+  virtual void FlushSession (Ptr<BpTcpClaSession> session);
+
+  /**
+   * Open a new connection for a session whose previous socket failed
+   *
+   * \param session the session
+   */
+  virtual void RetrySocketConn (Ptr<BpTcpClaSession> session);
 
-  //virtual void ResendPacket (Ptr<Packet> packet);
+  /**
+   * \brief Schedule a reconnect attempt for a session with queued bundles
+   *
+   * The delay grows as ReconnectBaseDelay * 2^retries, capped by 
+   * ReconnectMaxDelay, plus a random jitter of up to ReconnectJitter of
+   * that delay. After MaxReconnectAttempts failed attempts the queued 
+   * bundles are handed back to the bundle store.
+   *
+   * \param session the session
+   */
+  virtual void ScheduleReconnect (Ptr<BpTcpClaSession> session);
+
+  /**
+   * Send a bundle released by the contact scheduler
+   *
+   * \param bundle the bundle
+   * \param nextHop the endpoint id of the neighbour
+   *
+   * \return false if no session to the neighbour can be opened
+   */
+  bool SendHeldBundle (Ptr<Packet> bundle, const BpEndpointId &nextHop);
+
+  /**
+   * Give the queued bundles of a session back to the bundle protocol
+   *
+   * \param session the session
+   */
+  virtual void ReleaseSessionQueue (Ptr<BpTcpClaSession> session);
+
+  /**
+   * \return true if at least one session to a neighbour is connected
+   */
+  bool IsPeerConnected (const InetSocketAddress &address);
+
+  /**
+   * Tell the bundle protocol that the endpoint ids registered at an L4
+   * address went up or down. A neighbour is up while one of its sessions
+   * is connected, unless it has scheduled contacts: then it is up while a
+   * contact with it is open.
+   *
+   * \param address the L4 address of the neighbour
+   * \param up true if its first session connected, false if its last one closed
+   */
+  void NotifyPeer (const InetSocketAddress &address, bool up);
+
+  /**
+   * Contact callback of the contact scheduler
+   *
+   * \param neighbour the endpoint id of the neighbour
+   * \param open true if a contact with it opened, false if it closed
+   */
+  void NotifyContact (const BpEndpointId &neighbour, bool open);
+
+  /**
+   * Get the size of the first bundle in a receive buffer
+   *
+   * \param buffer the bytes received on one socket
+   *
+   * \return the size of the first bundle, or 0 if it is not complete yet
+   */
+  static uint32_t GetBundleSize (Ptr<Packet> buffer);
 
-  virtual void RetrySocketConn (Ptr<Packet> packet);
+protected:
+  virtual void DoDispose (void);
 
 private:
   Ptr<BundleProtocol> m_bp;                             /// bundle protocol
-  std::map<BpEndpointId, Ptr<Socket> > m_l4SendSockets; /// the transport layer sender sockets
-  std::map<BpEndpointId, Ptr<Socket> > m_l4RecvSockets; /// the transport layer receiver sockets
+  std::map<uint16_t, Ptr<Socket> > m_listeners;        /// the transport layer listening sockets: map (local port, socket)
+  std::map<BpEndpointId, uint16_t> m_recvRegistrations; /// registrations enabled to receive: map (endpoint id, listener port)
   std::map<BpEndpointId, InetSocketAddress> m_l4Addresses; /// the registered node socket addresses
-  std::map<Ptr<Socket>, u_int16_t> m_l4SocketStatus; // the status of registered sockets:  ok to send _only_ when status is 0
-                                                    // 0 - New connection created, ok to send
-                                                    // 1 - Connection request sent, waiting for response
-                                                    // 2 - Connection attempt failed, not ok to send
-                                                    // 3 - Connection closed normally
-                                                    // 4 - Connection closed by error
-                                                    // 5 - No status
-  std::map<Ptr<Socket>, InetSocketAddress> m_SendSocketL4Addresses; // map of destination addresses to corresponding sockets (since you cant query sockets for the remote address they are connected to)
-  std::map<InetSocketAddress, std::queue<Ptr<Packet> > > SocketAddressSendQueue; // storage of packets going to a particular L4 address while waiting for TCP sessions to be built
+  std::map<InetSocketAddress, std::vector<Ptr<BpTcpClaSession> > > m_sessions; /// outbound sessions: map (next-hop L4 address, parallel sessions)
+  std::map<Ptr<Socket>, Ptr<BpTcpClaSession> > m_socketSessions; /// reverse map for socket callbacks: map (socket, session)
+  std::map<Ptr<Socket>, Ptr<Packet> > m_rxBuffers;      /// partially received bundles of each socket
   Ptr<BpRoutingProtocol> m_bpRouting;                   /// bundle routing protocol
+  BpRouteCache<InetSocketAddress> m_routeCache;         /// next hop address of each destination
+  uint32_t m_maxQueuedBytes;                            /// session queue size above which SendPacket reports backpressure
+  uint32_t m_txQueuedBytes;                             /// total size of the bundles queued in all sessions
+  Time m_reconnectBaseDelay;                            /// delay before the first reconnect attempt
+  Time m_reconnectMaxDelay;                             /// upper bound of the reconnect delay
+  double m_reconnectJitter;                             /// maximum jitter, as a fraction of the reconnect delay
+  uint32_t m_maxReconnectAttempts;                      /// reconnect attempts before queued bundles are given back
+  Ptr<UniformRandomVariable> m_reconnectRng;            /// random jitter of reconnect attempts
+  uint32_t m_sessionsPerPeer;                           /// number of parallel sessions to each next hop
+  uint32_t m_coalesceBytes;                             /// byte budget of a coalesced write, 0 disables coalescing
+  Time m_coalesceDelay;                                 /// time a bundle may wait for a coalesced write
+  Ptr<BpContactScheduler> m_contacts;                   /// contact windows of the neighbours, if any
 };
 
 } // namespace ns3
@@ -0,0 +1,421 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/assert.h"
+#include "ns3/node.h"
+#include "ns3/socket.h"
+#include "ns3/socket-factory.h"
+#include "ns3/uinteger.h"
+#include "ns3/ipv4.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/ipv4-routing-protocol.h"
+#include "ns3/net-device.h"
+
+#include "bp-udp-cla-protocol.h"
+#include "bp-cla-protocol.h"
+#include "bundle-protocol.h"
+#include "bp-header.h"
+#include "bp-payload-header.h"
+#include "bp-endpoint-id.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+
+// default port number of dtn bundle udp convergence layer, which is
+// defined in draft-irtf-dtnrg-udp-clayer-00
+#define DTN_BUNDLE_UDP_PORT 4556
+
+// size of the IPv4 and UDP headers in front of a bundle
+#define UDP_IPV4_HEADER_SIZE 28
+
+NS_LOG_COMPONENT_DEFINE ("BpUdpClaProtocol");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BpUdpClaProtocol);
+
+TypeId
+BpUdpClaProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BpUdpClaProtocol")
+    .SetParent<BpClaProtocol> ()
+    .AddConstructor<BpUdpClaProtocol> ()
+    .AddAttribute ("Mtu",
+                   "MTU used for fragmentation when the outgoing interface towards the next hop is unknown",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&BpUdpClaProtocol::m_defaultMtu),
+                   MakeUintegerChecker<uint32_t> (UDP_IPV4_HEADER_SIZE + 1, 65535))
+  ;
+  return tid;
+}
+
+BpUdpClaProtocol::BpUdpClaProtocol ()
+  :m_bp (0),
+   m_socket (0),
+   m_bpRouting (0),
+   m_defaultMtu (1500)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BpUdpClaProtocol::~BpUdpClaProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BpUdpClaProtocol::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_socket = 0;
+  m_listeners.clear ();
+  m_recvRegistrations.clear ();
+  m_bp = 0;
+  m_bpRouting = 0;
+  m_routeCache.Clear ();
+  BpClaProtocol::DoDispose ();
+}
+
+void
+BpUdpClaProtocol::SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol)
+{
+  NS_LOG_FUNCTION (this << " " << bundleProtocol);
+  m_bp = bundleProtocol;
+}
+
+InetSocketAddress
+BpUdpClaProtocol::GetNextHopAddress (const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  if (!m_bpRouting)
+    NS_FATAL_ERROR ("BpUdpClaProtocol::GetNextHopAddress (): cannot find bundle routing protocol");
+
+  // resolved once per destination while the routes do not change
+  uint32_t generation = m_bpRouting->GetRouteGeneration ();
+  InetSocketAddress *cached = m_routeCache.Lookup (dst, generation);
+  if (cached)
+    return *cached;
+
+  // check route for destination endpoint id
+  BpEndpointId next_hop = m_bpRouting->GetRoute (dst);
+  InetSocketAddress address = getL4Address (next_hop);
+
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (address == badAddr)
+    {
+      NS_LOG_DEBUG ("BpUdpClaProtocol::GetNextHopAddress (): no L4 address for next hop " << next_hop.Uri () << " towards " << dst.Uri ());
+      return InetSocketAddress ("127.0.0.1", 0);
+    }
+
+  m_routeCache.Insert (dst, generation, address);
+  return address;
+}
+
+uint32_t
+BpUdpClaProtocol::GetPathMtu (const Ipv4Address &address)
+{
+  NS_LOG_FUNCTION (this << " " << address);
+  Ptr<Ipv4> ipv4 = m_bp->GetNode ()->GetObject<Ipv4> ();
+  if (ipv4 == NULL || ipv4->GetRoutingProtocol () == NULL)
+    return m_defaultMtu;
+
+  Ipv4Header header;
+  header.SetDestination (address);
+  Socket::SocketErrno sockerr;
+  Ptr<Ipv4Route> route = ipv4->GetRoutingProtocol ()->RouteOutput (0, header, 0, sockerr);
+  if (route == NULL || route->GetOutputDevice () == NULL)
+    return m_defaultMtu;
+
+  int32_t interface = ipv4->GetInterfaceForDevice (route->GetOutputDevice ());
+  if (interface < 0)
+    return m_defaultMtu;
+
+  return ipv4->GetMtu (interface);
+}
+
+Ptr<Socket>
+BpUdpClaProtocol::GetL4Socket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (GetNextHopAddress (bph.GetDestinationEid ()) == defaultAddr)
+    return NULL;
+
+  return GetTxSocket ();
+}
+
+Ptr<Socket>
+BpUdpClaProtocol::GetTxSocket ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_socket == NULL)
+    {
+      m_socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+      if (m_socket->Bind () < 0)
+        {
+          m_socket = 0;
+          return NULL;
+        }
+      // replies are not expected on the sending socket
+      m_socket->ShutdownRecv ();
+    }
+
+  return m_socket;
+}
+
+int
+BpUdpClaProtocol::SendPacket (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << " " << packet);
+  BpHeader bph;
+  packet->PeekHeader (bph);
+  BpEndpointId src = bph.GetSourceEid ();
+  BpEndpointId dst = bph.GetDestinationEid ();
+
+  InetSocketAddress address = GetNextHopAddress (dst);
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (address == defaultAddr)
+    return -1;
+
+  Ptr<Socket> socket = GetL4Socket (packet);
+  if (socket == NULL)
+    return -1;
+
+  Ptr<Packet> pkt = m_bp->GetBundle (src);  // this is retrieved again here in order to pop the packet from the SendBundleStore!
+  if (!pkt)
+    {
+      NS_LOG_FUNCTION (this << " Unable to get bundle for eid: " << src.Uri ());
+      return -1;
+    }
+
+  NS_LOG_FUNCTION (this << " Sending bundle from eid: " << src.Uri () << " to eid: " << dst.Uri () << " to " << address);
+  if (SendBundle (pkt, address) < 0)
+    {
+      // keep the whole bundle; fragments already sent are dropped as duplicates
+      m_bp->RestoreBundle (pkt);
+      return -1;
+    }
+
+  return 0;
+}
+
+int
+BpUdpClaProtocol::SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << packet << " " << nextHop.Uri ());
+  InetSocketAddress address = getL4Address (nextHop);
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (address == badAddr)
+    {
+      NS_LOG_DEBUG ("BpUdpClaProtocol::SendPacketTo (): no L4 address for next hop " << nextHop.Uri ());
+      return -1;
+    }
+
+  if (GetTxSocket () == NULL)
+    return -1;
+
+  return SendBundle (packet, address);
+}
+
+int
+BpUdpClaProtocol::SendBundle (Ptr<Packet> bundle, InetSocketAddress address)
+{
+  NS_LOG_FUNCTION (this << " " << bundle << " " << address);
+  uint32_t mtu = GetPathMtu (address.GetIpv4 ());
+  std::vector<Ptr<Packet> > fragments = BundleProtocol::FragmentBundle (bundle, mtu - UDP_IPV4_HEADER_SIZE);
+  if (fragments.empty ())
+    {
+      NS_LOG_FUNCTION (this << " Path MTU " << mtu << " towards " << address << " is too small for the bundle headers");
+      return -1;
+    }
+
+  NS_LOG_FUNCTION (this << " Sending bundle in " << fragments.size () << " datagrams to " << address);
+  for (uint32_t i = 0; i < fragments.size (); i++)
+    {
+      if (m_socket->SendTo (fragments[i], 0, address) < 0)
+        {
+          NS_LOG_FUNCTION (this << " Socket error sending datagram " << i << " of " << fragments.size ());
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+uint32_t
+BpUdpClaProtocol::GetTxQueuedBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  return 0;
+}
+
+int
+BpUdpClaProtocol::EnableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  BpEndpointId next_hop = m_bpRouting->GetRoute (local);
+  InetSocketAddress addr = getL4Address (next_hop);
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  if (addr == badAddr)
+    return -1;
+
+  uint16_t port;
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (addr == defaultAddr)
+    port = DTN_BUNDLE_UDP_PORT;
+  else
+    port = addr.GetPort ();
+
+  std::map<BpEndpointId, uint16_t>::iterator it = m_recvRegistrations.find (local);
+  if (it != m_recvRegistrations.end ())
+    return -1;
+
+  // one socket per node and port; bundles arriving on it are demultiplexed
+  // to the registrations by their destination endpoint id
+  if (m_listeners.find (port) == m_listeners.end ())
+    {
+      InetSocketAddress address (Ipv4Address::GetAny (), port);
+
+      Ptr<Socket> socket = Socket::CreateSocket (m_bp->GetNode (), UdpSocketFactory::GetTypeId ());
+      if (socket->Bind (address) < 0)
+        return -1;
+      socket->SetRecvCallback (MakeCallback (&BpUdpClaProtocol::DataRecv, this));
+      m_listeners.insert (std::pair<uint16_t, Ptr<Socket> > (port, socket));
+    }
+  else
+    {
+      NS_LOG_FUNCTION (this << " Sharing socket on port " << port << " with " << local.Uri ());
+    }
+
+  m_recvRegistrations.insert (std::pair<BpEndpointId, uint16_t> (local, port));
+
+  return 0;
+}
+
+int
+BpUdpClaProtocol::DisableReceive (const BpEndpointId &local)
+{
+  NS_LOG_FUNCTION (this << " " << local.Uri ());
+  std::map<BpEndpointId, uint16_t>::iterator it = m_recvRegistrations.find (local);
+  if (it == m_recvRegistrations.end ())
+    {
+      return -1;
+    }
+
+  uint16_t port = (*it).second;
+  m_recvRegistrations.erase (it);
+
+  // keep the socket while other registrations still receive through it
+  for (it = m_recvRegistrations.begin (); it != m_recvRegistrations.end (); ++it)
+    {
+      if ((*it).second == port)
+        return 0;
+    }
+
+  std::map<uint16_t, Ptr<Socket> >::iterator itListener = m_listeners.find (port);
+  if (itListener == m_listeners.end ())
+    return -1;
+  Ptr<Socket> socket = (*itListener).second;
+  m_listeners.erase (itListener);
+  return socket->Close ();
+}
+
+int
+BpUdpClaProtocol::EnableSend (const BpEndpointId &src, const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << src.Uri () << " " << dst.Uri ());
+  InetSocketAddress address = GetNextHopAddress (dst);
+
+  InetSocketAddress defaultAddr ("127.0.0.1", 0);
+  if (address == defaultAddr)
+    {
+      NS_LOG_DEBUG ("BpUdpClaProtocol::EnableSend (): cannot find route for destination endpoint id " << dst.Uri ());
+      return -1;
+    }
+
+  // udp is connectionless, nothing to set up
+  return 0;
+}
+
+void
+BpUdpClaProtocol::DataRecv (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << " " << socket);
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+   {
+     if (packet->GetSize () == 0)
+       continue;
+     m_bp->ReceiveBundle (packet);
+   }
+}
+
+int
+BpUdpClaProtocol::setL4Address (BpEndpointId eid, InetSocketAddress l4Address)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri() << " " << l4Address.GetIpv4());
+
+  std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.find (eid);
+  if (it == m_l4Addresses.end ())
+    m_l4Addresses.insert (std::pair<BpEndpointId, InetSocketAddress>(eid, l4Address));
+  else
+    return -1;
+
+  // a next hop which had no address may have one now
+  m_routeCache.Clear ();
+
+  return 0;
+}
+
+InetSocketAddress
+BpUdpClaProtocol::getL4Address (BpEndpointId eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri());
+
+  std::map<BpEndpointId, InetSocketAddress>::iterator it = m_l4Addresses.find (eid);
+  if (it == m_l4Addresses.end ())
+  {
+    InetSocketAddress badAddr ("1.0.0.1", 0);
+    return badAddr;
+  }
+  else
+    return ((*it).second);
+}
+
+void
+BpUdpClaProtocol::SetRoutingProtocol (Ptr<BpRoutingProtocol> route)
+{
+  NS_LOG_FUNCTION (this << " " << route);
+  m_bpRouting = route;
+}
+
+Ptr<BpRoutingProtocol>
+BpUdpClaProtocol::GetRoutingProtocol ()
+{
+  NS_LOG_FUNCTION (this);
+  return m_bpRouting;
+}
+
+} // namespace ns3
@@ -0,0 +1,214 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2013 University of New Brunswick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BP_UDP_CLA_PROTOCOL_H
+#define BP_UDP_CLA_PROTOCOL_H
+
+#include "ns3/ptr.h"
+#include "ns3/object-factory.h"
+#include "bp-cla-protocol.h"
+#include "bp-endpoint-id.h"
+#include "ns3/socket.h"
+#include "ns3/packet.h"
+#include "bundle-protocol.h"
+#include "bp-routing-protocol.h"
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup bundleprotocol
+ *
+ * \brief UDP convergence layer adapter
+ *
+ * Each bundle is sent in one UDP datagram, without connection setup. A
+ * bundle larger than the path MTU is split into bundle fragments
+ * (reactive fragmentation, section 5.8 of RFC 5050) which are sent in
+ * separate datagrams and reassembled by the destination bundle node.
+ * UDP gives no delivery guarantee: a lost fragment is recovered only by
+ * retransmission of the whole bundle at the bundle layer, otherwise the
+ * partial bundle is discarded by the receiver when its reassembly times out.
+ */
+class BpUdpClaProtocol : public BpClaProtocol
+{
+public:
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  BpUdpClaProtocol ();
+
+  /**
+   * Destroy
+   */
+  virtual ~BpUdpClaProtocol ();
+
+  /**
+   * send packet to the transport layer
+   *
+   * The bundle is sent at once, fragmented to the path MTU if needed.
+   *
+   * \param packet packet to sent
+   *
+   * \return -1 if the bundle cannot be sent, otherwise 0
+   */
+  virtual int SendPacket (Ptr<Packet> packet);
+
+  /**
+   * send a bundle to a given next hop, fragmented to the path MTU if needed
+   *
+   * \param packet the bundle to send
+   * \param nextHop the endpoint id of the neighbour
+   *
+   * \return -1 if the bundle cannot be sent, otherwise 0
+   */
+  virtual int SendPacketTo (Ptr<Packet> packet, const BpEndpointId &nextHop);
+
+  /**
+   * \return always 0, bundles are never queued in the UDP CLA
+   */
+  virtual uint32_t GetTxQueuedBytes () const;
+
+  /**
+   * Bind a UDP socket to the port of the registration
+   *
+   * All registrations using the same port share one socket.
+   *
+   * \param local the local endpoint id
+   */
+  virtual int EnableReceive (const BpEndpointId &local);
+
+  /**
+   * Close the UDP socket with the last registration using it
+   *
+   * \param local the endpoint id of registration
+   */
+  virtual int DisableReceive (const BpEndpointId &local);
+
+  /**
+   * Enable this bundle node to send bundles at the transport layer
+   *
+   * \param src the source endpoint id
+   * \param dst the destination endpoint id
+   *
+   * \return -1 if there is no route to the destination, otherwise 0
+   */
+  virtual int EnableSend (const BpEndpointId &src, const BpEndpointId &dst);
+
+  /**
+   * \brief Get the transport layer socket
+   *
+   * All bundles are sent on one unconnected UDP socket.
+   *
+   * \param packet the bundle required to be transmitted
+   *
+   * \return NULL if the next hop of the bundle cannot be resolved,
+   * otherwise the socket
+   */
+  virtual Ptr<Socket> GetL4Socket (Ptr<Packet> packet);
+
+  /**
+   * Connect to routing protocol
+   *
+   * \param route routing protocol
+   */
+  void SetRoutingProtocol (Ptr<BpRoutingProtocol> route);
+
+  /**
+   * Get routing protocol
+   *
+   * \return routing protocol
+   */
+  virtual Ptr<BpRoutingProtocol> GetRoutingProtocol ();
+
+  /**
+   * Connect to bundle protocol
+   *
+   * \param bundleProtocol bundle protocol
+   */
+  void SetBundleProtocol (Ptr<BundleProtocol> bundleProtocol);
+
+  /**
+   * \brief data receive callback; every datagram carries one bundle
+   */
+  void DataRecv (Ptr<Socket> socket);
+
+  virtual int setL4Address (BpEndpointId eid, InetSocketAddress l4Address);
+
+  virtual InetSocketAddress getL4Address (BpEndpointId eid);
+
+private:
+
+  /**
+   * Resolve the L4 address of the next hop towards a destination endpoint id
+   *
+   * \param dst the destination endpoint id
+   *
+   * \return the L4 address of the next hop; 127.0.0.1:0 if there is no route
+   */
+  virtual InetSocketAddress GetNextHopAddress (const BpEndpointId &dst);
+
+  /**
+   * Get the socket sending the bundles, created on first use
+   *
+   * \return the socket, NULL if it cannot be bound
+   */
+  Ptr<Socket> GetTxSocket ();
+
+  /**
+   * Send a bundle in one or more datagrams
+   *
+   * \param bundle the bundle
+   * \param address the L4 address of the next hop
+   *
+   * \return -1 if the bundle or one of its fragments cannot be sent,
+   * otherwise 0
+   */
+  int SendBundle (Ptr<Packet> bundle, InetSocketAddress address);
+
+  /**
+   * Get the MTU of the interface used to reach an IPv4 address
+   *
+   * \param address the IPv4 address of the next hop
+   *
+   * \return the MTU of the outgoing interface, or the Mtu attribute if
+   * the node has no route to the address
+   */
+  virtual uint32_t GetPathMtu (const Ipv4Address &address);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  Ptr<BundleProtocol> m_bp;                             /// bundle protocol
+  Ptr<Socket> m_socket;                                 /// unconnected socket all bundles are sent on
+  std::map<uint16_t, Ptr<Socket> > m_listeners;         /// receiving sockets: map (port, socket)
+  std::map<BpEndpointId, uint16_t> m_recvRegistrations; /// registrations enabled to receive: map (endpoint id, port)
+  std::map<BpEndpointId, InetSocketAddress> m_l4Addresses; /// the registered node socket addresses
+  Ptr<BpRoutingProtocol> m_bpRouting;                   /// bundle routing protocol
+  BpRouteCache<InetSocketAddress> m_routeCache;         /// next hop address of each destination
+  uint32_t m_defaultMtu;                                /// MTU used when the outgoing interface is unknown
+};
+
+} // namespace ns3
+
+#endif /* BP_UDP_CLA_PROTOCOL_H */
@@ -23,14 +23,22 @@
 #include "ns3/packet.h"
 #include "ns3/socket.h"
 #include "ns3/uinteger.h"
+#include "ns3/boolean.h"
 #include "ns3/simulator.h"
 #include "ns3/string.h"
 #include "ns3/buffer.h"
 #include "bp-tcp-cla-protocol.h"
+#include "bp-udp-cla-protocol.h"
+#include "bp-ltp-cla-protocol.h"
+#include "bp-netdevice-cla-protocol.h"
 #include "bundle-protocol.h"
 #include "bp-header.h"
 #include "bp-payload-header.h"
+#include "bp-custody-signal-header.h"
+#include "bp-aggregate-custody-signal-header.h"
+#include "bp-status-report-header.h"
 #include <algorithm>
+#include <iterator>
 #include <map>
 #include <ctime>
 
@@ -50,6 +58,58 @@ BundleProtocol::GetTypeId (void)
            UintegerValue (512),
            MakeUintegerAccessor (&BundleProtocol::m_bundleSize),
            MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("BundlePriority", "Priority of the bundles sent by this node: 0 bulk, 1 normal, 2 expedited",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BundleProtocol::m_bundlePriority),
+           MakeUintegerChecker<uint8_t> (0, 2))
+    .AddAttribute ("ReassemblyTimeout", "Time after which a partially received bundle without lifetime is discarded",
+           TimeValue (Seconds (60)),
+           MakeTimeAccessor (&BundleProtocol::m_reassemblyTimeout),
+           MakeTimeChecker ())
+    .AddAttribute ("CustodyTransfer", "Request custody transfer for the bundles sent by this node, and accept custody of the bundles requesting it",
+           BooleanValue (false),
+           MakeBooleanAccessor (&BundleProtocol::m_custodyTransfer),
+           MakeBooleanChecker ())
+    .AddAttribute ("CustodyTimeout", "Time to wait for the next custodian to accept a bundle before sending it again",
+           TimeValue (Seconds (30)),
+           MakeTimeAccessor (&BundleProtocol::m_custodyTimeout),
+           MakeTimeChecker ())
+    .AddAttribute ("AggregateCustodySignals", "Accept custody of the bundles of a custodian in aggregate custody signals instead of one signal per bundle",
+           BooleanValue (false),
+           MakeBooleanAccessor (&BundleProtocol::m_aggregateCustodySignals),
+           MakeBooleanChecker ())
+    .AddAttribute ("AcsBundleCount", "Number of bundles after which an aggregate custody signal is sent to their custodian",
+           UintegerValue (64),
+           MakeUintegerAccessor (&BundleProtocol::m_acsBundleCount),
+           MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+    .AddAttribute ("AcsDelay", "Time after which an aggregate custody signal is sent for the bundles accepted so far; shorter than the CustodyTimeout of the custodians",
+           TimeValue (Seconds (1)),
+           MakeTimeAccessor (&BundleProtocol::m_acsDelay),
+           MakeTimeChecker ())
+    .AddAttribute ("StatusReports", "Status reports requested for the bundles sent by this node, to this node: bitwise or of the BpStatusReportHeader status flags (1 received, 4 forwarded, 8 delivered, 16 deleted)",
+           UintegerValue (0),
+           MakeUintegerAccessor (&BundleProtocol::m_statusReports),
+           MakeUintegerChecker<uint8_t> (0, 0x1f))
+    .AddAttribute ("StatusReportInterval", "Minimum time between two bundles of status reports sent to the same report-to endpoint",
+           TimeValue (Seconds (1)),
+           MakeTimeAccessor (&BundleProtocol::m_reportInterval),
+           MakeTimeChecker ())
+    .AddAttribute ("StatusReportBatch", "Maximum number of status reports sent in one bundle",
+           UintegerValue (32),
+           MakeUintegerAccessor (&BundleProtocol::m_reportBatch),
+           MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+    .AddAttribute ("MaxPendingStatusReports", "Maximum number of status reports waiting to be sent to a report-to endpoint; more are dropped",
+           UintegerValue (1024),
+           MakeUintegerAccessor (&BundleProtocol::m_maxPendingReports),
+           MakeUintegerChecker<uint32_t> (1, 0xffffffff))
+    .AddAttribute ("DuplicateFilterSize", "Maximum number of bundle ids remembered to drop the bundles received again; 0 disables the filter",
+           UintegerValue (65536),
+           MakeUintegerAccessor (&BundleProtocol::m_duplicateFilterSize),
+           MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("DuplicateFilterWindow", "Time a received bundle id is remembered to drop the bundles received again",
+           TimeValue (Seconds (300)),
+           MakeTimeAccessor (&BundleProtocol::m_duplicateFilterWindow),
+           MakeTimeChecker ())
     .AddAttribute ("L4Type", "The type of transport layer protocol",
            StringValue ("Tcp"),
            MakeStringAccessor (&BundleProtocol::m_l4Type),
@@ -69,6 +129,16 @@ BundleProtocol::GetTypeId (void)
 BundleProtocol::BundleProtocol ()
   : m_node (0),
     m_cla (0),
+    m_custodyTransfer (false),
+    m_nextCustodyId (1),
+    m_aggregateCustodySignals (false),
+    m_acsBundleCount (64),
+    m_statusReports (0),
+    m_reportBatch (32),
+    m_maxPendingReports (1024),
+    m_nStatusReports (0),
+    m_duplicateFilterSize (65536),
+    m_nDuplicates (0),
     m_bpRxBufferPacket (Create<Packet> (0)),
     m_seq (0),
     m_eid ("dtn:none"),
@@ -89,18 +159,53 @@ BundleProtocol::Open (Ptr<Node> node)
   NS_LOG_FUNCTION (this << " " << node);
   m_node = node;
 
-  // add the convergence layer protocol
-  if (m_l4Type == "Tcp")
+  // add the default convergence layer protocol
+  m_cla = AddCla (m_l4Type);
+  if (!m_cla)
     {
-      Ptr<BpTcpClaProtocol> cla = CreateObject<BpTcpClaProtocol>();
-      m_cla = cla;
-      m_cla->SetBundleProtocol (this);
+      NS_FATAL_ERROR ("BundleProtocol::Open (): unkonw tranport layer protocol type! " << m_l4Type);   
+    }
+
+}
+
+Ptr<BpClaProtocol>
+BundleProtocol::AddCla (const std::string &l4Type)
+{
+  NS_LOG_FUNCTION (this << " " << l4Type);
+  std::map<std::string, Ptr<BpClaProtocol> >::iterator it = m_clas.find (l4Type);
+  if (it != m_clas.end ())
+    return (*it).second;
+
+  Ptr<BpClaProtocol> cla = NULL;
+  if (l4Type == "Tcp")
+    {
+      cla = CreateObject<BpTcpClaProtocol>();
+    }
+  else if (l4Type == "Udp")
+    {
+      cla = CreateObject<BpUdpClaProtocol>();
+    }
+  else if (l4Type == "Ltp")
+    {
+      cla = CreateObject<BpLtpClaProtocol>();
+    }
+  else if (l4Type == "NetDevice")
+    {
+      cla = CreateObject<BpNetDeviceClaProtocol>();
     }
   else
     {
-      NS_FATAL_ERROR ("BundleProtocol::Open (): unkonw tranport layer protocol type! " << m_l4Type);   
+      NS_LOG_DEBUG ("BundleProtocol::AddCla (): unknown convergence layer type " << l4Type);
+      return NULL;
     }
 
+  cla->SetBundleProtocol (this);
+  // a CLA added after the routing protocol was set shares it
+  if (m_cla && m_cla->GetRoutingProtocol ())
+    cla->SetRoutingProtocol (m_cla->GetRoutingProtocol ());
+  m_clas.insert (std::pair<std::string, Ptr<BpClaProtocol> > (l4Type, cla));
+
+  return cla;
 }
 
 BpEndpointId
@@ -136,15 +241,42 @@ int
 BundleProtocol::ExternalRegister (const BpEndpointId &eid, const double lifetime, const bool state, const InetSocketAddress l4Address)
 {
   NS_LOG_FUNCTION (this << " " << eid.Uri ());
-  BpRegisterInfo info;
-  info.lifetime = lifetime;
-  info.state = state;
-  info.cla = m_cla;
-  int retval = m_cla->setL4Address (eid, l4Address);
+  return ExternalRegister (eid, lifetime, state, l4Address, m_l4Type);
+}
+
+int
+BundleProtocol::ExternalRegister (const BpEndpointId &eid, const double lifetime, const bool state, const InetSocketAddress l4Address, const std::string &l4Type)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri () << " " << l4Type);
+  std::map<std::string, Ptr<BpClaProtocol> >::iterator itCla = m_clas.find (l4Type);
+  if (itCla == m_clas.end ())
+    {
+      return -1;
+    }
+  Ptr<BpClaProtocol> cla = (*itCla).second;
+
+  int retval = cla->setL4Address (eid, l4Address);
   if (retval < 0)
   {
     return -1;
   }
+
+  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.find (eid);
+  if (it != BpRegistration.end ())
+    {
+      // the endpoint id is already known through another CLA; bundles
+      // routed through it now use this one
+      (*it).second.cla = cla;
+      m_claCache.Clear ();
+      if ((*it).second.state)
+        return cla->EnableReceive (eid);
+      return 0;
+    }
+
+  BpRegisterInfo info;
+  info.lifetime = lifetime;
+  info.state = state;
+  info.cla = cla;
   return Register (eid, info);
 }
 
@@ -161,11 +293,13 @@ BundleProtocol::Register (const BpEndpointId &eid, const struct BpRegisterInfo &
       rInfo.state = info.state;
       rInfo.cla = info.cla;
       BpRegistration.insert (std::pair<BpEndpointId, BpRegisterInfo> (eid, rInfo));
+      // the endpoint id may be the next hop of cached destinations
+      m_claCache.Clear ();
 
       if (info.state)
         {
           // enable the transport layer to receive packets
-          return m_cla->EnableReceive (eid);
+          return EnableReceive (eid);
         }
 
       return 0;
@@ -191,7 +325,15 @@ BundleProtocol::Unregister (const BpEndpointId &eid)
     } 
 
   (*it).second.state = false;
-  return m_cla->DisableReceive (eid);
+
+  // succeed if any CLA was receiving for the registration
+  int retval = -1;
+  for (std::map<std::string, Ptr<BpClaProtocol> >::iterator itCla = m_clas.begin (); itCla != m_clas.end (); ++itCla)
+    {
+      if ((*itCla).second->DisableReceive (eid) == 0)
+        retval = 0;
+    }
+  return retval;
 }
 
 int
@@ -209,7 +351,7 @@ BundleProtocol::Bind (const BpEndpointId &eid)
       // set the registeration of this eid to active
       (*it).second.state = true;
 
-      return m_cla->EnableReceive (eid);
+      return EnableReceive (eid);
     }
 }
 
@@ -223,6 +365,48 @@ BundleProtocol::Send_file (std::string file_path, const BpEndpointId &src, const
   return 0;
 }
 
+int
+BundleProtocol::EnableReceive (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  // every CLA receives for the registration; a CLA without an address for
+  // it (e.g. a TCP CLA on a node reached only by UDP) refuses, which is
+  // fine as long as one of them accepts
+  int retval = -1;
+  for (std::map<std::string, Ptr<BpClaProtocol> >::iterator it = m_clas.begin (); it != m_clas.end (); ++it)
+    {
+      if ((*it).second->EnableReceive (eid) == 0)
+        retval = 0;
+    }
+  return retval;
+}
+
+Ptr<BpClaProtocol>
+BundleProtocol::SelectCla (const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  if (m_clas.size () < 2)
+    return m_cla;
+
+  Ptr<BpRoutingProtocol> route = m_cla->GetRoutingProtocol ();
+  if (!route)
+    return m_cla;
+
+  uint32_t generation = route->GetRouteGeneration ();
+  Ptr<BpClaProtocol> *cached = m_claCache.Lookup (dst, generation);
+  if (cached)
+    return *cached;
+
+  // the CLA the next hop was registered with, otherwise the default one
+  Ptr<BpClaProtocol> cla = m_cla;
+  std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.find (route->GetRoute (dst));
+  if (it != BpRegistration.end () && (*it).second.cla)
+    cla = (*it).second.cla;
+
+  m_claCache.Insert (dst, generation, cla);
+  return cla;
+}
+
 /*
 * NOTE:  Send(..) will be replaced by contents of Send_packet(..) once it has been fully vetted.
 * Do not rely on /reference this code for future development - reference Send_packet(..) instead
@@ -247,6 +431,8 @@ BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId
   uint32_t total = p->GetSize ();
   bool fragment =  ( total > m_bundleSize ) ? true : false;
 
+  Ptr<BpClaProtocol> cla = SelectCla (dst);
+
   // a simple fragementation: ensure a bundle is transmittd by one packet at the transport layer
   uint32_t num = 0;
   while ( total > 0 )   
@@ -263,18 +449,27 @@ BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId
       bph.SetSourceEid (src);
 
       bph.SetCreateTimestamp (std::time(NULL));
+      // all fragments of an ADU share its sequence number
       bph.SetSequenceNumber (m_seq);
-      m_seq++;
 
       size = std::min (total, m_bundleSize);
 
       bph.SetBlockLength (size);       
       bph.SetLifeTime (0);
+      bph.SetPriority (m_bundlePriority);
+      if (m_custodyTransfer)
+        {
+          // released from the storage once the next custodian accepts it
+          bph.SetCustTxReq (true);
+          bph.SetCustEid (m_eid);
+          bph.SetCustodyId (m_nextCustodyId++);
+        }
+      RequestStatusReports (bph);
 
       if (fragment)
         {
           bph.SetIsFragment (true);
-          bph.SetFragOffset (p->GetSize () - size);
+          bph.SetFragOffset (p->GetSize () - total);
           bph.SetAduLength (p->GetSize ());
         }
       else
@@ -313,10 +508,10 @@ BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId
           (*it).second.push (packet);
         }
 
-      if (m_cla)
+      if (cla)
         {
-           //m_cla->SendPacket (packet);
-           if (m_cla->SendPacket (packet) == 0)
+           //cla->SendPacket (packet);
+           if (cla->SendPacket (packet) == 0)
            {
              num++;
            }
@@ -332,11 +527,12 @@ BundleProtocol::Send (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId
 
       // force the convergence layer to send the packet
       if (num == 1)
-        if (m_cla->SendPacket (packet) != 0)
+        if (cla->SendPacket (packet) != 0)
         {
           NS_LOG_FUNCTION(this << " " << "CLA unable to send to send bundle");
         }
     }
+  m_seq++;
 
   return 0;
 }
@@ -365,7 +561,15 @@ BundleProtocol::Send_packet (Ptr<Packet> p, const BpEndpointId &src, const BpEnd
   NS_LOG_FUNCTION("Received PDU of size: " << total << "; max bundle size is: " << m_bundleSize << (( total > m_bundleSize ) ? "Fragmenting" : "No Fragmenting"));
 
   // a simple fragementation: ensure a bundle is transmittd by one packet at the transport layer
-  SequenceNumber32 seqNum (0);
+  // all fragments of an ADU share its sequence number, which together with the
+  // creation timestamp identifies the bundle
+  SequenceNumber32 seqNum = m_seq;
+  m_seq++;
+  int retval = 0;
+  Ptr<BpClaProtocol> cla = SelectCla (dst);
+  Ptr<BpRoutingProtocol> route = m_cla ? m_cla->GetRoutingProtocol () : NULL;
+  std::vector<BpEndpointId> groupNextHops;
+  bool group = (route && route->GetGroupRoutes (src, dst, groupNextHops)) || IsGroupMember (dst);
 
   std::time_t timestamp = std::time(NULL);
 
@@ -380,6 +584,7 @@ BundleProtocol::Send_packet (Ptr<Packet> p, const BpEndpointId &src, const BpEnd
       BpHeader bph;
       bph.SetDestinationEid (dst);
       bph.SetSourceEid (src);
+      bph.SetSingletonDest (!group);
 
       bph.SetCreateTimestamp (timestamp);
       bph.SetSequenceNumber (seqNum);
@@ -389,6 +594,14 @@ BundleProtocol::Send_packet (Ptr<Packet> p, const BpEndpointId &src, const BpEnd
 
       bph.SetBlockLength (size);       
       bph.SetLifeTime (0);
+      bph.SetPriority (m_bundlePriority);
+      if (m_custodyTransfer && !group)
+        {
+          bph.SetCustTxReq (true);
+          bph.SetCustEid (m_eid);
+          bph.SetCustodyId (m_nextCustodyId++);
+        }
+      RequestStatusReports (bph);
 
       if (fragment)
         {
@@ -418,6 +631,22 @@ BundleProtocol::Send_packet (Ptr<Packet> p, const BpEndpointId &src, const BpEnd
                                  " dst eid " << bph.GetDestinationEid ().Uri () << 
                                  " pkt size " << packet->GetSize ());
 
+      if (route && route->HandleBundle (packet))
+        {
+          // the routing protocol keeps the bundle and sends its copies
+          total = total - size;
+          offset = offset + size;
+          continue;
+        }
+
+      if (group)
+        {
+          // one copy per branch of the distribution tree, not stored
+          ForwardToGroup (packet, bph);
+          total = total - size;
+          offset = offset + size;
+          continue;
+        }
 
       // store the bundle into persistant sent storage
       std::map<BpEndpointId, std::queue<Ptr<Packet> > >::iterator it = BpSendBundleStore.end ();
@@ -435,10 +664,13 @@ BundleProtocol::Send_packet (Ptr<Packet> p, const BpEndpointId &src, const BpEnd
           (*it).second.push (packet);
         }
 
-      if (m_cla)
+      if (cla)
         {
-           m_cla->SendPacket (packet);                             
-           seqNum++;
+           if (cla->SendPacket (packet) == 1)
+             {
+               // accepted, but the CLA queue is above its limit
+               retval = 1;
+             }
         }
       else
         NS_FATAL_ERROR ("BundleProtocol::Send (): undefined m_cla");
@@ -448,10 +680,10 @@ BundleProtocol::Send_packet (Ptr<Packet> p, const BpEndpointId &src, const BpEnd
 
       // force the convergence layer to send the packet
       //if (num == 1)
-      //  m_cla->SendPacket (packet);                             
+      //  cla->SendPacket (packet);                             
     }
 
-  return 0;
+  return retval;
 }
 
 int
@@ -478,9 +710,11 @@ BundleProtocol::ForwardBundle (Ptr<Packet> bundle)
       (*it).second.push (bundle);
     }
 
-  if (m_cla)
+  Ptr<BpClaProtocol> cla = SelectCla (bpHeader.GetDestinationEid ());
+  if (cla)
     {
-        m_cla->SendPacket (bundle);                             
+        if (cla->SendPacket (bundle) == 1)
+          return 1;
     }
   else
   {
@@ -490,6 +724,119 @@ BundleProtocol::ForwardBundle (Ptr<Packet> bundle)
   return 0;
 }
 
+int
+BundleProtocol::ForwardBundleTo (Ptr<Packet> bundle, const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << bundle << " " << nextHop.Uri ());
+  Ptr<BpClaProtocol> cla = GetNeighbourCla (nextHop);
+  if (!cla)
+    NS_FATAL_ERROR ("BundleProtocol::ForwardBundleTo (): undefined m_cla");
+
+  return cla->SendPacketTo (bundle, nextHop);
+}
+
+bool
+BundleProtocol::ForwardToGroup (Ptr<Packet> bundle, const BpHeader &bpHeader)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpEndpointId dst = bpHeader.GetDestinationEid ();
+  Ptr<BpRoutingProtocol> route = m_cla ? m_cla->GetRoutingProtocol () : NULL;
+  std::vector<BpEndpointId> nextHops;
+  bool known = route && route->GetGroupRoutes (bpHeader.GetSourceEid (), dst, nextHops);
+  if (!known && !IsGroupMember (dst))
+    return false;
+
+  for (std::vector<BpEndpointId>::iterator it = nextHops.begin (); it != nextHops.end (); ++it)
+    {
+      // copies share the payload buffer of the bundle
+      if (ForwardBundleTo (bundle->Copy (), *it) < 0)
+        NS_LOG_DEBUG ("Copy of a bundle to group " << dst.Uri () << " refused towards " << (*it).Uri ());
+    }
+  return true;
+}
+
+int
+BundleProtocol::JoinGroup (const BpEndpointId &group)
+{
+  NS_LOG_FUNCTION (this << " " << group.Uri ());
+  if (BpRegistration.find (group) != BpRegistration.end ())
+    return -1;
+
+  // a passive registration: the bundles come through the endpoint id of the node
+  BpRegisterInfo info;
+  info.lifetime = 0;
+  info.state = false;
+  m_groups.insert (group);
+  return Register (group, info);
+}
+
+int
+BundleProtocol::LeaveGroup (const BpEndpointId &group)
+{
+  NS_LOG_FUNCTION (this << " " << group.Uri ());
+  if (m_groups.erase (group) == 0)
+    return -1;
+
+  BpRegistration.erase (group);
+  BpRecvBundleStore.erase (group);
+  return 0;
+}
+
+bool
+BundleProtocol::IsGroupMember (const BpEndpointId &group) const
+{
+  NS_LOG_FUNCTION (this << " " << group.Uri ());
+  return m_groups.find (group) != m_groups.end ();
+}
+
+int
+BundleProtocol::SendAdminRecord (Ptr<Packet> record, const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << record << " " << dst.Uri ());
+  uint32_t size = record->GetSize ();
+
+  BpPayloadHeader bpph;
+  bpph.SetBlockLength (size);
+
+  BpHeader bph;
+  bph.SetDestinationEid (dst);
+  bph.SetSourceEid (m_eid);
+  bph.SetCreateTimestamp (std::time (NULL));
+  bph.SetSequenceNumber (m_seq);
+  m_seq++;
+  bph.SetIsAdmin (true);
+  bph.SetIsFragment (false);
+  bph.SetPriority (2);
+  bph.SetLifeTime (0);
+  bph.SetBlockLength (size);
+  bph.SetAduLength (size);
+
+  Ptr<Packet> bundle = record->Copy ();
+  bundle->AddHeader (bpph);
+  bundle->AddHeader (bph);
+
+  Ptr<BpRoutingProtocol> route = m_cla ? m_cla->GetRoutingProtocol () : NULL;
+  return ForwardBundleTo (bundle, route ? route->GetRoute (dst) : dst);
+}
+
+void
+BundleProtocol::NotifyNeighbourUp (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  Ptr<BpRoutingProtocol> route = m_cla ? m_cla->GetRoutingProtocol () : NULL;
+  if (route)
+    route->NotifyNeighbourUp (eid);
+}
+
+void
+BundleProtocol::NotifyNeighbourDown (const BpEndpointId &eid)
+{
+  NS_LOG_FUNCTION (this << " " << eid.Uri ());
+  Ptr<BpRoutingProtocol> route = m_cla ? m_cla->GetRoutingProtocol () : NULL;
+  if (route)
+    route->NotifyNeighbourDown (eid);
+}
+
 int
 BundleProtocol::Close (const BpEndpointId &eid)
 {
@@ -589,6 +936,13 @@ BundleProtocol::ReceivePacket (Ptr<Packet> packet)
   // ACS end
 }
 
+void 
+BundleProtocol::ReceiveBundle (Ptr<Packet> bundle)
+{ 
+  NS_LOG_FUNCTION (this << " " << bundle);
+  ProcessBundle (bundle);
+}
+
 void 
 BundleProtocol::ProcessBundle (Ptr<Packet> bundle)
 { 
@@ -609,11 +963,63 @@ BundleProtocol::ProcessBundle (Ptr<Packet> bundle)
                               " dst eid " << bpHeader.GetDestinationEid ().Uri () << 
                               " packet size " << bundle->GetSize ());
 
+  // copies of a bundle coming over several paths, or sent again
+  if (IsDuplicate (bpHeader.GetBundleIdHash ()))
+    {
+      NS_LOG_DEBUG ("Dropping bundle " << bpHeader.GetBundleIdHash () << " received before");
+      m_nDuplicates++;
+      // the custodian missed the custody signal: release it
+      if (m_custodyTransfer && bpHeader.CustTxReq () && !bpHeader.IsAdmin ())
+        SendCustodySignal (bpHeader, false, BpCustodySignalHeader::REDUNDANT_RECEPTION);
+      return;
+    }
+
+  // administrative records to this node are consumed at once
+  if (bpHeader.IsAdmin () && dst == m_eid && !bpHeader.IsFragment ())
+    {
+      ProcessAdminRecord (bundle);
+      return;
+    }
+
+  ReportStatus (bpHeader, BpStatusReportHeader::RECEIVED, BpStatusReportHeader::NO_ADDITIONAL_INFORMATION);
+
+  // a routing protocol replicating bundles keeps and sends them itself
+  Ptr<BpRoutingProtocol> route = m_cla ? m_cla->GetRoutingProtocol () : NULL;
+  if (!bpHeader.IsAdmin () && route && route->HandleBundle (bundle))
+    {
+      NS_LOG_FUNCTION ("Bundle to eid: " << dst.Uri () << " taken by the routing protocol");
+      return;
+    }
+
+  // a bundle to a group goes down the distribution tree, and is delivered
+  // here only if this node is a member
+  bool group = !bpHeader.SingletonDest () && ForwardToGroup (bundle, bpHeader);
+  if (group && !IsGroupMember (dst))
+    return;
+
   // the destination endpoint eid is registered? 
   std::map<BpEndpointId, BpRegisterInfo>::iterator it = BpRegistration.find (dst);
-  if (it == BpRegistration.end ())
+  if (!group && dst != this->m_eid)
+  {
+    // routes computed for the whole topology (BpStaticRoutingHelper) do
+    // not register every destination, so forward whenever there is a route
+    if (!HasRoute (dst))
+    {
+      NS_LOG_FUNCTION ("No route to eid: " << dst.Uri() << ".  Bundle dropped");
+      ReportStatus (bpHeader, BpStatusReportHeader::DELETED, BpStatusReportHeader::NO_KNOWN_ROUTE);
+      return;
+    }
+    NS_LOG_FUNCTION ("Received bundle for eid: " << dst.Uri() << ". Current eid is: " << this->m_eid.Uri() << ". Forwarding bundle");
+    if (!TakeCustody (bundle, bpHeader, true))
+      return;
+    ForwardBundle (bundle);
+    ReportStatus (bpHeader, BpStatusReportHeader::FORWARDED, BpStatusReportHeader::NO_ADDITIONAL_INFORMATION);
+    return;
+  }
+  if (!group && it == BpRegistration.end ())
     {
       NS_LOG_FUNCTION ("Attempting to process bundle for eid: " << dst.Uri() << " which is not registered with current registration.  Dropping");
+      ReportStatus (bpHeader, BpStatusReportHeader::DELETED, BpStatusReportHeader::NO_KNOWN_ROUTE);
       // the destination endpoint id is not registered, drop packet
       return;
     } 
@@ -621,65 +1027,65 @@ BundleProtocol::ProcessBundle (Ptr<Packet> bundle)
     {
       // TBD: the lifetime of the eid is expired?
     }
-  if (dst != this->m_eid)
-  {
-    // destination is registered and not the current node, so forwarding
-    NS_LOG_FUNCTION ("Received bundle for eid: " << dst.Uri() << ". Current eid is: " << this->m_eid.Uri() << ". Forwarding bundle");
-    if (ForwardBundle(bundle) < 0)
-    {
-      NS_LOG_FUNCTION ("Forwarding of bundle to eid: " << dst.Uri() << " failed.  Bundle dropped");
-    }
-    return;
-  }
+  if (!group)
+    TakeCustody (bundle, bpHeader, false);
+
   // check if this is part of a fragment
   if (bpHeader.IsFragment ()){
     // store all needed data from headers before we strip from them from fragments
     time_t CreateTimeStamp = bpHeader.GetCreateTimestamp ();
-    std::string FragName = src.Uri () + "_" + std::to_string(CreateTimeStamp);
+    std::string FragName = src.Uri () + "_" + std::to_string(CreateTimeStamp) + "_" + std::to_string(bpHeader.GetSequenceNumber ().GetValue ());
     u_int32_t AduLength = bpHeader.GetAduLength ();
+    u_int32_t FragOffset = bpHeader.GetFragOffset ();
     
     NS_LOG_FUNCTION (this << "Bundle is part of fragment: timestamp=" << CreateTimeStamp <<
                               "total ADU length: " << AduLength <<
                               "seq=" << bpHeader.GetSequenceNumber ().GetValue () <<
-                              " offset=" << bpHeader.GetFragOffset ()); 
+                              " offset=" << FragOffset); 
     
-    // is this the first fragment of the bundle we've received?
+    // fragments are keyed by their offset in the ADU, since a fragment may be
+    // fragmented again by a CLA on the way (reactive fragmentation)
     std::map<std::string, std::map<u_int32_t, Ptr<Packet> > >::iterator itBpFrag = BpRecvFragMap.find (FragName);
     if (itBpFrag == BpRecvFragMap.end ())
     {
       // this is the first fragment of this bundle received
       NS_LOG_FUNCTION (this << " First fragment for bundle: " << FragName);
       std::map<u_int32_t, Ptr<Packet> > FragMap;
-      FragMap.insert (std::pair<u_int32_t, Ptr<Packet> > (bpHeader.GetSequenceNumber ().GetValue (), bundle));
-      BpRecvFragMap.insert (std::pair<std::string, std::map<u_int32_t, Ptr<Packet> > > (FragName, FragMap));
+      FragMap.insert (std::pair<u_int32_t, Ptr<Packet> > (FragOffset, bundle));
+      itBpFrag = BpRecvFragMap.insert (std::pair<std::string, std::map<u_int32_t, Ptr<Packet> > > (FragName, FragMap)).first;
+
+      // lost fragments are not retransmitted by the CLA; give up on the bundle
+      // once its lifetime, or the reassembly timeout, is over
+      Time timeout = (bpHeader.GetLifeTime () > 0) ? Seconds (bpHeader.GetLifeTime ()) : m_reassemblyTimeout;
+      BpRecvFragTimers[FragName] = Simulator::Schedule (timeout, &BundleProtocol::ExpireFragments, this, FragName);
     }
     else
     {
       // some bundle fragments already received
-      u_int32_t fragSeqNum = bpHeader.GetSequenceNumber ().GetValue ();
-      NS_LOG_FUNCTION (this << " Already have some fragments, adding sequence number: " << fragSeqNum);
-      std::map<u_int32_t, Ptr<Packet> >::iterator itFrag = (*itBpFrag).second.find(fragSeqNum);
+      NS_LOG_FUNCTION (this << " Already have some fragments, adding offset: " << FragOffset);
+      std::map<u_int32_t, Ptr<Packet> >::iterator itFrag = (*itBpFrag).second.find(FragOffset);
       if (itFrag != (*itBpFrag).second.end ())
       {
         NS_LOG_FUNCTION (this << " Bundle fragment already received. Dropping");
         return;
       }
-      (*itBpFrag).second.insert (std::pair<u_int32_t, Ptr<Packet> > (bpHeader.GetSequenceNumber ().GetValue (), bundle));
+      (*itBpFrag).second.insert (std::pair<u_int32_t, Ptr<Packet> > (FragOffset, bundle));
     }
-    // test if bundle is now complete
+    // test if bundle is now complete: the fragments must cover the ADU without gaps
     NS_LOG_FUNCTION (this << " Checking for complete bundle");
-    itBpFrag = BpRecvFragMap.find (FragName); // Retrieving the fragmentation map again in the event of a first fragment received
     u_int32_t CurrentBundleLength = 0;
     
     for (auto& it : (*itBpFrag).second)
     {
       NS_LOG_FUNCTION (this << "inspecting fragment: " << it.second);
+      if (it.first > CurrentBundleLength)
+        break;
       BpHeader fragBpHeader;
       it.second->PeekHeader (fragBpHeader);
-      CurrentBundleLength += fragBpHeader.GetBlockLength ();
+      CurrentBundleLength = std::max (CurrentBundleLength, it.first + fragBpHeader.GetBlockLength ());
       NS_LOG_FUNCTION (this << "CurrentBundleLength: " << CurrentBundleLength);
     }
-    if (CurrentBundleLength != AduLength)
+    if (CurrentBundleLength < AduLength)
     {
       // we do not have the complete bundle. Return and wait for rest of bundle fragments to come in
       NS_LOG_FUNCTION (this << " Have " << CurrentBundleLength << " out of " << AduLength << ". Waiting to receive rest");
@@ -688,27 +1094,51 @@ BundleProtocol::ProcessBundle (Ptr<Packet> bundle)
     // bundle is complete
     NS_LOG_FUNCTION (this << " Have complete bundle of size " << CurrentBundleLength);
     // Get first fragment and start building from there;
-    u_int32_t FragSeqNum = 0;
-    std::map<u_int32_t, Ptr<Packet> >::iterator itFrag = (*itBpFrag).second.find(FragSeqNum);
+    std::map<u_int32_t, Ptr<Packet> >::iterator itFrag = (*itBpFrag).second.begin ();
     bundle = (*itFrag).second;
-    bundle->PeekHeader (bpHeader);
+    bundle->RemoveHeader (bpHeader);
+    bundle->RemoveHeader (bppHeader);
     CurrentBundleLength = bpHeader.GetBlockLength ();
-    FragSeqNum++;
-    for (; CurrentBundleLength < AduLength; FragSeqNum++)
+    for (++itFrag; itFrag != (*itBpFrag).second.end () && CurrentBundleLength < AduLength; ++itFrag)
     {
-      itFrag = (*itBpFrag).second.find(FragSeqNum);
       Ptr<Packet> bundleFragment = (*itFrag).second;
-      bundleFragment->PeekHeader (bpHeader);
-      CurrentBundleLength += bpHeader.GetBlockLength ();
+      BpHeader fragBpHeader;
       // strip fragment headers
-      bundleFragment->RemoveHeader (bpHeader);
+      bundleFragment->RemoveHeader (fragBpHeader);
       bundleFragment->RemoveHeader (bppHeader);
+      u_int32_t FragEnd = (*itFrag).first + fragBpHeader.GetBlockLength ();
+      if (FragEnd <= CurrentBundleLength)
+        continue;
+      // skip the bytes already delivered by an overlapping fragment
+      bundleFragment->RemoveAtStart (CurrentBundleLength - (*itFrag).first);
       bundle->AddAtEnd(bundleFragment);
+      CurrentBundleLength = FragEnd;
     }
+    // the reassembled bundle is a whole bundle again
+    bpHeader.SetIsFragment (false);
+    bpHeader.SetBlockLength (AduLength);
+    bppHeader.SetBlockLength (AduLength);
+    bundle->AddHeader (bppHeader);
+    bundle->AddHeader (bpHeader);
     // Now have reconstructed packet, delete fragment map
     BpRecvFragMap.erase (FragName);
+    std::map<std::string, EventId>::iterator itTimer = BpRecvFragTimers.find (FragName);
+    if (itTimer != BpRecvFragTimers.end ())
+    {
+      (*itTimer).second.Cancel ();
+      BpRecvFragTimers.erase (itTimer);
+    }
   }
 
+  // an administrative bundle which came in fragments
+  if (bpHeader.IsAdmin ())
+    {
+      ProcessAdminRecord (bundle);
+      return;
+    }
+
+  ReportStatus (bpHeader, BpStatusReportHeader::DELIVERED, BpStatusReportHeader::NO_ADDITIONAL_INFORMATION);
+
   // store the bundle into persistant received storage
   std::map<BpEndpointId, std::queue<Ptr<Packet> > >::iterator itMap = BpRecvBundleStore.end ();
   itMap = BpRecvBundleStore.find (dst);
@@ -727,6 +1157,489 @@ BundleProtocol::ProcessBundle (Ptr<Packet> bundle)
 
 }
 
+bool
+BundleProtocol::TakeCustody (Ptr<Packet> bundle, BpHeader &bpHeader, bool forward)
+{
+  NS_LOG_FUNCTION (this << " " << bundle << " " << forward);
+  if (!m_custodyTransfer || !bpHeader.CustTxReq () || bpHeader.IsAdmin ())
+    return true;
+
+  if (forward && m_custodyBundles.find (bpHeader.GetBundleIdHash ()) != m_custodyBundles.end ())
+    {
+      // the custodian missed the signal and sent the bundle again
+      NS_LOG_DEBUG ("Bundle already in custody, from " << bpHeader.GetCustEid ().Uri ());
+      SendCustodySignal (bpHeader, false, BpCustodySignalHeader::REDUNDANT_RECEPTION);
+      return false;
+    }
+
+  SendCustodySignal (bpHeader, true, BpCustodySignalHeader::NO_ADDITIONAL_INFORMATION);
+  if (forward)
+    {
+      bundle->RemoveHeader (bpHeader);
+      bpHeader.SetCustEid (m_eid);
+      bpHeader.SetCustodyId (m_nextCustodyId++);
+      bundle->AddHeader (bpHeader);
+    }
+  return true;
+}
+
+void
+BundleProtocol::KeepCustody (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bpHeader;
+  bundle->PeekHeader (bpHeader);
+  if (!bpHeader.CustTxReq () || bpHeader.IsAdmin () || bpHeader.GetCustEid () != m_eid)
+    return;
+
+  uint64_t id = bpHeader.GetBundleIdHash ();
+  if (m_custodyBundles.find (id) != m_custodyBundles.end ())
+    {
+      // sent again: its timer was restarted when it expired
+      return;
+    }
+
+  // the deadlines are pushed in order, since the timeout is the same for all
+  CustodyBundle &custody = m_custodyBundles[id];
+  custody.bundle = bundle;
+  custody.custodyId = bpHeader.GetCustodyId ();
+  m_custodyIds[custody.custodyId] = id;
+  custody.aduId = BpHeader::GetBundleIdHash (bpHeader.GetSourceEid ().Uri (), bpHeader.GetCreateTimestamp (), bpHeader.GetSequenceNumber ().GetValue (), false, 0);
+  custody.offset = bpHeader.IsFragment () ? bpHeader.GetFragOffset () : 0;
+  custody.length = bpHeader.GetBlockLength ();
+  m_custodyOffsets[std::make_pair (custody.aduId, custody.offset)] = id;
+  custody.deadline = Simulator::Now () + m_custodyTimeout;
+  m_custodyTimers.push_back (std::make_pair (custody.deadline, id));
+  ScheduleCustodyTimer ();
+}
+
+void
+BundleProtocol::SendCustodySignal (const BpHeader &bpHeader, bool succeeded, uint8_t reason)
+{
+  NS_LOG_FUNCTION (this << " " << succeeded << " " << (uint16_t) reason);
+  if (m_aggregateCustodySignals && bpHeader.GetCustodyId () != 0)
+    {
+      AggregateCustodySignal (bpHeader.GetCustEid (), bpHeader.GetCustodyId (), succeeded, reason);
+      return;
+    }
+
+  BpCustodySignalHeader signal;
+  signal.SetStatus (succeeded, reason);
+  if (bpHeader.IsFragment ())
+    signal.SetFragment (bpHeader.GetFragOffset (), bpHeader.GetBlockLength ());
+  signal.SetSignalTime (Simulator::Now ());
+  signal.SetBundleId (bpHeader.GetSourceEid (), bpHeader.GetCreateTimestamp (), bpHeader.GetSequenceNumber ().GetValue ());
+
+  Ptr<Packet> record = Create<Packet> ();
+  record->AddHeader (signal);
+  if (SendAdminRecord (record, bpHeader.GetCustEid ()) < 0)
+    NS_LOG_DEBUG ("Custody signal to " << bpHeader.GetCustEid ().Uri () << " refused by the CLA");
+}
+
+bool
+BundleProtocol::HandleCustodySignal (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  Ptr<Packet> record = bundle->Copy ();
+  BpHeader bpHeader;
+  BpPayloadHeader bppHeader;
+  record->RemoveHeader (bpHeader);
+  record->RemoveHeader (bppHeader);
+  if (BpAggregateCustodySignalHeader::IsAggregateCustodySignal (record))
+    {
+      BpAggregateCustodySignalHeader signal;
+      record->RemoveHeader (signal);
+      if (!signal.IsSucceeded () && signal.GetReason () != BpCustodySignalHeader::REDUNDANT_RECEPTION)
+        return true;
+
+      uint32_t released = 0;
+      const std::vector<std::pair<uint64_t, uint64_t> > &fills = signal.GetFills ();
+      for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator it = fills.begin (); it != fills.end (); ++it)
+        {
+          // only the ids in custody are visited, whatever the length of the
+          // fill; ~first is the largest length that does not wrap around
+          uint64_t end = (*it).first + std::min ((*it).second, ~(*it).first);
+          std::map<uint64_t, uint64_t>::iterator itId = m_custodyIds.lower_bound ((*it).first);
+          while (itId != m_custodyIds.end () && (*itId).first < end)
+            {
+              // ReleaseCustody erases the entry
+              uint64_t id = (*itId).second;
+              ++itId;
+              if (ReleaseCustody (id))
+                released++;
+            }
+        }
+      NS_LOG_DEBUG ("Custody of " << released << " bundles taken by " << bpHeader.GetSourceEid ().Uri ());
+      return true;
+    }
+
+  if (!BpCustodySignalHeader::IsCustodySignal (record))
+    return false;
+
+  BpCustodySignalHeader signal;
+  record->RemoveHeader (signal);
+  // a refusal for another reason leaves the bundle to its retransmission timer
+  if (signal.IsSucceeded () || signal.GetReason () == BpCustodySignalHeader::REDUNDANT_RECEPTION)
+    {
+      bool released = ReleaseCustody (signal.GetBundleIdHash ());
+      if (!released && signal.IsFragment ())
+        {
+          // a fragment made by a convergence layer on the way
+          uint64_t aduId = BpHeader::GetBundleIdHash (signal.GetSourceEid ().Uri (), signal.GetCreateTimestamp (), signal.GetSequenceNumber (), false, 0);
+          released = ReleaseCustody (aduId, signal.GetFragOffset (), signal.GetFragLength ());
+        }
+      if (released)
+        NS_LOG_DEBUG ("Custody of a bundle from " << signal.GetSourceEid ().Uri () << " taken by " << bpHeader.GetSourceEid ().Uri ());
+    }
+  return true;
+}
+
+bool
+BundleProtocol::ReleaseCustody (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  std::unordered_map<uint64_t, CustodyBundle>::iterator it = m_custodyBundles.find (id);
+  if (it == m_custodyBundles.end ())
+    return false;
+
+  m_custodyIds.erase ((*it).second.custodyId);
+  m_custodyOffsets.erase (std::make_pair ((*it).second.aduId, (*it).second.offset));
+  m_custodyBundles.erase (it);
+  return true;
+}
+
+bool
+BundleProtocol::ReleaseCustody (uint64_t aduId, uint32_t offset, uint32_t length)
+{
+  NS_LOG_FUNCTION (this << " " << aduId << " " << offset << " " << length);
+  // the bundle in custody the fragment starts in
+  std::map<std::pair<uint64_t, uint32_t>, uint64_t>::iterator itOffset = m_custodyOffsets.upper_bound (std::make_pair (aduId, offset));
+  if (itOffset == m_custodyOffsets.begin ())
+    return false;
+  --itOffset;
+  if ((*itOffset).first.first != aduId)
+    return false;
+  std::unordered_map<uint64_t, CustodyBundle>::iterator it = m_custodyBundles.find ((*itOffset).second);
+  if (it == m_custodyBundles.end ())
+    return false;
+
+  CustodyBundle &custody = (*it).second;
+  uint32_t end = std::min (offset + length, custody.offset + custody.length);
+  if (offset >= end)
+    return false;
+
+  // merge the fragment with the parts accepted before
+  std::map<uint32_t, uint32_t>::iterator itPart = custody.accepted.upper_bound (offset);
+  if (itPart != custody.accepted.begin () && (*std::prev (itPart)).second >= offset)
+    --itPart;
+  while (itPart != custody.accepted.end () && (*itPart).first <= end)
+    {
+      offset = std::min (offset, (*itPart).first);
+      end = std::max (end, (*itPart).second);
+      itPart = custody.accepted.erase (itPart);
+    }
+  custody.accepted[offset] = end;
+
+  if (offset > custody.offset || end < custody.offset + custody.length)
+    return false;
+  return ReleaseCustody ((*it).first);
+}
+
+void
+BundleProtocol::AggregateCustodySignal (const BpEndpointId &custodian, uint64_t custodyId, bool succeeded, uint8_t reason)
+{
+  NS_LOG_FUNCTION (this << " " << custodian.Uri () << " " << custodyId << " " << succeeded);
+  std::pair<BpEndpointId, uint8_t> key (custodian, (succeeded ? 0x80 : 0) | (reason & 0x7f));
+  PendingAcs &pending = m_pendingAcs[key];
+  pending.custodyIds.insert (custodyId);
+  if (pending.custodyIds.size () >= m_acsBundleCount)
+    {
+      FlushCustodySignal (key);
+      return;
+    }
+  if (!pending.flush.IsRunning ())
+    pending.flush = Simulator::Schedule (m_acsDelay, &BundleProtocol::FlushCustodySignal, this, key);
+}
+
+void
+BundleProtocol::FlushCustodySignal (std::pair<BpEndpointId, uint8_t> key)
+{
+  NS_LOG_FUNCTION (this << " " << key.first.Uri () << " " << (uint16_t) key.second);
+  std::map<std::pair<BpEndpointId, uint8_t>, PendingAcs>::iterator it = m_pendingAcs.find (key);
+  if (it == m_pendingAcs.end ())
+    return;
+
+  BpAggregateCustodySignalHeader signal;
+  signal.SetStatus ((key.second & 0x80) != 0, key.second & 0x7f);
+  for (std::set<uint64_t>::iterator itId = (*it).second.custodyIds.begin (); itId != (*it).second.custodyIds.end (); ++itId)
+    {
+      signal.AddCustodyId (*itId);
+    }
+  (*it).second.flush.Cancel ();
+  m_pendingAcs.erase (it);
+
+  Ptr<Packet> record = Create<Packet> ();
+  record->AddHeader (signal);
+  if (SendAdminRecord (record, key.first) < 0)
+    NS_LOG_DEBUG ("Aggregate custody signal to " << key.first.Uri () << " refused by the CLA");
+}
+
+void
+BundleProtocol::ScheduleCustodyTimer ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_custodyTimerEvent.IsRunning () || m_custodyTimers.empty ())
+    return;
+  m_custodyTimerEvent = Simulator::Schedule (m_custodyTimers.front ().first - Simulator::Now (), &BundleProtocol::CustodyTimerExpired, this);
+}
+
+void
+BundleProtocol::CustodyTimerExpired ()
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  while (!m_custodyTimers.empty () && m_custodyTimers.front ().first <= now)
+    {
+      std::pair<Time, uint64_t> timer = m_custodyTimers.front ();
+      m_custodyTimers.pop_front ();
+      std::unordered_map<uint64_t, CustodyBundle>::iterator it = m_custodyBundles.find (timer.second);
+      // released, or its timer restarted since
+      if (it == m_custodyBundles.end () || (*it).second.deadline != timer.first)
+        continue;
+
+      NS_LOG_DEBUG ("No custody signal for bundle " << timer.second << ", sending it again");
+      (*it).second.deadline = now + m_custodyTimeout;
+      m_custodyTimers.push_back (std::make_pair ((*it).second.deadline, timer.second));
+      ForwardBundle ((*it).second.bundle->Copy ());
+    }
+  ScheduleCustodyTimer ();
+}
+
+uint32_t
+BundleProtocol::GetNCustodyBundles () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_custodyBundles.size ();
+}
+
+void
+BundleProtocol::ProcessAdminRecord (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  if (HandleCustodySignal (bundle) || HandleStatusReports (bundle))
+    return;
+
+  // routing control records of the neighbours
+  Ptr<BpRoutingProtocol> route = m_cla ? m_cla->GetRoutingProtocol () : NULL;
+  if (route && route->HandleAdminRecord (bundle))
+    return;
+
+  NS_LOG_DEBUG ("Unknown administrative record dropped");
+}
+
+void
+BundleProtocol::RequestStatusReports (BpHeader &bph)
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_statusReports)
+    return;
+
+  bph.SetReportEid (m_eid);
+  bph.SetRecptionReport (m_statusReports & BpStatusReportHeader::RECEIVED);
+  bph.SetForwardReport (m_statusReports & BpStatusReportHeader::FORWARDED);
+  bph.SetDeliveryReport (m_statusReports & BpStatusReportHeader::DELIVERED);
+  bph.SetDeletionReport (m_statusReports & BpStatusReportHeader::DELETED);
+}
+
+/**
+ * \return the key of the reports about a bundle and status, the fragments
+ * of a bundle sharing it
+ */
+static uint64_t
+StatusReportKey (const std::string &src, std::time_t timestamp, uint32_t seq, uint8_t status)
+{
+  return BpHeader::GetBundleIdHash (src, timestamp, seq, false, 0) * 31 + status;
+}
+
+void
+BundleProtocol::ReportStatus (const BpHeader &bpHeader, uint8_t status, uint8_t reason)
+{
+  NS_LOG_FUNCTION (this << " " << (uint16_t) status << " " << (uint16_t) reason);
+  if (bpHeader.IsAdmin ())
+    return;
+
+  bool requested = false;
+  switch (status)
+    {
+    case BpStatusReportHeader::RECEIVED:
+      requested = bpHeader.RecptionReport ();
+      break;
+    case BpStatusReportHeader::FORWARDED:
+      requested = bpHeader.ForwardReport ();
+      break;
+    case BpStatusReportHeader::DELIVERED:
+      requested = bpHeader.DeliveryReport ();
+      break;
+    case BpStatusReportHeader::DELETED:
+      requested = bpHeader.DeletionReport ();
+      break;
+    }
+  BpEndpointId report = bpHeader.GetReportEid ();
+  if (!requested || report == m_eid)
+    return;
+
+  BpEndpointId src = bpHeader.GetSourceEid ();
+  uint32_t seq = bpHeader.GetSequenceNumber ().GetValue ();
+  uint64_t key = StatusReportKey (src.Uri (), bpHeader.GetCreateTimestamp (), seq, status);
+  PendingReports &pending = m_pendingReports[report];
+
+  // the fragments of a bundle mostly come in order: one report covers them
+  std::unordered_map<uint64_t, uint32_t>::iterator itIndex = pending.index.find (key);
+  if (bpHeader.IsFragment () && itIndex != pending.index.end ())
+    {
+      BpStatusReportHeader &last = pending.reports[(*itIndex).second];
+      if (last.IsFragment () && last.GetReason () == reason && last.GetSourceEid () == src
+          && last.GetCreateTimestamp () == bpHeader.GetCreateTimestamp () && last.GetSequenceNumber () == seq
+          && last.GetFragOffset () + last.GetFragLength () == bpHeader.GetFragOffset ())
+        {
+          last.SetFragment (last.GetFragOffset (), last.GetFragLength () + bpHeader.GetBlockLength ());
+          return;
+        }
+    }
+
+  if (pending.reports.size () >= m_maxPendingReports)
+    {
+      NS_LOG_DEBUG ("Too many status reports queued for " << report.Uri () << ", report dropped");
+      return;
+    }
+
+  BpStatusReportHeader header;
+  header.SetStatus (status, Simulator::Now ());
+  header.SetReason (reason);
+  header.SetBundleId (src, bpHeader.GetCreateTimestamp (), seq);
+  if (bpHeader.IsFragment ())
+    header.SetFragment (bpHeader.GetFragOffset (), bpHeader.GetBlockLength ());
+  pending.index[key] = pending.reports.size ();
+  pending.reports.push_back (header);
+
+  if (!pending.flush.IsRunning ())
+    {
+      Time delay = std::max (pending.next - Simulator::Now (), Seconds (0));
+      pending.flush = Simulator::Schedule (delay, &BundleProtocol::FlushStatusReports, this, report);
+    }
+}
+
+void
+BundleProtocol::FlushStatusReports (BpEndpointId report)
+{
+  NS_LOG_FUNCTION (this << " " << report.Uri ());
+  std::map<BpEndpointId, PendingReports>::iterator it = m_pendingReports.find (report);
+  if (it == m_pendingReports.end () || (*it).second.reports.empty ())
+    return;
+
+  PendingReports &pending = (*it).second;
+  uint32_t n = std::min ((uint32_t) pending.reports.size (), m_reportBatch);
+  Ptr<Packet> record = Create<Packet> ();
+  for (uint32_t k = n; k > 0; k--)
+    {
+      record->AddHeader (pending.reports[k - 1]);
+    }
+  pending.reports.erase (pending.reports.begin (), pending.reports.begin () + n);
+
+  pending.index.clear ();
+  for (uint32_t k = 0; k < pending.reports.size (); k++)
+    {
+      const BpStatusReportHeader &header = pending.reports[k];
+      pending.index[StatusReportKey (header.GetSourceEid ().Uri (), header.GetCreateTimestamp (), header.GetSequenceNumber (), header.GetStatus ())] = k;
+    }
+
+  NS_LOG_DEBUG ("Sending " << n << " status reports to " << report.Uri ());
+  if (SendAdminRecord (record, report) < 0)
+    NS_LOG_DEBUG ("Status reports to " << report.Uri () << " refused by the CLA");
+
+  pending.next = Simulator::Now () + m_reportInterval;
+  if (!pending.reports.empty ())
+    pending.flush = Simulator::Schedule (m_reportInterval, &BundleProtocol::FlushStatusReports, this, report);
+}
+
+bool
+BundleProtocol::HandleStatusReports (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  Ptr<Packet> record = bundle->Copy ();
+  BpHeader bpHeader;
+  BpPayloadHeader bppHeader;
+  record->RemoveHeader (bpHeader);
+  record->RemoveHeader (bppHeader);
+  if (!BpStatusReportHeader::IsStatusReport (record))
+    return false;
+
+  while (BpStatusReportHeader::IsStatusReport (record))
+    {
+      BpStatusReportHeader header;
+      record->RemoveHeader (header);
+      m_nStatusReports++;
+      NS_LOG_DEBUG ("Status report from " << bpHeader.GetSourceEid ().Uri () << ": status " << (uint16_t) header.GetStatus ()
+                    << " reason " << (uint16_t) header.GetReason () << " bundle " << header.GetSourceEid ().Uri ()
+                    << " " << header.GetCreateTimestamp () << " " << header.GetSequenceNumber ());
+    }
+  return true;
+}
+
+uint32_t
+BundleProtocol::GetNStatusReports () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_nStatusReports;
+}
+
+bool
+BundleProtocol::IsDuplicate (uint64_t id)
+{
+  NS_LOG_FUNCTION (this << " " << id);
+  if (m_duplicateFilterSize == 0)
+    return false;
+
+  Time now = Simulator::Now ();
+  while (!m_seenOrder.empty ()
+         && (m_seenOrder.size () >= m_duplicateFilterSize || m_seenOrder.front ().first + m_duplicateFilterWindow <= now))
+    {
+      m_seenBundles.erase (m_seenOrder.front ().second);
+      m_seenOrder.pop_front ();
+    }
+
+  if (!m_seenBundles.insert (id).second)
+    return true;
+  m_seenOrder.push_back (std::make_pair (now, id));
+  return false;
+}
+
+uint32_t
+BundleProtocol::GetNDuplicateBundles () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_nDuplicates;
+}
+
+void
+BundleProtocol::ExpireFragments (std::string fragName)
+{ 
+  NS_LOG_FUNCTION (this << " " << fragName);
+  std::map<std::string, std::map<u_int32_t, Ptr<Packet> > >::iterator it = BpRecvFragMap.find (fragName);
+  if (it != BpRecvFragMap.end ())
+    {
+      NS_LOG_DEBUG ("Discarding incomplete bundle " << fragName << " with " << (*it).second.size () << " fragments");
+      for (std::map<u_int32_t, Ptr<Packet> >::iterator itFrag = (*it).second.begin (); itFrag != (*it).second.end (); ++itFrag)
+        {
+          BpHeader bpHeader;
+          (*itFrag).second->PeekHeader (bpHeader);
+          ReportStatus (bpHeader, BpStatusReportHeader::DELETED, BpStatusReportHeader::LIFETIME_EXPIRED);
+        }
+      BpRecvFragMap.erase (it);
+    }
+  BpRecvFragTimers.erase (fragName);
+}
+
 Ptr<Packet>
 BundleProtocol::Receive (const BpEndpointId &eid)
 { 
@@ -788,7 +1701,13 @@ void
 BundleProtocol::SetRoutingProtocol (Ptr<BpRoutingProtocol> route)
 { 
   NS_LOG_FUNCTION (this << " " << route);
-  m_cla->SetRoutingProtocol (route);
+  for (std::map<std::string, Ptr<BpClaProtocol> >::iterator it = m_clas.begin (); it != m_clas.end (); ++it)
+    {
+      (*it).second->SetRoutingProtocol (route);
+    }
+  m_bpRoutingProtocol = route;
+  if (route)
+    route->SetBundleProtocol (this);
 }
 
 Ptr<BpRoutingProtocol> 
@@ -798,6 +1717,167 @@ BundleProtocol::GetRoutingProtocol ()
   return m_cla->GetRoutingProtocol ();
 }
 
+void
+BundleProtocol::RestoreBundle (Ptr<Packet> bundle)
+{
+  NS_LOG_FUNCTION (this << " " << bundle);
+  BpHeader bpHeader;
+  bundle->PeekHeader (bpHeader);
+  BpEndpointId src = bpHeader.GetSourceEid ();
+
+  std::map<BpEndpointId, std::queue<Ptr<Packet> > >::iterator it = BpSendBundleStore.find (src);
+  if ( it == BpSendBundleStore.end ())
+    {
+      std::queue<Ptr<Packet> > qu;
+      qu.push (bundle);
+      BpSendBundleStore.insert (std::pair<BpEndpointId, std::queue<Ptr<Packet> > > (src, qu) );
+    }
+  else
+    {
+      (*it).second.push (bundle);
+    }
+}
+
+std::vector<Ptr<Packet> >
+BundleProtocol::FragmentBundle (Ptr<Packet> bundle, uint32_t maxSize)
+{
+  NS_LOG_FUNCTION (bundle << " " << maxSize);
+  std::vector<Ptr<Packet> > fragments;
+  if (bundle->GetSize () <= maxSize)
+    {
+      fragments.push_back (bundle);
+      return fragments;
+    }
+
+  Ptr<Packet> payload = bundle->Copy ();
+  BpHeader bph;
+  BpPayloadHeader bpph;
+  payload->RemoveHeader (bph);
+  payload->RemoveHeader (bpph);
+
+  uint32_t aduOffset = bph.IsFragment () ? bph.GetFragOffset () : 0;
+  uint32_t total = payload->GetSize ();
+
+  // a whole bundle carries no ADU length on the wire, the fragments need it
+  if (!bph.IsFragment ())
+    bph.SetAduLength (total);
+
+  // the fragments would share the custody id of the bundle, which is
+  // released only once all of them are accepted: have them signalled one
+  // by one with their offsets rather than in aggregate custody signals
+  bph.SetCustodyId (0);
+
+  // size the headers for the largest offset, the SDNV fields only shrink below it
+  bph.SetIsFragment (true);
+  bph.SetFragOffset (aduOffset + total);
+  bph.SetBlockLength (total);
+  bpph.SetBlockLength (total);
+  uint32_t headerSize = bph.GetSerializedSize () + bpph.GetSerializedSize ();
+  if (headerSize >= maxSize)
+    {
+      NS_LOG_DEBUG ("Bundle headers of " << headerSize << " bytes do not fit in " << maxSize << " bytes");
+      return fragments;
+    }
+
+  uint32_t chunk = maxSize - headerSize;
+  for (uint32_t offset = 0; offset < total; offset += chunk)
+    {
+      uint32_t size = std::min (chunk, total - offset);
+      Ptr<Packet> fragment = payload->CreateFragment (offset, size);
+
+      bph.SetFragOffset (aduOffset + offset);
+      bph.SetBlockLength (size);
+      bpph.SetBlockLength (size);
+      fragment->AddHeader (bpph);
+      fragment->AddHeader (bph);
+      fragments.push_back (fragment);
+    }
+
+  return fragments;
+}
+
+void
+BundleProtocol::RerouteBundles (const BpEndpointId &nextHop)
+{
+  NS_LOG_FUNCTION (this << " " << nextHop.Uri ());
+  Ptr<BpClaProtocol> cla = GetNeighbourCla (nextHop);
+  if (cla)
+    cla->ReleaseQueuedBundles (nextHop);
+
+  for (std::map<BpEndpointId, std::queue<Ptr<Packet> > >::iterator it = BpSendBundleStore.begin (); it != BpSendBundleStore.end (); ++it)
+    {
+      std::queue<Ptr<Packet> > &bundles = (*it).second;
+      // each bundle stored now is tried once; the CLA pops it on success
+      for (size_t n = bundles.size (); n > 0 && !bundles.empty (); n--)
+        {
+          Ptr<Packet> bundle = bundles.front ();
+          BpHeader bpHeader;
+          bundle->PeekHeader (bpHeader);
+          Ptr<BpClaProtocol> bundleCla = SelectCla (bpHeader.GetDestinationEid ());
+          if (bundleCla->SendPacket (bundle) < 0 && !bundles.empty () && bundles.front () == bundle)
+            {
+              // no route for now, hold it behind the others
+              bundles.pop ();
+              bundles.push (bundle);
+            }
+        }
+    }
+}
+
+uint32_t
+BundleProtocol::GetClaQueuedBytes () const
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t bytes = 0;
+  for (std::map<std::string, Ptr<BpClaProtocol> >::const_iterator it = m_clas.begin (); it != m_clas.end (); ++it)
+    {
+      bytes += (*it).second->GetTxQueuedBytes ();
+    }
+  return bytes;
+}
+
+Ptr<BpClaProtocol>
+BundleProtocol::GetCla () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_cla;
+}
+
+Ptr<BpClaProtocol>
+BundleProtocol::GetNeighbourCla (const BpEndpointId &nextHop) const
+{
+  NS_LOG_FUNCTION (this << " " << nextHop.Uri ());
+  std::map<BpEndpointId, BpRegisterInfo>::const_iterator it = BpRegistration.find (nextHop);
+  if (it != BpRegistration.end () && (*it).second.cla)
+    return (*it).second.cla;
+  return m_cla;
+}
+
+bool
+BundleProtocol::HasRoute (const BpEndpointId &dst)
+{
+  NS_LOG_FUNCTION (this << " " << dst.Uri ());
+  Ptr<BpClaProtocol> cla = SelectCla (dst);
+  Ptr<BpRoutingProtocol> route = cla ? cla->GetRoutingProtocol () : NULL;
+  if (!route)
+    return false;
+
+  // the CLA knows the address of the next hop; EnableSend would open a
+  // session to tell
+  InetSocketAddress badAddr ("1.0.0.1", 0);
+  return cla->getL4Address (route->GetRoute (dst)) != badAddr;
+}
+
+Ptr<BpClaProtocol>
+BundleProtocol::GetCla (const std::string &l4Type) const
+{
+  NS_LOG_FUNCTION (this << " " << l4Type);
+  std::map<std::string, Ptr<BpClaProtocol> >::const_iterator it = m_clas.find (l4Type);
+  if (it == m_clas.end ())
+    return NULL;
+  return (*it).second;
+}
+
 Ptr<Node> 
 BundleProtocol::GetNode () const
 { 
@@ -825,6 +1905,9 @@ BundleProtocol::GetBundle (const BpEndpointId &src)
       Ptr<Packet> packet = ((*it).second).front ();
       ((*it).second).pop ();
 
+      // a bundle in custody leaves the storage only once accepted
+      if (m_custodyTransfer)
+        KeepCustody (packet);
       return packet;
     }
 }
@@ -889,9 +1972,35 @@ BundleProtocol::DoDispose (void)
   NS_LOG_FUNCTION (this);
   m_node = 0;
   m_cla = 0;
+  m_clas.clear ();
+  m_claCache.Clear ();
+  // the routing protocol may be shared with other nodes, do not dispose it
   m_bpRoutingProtocol = 0;
   m_startEvent.Cancel ();
   m_stopEvent.Cancel ();
+  for (std::map<std::string, EventId>::iterator it = BpRecvFragTimers.begin (); it != BpRecvFragTimers.end (); ++it)
+    {
+      (*it).second.Cancel ();
+    }
+  BpRecvFragTimers.clear ();
+  BpRecvFragMap.clear ();
+  m_custodyTimerEvent.Cancel ();
+  m_custodyTimers.clear ();
+  m_custodyBundles.clear ();
+  m_custodyIds.clear ();
+  m_custodyOffsets.clear ();
+  for (std::map<std::pair<BpEndpointId, uint8_t>, PendingAcs>::iterator it = m_pendingAcs.begin (); it != m_pendingAcs.end (); ++it)
+    {
+      (*it).second.flush.Cancel ();
+    }
+  m_pendingAcs.clear ();
+  for (std::map<BpEndpointId, PendingReports>::iterator it = m_pendingReports.begin (); it != m_pendingReports.end (); ++it)
+    {
+      (*it).second.flush.Cancel ();
+    }
+  m_pendingReports.clear ();
+  m_seenBundles.clear ();
+  m_seenOrder.clear ();
   Object::DoDispose ();
 }
 
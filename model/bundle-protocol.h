@@ -23,6 +23,7 @@
 #include "bp-cla-protocol.h"
 #include "bp-endpoint-id.h"
 #include "bp-routing-protocol.h"
+#include "bp-status-report-header.h"
 #include "ns3/sequence-number.h"
 #include "ns3/object.h"
 #include "ns3/event-id.h"
@@ -30,10 +31,17 @@
 #include "ns3/inet-socket-address.h"
 #include <string>
 #include <map>
+#include <set>
 #include <queue>
+#include <deque>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace ns3 {
 
+class BpHeader;
+
 /**
  * \brief the bundle protocol register information of a endpoint id
  */
@@ -83,14 +91,45 @@ public:
    */
   virtual void Open (Ptr<Node> node);
 
+  /**
+   * \brief Add a convergence layer adapter to the bundle node
+   *
+   * The CLA given by the L4Type attribute is added by Open () and is the
+   * default one. Further CLAs are used for the next hops registered with
+   * them (see ExternalRegister ()), so that e.g. a gateway reaches one
+   * neighbour over TCP and another one over LTP.
+   *
+   * \param l4Type the CLA type: "Tcp", "Udp", "Ltp" or "NetDevice"
+   *
+   * \return the CLA of this type, NULL if the type is unknown
+   */
+  Ptr<BpClaProtocol> AddCla (const std::string &l4Type);
+
   int ExternalRegister (const BpEndpointId &eid, const double lifetime, const bool state, const InetSocketAddress l4Address);
 
+  /**
+   * \brief Register an external endpoint id reached through a given CLA
+   *
+   * Bundles whose next hop is this endpoint id are sent on the CLA. An
+   * endpoint id which is already registered is moved to the CLA.
+   *
+   * \param eid the external endpoint id
+   * \param lifetime the lifetime of the registration
+   * \param state the registration state
+   * \param l4Address the address of the endpoint id on the CLA
+   * \param l4Type the CLA type, which must have been added with AddCla ()
+   *
+   * \return -1 if the CLA is not added or refuses the address, otherwise
+   * the result of the registration
+   */
+  int ExternalRegister (const BpEndpointId &eid, const double lifetime, const bool state, const InetSocketAddress l4Address, const std::string &l4Type);
+
   /**
    * \brief Register a local endpoint id in the bundle protocol
    *
    *  This method adds an entry in the registration storage. If the state field 
    *  in the BpRegisterInfo is “true” (active state),  which means that this 
-   *  application desires to receive bundles, it triggers the convergence layer 
+   *  application desires to receive bundles, it triggers every convergence layer 
    *  (CLA) protocol to enable a transport layer connection to receive packets 
    *  (e.g., listen state in TCP).
    *
@@ -186,6 +225,10 @@ public:
   /*
    * Ultimately going to replace existing 'Send(...)' function as it receives an
    * NS-3 packet of data and copies the contents into the bundle payload
+   *
+   * Returns -1 if the source endpoint id is not registered, 1 if the bundles 
+   * were accepted but the convergence layer queue towards the next hop is
+   * congested (the caller should slow down), otherwise 0.
   */
   virtual int Send_packet (Ptr<Packet> p, const BpEndpointId &src, const BpEndpointId &dst);
 
@@ -196,8 +239,98 @@ public:
    */
   virtual int Close (const BpEndpointId &eid);  
 
+  /**
+   * \brief Forward a received bundle towards its destination
+   *
+   * The caller checks that there is a route (HasRoute ()) beforehand.
+   *
+   * \param bundle the bundle
+   *
+   * \return 1 if the convergence layer queue towards the next hop is
+   * congested, otherwise 0
+   */
   int ForwardBundle (Ptr<Packet> bundle);
 
+  /**
+   * \brief Send a bundle to a given next hop
+   *
+   * Used by the routing protocols which replicate bundles: the bundle is
+   * not stored in the persistent storage, and is sent on the CLA the next
+   * hop is registered with, or the default one.
+   *
+   * \param bundle the bundle, with its headers
+   * \param nextHop the endpoint id of the neighbour
+   *
+   * \return the result of BpClaProtocol::SendPacketTo ()
+   */
+  int ForwardBundleTo (Ptr<Packet> bundle, const BpEndpointId &nextHop);
+
+  /**
+   * \brief Send an administrative record from this node
+   *
+   * The record is sent in an expedited administrative bundle to the next
+   * hop of its destination.
+   *
+   * \param record the administrative record
+   * \param dst the destination endpoint id
+   *
+   * \return the result of ForwardBundleTo ()
+   */
+  int SendAdminRecord (Ptr<Packet> record, const BpEndpointId &dst);
+
+  /**
+   * \brief Tell the routing protocol that a neighbour can be reached,
+   * e.g. at the start of a contact
+   *
+   * The CLAs with a notion of neighbour raise it: the TCP CLA when its
+   * first session to the neighbour connects, or when a contact scheduled
+   * with it opens, and the NetDevice CLA when the link to it is up. The
+   * UDP and LTP CLAs have none; for the neighbours reached over them,
+   * the application calls it.
+   *
+   * \param eid the endpoint id of the neighbour
+   */
+  void NotifyNeighbourUp (const BpEndpointId &eid);
+
+  /**
+   * \brief Tell the routing protocol that a neighbour cannot be reached
+   * any more
+   *
+   * Raised by the same CLAs as NotifyNeighbourUp (), when the last session
+   * to the neighbour closes, its contact closes or its link goes down.
+   *
+   * \param eid the endpoint id of the neighbour
+   */
+  void NotifyNeighbourDown (const BpEndpointId &eid);
+
+  /**
+   * \brief Join a group endpoint id
+   *
+   * The bundles sent to the group are delivered to this node, and can be
+   * read with Receive (group). A bundle to a group is sent by Send_packet ()
+   * and forwarded along the distribution trees of the routing protocol,
+   * see BpRoutingProtocol::GetGroupRoutes ().
+   *
+   * \param group the group endpoint id
+   *
+   * \return -1 if the endpoint id is already registered, otherwise 0
+   */
+  int JoinGroup (const BpEndpointId &group);
+
+  /**
+   * \brief Leave a group endpoint id
+   *
+   * \param group the group endpoint id
+   *
+   * \return -1 if this node is not a member of the group, otherwise 0
+   */
+  int LeaveGroup (const BpEndpointId &group);
+
+  /**
+   * \return true if this node is a member of the group
+   */
+  bool IsGroupMember (const BpEndpointId &group) const;
+
   /**
    *  \brief Receive bundle with dst eid
    *
@@ -220,6 +353,17 @@ public:
    */
   void ReceivePacket (Ptr<Packet> packet);
 
+  /**
+   * Receive one complete bundle from the convergence layer
+   *
+   * This method is used by convergence layers which already delimit the 
+   * bundles (e.g., per-session reassembly of a TCP stream), so the bundle
+   * is processed without going through the shared receive buffer.
+   *
+   * \param bundle the bundle received from the transport layer
+   */
+  void ReceiveBundle (Ptr<Packet> bundle);
+
   /**
    * Get and delete a bundle from the persistant storage
    *
@@ -232,6 +376,94 @@ public:
    */
   virtual Ptr<Packet> GetBundle (const BpEndpointId &src);
 
+  /**
+   * \brief Put a bundle back into the persistent send storage
+   *
+   * This method is called by BpClaProtocol when it gives up on delivering a
+   * bundle it had already taken from the storage (e.g., the connection to
+   * the next hop could not be re-established). The bundle is sent again
+   * with the next bundles of its source endpoint id.
+   *
+   * \param bundle the bundle
+   */
+  void RestoreBundle (Ptr<Packet> bundle);
+
+  /**
+   * Split a bundle into bundle fragments of at most a given size
+   *
+   * The fragment offsets are relative to the original ADU, so a bundle
+   * which is already a fragment can be fragmented again.
+   *
+   * \param bundle the bundle, with its primary and payload block headers
+   * \param maxSize the maximum size of a fragment, headers included
+   *
+   * \return the fragments, or the bundle itself if it fits in maxSize;
+   * empty if maxSize cannot even hold the headers
+   */
+  static std::vector<Ptr<Packet> > FragmentBundle (Ptr<Packet> bundle, uint32_t maxSize);
+
+  /**
+   * \brief Route the stored bundles again after a next hop went down or
+   * came back
+   *
+   * The bundles queued in the CLA towards the next hop are taken back into
+   * the persistent send storage, then every stored bundle is handed to the
+   * CLA of its current route. A bundle without a usable route stays in
+   * the storage until the next call.
+   *
+   * \param nextHop the endpoint id of the neighbour
+   */
+  void RerouteBundles (const BpEndpointId &nextHop);
+
+  /**
+   * \return the number of bundles this node is the custodian of, waiting
+   * for the next custodian to accept them
+   */
+  uint32_t GetNCustodyBundles () const;
+
+  /**
+   * \return the number of status reports received for the bundles this
+   * node is the report-to endpoint of
+   */
+  uint32_t GetNStatusReports () const;
+
+  /**
+   * \return the number of received bundles dropped as duplicates
+   */
+  uint32_t GetNDuplicateBundles () const;
+
+  /**
+   * \return the number of bytes of bundles queued in the convergence layer,
+   * waiting for the transport layer to accept them
+   */
+  uint32_t GetClaQueuedBytes () const;
+
+  /**
+   * Get the convergence layer adapter, e.g. to give the NetDevice CLA the
+   * link layer addresses of the neighbours
+   *
+   * \return convergence layer adapter
+   */
+  Ptr<BpClaProtocol> GetCla () const;
+
+  /**
+   * Get a convergence layer adapter by type
+   *
+   * \param l4Type the CLA type
+   *
+   * \return the CLA, NULL if no CLA of this type was added
+   */
+  Ptr<BpClaProtocol> GetCla (const std::string &l4Type) const;
+
+  /**
+   * Get the convergence layer adapter a neighbour is reached through
+   *
+   * \param nextHop the endpoint id of the neighbour
+   *
+   * \return the CLA the neighbour is registered with, or the default CLA
+   */
+  Ptr<BpClaProtocol> GetNeighbourCla (const BpEndpointId &nextHop) const;
+
   /**
    * Get node of this bundle protocol
    *
@@ -304,6 +536,13 @@ private:
    */
   void RetreiveBundle ();
 
+  /**
+   * Discard the fragments of a bundle which was not completely received in time
+   *
+   * \param fragName the reassembly key of the bundle
+   */
+  void ExpireFragments (std::string fragName);
+
   /**
    * \brief Bundle protocol specific startup code
    *
@@ -321,19 +560,278 @@ private:
    */
   void StopBundleProtocol ();
 
+  /**
+   * Enable every CLA to receive bundles for a registration
+   *
+   * \param eid the endpoint id of the registration
+   *
+   * \return 0 if at least one CLA is enabled, otherwise -1
+   */
+  int EnableReceive (const BpEndpointId &eid);
+
+  /**
+   * Send a copy of a bundle to each next hop of the distribution tree of
+   * its group; the copies share the payload buffer of the bundle
+   *
+   * \param bundle the bundle, with its headers
+   * \param bpHeader the primary bundle header of the bundle
+   *
+   * \return true if the destination is a group, known to the routing
+   * protocol or joined by this node
+   */
+  bool ForwardToGroup (Ptr<Packet> bundle, const BpHeader &bpHeader);
+
+  /**
+   * Take custody of a received bundle which requests it, if custody
+   * transfer is enabled: signal the acceptance to its custodian and, for a
+   * bundle forwarded, become its custodian
+   *
+   * \param bundle the bundle, with its headers
+   * \param bpHeader the primary bundle header of the bundle, updated
+   * \param forward the bundle is forwarded, not delivered here
+   *
+   * \return false if this node already holds custody of the bundle: the
+   * copy received is redundant and dropped
+   */
+  bool TakeCustody (Ptr<Packet> bundle, BpHeader &bpHeader, bool forward);
+
+  /**
+   * Keep a bundle handed to a CLA until its next custodian accepts it, if
+   * this node is its custodian, and start its retransmission timer. A
+   * retransmission keeps the timer CustodyTimerExpired () restarted
+   *
+   * \param bundle the bundle, with its headers
+   */
+  void KeepCustody (Ptr<Packet> bundle);
+
+  /**
+   * Send a custody signal about a bundle to its custodian
+   *
+   * \param bpHeader the primary bundle header of the bundle
+   * \param succeeded custody was accepted
+   * \param reason the reason code, see BpCustodySignalHeader
+   */
+  void SendCustodySignal (const BpHeader &bpHeader, bool succeeded, uint8_t reason);
+
+  /**
+   * Release the bundles accepted by their next custodian
+   *
+   * \param bundle the administrative bundle, with its headers
+   *
+   * \return true if the bundle is a custody signal
+   */
+  bool HandleCustodySignal (Ptr<Packet> bundle);
+
+  /**
+   * Consume an administrative bundle addressed to this node: custody
+   * signals, status reports and routing control records are handled,
+   * any other record is dropped. Administrative bundles are never put in
+   * the received bundle storage.
+   *
+   * \param bundle the administrative bundle, with its headers
+   */
+  void ProcessAdminRecord (Ptr<Packet> bundle);
+
+  /**
+   * Request the status reports of the StatusReports attribute for a
+   * bundle sent by this node, this node being the report-to endpoint
+   *
+   * \param bph the primary bundle header of the bundle
+   */
+  void RequestStatusReports (BpHeader &bph);
+
+  /**
+   * Queue a status report about a bundle for its report-to endpoint, if
+   * the bundle requested it. A report about the fragment following the
+   * one of a queued report is merged into it.
+   *
+   * \param bpHeader the primary bundle header of the bundle
+   * \param status the status flag, see BpStatusReportHeader
+   * \param reason the reason code, see BpStatusReportHeader
+   */
+  void ReportStatus (const BpHeader &bpHeader, uint8_t status, uint8_t reason);
+
+  /**
+   * Send up to StatusReportBatch queued status reports to a report-to
+   * endpoint in one administrative bundle, and schedule the next bundle
+   * StatusReportInterval later if reports are left
+   *
+   * \param report the report-to endpoint id
+   */
+  void FlushStatusReports (BpEndpointId report);
+
+  /**
+   * Count the status reports received
+   *
+   * \param bundle the administrative bundle, with its headers
+   *
+   * \return true if the bundle carries status reports
+   */
+  bool HandleStatusReports (Ptr<Packet> bundle);
+
+  /**
+   * Check a received bundle against the duplicate filter, and add it
+   *
+   * The filter holds the bundle id hashes seen in the last
+   * DuplicateFilterWindow, at most DuplicateFilterSize of them; the
+   * oldest are forgotten first.
+   *
+   * \param id the hash of the bundle id
+   *
+   * \return true if the bundle was seen before
+   */
+  bool IsDuplicate (uint64_t id);
+
+  /**
+   * Release a bundle this node is the custodian of
+   *
+   * \param id the hash of the bundle id
+   *
+   * \return true if the bundle was in custody
+   */
+  bool ReleaseCustody (uint64_t id);
+
+  /**
+   * Release the part of a bundle this node is the custodian of that a
+   * convergence layer fragmented on the way; the bundle is released once
+   * all its parts are accepted
+   *
+   * \param aduId the hash of the bundle id without the fragment offset
+   * \param offset the offset of the fragment accepted in the ADU
+   * \param length the length of the fragment accepted
+   *
+   * \return true if the whole bundle is now released
+   */
+  bool ReleaseCustody (uint64_t aduId, uint32_t offset, uint32_t length);
+
+  /**
+   * Add a bundle to the aggregate custody signal pending for its
+   * custodian, and send the signal once AcsBundleCount bundles are in it
+   * or AcsDelay after the first one
+   *
+   * \param custodian the custodian of the bundle
+   * \param custodyId the custody id the custodian gave the bundle
+   * \param succeeded custody was accepted
+   * \param reason the reason code, see BpCustodySignalHeader
+   */
+  void AggregateCustodySignal (const BpEndpointId &custodian, uint64_t custodyId, bool succeeded, uint8_t reason);
+
+  /**
+   * Send a pending aggregate custody signal
+   *
+   * \param key the custodian and the status byte of the signal
+   */
+  void FlushCustodySignal (std::pair<BpEndpointId, uint8_t> key);
+
+  /**
+   * Schedule the custody timer at the first retransmission deadline
+   */
+  void ScheduleCustodyTimer ();
+
+  /**
+   * Send again the bundles whose retransmission deadline passed
+   */
+  void CustodyTimerExpired ();
+
+  /**
+   * Select the CLA of the next hop towards a destination
+   *
+   * \param dst the destination endpoint id
+   *
+   * \return the CLA the next hop is registered with, or the default CLA
+   */
+  Ptr<BpClaProtocol> SelectCla (const BpEndpointId &dst);
+
+  /**
+   * Check that the CLA of the next hop towards a destination knows its
+   * address, without opening a connection to it
+   *
+   * \param dst the destination endpoint id
+   *
+   * \return true if there is a route to the destination
+   */
+  bool HasRoute (const BpEndpointId &dst);
+
 private:
   Ptr<Node>           m_node;  /// bundle node            
-  Ptr<BpClaProtocol>  m_cla;   /// convergence layer adapter (CLA)
+  Ptr<BpClaProtocol>  m_cla;   /// default convergence layer adapter (CLA)
+  std::map<std::string, Ptr<BpClaProtocol> > m_clas; /// all CLAs of the node: map (CLA type, CLA)
+  BpRouteCache<Ptr<BpClaProtocol> > m_claCache; /// CLA of the next hop of each destination
 
   uint32_t m_bundleSize;       /// bundle size
+  uint8_t m_bundlePriority;    /// priority of the bundles sent by this node
   std::string m_l4Type;        /// the transport layer type
   std::string m_rtType;        /// the bundle routing protocol type
 
   std::map<BpEndpointId, std::queue<Ptr<Packet> > > BpSendBundleStore; /// persistant storage of sent bundles: map (source endpoint id, bundle packet queue )
   std::map<BpEndpointId, std::queue<Ptr<Packet> > > BpRecvBundleStore; /// persistant storage of received bundles: map (destination endpoint id, bundle packet queue )
   std::map<BpEndpointId, BpRegisterInfo> BpRegistration; /// persistant storage of registrations: map (local endpoint id, registration information)
+  std::set<BpEndpointId> m_groups; /// groups this node is a member of
+
+  std::map<std::string, std::map<u_int32_t, Ptr<Packet> > > BpRecvFragMap; /// mapping of partial bundle fragment buffers: map (source eid_timestamp_seq, map (fragment offset, fragment))
+  std::map<std::string, EventId> BpRecvFragTimers; /// reassembly timeouts of the partial bundles in BpRecvFragMap
+  Time m_reassemblyTimeout;       /// time a partial bundle without lifetime is kept
+
+  /**
+   * \brief A bundle this node is the custodian of
+   */
+  struct CustodyBundle
+  {
+    Ptr<Packet> bundle;         /// the bundle
+    Time deadline;              /// time of its next retransmission
+    uint64_t custodyId;         /// the custody id this node gave it
+    uint64_t aduId;             /// hash of its bundle id without the fragment offset
+    uint32_t offset;            /// its offset in the ADU, 0 if not a fragment
+    uint32_t length;            /// the length of its payload
+    std::map<uint32_t, uint32_t> accepted; /// parts accepted in fragments so far: map (offset, end)
+  };
+
+  /**
+   * \brief An aggregate custody signal not sent yet
+   */
+  struct PendingAcs
+  {
+    std::set<uint64_t> custodyIds;  /// custody ids of the bundles signalled
+    EventId flush;                  /// sending of the signal after AcsDelay
+  };
+
+  bool m_custodyTransfer;         /// request and accept custody of bundles
+  Time m_custodyTimeout;          /// time to wait for the next custodian to accept a bundle
+  std::unordered_map<uint64_t, CustodyBundle> m_custodyBundles; /// bundles in custody: map (bundle id hash, bundle)
+  std::deque<std::pair<Time, uint64_t> > m_custodyTimers; /// retransmission deadlines, earliest first: (deadline, bundle id hash); entries of released bundles are skipped
+  EventId m_custodyTimerEvent;    /// expiry of the first retransmission deadline
+  uint64_t m_nextCustodyId;       /// custody id given to the next bundle this node becomes the custodian of
+  std::map<uint64_t, uint64_t> m_custodyIds;          /// bundles in custody: map (custody id, bundle id hash), ordered for the ranges of the aggregate custody signals
+  std::map<std::pair<uint64_t, uint32_t>, uint64_t> m_custodyOffsets; /// bundles in custody: map ((ADU id hash, offset), bundle id hash), ordered to find the bundle a fragment is part of
+
+  bool m_aggregateCustodySignals; /// signal custody in aggregate custody signals
+  uint32_t m_acsBundleCount;      /// bundles after which an aggregate custody signal is sent
+  Time m_acsDelay;                /// time after which an aggregate custody signal is sent
+  std::map<std::pair<BpEndpointId, uint8_t>, PendingAcs> m_pendingAcs; /// signals not sent yet: map ((custodian, status byte), signal)
 
-  std::map<std::string, std::map<u_int32_t, Ptr<Packet> > > BpRecvFragMap; /// mapping of partial bundle fragment buffers
+  /**
+   * \brief The status reports queued for a report-to endpoint
+   */
+  struct PendingReports
+  {
+    std::vector<BpStatusReportHeader> reports;        /// reports not sent yet, oldest first
+    std::unordered_map<uint64_t, uint32_t> index;     /// last report of each bundle and status: map (key, position in reports)
+    Time next;                                        /// earliest time of the next report bundle
+    EventId flush;                                    /// sending of the next report bundle
+  };
+
+  uint8_t m_statusReports;        /// status flags requested for the bundles sent by this node
+  Time m_reportInterval;          /// minimum time between two report bundles to the same endpoint
+  uint32_t m_reportBatch;         /// maximum number of reports in one report bundle
+  uint32_t m_maxPendingReports;   /// maximum number of reports queued for one endpoint; more are dropped
+  std::map<BpEndpointId, PendingReports> m_pendingReports; /// reports not sent yet: map (report-to endpoint id, reports)
+  uint32_t m_nStatusReports;      /// status reports received
+
+  uint32_t m_duplicateFilterSize; /// maximum number of bundle ids in the duplicate filter, 0 to disable it
+  Time m_duplicateFilterWindow;   /// time a bundle id stays in the duplicate filter
+  std::unordered_set<uint64_t> m_seenBundles; /// duplicate filter: hashes of the bundle ids received
+  std::deque<std::pair<Time, uint64_t> > m_seenOrder; /// the duplicate filter, oldest first: (time received, bundle id hash)
+  uint32_t m_nDuplicates;         /// bundles dropped as duplicates
 
   Ptr<Packet> m_bpRxBufferPacket; /// a buffer for all packets received from the CLA; bundles are retreived from this buffer
 
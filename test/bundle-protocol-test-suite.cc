@@ -20,6 +20,7 @@
 
 #include <string>
 #include <fstream>
+#include <vector>
 #include <tgmath.h>
 #include "ns3/bp-endpoint-id.h"
 #include "ns3/bundle-protocol.h"
@@ -30,7 +31,17 @@
 #include "ns3/bp-endpoint-id.h"
 #include "ns3/bundle-protocol.h"
 #include "ns3/bp-static-routing-protocol.h"
+#include "ns3/bp-netdevice-cla-protocol.h"
+#include "ns3/bp-forwarding-table.h"
+#include "ns3/bp-cgr-routing-protocol.h"
+#include "ns3/bp-epidemic-routing-protocol.h"
+#include "ns3/bp-prophet-routing-protocol.h"
+#include "ns3/bp-spray-and-wait-routing-protocol.h"
+#include "ns3/bp-link-state-routing-protocol.h"
+#include "ns3/bp-tcp-cla-protocol.h"
+#include "ns3/bp-contact-scheduler.h"
 #include "ns3/bundle-protocol-helper.h"
+#include "ns3/bp-static-routing-helper.h"
 #include "ns3/bundle-protocol-container.h"
 #include "ns3/test.h"
 
@@ -59,6 +70,471 @@ private:
   std::string m_claType;
 };
 
+/**
+ * Bundle nodes dtn:node0, dtn:node1, ... on a chain of point-to-point
+ * links, each registering its neighbours. The test cases deriving from it
+ * set the configuration defaults and the routes, schedule the bundles and
+ * check the outcome.
+ */
+class BundleProtocolChainTestCase : public TestCase
+{
+public:
+  BundleProtocolChainTestCase (std::string name);
+  virtual ~BundleProtocolChainTestCase ();
+
+protected:
+  /**
+   * Build the chain with the configuration defaults set so far
+   *
+   * \param n the number of nodes
+   * \param routing the type of the bundle routing protocol, one instance per node
+   * \param registerNeighbours register the neighbours with each other at 0.1 s
+   */
+  void Build (uint32_t n, std::string routing = "ns3::BpStaticRoutingProtocol", bool registerNeighbours = true);
+
+  /**
+   * Run the simulation, then restore the configuration defaults
+   *
+   * \param stop the end of the simulation
+   */
+  void Run (Time stop);
+
+  BpEndpointId GetEid (uint32_t node) const;
+  InetSocketAddress GetAddress (uint32_t node, uint32_t neighbour) const;
+  void Send (uint32_t node, uint32_t size, BpEndpointId dst);
+  void Receive (uint32_t node, BpEndpointId eid);
+  void Register (uint32_t node, uint32_t neighbour);
+  Ptr<BpStaticRoutingProtocol> GetStaticRouting (uint32_t node) const;
+  uint32_t GetNTcpSockets (uint32_t node) const;
+
+  /**
+   * Schedule a contact of the TCP CLA of a node with a neighbour, at the
+   * rate of the links
+   */
+  void AddContact (uint32_t node, uint32_t neighbour, Time start, Time stop);
+
+protected:
+  NodeContainer m_nodes;
+  std::vector<Ptr<BundleProtocol> > m_bps;
+  std::vector<Ipv4InterfaceContainer> m_links;      // link k joins the nodes k and k + 1
+  std::vector<std::vector<uint32_t> > m_received;   // sizes of the bundles received by each node, in order
+  std::vector<int> m_sendResults;                   // results of Send_packet, in order
+};
+
+/**
+ * The custody signals of the receiver release the bundles kept by the sender
+ */
+class BundleProtocolCustodyTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolCustodyTestCase (std::string claType, uint32_t sentBundleSize, uint32_t bundleSize);
+  virtual ~BundleProtocolCustodyTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckSent (void);
+  void CheckReleased (void);
+
+private:
+  std::string m_claType;
+  uint32_t m_sentBundleSize;
+  uint32_t m_bundleSize;
+  uint32_t m_custodyAfterSend;  // bundles in custody at the sender right after sending
+  uint32_t m_custodyAtEnd;      // bundles still in custody at the sender at the end
+};
+
+/**
+ * The receiver accepts the custody of several bundles in one aggregate
+ * custody signal, sent once AcsDelay is over
+ */
+class BundleProtocolAggregateCustodyTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolAggregateCustodyTestCase ();
+  virtual ~BundleProtocolAggregateCustodyTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckPending (void);
+  void CheckReleased (void);
+
+private:
+  uint32_t m_custodyPending;    // bundles in custody at the sender while the signal is pending
+  uint32_t m_custodyAtEnd;      // bundles still in custody at the sender at the end
+};
+
+/**
+ * The receiver reports the reception and the delivery of a bundle to its
+ * source
+ */
+class BundleProtocolStatusReportTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolStatusReportTestCase ();
+  virtual ~BundleProtocolStatusReportTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  uint32_t m_statusReports;     // status reports received by the sender
+};
+
+/**
+ * The bundles sent again by a custodian before the custody signal comes
+ * back are dropped by the receiver
+ */
+class BundleProtocolDuplicateTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolDuplicateTestCase ();
+  virtual ~BundleProtocolDuplicateTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  uint32_t m_duplicateBundles;  // bundles dropped as duplicates by the receiver
+  uint32_t m_custodyAtEnd;      // bundles still in custody at the sender at the end
+};
+
+/**
+ * Two bundle nodes over TCP with several parallel sessions between them,
+ * checking that the bundles to one destination are delivered in order
+ */
+class BundleProtocolOrderTestCase : public TestCase
+{
+public:
+  BundleProtocolOrderTestCase (uint32_t sessions);
+  virtual ~BundleProtocolOrderTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Send (Ptr<BundleProtocol> sender, uint32_t size, BpEndpointId src, BpEndpointId dst);
+  void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid);
+  void Register (Ptr<BundleProtocol> node, BpEndpointId eid, InetSocketAddress l4Address);
+
+private:
+  uint32_t m_sessions;
+  std::vector<uint32_t> m_sentSizes;      // sizes of the bundles in the order they are sent
+  std::vector<uint32_t> m_receivedSizes;  // sizes of the bundles in the order they are received
+};
+
+/**
+ * A forwarder relaying the bundles of another node next to its own sends
+ * them all on its one TCP session to the next hop
+ */
+class BundleProtocolSessionTableTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolSessionTableTestCase ();
+  virtual ~BundleProtocolSessionTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  uint32_t m_receiverSockets;   // TCP sockets of the receiver: its listener and the connections accepted
+};
+
+/**
+ * Bundles larger than the TCP send buffer are delivered whole, and the
+ * sender is told to slow down while the CLA queue is above MaxQueuedBytes
+ */
+class BundleProtocolBackpressureTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolBackpressureTestCase ();
+  virtual ~BundleProtocolBackpressureTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  uint32_t m_queuedBytes;       // bytes left in the CLA queue of the sender at the end
+};
+
+/**
+ * A session whose connection is refused is reconnected with backoff, and
+ * its queued bundles are sent once the next hop listens
+ */
+class BundleProtocolReconnectTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolReconnectTestCase ();
+  virtual ~BundleProtocolReconnectTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  uint32_t m_receivedEarly;     // bundles received before the receiver listens
+};
+
+/**
+ * Two neighbours send bundles both ways on the connection the first of
+ * them opened
+ */
+class BundleProtocolBidirectionalTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolBidirectionalTestCase ();
+  virtual ~BundleProtocolBidirectionalTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  uint32_t m_sockets[2];        // TCP sockets of each node: its listener and its connections
+};
+
+/**
+ * A node registering several neighbours listens on one socket and
+ * receives the bundles of all of them through it
+ */
+class BundleProtocolListenerTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolListenerTestCase ();
+  virtual ~BundleProtocolListenerTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  uint32_t m_sockets;           // TCP sockets of the middle node before any bundle is sent
+};
+
+/**
+ * Small bundles coalesced into batched TCP writes are received whole and
+ * in order, including a tail flushed by the coalescing delay
+ */
+class BundleProtocolCoalesceTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolCoalesceTestCase ();
+  virtual ~BundleProtocolCoalesceTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+private:
+  std::vector<uint32_t> m_sentSizes;    // sizes of the bundles sent, in order
+};
+
+/**
+ * A bundle larger than the device MTU crosses a forwarder over the
+ * NetDevice CLA, on nodes without an Internet stack; with a lossy link
+ * the lost frame is retransmitted
+ */
+class BundleProtocolNetDeviceClaTestCase : public TestCase
+{
+public:
+  BundleProtocolNetDeviceClaTestCase (bool lossy);
+  virtual ~BundleProtocolNetDeviceClaTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid);
+  void Register (Ptr<BundleProtocol> node, BpEndpointId eid);
+
+private:
+  bool m_lossy;                 // drop the first frame received by the forwarder
+  std::vector<uint32_t> m_received;     // sizes of the bundles received, in order
+};
+
+/**
+ * A gateway forwards the bundles it receives over TCP from one neighbour
+ * to another neighbour registered with the UDP CLA
+ */
+class BundleProtocolGatewayTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolGatewayTestCase ();
+  virtual ~BundleProtocolGatewayTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void RegisterUdp (uint32_t node, uint32_t neighbour);
+  void Check (void);
+
+private:
+  uint32_t m_gatewaySockets;    // TCP sockets of the gateway
+  uint32_t m_receiverSockets;   // TCP sockets of the receiver, reached over UDP only
+};
+
+/**
+ * A route added after bundles were sent on another route is used for the
+ * next bundles, although the next hop of the destination is cached
+ */
+class BundleProtocolRouteChangeTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolRouteChangeTestCase ();
+  virtual ~BundleProtocolRouteChangeTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void AddRoute (uint32_t node, uint32_t dst, uint32_t nextHop);
+};
+
+/**
+ * The routes computed by BpStaticRoutingHelper carry bundles both ways
+ * along a chain, without routes or registrations given by hand
+ */
+class BundleProtocolStaticRoutingHelperTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolStaticRoutingHelperTestCase ();
+  virtual ~BundleProtocolStaticRoutingHelperTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+/**
+ * Contact Graph Routing forwards bundles along the contacts of a contact
+ * plan given to every node of a chain
+ */
+class BundleProtocolCgrTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolCgrTestCase ();
+  virtual ~BundleProtocolCgrTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+/**
+ * Epidemic routing replicates a bundle hop by hop over the contacts of a
+ * chain without routes, and delivers it once
+ */
+class BundleProtocolEpidemicTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolEpidemicTestCase ();
+  virtual ~BundleProtocolEpidemicTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  uint32_t m_relayBuffered;     // bundles kept for replication by the middle node
+};
+
+/**
+ * PRoPHET hands a bundle to a neighbour only if it is a better carrier
+ * towards the destination
+ */
+class BundleProtocolProphetTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolProphetTestCase ();
+  virtual ~BundleProtocolProphetTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+private:
+  double m_transitive;          // predictability of node2 at node0, learnt through node1
+  uint32_t m_relayBuffered;     // bundles kept for forwarding by the middle node
+};
+
+/**
+ * Spray-and-Wait carries a bundle across a chain only while copy tokens
+ * are left to hand over to the relays
+ */
+class BundleProtocolSprayAndWaitTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolSprayAndWaitTestCase (uint32_t initialCopies, uint32_t delivered);
+  virtual ~BundleProtocolSprayAndWaitTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+private:
+  uint32_t m_initialCopies;
+  uint32_t m_delivered;         // bundles expected at the end of the chain
+};
+
+/**
+ * Link-state routing holds a bundle while the interface towards its next
+ * hop is down, and sends it as soon as the interface comes back up
+ */
+class BundleProtocolLinkStateTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolLinkStateTestCase ();
+  virtual ~BundleProtocolLinkStateTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void SetInterface (uint32_t node, bool up);
+  void Check (void);
+
+private:
+  uint32_t m_receivedWhileDown; // bundles received while the interface is down
+  bool m_nextHopDown;           // the next hop was marked down, without waiting for TCP
+};
+
+/**
+ * A bundle sent to a group endpoint id is delivered to each member once,
+ * along the distribution tree, and not to the nodes it only crosses
+ */
+class BundleProtocolGroupTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolGroupTestCase ();
+  virtual ~BundleProtocolGroupTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+/**
+ * One forwarding table, shared by the static routing of every node of a
+ * chain, carries bundles across it both ways
+ */
+class BundleProtocolForwardingTableTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolForwardingTableTestCase ();
+  virtual ~BundleProtocolForwardingTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+/**
+ * Bundles sent out of contact are held by the TCP CLA and released when
+ * the contact opens, no more than the volume of each contact
+ */
+class BundleProtocolContactTestCase : public BundleProtocolChainTestCase
+{
+public:
+  BundleProtocolContactTestCase ();
+  virtual ~BundleProtocolContactTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (uint32_t index);
+
+private:
+  uint32_t m_receivedBefore[2]; // bundles received before the first contact, and before the second
+  uint32_t m_heldBytes;         // bytes held by the sender before the first contact
+};
+
 static class BundleProtocolTestSuite : public TestSuite
 {
 public:
@@ -70,6 +546,41 @@ public:
       AddTestCase (new BundleProtocolTestCase (1000, 400, 512, "Tcp"), TestCase::QUICK);
       AddTestCase (new BundleProtocolTestCase (1000, 512, 512, "Tcp"), TestCase::QUICK);
       AddTestCase (new BundleProtocolTestCase (1000, 1000, 512, "Tcp"), TestCase::QUICK);
+      AddTestCase (new BundleProtocolTestCase (1000, 1000, 512, "Udp"), TestCase::QUICK);
+      // a bundle larger than the MTU is fragmented by the UDP CLA and reassembled by the receiver
+      AddTestCase (new BundleProtocolTestCase (3000, 3000, 512, "Udp"), TestCase::QUICK);
+      AddTestCase (new BundleProtocolTestCase (3000, 3000, 512, "Ltp"), TestCase::QUICK);
+      AddTestCase (new BundleProtocolCustodyTestCase ("Tcp", 1000, 1000), TestCase::QUICK);
+      AddTestCase (new BundleProtocolCustodyTestCase ("Tcp", 1000, 400), TestCase::QUICK);
+      // the UDP CLA fragments the bundle, larger than the MTU; each fragment is accepted apart
+      AddTestCase (new BundleProtocolCustodyTestCase ("Udp", 3000, 3000), TestCase::QUICK);
+      AddTestCase (new BundleProtocolAggregateCustodyTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolStatusReportTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolDuplicateTestCase (), TestCase::QUICK);
+      // the bundles to one destination keep to one of the parallel sessions
+      AddTestCase (new BundleProtocolOrderTestCase (4), TestCase::QUICK);
+      AddTestCase (new BundleProtocolSessionTableTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolBackpressureTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolReconnectTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolBidirectionalTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolListenerTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolCoalesceTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolNetDeviceClaTestCase (false), TestCase::QUICK);
+      AddTestCase (new BundleProtocolNetDeviceClaTestCase (true), TestCase::QUICK);
+      AddTestCase (new BundleProtocolGatewayTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolRouteChangeTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolStaticRoutingHelperTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolCgrTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolEpidemicTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolProphetTestCase (), TestCase::QUICK);
+      // node1 receives half of the tokens, node2 the last one, which only goes to node3
+      AddTestCase (new BundleProtocolSprayAndWaitTestCase (4, 1), TestCase::QUICK);
+      // node1 receives the last token and waits for node3, which it never meets
+      AddTestCase (new BundleProtocolSprayAndWaitTestCase (2, 0), TestCase::QUICK);
+      AddTestCase (new BundleProtocolLinkStateTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolGroupTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolForwardingTableTestCase (), TestCase::QUICK);
+      AddTestCase (new BundleProtocolContactTestCase (), TestCase::QUICK);
     }
 
 } g_bundleProtocolTestSuite;
@@ -193,4 +704,1230 @@ BundleProtocolTestCase::Register (Ptr<BundleProtocol> node, BpEndpointId eid, In
 {
     std::cout << Simulator::Now ().GetMilliSeconds () << " Registering external node " << eid.Uri () << std::endl;
     node->ExternalRegister (eid, 0, true, l4Address);
-}
\ No newline at end of file
+}
+
+BundleProtocolChainTestCase::BundleProtocolChainTestCase (std::string name)
+  : TestCase (name)
+{
+}
+
+BundleProtocolChainTestCase::~BundleProtocolChainTestCase ()
+{
+}
+
+void
+BundleProtocolChainTestCase::Build (uint32_t n, std::string routing, bool registerNeighbours)
+{
+  m_nodes.Create (n);
+  m_received.resize (n);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("500Kbps"));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("5ms"));
+
+  std::vector<NetDeviceContainer> devices;
+  for (uint32_t k = 0; k + 1 < n; k++)
+    {
+      devices.push_back (pointToPoint.Install (m_nodes.Get (k), m_nodes.Get (k + 1)));
+    }
+
+  InternetStackHelper internet;
+  internet.Install (m_nodes);
+
+  Ipv4AddressHelper ipv4;
+  for (uint32_t k = 0; k + 1 < n; k++)
+    {
+      std::ostringstream subnet;
+      subnet << "10.1." << k + 1 << ".0";
+      ipv4.SetBase (subnet.str ().c_str (), "255.255.255.0");
+      m_links.push_back (ipv4.Assign (devices[k]));
+    }
+
+  for (uint32_t k = 0; k < n; k++)
+    {
+      BundleProtocolHelper bpHelper;
+      bpHelper.SetRoutingProtocol (routing);
+      bpHelper.SetBpEndpointId (GetEid (k));
+      BundleProtocolContainer bps = bpHelper.Install (m_nodes.Get (k));
+      bps.Start (Seconds (0.0));
+      m_bps.push_back (bps.Get (0));
+    }
+
+  for (uint32_t k = 0; registerNeighbours && k + 1 < n; k++)
+    {
+      Simulator::Schedule (Seconds (0.1), &BundleProtocolChainTestCase::Register, this, k, k + 1);
+      Simulator::Schedule (Seconds (0.1), &BundleProtocolChainTestCase::Register, this, k + 1, k);
+    }
+}
+
+void
+BundleProtocolChainTestCase::Run (Time stop)
+{
+  Simulator::Stop (stop);
+  Simulator::Run ();
+  Simulator::Destroy ();
+  // the configuration must not leak into the other test cases
+  Config::Reset ();
+}
+
+BpEndpointId
+BundleProtocolChainTestCase::GetEid (uint32_t node) const
+{
+  std::ostringstream ssp;
+  ssp << "node" << node;
+  return BpEndpointId ("dtn", ssp.str ());
+}
+
+InetSocketAddress
+BundleProtocolChainTestCase::GetAddress (uint32_t node, uint32_t neighbour) const
+{
+  // the address of the neighbour on the link it shares with the node
+  if (neighbour == node + 1)
+    return InetSocketAddress (m_links[node].GetAddress (1), 9);
+  NS_ASSERT (neighbour + 1 == node);
+  return InetSocketAddress (m_links[neighbour].GetAddress (0), 9);
+}
+
+void
+BundleProtocolChainTestCase::Send (uint32_t node, uint32_t size, BpEndpointId dst)
+{
+  Ptr<Packet> packet = Create<Packet> (size);
+  m_sendResults.push_back (m_bps[node]->Send_packet (packet, GetEid (node), dst));
+}
+
+void
+BundleProtocolChainTestCase::Receive (uint32_t node, BpEndpointId eid)
+{
+  Ptr<Packet> p = m_bps[node]->Receive (eid);
+  while (p != NULL)
+    {
+      m_received[node].push_back (p->GetSize ());
+      p = m_bps[node]->Receive (eid);
+    }
+}
+
+void
+BundleProtocolChainTestCase::Register (uint32_t node, uint32_t neighbour)
+{
+  m_bps[node]->ExternalRegister (GetEid (neighbour), 0, true, GetAddress (node, neighbour));
+}
+
+Ptr<BpStaticRoutingProtocol>
+BundleProtocolChainTestCase::GetStaticRouting (uint32_t node) const
+{
+  return DynamicCast<BpStaticRoutingProtocol> (m_bps[node]->GetRoutingProtocol ());
+}
+
+uint32_t
+BundleProtocolChainTestCase::GetNTcpSockets (uint32_t node) const
+{
+  ObjectVectorValue sockets;
+  m_nodes.Get (node)->GetObject<TcpL4Protocol> ()->GetAttribute ("SocketList", sockets);
+  return sockets.GetN ();
+}
+
+void
+BundleProtocolChainTestCase::AddContact (uint32_t node, uint32_t neighbour, Time start, Time stop)
+{
+  Ptr<BpTcpClaProtocol> cla = DynamicCast<BpTcpClaProtocol> (m_bps[node]->GetCla ("Tcp"));
+  cla->GetContactScheduler ()->AddContact (GetEid (neighbour), start, stop, 62500);
+}
+
+BundleProtocolCustodyTestCase::BundleProtocolCustodyTestCase (std::string claType, uint32_t sentBundleSize, uint32_t bundleSize)
+  : BundleProtocolChainTestCase ("Test that the custody signals of the receiver release the bundles kept by the sender over " + claType),
+    m_claType (claType),
+    m_sentBundleSize (sentBundleSize),
+    m_bundleSize (bundleSize),
+    m_custodyAfterSend (0),
+    m_custodyAtEnd (0)
+{
+}
+
+BundleProtocolCustodyTestCase::~BundleProtocolCustodyTestCase ()
+{
+}
+
+void
+BundleProtocolCustodyTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue (m_claType));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (m_bundleSize));
+  Config::SetDefault ("ns3::BundleProtocol::CustodyTransfer", BooleanValue (true));
+  Build (2);
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolCustodyTestCase::Send, this, 0, m_sentBundleSize, GetEid (1));
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolCustodyTestCase::CheckSent, this);
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolCustodyTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolCustodyTestCase::CheckReleased, this);
+  Run (Seconds (1.0));
+
+  uint32_t received = 0;
+  for (uint32_t k = 0; k < m_received[1].size (); k++)
+    {
+      received += m_received[1][k];
+    }
+  NS_TEST_EXPECT_MSG_EQ (received, m_sentBundleSize, "All bundles are received at the receiver");
+  NS_TEST_EXPECT_MSG_EQ (m_custodyAfterSend, (m_sentBundleSize + m_bundleSize - 1) / m_bundleSize, "The sender keeps custody of the bundles it sent");
+  NS_TEST_EXPECT_MSG_EQ (m_custodyAtEnd, 0, "The custody signals of the receiver release the bundles at the sender");
+}
+
+void
+BundleProtocolCustodyTestCase::CheckSent (void)
+{
+  m_custodyAfterSend = m_bps[0]->GetNCustodyBundles ();
+}
+
+void
+BundleProtocolCustodyTestCase::CheckReleased (void)
+{
+  m_custodyAtEnd = m_bps[0]->GetNCustodyBundles ();
+}
+
+BundleProtocolAggregateCustodyTestCase::BundleProtocolAggregateCustodyTestCase ()
+  : BundleProtocolChainTestCase ("Test that one aggregate custody signal of the receiver releases the bundles kept by the sender"),
+    m_custodyPending (0),
+    m_custodyAtEnd (0)
+{
+}
+
+BundleProtocolAggregateCustodyTestCase::~BundleProtocolAggregateCustodyTestCase ()
+{
+}
+
+void
+BundleProtocolAggregateCustodyTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (400));
+  Config::SetDefault ("ns3::BundleProtocol::CustodyTransfer", BooleanValue (true));
+  Config::SetDefault ("ns3::BundleProtocol::AggregateCustodySignals", BooleanValue (true));
+  Config::SetDefault ("ns3::BundleProtocol::AcsDelay", TimeValue (Seconds (0.5)));
+  Build (2);
+
+  // three bundles, accepted within a few tens of milliseconds
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolAggregateCustodyTestCase::Send, this, 0, 1000, GetEid (1));
+  Simulator::Schedule (Seconds (0.6), &BundleProtocolAggregateCustodyTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.6), &BundleProtocolAggregateCustodyTestCase::CheckPending, this);
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolAggregateCustodyTestCase::CheckReleased, this);
+  Run (Seconds (1.0));
+
+  // the three bundles are fragments of one ADU, delivered once reassembled
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 1, "The ADU is received at the receiver before the signal is due");
+  NS_TEST_EXPECT_MSG_EQ (m_custodyPending, 3, "No custody is released before AcsDelay is over");
+  NS_TEST_EXPECT_MSG_EQ (m_custodyAtEnd, 0, "The aggregate custody signal releases all the bundles at the sender");
+}
+
+void
+BundleProtocolAggregateCustodyTestCase::CheckPending (void)
+{
+  m_custodyPending = m_bps[0]->GetNCustodyBundles ();
+}
+
+void
+BundleProtocolAggregateCustodyTestCase::CheckReleased (void)
+{
+  m_custodyAtEnd = m_bps[0]->GetNCustodyBundles ();
+}
+
+BundleProtocolStatusReportTestCase::BundleProtocolStatusReportTestCase ()
+  : BundleProtocolChainTestCase ("Test that the receiver reports the reception and the delivery of a bundle to its source"),
+    m_statusReports (0)
+{
+}
+
+BundleProtocolStatusReportTestCase::~BundleProtocolStatusReportTestCase ()
+{
+}
+
+void
+BundleProtocolStatusReportTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  // received (1) and delivered (8)
+  Config::SetDefault ("ns3::BundleProtocol::StatusReports", UintegerValue (9));
+  Config::SetDefault ("ns3::BundleProtocol::StatusReportInterval", TimeValue (Seconds (0.1)));
+  Build (2);
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolStatusReportTestCase::Send, this, 0, 1000, GetEid (1));
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolStatusReportTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolStatusReportTestCase::Check, this);
+  Run (Seconds (1.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 1, "The bundle is received at the receiver");
+  NS_TEST_EXPECT_MSG_EQ (m_statusReports, 2, "The sender receives the reception and delivery reports of its bundle");
+}
+
+void
+BundleProtocolStatusReportTestCase::Check (void)
+{
+  m_statusReports = m_bps[0]->GetNStatusReports ();
+}
+
+BundleProtocolDuplicateTestCase::BundleProtocolDuplicateTestCase ()
+  : BundleProtocolChainTestCase ("Test that the receiver drops the bundles a custodian sent again"),
+    m_duplicateBundles (0),
+    m_custodyAtEnd (0)
+{
+}
+
+BundleProtocolDuplicateTestCase::~BundleProtocolDuplicateTestCase ()
+{
+}
+
+void
+BundleProtocolDuplicateTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::BundleProtocol::CustodyTransfer", BooleanValue (true));
+  // shorter than the round trip of the bundle and its custody signal
+  Config::SetDefault ("ns3::BundleProtocol::CustodyTimeout", TimeValue (MilliSeconds (10)));
+  Build (2);
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolDuplicateTestCase::Send, this, 0, 1000, GetEid (1));
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolDuplicateTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolDuplicateTestCase::Check, this);
+  Run (Seconds (1.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 1, "The bundle is delivered once");
+  NS_TEST_EXPECT_MSG_GT (m_duplicateBundles, 0, "The receiver drops the retransmissions of the bundle it already received");
+  NS_TEST_EXPECT_MSG_EQ (m_custodyAtEnd, 0, "The custody signal of the receiver stops the retransmissions");
+}
+
+void
+BundleProtocolDuplicateTestCase::Check (void)
+{
+  m_duplicateBundles = m_bps[1]->GetNDuplicateBundles ();
+  m_custodyAtEnd = m_bps[0]->GetNCustodyBundles ();
+}
+
+BundleProtocolOrderTestCase::BundleProtocolOrderTestCase (uint32_t sessions)
+  : TestCase ("Test that the bundles to one destination are received in order over parallel TCP sessions"),
+    m_sessions (sessions)
+{
+}
+
+BundleProtocolOrderTestCase::~BundleProtocolOrderTestCase ()
+{
+}
+
+void
+BundleProtocolOrderTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("500Kbps"));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("5ms"));
+
+  NetDeviceContainer devices;
+  devices = pointToPoint.Install (nodes);
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer i = ipv4.Assign (devices);
+
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (512));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::SessionsPerPeer", UintegerValue (m_sessions));
+
+  BpEndpointId eidSender ("dtn", "node0");
+  BpEndpointId eidRecv ("dtn", "node1");
+  InetSocketAddress Node0Addr (i.GetAddress (0), 9);
+  InetSocketAddress Node1Addr (i.GetAddress (1), 9);
+
+  Ptr<BpStaticRoutingProtocol> route = CreateObject<BpStaticRoutingProtocol> ();
+
+  BundleProtocolHelper bpSenderHelper;
+  bpSenderHelper.SetRoutingProtocol (route);
+  bpSenderHelper.SetBpEndpointId (eidSender);
+  BundleProtocolContainer bpSenders = bpSenderHelper.Install (nodes.Get (0));
+  bpSenders.Start (Seconds (0.1));
+  bpSenders.Stop (Seconds (1.0));
+
+  BundleProtocolHelper bpReceiverHelper;
+  bpReceiverHelper.SetRoutingProtocol (route);
+  bpReceiverHelper.SetBpEndpointId (eidRecv);
+  BundleProtocolContainer bpReceivers = bpReceiverHelper.Install (nodes.Get (1));
+  bpReceivers.Start (Seconds (0.0));
+  bpReceivers.Stop (Seconds (1.0));
+
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolOrderTestCase::Register, this, bpSenders.Get (0), eidRecv, Node1Addr);
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolOrderTestCase::Register, this, bpReceivers.Get (0), eidSender, Node0Addr);
+
+  // bundles of distinct sizes, so that the received sequence tells their order
+  for (uint32_t k = 1; k <= 2 * m_sessions; k++)
+    {
+      Simulator::Schedule (Seconds (0.2), &BundleProtocolOrderTestCase::Send, this, bpSenders.Get (0),
+                           100 * k, eidSender, eidRecv);
+    }
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolOrderTestCase::Receive, this, bpReceivers.Get (0),
+                       eidRecv);
+
+  Simulator::Stop (Seconds (1.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  Config::Reset ();
+
+  NS_TEST_EXPECT_MSG_EQ (m_receivedSizes.size (), m_sentSizes.size (), "All bundles are received at the receiver");
+  NS_TEST_EXPECT_MSG_EQ ((m_receivedSizes == m_sentSizes), true, "The bundles are received in the order they were sent");
+}
+
+void
+BundleProtocolOrderTestCase::Send (Ptr<BundleProtocol> sender, uint32_t size, BpEndpointId src, BpEndpointId dst)
+{
+  Ptr<Packet> packet = Create<Packet> (size);
+  sender->Send (packet, src, dst);
+  m_sentSizes.push_back (size);
+}
+
+void
+BundleProtocolOrderTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      m_receivedSizes.push_back (p->GetSize ());
+      p = receiver->Receive (eid);
+    }
+}
+
+void
+BundleProtocolOrderTestCase::Register (Ptr<BundleProtocol> node, BpEndpointId eid, InetSocketAddress l4Address)
+{
+  node->ExternalRegister (eid, 0, true, l4Address);
+}
+
+BundleProtocolSessionTableTestCase::BundleProtocolSessionTableTestCase ()
+  : BundleProtocolChainTestCase ("Test that a forwarder sends the bundles of several sources on one TCP session to the next hop"),
+    m_receiverSockets (0)
+{
+}
+
+BundleProtocolSessionTableTestCase::~BundleProtocolSessionTableTestCase ()
+{
+}
+
+void
+BundleProtocolSessionTableTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (3);
+  GetStaticRouting (0)->AddRoute (GetEid (2), GetEid (1));
+
+  // node1 relays the bundle of node0 and sends its own to node2
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolSessionTableTestCase::Send, this, 0, 500, GetEid (2));
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolSessionTableTestCase::Send, this, 1, 700, GetEid (2));
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolSessionTableTestCase::Receive, this, 2, GetEid (2));
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolSessionTableTestCase::Check, this);
+  Run (Seconds (1.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[2].size (), 2, "The bundles of both sources are received at the receiver");
+  NS_TEST_EXPECT_MSG_EQ (m_receiverSockets, 2, "The forwarder opens one connection to the receiver for both sources");
+}
+
+void
+BundleProtocolSessionTableTestCase::Check (void)
+{
+  m_receiverSockets = GetNTcpSockets (2);
+}
+
+BundleProtocolBackpressureTestCase::BundleProtocolBackpressureTestCase ()
+  : BundleProtocolChainTestCase ("Test that the TCP CLA keeps what does not fit in the send buffer and reports backpressure"),
+    m_queuedBytes (0)
+{
+}
+
+BundleProtocolBackpressureTestCase::~BundleProtocolBackpressureTestCase ()
+{
+}
+
+void
+BundleProtocolBackpressureTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (10000));
+  Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (4096));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::MaxQueuedBytes", UintegerValue (4000));
+  Build (2);
+
+  // each bundle is larger than the send buffer and the queue limit
+  for (uint32_t k = 0; k < 3; k++)
+    {
+      Simulator::Schedule (Seconds (0.2), &BundleProtocolBackpressureTestCase::Send, this, 0, 10000, GetEid (1));
+    }
+  Simulator::Schedule (Seconds (1.8), &BundleProtocolBackpressureTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (1.9), &BundleProtocolBackpressureTestCase::Check, this);
+  Run (Seconds (2.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_sendResults.size (), 3, "All bundles are sent");
+  NS_TEST_EXPECT_MSG_EQ (m_sendResults[2], 1, "The sender is told that the CLA queue is congested");
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 3, "All bundles are received at the receiver");
+  for (uint32_t k = 0; k < m_received[1].size (); k++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_received[1][k], 10000, "Each bundle is received whole");
+    }
+  NS_TEST_EXPECT_MSG_EQ (m_queuedBytes, 0, "The CLA queue drains once TCP frees its send buffer");
+}
+
+void
+BundleProtocolBackpressureTestCase::Check (void)
+{
+  m_queuedBytes = m_bps[0]->GetCla ("Tcp")->GetTxQueuedBytes ();
+}
+
+BundleProtocolReconnectTestCase::BundleProtocolReconnectTestCase ()
+  : BundleProtocolChainTestCase ("Test that a refused TCP session is reconnected and sends its queued bundles"),
+    m_receivedEarly (0)
+{
+}
+
+BundleProtocolReconnectTestCase::~BundleProtocolReconnectTestCase ()
+{
+}
+
+void
+BundleProtocolReconnectTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  // attempts at about 0.2, 0.3 and 0.5 s
+  Config::SetDefault ("ns3::BpTcpClaProtocol::ReconnectBaseDelay", TimeValue (MilliSeconds (100)));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::ReconnectJitter", DoubleValue (0.0));
+  Build (2, "ns3::BpStaticRoutingProtocol", false);
+
+  // the receiver listens only once it registers the sender
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolReconnectTestCase::Register, this, 0, 1);
+  Simulator::Schedule (Seconds (0.45), &BundleProtocolReconnectTestCase::Register, this, 1, 0);
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolReconnectTestCase::Send, this, 0, 1000, GetEid (1));
+  Simulator::Schedule (Seconds (0.4), &BundleProtocolReconnectTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.4), &BundleProtocolReconnectTestCase::Check, this);
+  Simulator::Schedule (Seconds (1.8), &BundleProtocolReconnectTestCase::Receive, this, 1, GetEid (1));
+  Run (Seconds (2.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_receivedEarly, 0, "Nothing is received while the receiver does not listen");
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 1, "The queued bundle is sent once the session reconnects");
+}
+
+void
+BundleProtocolReconnectTestCase::Check (void)
+{
+  m_receivedEarly = m_received[1].size ();
+}
+
+BundleProtocolBidirectionalTestCase::BundleProtocolBidirectionalTestCase ()
+  : BundleProtocolChainTestCase ("Test that two neighbours exchange bundles both ways on one TCP connection")
+{
+  m_sockets[0] = 0;
+  m_sockets[1] = 0;
+}
+
+BundleProtocolBidirectionalTestCase::~BundleProtocolBidirectionalTestCase ()
+{
+}
+
+void
+BundleProtocolBidirectionalTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (2);
+
+  // node1 answers once the connection of node0 is up
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolBidirectionalTestCase::Send, this, 0, 500, GetEid (1));
+  Simulator::Schedule (Seconds (0.4), &BundleProtocolBidirectionalTestCase::Send, this, 1, 700, GetEid (0));
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolBidirectionalTestCase::Receive, this, 0, GetEid (0));
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolBidirectionalTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolBidirectionalTestCase::Check, this);
+  Run (Seconds (1.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 1, "The bundle of node0 is received at node1");
+  NS_TEST_EXPECT_MSG_EQ (m_received[0].size (), 1, "The bundle of node1 is received at node0");
+  NS_TEST_EXPECT_MSG_EQ (m_sockets[0], 2, "node0 has no connection besides the one it opened");
+  NS_TEST_EXPECT_MSG_EQ (m_sockets[1], 2, "node1 answers on the connection it accepted");
+}
+
+void
+BundleProtocolBidirectionalTestCase::Check (void)
+{
+  m_sockets[0] = GetNTcpSockets (0);
+  m_sockets[1] = GetNTcpSockets (1);
+}
+
+BundleProtocolListenerTestCase::BundleProtocolListenerTestCase ()
+  : BundleProtocolChainTestCase ("Test that a node receives the bundles of all its neighbours on one listening socket"),
+    m_sockets (0)
+{
+}
+
+BundleProtocolListenerTestCase::~BundleProtocolListenerTestCase ()
+{
+}
+
+void
+BundleProtocolListenerTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  // node1 registers both node0 and node2 at 0.1 s
+  Build (3);
+
+  Simulator::Schedule (Seconds (0.15), &BundleProtocolListenerTestCase::Check, this);
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolListenerTestCase::Send, this, 0, 500, GetEid (1));
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolListenerTestCase::Send, this, 2, 600, GetEid (1));
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolListenerTestCase::Receive, this, 1, GetEid (1));
+  Run (Seconds (1.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_sockets, 1, "node1 listens on one socket for all its registrations");
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 2, "node1 receives the bundles of both neighbours");
+}
+
+void
+BundleProtocolListenerTestCase::Check (void)
+{
+  m_sockets = GetNTcpSockets (1);
+}
+
+BundleProtocolCoalesceTestCase::BundleProtocolCoalesceTestCase ()
+  : BundleProtocolChainTestCase ("Test that small bundles coalesced into batched TCP writes are received whole and in order")
+{
+}
+
+BundleProtocolCoalesceTestCase::~BundleProtocolCoalesceTestCase ()
+{
+}
+
+void
+BundleProtocolCoalesceTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::CoalesceBytes", UintegerValue (2000));
+  Config::SetDefault ("ns3::BpTcpClaProtocol::CoalesceDelay", TimeValue (MilliSeconds (50)));
+  Build (2);
+
+  // a burst filling several coalesced writes, then a tail below CoalesceBytes
+  for (uint32_t k = 0; k < 30; k++)
+    {
+      m_sentSizes.push_back (40 + k);
+      Simulator::Schedule (Seconds (0.2), &BundleProtocolCoalesceTestCase::Send, this, 0, 40 + k, GetEid (1));
+    }
+  for (uint32_t k = 0; k < 3; k++)
+    {
+      m_sentSizes.push_back (20 + k);
+      Simulator::Schedule (Seconds (0.5), &BundleProtocolCoalesceTestCase::Send, this, 0, 20 + k, GetEid (1));
+    }
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolCoalesceTestCase::Receive, this, 1, GetEid (1));
+  Run (Seconds (1.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), m_sentSizes.size (), "Every coalesced bundle is received");
+  for (uint32_t k = 0; k < m_received[1].size () && k < m_sentSizes.size (); k++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_received[1][k], m_sentSizes[k], "The bundles are received whole and in order");
+    }
+}
+
+BundleProtocolNetDeviceClaTestCase::BundleProtocolNetDeviceClaTestCase (bool lossy)
+  : TestCase (lossy ? "Test that the NetDevice CLA retransmits a lost frame"
+              : "Test that the NetDevice CLA delivers a bundle between nodes without an Internet stack"),
+    m_lossy (lossy)
+{
+}
+
+BundleProtocolNetDeviceClaTestCase::~BundleProtocolNetDeviceClaTestCase ()
+{
+}
+
+void
+BundleProtocolNetDeviceClaTestCase::DoRun (void)
+{
+  NodeContainer nodes, link1Nodes, link2Nodes;
+  nodes.Create (3);
+  link1Nodes.Add (nodes.Get (0));
+  link1Nodes.Add (nodes.Get (1));
+  link2Nodes.Add (nodes.Get (1));
+  link2Nodes.Add (nodes.Get (2));
+
+  // no InternetStackHelper; the SimpleNetDevice carries any protocol number
+  SimpleNetDeviceHelper simple;
+  simple.SetDeviceAttribute ("DataRate", StringValue ("5Mbps"));
+  simple.SetChannelAttribute ("Delay", StringValue ("2ms"));
+  NetDeviceContainer link1Devices = simple.Install (link1Nodes);
+  NetDeviceContainer link2Devices = simple.Install (link2Nodes);
+  for (uint32_t k = 0; k < 2; k++)
+    {
+      link1Devices.Get (k)->SetMtu (1000);
+      link2Devices.Get (k)->SetMtu (1000);
+    }
+
+  if (m_lossy)
+    {
+      Ptr<ReceiveListErrorModel> em = CreateObject<ReceiveListErrorModel> ();
+      std::list<uint32_t> lost;
+      lost.push_back (0);
+      em->SetList (lost);
+      link1Devices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+    }
+
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("NetDevice"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (4000));
+
+  BpEndpointId eidSender ("dtn", "node0");
+  BpEndpointId eidForwarder ("dtn", "node1");
+  BpEndpointId eidRecv ("dtn", "node2");
+
+  std::vector<Ptr<BundleProtocol> > bps;
+  for (uint32_t k = 0; k < 3; k++)
+    {
+      Ptr<BpStaticRoutingProtocol> route = CreateObject<BpStaticRoutingProtocol> ();
+      BundleProtocolHelper bpHelper;
+      bpHelper.SetRoutingProtocol (route);
+      bpHelper.SetBpEndpointId (k == 0 ? eidSender : (k == 1 ? eidForwarder : eidRecv));
+      BundleProtocolContainer bpContainer = bpHelper.Install (nodes.Get (k));
+      bpContainer.Start (Seconds (0.0));
+      bps.push_back (bpContainer.Get (0));
+    }
+  DynamicCast<BpStaticRoutingProtocol> (bps[0]->GetRoutingProtocol ())->AddRoute (eidRecv, eidForwarder);
+
+  Ptr<BpNetDeviceClaProtocol> cla0 = DynamicCast<BpNetDeviceClaProtocol> (bps[0]->GetCla ());
+  Ptr<BpNetDeviceClaProtocol> cla1 = DynamicCast<BpNetDeviceClaProtocol> (bps[1]->GetCla ());
+  Ptr<BpNetDeviceClaProtocol> cla2 = DynamicCast<BpNetDeviceClaProtocol> (bps[2]->GetCla ());
+  cla0->AddNeighbour (eidForwarder, link1Devices.Get (0), link1Devices.Get (1)->GetAddress ());
+  cla1->AddNeighbour (eidSender, link1Devices.Get (1), link1Devices.Get (0)->GetAddress ());
+  cla1->AddNeighbour (eidRecv, link2Devices.Get (0), link2Devices.Get (1)->GetAddress ());
+  cla2->AddNeighbour (eidForwarder, link2Devices.Get (1), link2Devices.Get (0)->GetAddress ());
+
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolNetDeviceClaTestCase::Register, this, bps[0], eidForwarder);
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolNetDeviceClaTestCase::Register, this, bps[1], eidSender);
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolNetDeviceClaTestCase::Register, this, bps[1], eidRecv);
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolNetDeviceClaTestCase::Register, this, bps[2], eidForwarder);
+
+  // 3000 bytes are split into frames of the 1000 bytes MTU
+  Ptr<Packet> packet = Create<Packet> (3000);
+  Simulator::Schedule (Seconds (0.2), &BundleProtocol::Send_packet, bps[0], packet, eidSender, eidRecv);
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolNetDeviceClaTestCase::Receive, this, bps[2], eidRecv);
+
+  Simulator::Stop (Seconds (1.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  Config::Reset ();
+
+  NS_TEST_EXPECT_MSG_EQ ((nodes.Get (1)->GetObject<Ipv4> () == 0), true, "The nodes have no Internet stack");
+  NS_TEST_EXPECT_MSG_EQ (m_received.size (), 1, "The bundle is received once, reassembled");
+  if (m_received.size () == 1)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_received[0], 3000, "The bundle is received whole");
+    }
+}
+
+void
+BundleProtocolNetDeviceClaTestCase::Receive (Ptr<BundleProtocol> receiver, BpEndpointId eid)
+{
+  Ptr<Packet> p = receiver->Receive (eid);
+  while (p != NULL)
+    {
+      m_received.push_back (p->GetSize ());
+      p = receiver->Receive (eid);
+    }
+}
+
+void
+BundleProtocolNetDeviceClaTestCase::Register (Ptr<BundleProtocol> node, BpEndpointId eid)
+{
+  // the L4 address is not used by the NetDevice CLA
+  node->ExternalRegister (eid, 0, true, InetSocketAddress (Ipv4Address::GetAny (), 0));
+}
+
+BundleProtocolGatewayTestCase::BundleProtocolGatewayTestCase ()
+  : BundleProtocolChainTestCase ("Test that a gateway forwards bundles from a TCP neighbour to a UDP neighbour"),
+    m_gatewaySockets (0),
+    m_receiverSockets (0)
+{
+}
+
+BundleProtocolGatewayTestCase::~BundleProtocolGatewayTestCase ()
+{
+}
+
+void
+BundleProtocolGatewayTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (3, "ns3::BpStaticRoutingProtocol", false);
+  GetStaticRouting (0)->AddRoute (GetEid (2), GetEid (1));
+
+  // node0 - node1 over the default TCP CLA, node1 - node2 over UDP
+  m_bps[1]->AddCla ("Udp");
+  m_bps[2]->AddCla ("Udp");
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolGatewayTestCase::Register, this, 0, 1);
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolGatewayTestCase::Register, this, 1, 0);
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolGatewayTestCase::RegisterUdp, this, 1, 2);
+  Simulator::Schedule (Seconds (0.1), &BundleProtocolGatewayTestCase::RegisterUdp, this, 2, 1);
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolGatewayTestCase::Send, this, 0, 500, GetEid (2));
+  Simulator::Schedule (Seconds (0.8), &BundleProtocolGatewayTestCase::Receive, this, 2, GetEid (2));
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolGatewayTestCase::Check, this);
+  Run (Seconds (1.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[2].size (), 1, "The bundle is forwarded by the gateway to node2");
+  NS_TEST_EXPECT_MSG_EQ (m_gatewaySockets, 2, "The gateway listens on TCP and accepts the session of node0");
+  NS_TEST_EXPECT_MSG_EQ (m_receiverSockets, 0, "node2 is reached over UDP only");
+}
+
+void
+BundleProtocolGatewayTestCase::RegisterUdp (uint32_t node, uint32_t neighbour)
+{
+  m_bps[node]->ExternalRegister (GetEid (neighbour), 0, true, GetAddress (node, neighbour), "Udp");
+}
+
+void
+BundleProtocolGatewayTestCase::Check (void)
+{
+  m_gatewaySockets = GetNTcpSockets (1);
+  m_receiverSockets = GetNTcpSockets (2);
+}
+
+BundleProtocolRouteChangeTestCase::BundleProtocolRouteChangeTestCase ()
+  : BundleProtocolChainTestCase ("Test that a route added after sending replaces the cached next hop")
+{
+}
+
+BundleProtocolRouteChangeTestCase::~BundleProtocolRouteChangeTestCase ()
+{
+}
+
+void
+BundleProtocolRouteChangeTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (4);
+
+  // node1 first routes node3 the wrong way, to node0, which has no route to it
+  std::vector<BpEndpointId> eids;
+  for (uint32_t k = 0; k < 4; k++)
+    {
+      eids.push_back (GetEid (k));
+    }
+  Ptr<BpForwardingTable> table = Create<BpForwardingTable> (eids);
+  std::vector<int32_t> row0 (4, -1);
+  row0[1] = 1;
+  table->AddRow (row0);
+  std::vector<int32_t> row1 (4, -1);
+  row1[0] = 0;
+  row1[2] = 2;
+  row1[3] = 0;
+  table->AddRow (row1);
+  GetStaticRouting (1)->SetForwardingTable (table, 1);
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolRouteChangeTestCase::Send, this, 1, 100, GetEid (3));
+  // the route of node1 takes precedence over the table
+  Simulator::Schedule (Seconds (0.4), &BundleProtocolRouteChangeTestCase::AddRoute, this, 1, 3, 2);
+  Simulator::Schedule (Seconds (0.5), &BundleProtocolRouteChangeTestCase::Send, this, 1, 200, GetEid (3));
+  Simulator::Schedule (Seconds (1.4), &BundleProtocolRouteChangeTestCase::Receive, this, 3, GetEid (3));
+  Run (Seconds (1.5));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[3].size (), 1, "Only the bundle sent after the route change reaches node3");
+  if (m_received[3].size () == 1)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_received[3][0], 200, "The bundle sent after the route change reaches node3");
+    }
+}
+
+void
+BundleProtocolRouteChangeTestCase::AddRoute (uint32_t node, uint32_t dst, uint32_t nextHop)
+{
+  GetStaticRouting (node)->AddRoute (GetEid (dst), GetEid (nextHop));
+}
+
+BundleProtocolStaticRoutingHelperTestCase::BundleProtocolStaticRoutingHelperTestCase ()
+  : BundleProtocolChainTestCase ("Test that the routes computed by BpStaticRoutingHelper deliver bundles across a chain")
+{
+}
+
+BundleProtocolStaticRoutingHelperTestCase::~BundleProtocolStaticRoutingHelperTestCase ()
+{
+}
+
+void
+BundleProtocolStaticRoutingHelperTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (4, "ns3::BpStaticRoutingProtocol", false);
+
+  BundleProtocolContainer bps;
+  for (uint32_t k = 0; k < m_bps.size (); k++)
+    {
+      bps.Add (m_bps[k]);
+    }
+  BpStaticRoutingHelper routingHelper;
+  routingHelper.PopulateRoutingTables (bps);
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolStaticRoutingHelperTestCase::Send, this, 0, 500, GetEid (3));
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolStaticRoutingHelperTestCase::Send, this, 3, 700, GetEid (0));
+  Simulator::Schedule (Seconds (1.4), &BundleProtocolStaticRoutingHelperTestCase::Receive, this, 0, GetEid (0));
+  Simulator::Schedule (Seconds (1.4), &BundleProtocolStaticRoutingHelperTestCase::Receive, this, 3, GetEid (3));
+  Run (Seconds (1.5));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[3].size (), 1, "The bundle of node0 crosses the chain to node3");
+  NS_TEST_EXPECT_MSG_EQ (m_received[0].size (), 1, "The bundle of node3 crosses the chain to node0");
+}
+
+BundleProtocolCgrTestCase::BundleProtocolCgrTestCase ()
+  : BundleProtocolChainTestCase ("Test that Contact Graph Routing forwards bundles along the contact plan")
+{
+}
+
+BundleProtocolCgrTestCase::~BundleProtocolCgrTestCase ()
+{
+}
+
+void
+BundleProtocolCgrTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (4, "ns3::BpCgrRoutingProtocol");
+
+  // the links of the chain are contacts both ways for the whole run
+  for (uint32_t k = 0; k < m_bps.size (); k++)
+    {
+      Ptr<BpCgrRoutingProtocol> cgr = DynamicCast<BpCgrRoutingProtocol> (m_bps[k]->GetRoutingProtocol ());
+      cgr->SetLocalNode (k);
+      for (uint32_t j = 0; j < m_bps.size (); j++)
+        {
+          cgr->AddNode (j, GetEid (j));
+        }
+      for (uint32_t j = 0; j + 1 < m_bps.size (); j++)
+        {
+          cgr->AddContact (0, 10, j, j + 1, 62500);
+          cgr->AddContact (0, 10, j + 1, j, 62500);
+          cgr->AddRange (0, 10, j, j + 1, 0.005);
+        }
+    }
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolCgrTestCase::Send, this, 0, 500, GetEid (3));
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolCgrTestCase::Send, this, 3, 700, GetEid (0));
+  Simulator::Schedule (Seconds (1.4), &BundleProtocolCgrTestCase::Receive, this, 0, GetEid (0));
+  Simulator::Schedule (Seconds (1.4), &BundleProtocolCgrTestCase::Receive, this, 3, GetEid (3));
+  Run (Seconds (1.5));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[3].size (), 1, "The bundle of node0 is routed over the contacts to node3");
+  NS_TEST_EXPECT_MSG_EQ (m_received[0].size (), 1, "The bundle of node3 is routed over the contacts to node0");
+}
+
+BundleProtocolEpidemicTestCase::BundleProtocolEpidemicTestCase ()
+  : BundleProtocolChainTestCase ("Test that epidemic routing replicates a bundle over the contacts of a chain"),
+    m_relayBuffered (0)
+{
+}
+
+BundleProtocolEpidemicTestCase::~BundleProtocolEpidemicTestCase ()
+{
+}
+
+void
+BundleProtocolEpidemicTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (3, "ns3::BpEpidemicRoutingProtocol");
+
+  // the neighbours come up, and exchange their summary vectors, at 0.3 s
+  for (uint32_t k = 0; k + 1 < m_bps.size (); k++)
+    {
+      AddContact (k, k + 1, Seconds (0.3), Seconds (5.0));
+      AddContact (k + 1, k, Seconds (0.3), Seconds (5.0));
+    }
+
+  Simulator::Schedule (Seconds (0.5), &BundleProtocolEpidemicTestCase::Send, this, 0, 500, GetEid (2));
+  Simulator::Schedule (Seconds (1.8), &BundleProtocolEpidemicTestCase::Receive, this, 2, GetEid (2));
+  Simulator::Schedule (Seconds (1.9), &BundleProtocolEpidemicTestCase::Check, this);
+  Run (Seconds (2.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[2].size (), 1, "The bundle is replicated to node2 and delivered once");
+  NS_TEST_EXPECT_MSG_EQ (m_relayBuffered, 1, "node1 keeps its copy for the next contacts");
+}
+
+void
+BundleProtocolEpidemicTestCase::Check (void)
+{
+  m_relayBuffered = DynamicCast<BpEpidemicRoutingProtocol> (m_bps[1]->GetRoutingProtocol ())->GetNBufferedBundles ();
+}
+
+BundleProtocolProphetTestCase::BundleProtocolProphetTestCase ()
+  : BundleProtocolChainTestCase ("Test that PRoPHET forwards a bundle only to a better carrier"),
+    m_transitive (0),
+    m_relayBuffered (0)
+{
+}
+
+BundleProtocolProphetTestCase::~BundleProtocolProphetTestCase ()
+{
+}
+
+void
+BundleProtocolProphetTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (3, "ns3::BpProphetRoutingProtocol");
+
+  // node1 meets node2 before node0, so it is the better carrier towards node2
+  AddContact (1, 2, Seconds (0.2), Seconds (5.0));
+  AddContact (2, 1, Seconds (0.2), Seconds (5.0));
+  AddContact (0, 1, Seconds (0.4), Seconds (5.0));
+  AddContact (1, 0, Seconds (0.4), Seconds (5.0));
+
+  Simulator::Schedule (Seconds (0.6), &BundleProtocolProphetTestCase::Send, this, 0, 500, GetEid (2));
+  // no node has met node9: node1 is no better carrier towards it than node0
+  Simulator::Schedule (Seconds (0.6), &BundleProtocolProphetTestCase::Send, this, 0, 600, GetEid (9));
+  Simulator::Schedule (Seconds (1.8), &BundleProtocolProphetTestCase::Receive, this, 2, GetEid (2));
+  Simulator::Schedule (Seconds (1.9), &BundleProtocolProphetTestCase::Check, this);
+  Run (Seconds (2.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[2].size (), 1, "The bundle is carried by node1 to node2");
+  NS_TEST_EXPECT_MSG_GT (m_transitive, 0, "node0 learns node2 through node1");
+  NS_TEST_EXPECT_MSG_EQ (m_relayBuffered, 1, "node1 is not given the bundle to node9");
+}
+
+void
+BundleProtocolProphetTestCase::Check (void)
+{
+  m_transitive = DynamicCast<BpProphetRoutingProtocol> (m_bps[0]->GetRoutingProtocol ())->GetPredictability (GetEid (2));
+  m_relayBuffered = DynamicCast<BpProphetRoutingProtocol> (m_bps[1]->GetRoutingProtocol ())->GetNBufferedBundles ();
+}
+
+BundleProtocolSprayAndWaitTestCase::BundleProtocolSprayAndWaitTestCase (uint32_t initialCopies, uint32_t delivered)
+  : BundleProtocolChainTestCase ("Test that Spray-and-Wait hands copies over while copy tokens are left"),
+    m_initialCopies (initialCopies),
+    m_delivered (delivered)
+{
+}
+
+BundleProtocolSprayAndWaitTestCase::~BundleProtocolSprayAndWaitTestCase ()
+{
+}
+
+void
+BundleProtocolSprayAndWaitTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::BpSprayAndWaitRoutingProtocol::InitialCopies", UintegerValue (m_initialCopies));
+  Build (4, "ns3::BpSprayAndWaitRoutingProtocol");
+
+  for (uint32_t k = 0; k + 1 < m_bps.size (); k++)
+    {
+      AddContact (k, k + 1, Seconds (0.3), Seconds (5.0));
+      AddContact (k + 1, k, Seconds (0.3), Seconds (5.0));
+    }
+
+  Simulator::Schedule (Seconds (0.5), &BundleProtocolSprayAndWaitTestCase::Send, this, 0, 500, GetEid (3));
+  Simulator::Schedule (Seconds (1.8), &BundleProtocolSprayAndWaitTestCase::Receive, this, 3, GetEid (3));
+  Run (Seconds (2.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[3].size (), m_delivered, "The bundle reaches node3 only if a relay next to it holds a token");
+}
+
+BundleProtocolLinkStateTestCase::BundleProtocolLinkStateTestCase ()
+  : BundleProtocolChainTestCase ("Test that link-state routing holds bundles while the interface is down and sends them when it is up"),
+    m_receivedWhileDown (0),
+    m_nextHopDown (false)
+{
+}
+
+BundleProtocolLinkStateTestCase::~BundleProtocolLinkStateTestCase ()
+{
+}
+
+void
+BundleProtocolLinkStateTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (2, "ns3::BpLinkStateRoutingProtocol");
+  // node1 is watched as the next hop of the route to itself
+  DynamicCast<BpLinkStateRoutingProtocol> (m_bps[0]->GetRoutingProtocol ())->AddRoute (GetEid (1), GetEid (1));
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolLinkStateTestCase::SetInterface, this, 0, false);
+  Simulator::Schedule (Seconds (0.3), &BundleProtocolLinkStateTestCase::Send, this, 0, 500, GetEid (1));
+  Simulator::Schedule (Seconds (0.6), &BundleProtocolLinkStateTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.6), &BundleProtocolLinkStateTestCase::Check, this);
+  Simulator::Schedule (Seconds (0.7), &BundleProtocolLinkStateTestCase::SetInterface, this, 0, true);
+  // well before a TCP timeout
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolLinkStateTestCase::Receive, this, 1, GetEid (1));
+  Run (Seconds (1.0));
+
+  NS_TEST_EXPECT_MSG_EQ (m_nextHopDown, true, "node1 is marked down as soon as the interface is");
+  NS_TEST_EXPECT_MSG_EQ (m_receivedWhileDown, 0, "The bundle is held while the interface is down");
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 1, "The bundle is sent once the interface is up again");
+}
+
+void
+BundleProtocolLinkStateTestCase::SetInterface (uint32_t node, bool up)
+{
+  // interface 1 is the first point-to-point link of the node
+  Ptr<Ipv4> ipv4 = m_nodes.Get (node)->GetObject<Ipv4> ();
+  if (up)
+    ipv4->SetUp (1);
+  else
+    ipv4->SetDown (1);
+}
+
+void
+BundleProtocolLinkStateTestCase::Check (void)
+{
+  m_receivedWhileDown = m_received[1].size ();
+  m_nextHopDown = DynamicCast<BpLinkStateRoutingProtocol> (m_bps[0]->GetRoutingProtocol ())->IsDown (GetEid (1));
+}
+
+BundleProtocolGroupTestCase::BundleProtocolGroupTestCase ()
+  : BundleProtocolChainTestCase ("Test that a bundle to a group is delivered once to each member")
+{
+}
+
+BundleProtocolGroupTestCase::~BundleProtocolGroupTestCase ()
+{
+}
+
+void
+BundleProtocolGroupTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (4, "ns3::BpStaticRoutingProtocol", false);
+
+  // node1 and node3 are members; node2 only forwards
+  BpEndpointId group ("dtn", "group");
+  BundleProtocolContainer bps;
+  for (uint32_t k = 0; k < m_bps.size (); k++)
+    {
+      bps.Add (m_bps[k]);
+    }
+  BpStaticRoutingHelper routingHelper;
+  routingHelper.AddGroupMember (group, m_bps[1]);
+  routingHelper.AddGroupMember (group, m_bps[3]);
+  routingHelper.PopulateRoutingTables (bps);
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolGroupTestCase::Send, this, 0, 500, group);
+  for (uint32_t k = 1; k < m_bps.size (); k++)
+    {
+      Simulator::Schedule (Seconds (1.4), &BundleProtocolGroupTestCase::Receive, this, k, group);
+    }
+  Run (Seconds (1.5));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 1, "The member node1 receives the bundle once");
+  NS_TEST_EXPECT_MSG_EQ (m_received[2].size (), 0, "node2 forwards the bundle without receiving it");
+  NS_TEST_EXPECT_MSG_EQ (m_received[3].size (), 1, "The member node3 receives the bundle once");
+}
+
+BundleProtocolForwardingTableTestCase::BundleProtocolForwardingTableTestCase ()
+  : BundleProtocolChainTestCase ("Test that a forwarding table shared by all nodes routes bundles across a chain")
+{
+}
+
+BundleProtocolForwardingTableTestCase::~BundleProtocolForwardingTableTestCase ()
+{
+}
+
+void
+BundleProtocolForwardingTableTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  uint32_t n = 4;
+  Build (n);
+
+  // node k reaches the nodes above it through k + 1, those below through k - 1
+  std::vector<BpEndpointId> eids;
+  for (uint32_t k = 0; k < n; k++)
+    {
+      eids.push_back (GetEid (k));
+    }
+  Ptr<BpForwardingTable> table = Create<BpForwardingTable> (eids);
+  for (uint32_t k = 0; k < n; k++)
+    {
+      std::vector<int32_t> row (n, -1);
+      for (uint32_t dst = 0; dst < n; dst++)
+        {
+          if (dst > k)
+            row[dst] = k + 1;
+          else if (dst < k)
+            row[dst] = k - 1;
+        }
+      table->AddRow (row);
+    }
+  for (uint32_t k = 0; k < n; k++)
+    {
+      GetStaticRouting (k)->SetForwardingTable (table, k);
+    }
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolForwardingTableTestCase::Send, this, 0, 500, GetEid (3));
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolForwardingTableTestCase::Send, this, 3, 700, GetEid (0));
+  Simulator::Schedule (Seconds (1.4), &BundleProtocolForwardingTableTestCase::Receive, this, 0, GetEid (0));
+  Simulator::Schedule (Seconds (1.4), &BundleProtocolForwardingTableTestCase::Receive, this, 3, GetEid (3));
+  Run (Seconds (1.5));
+
+  NS_TEST_EXPECT_MSG_EQ (m_received[3].size (), 1, "The bundle of node0 is routed by the shared table to node3");
+  NS_TEST_EXPECT_MSG_EQ (m_received[0].size (), 1, "The bundle of node3 is routed by the shared table to node0");
+}
+
+BundleProtocolContactTestCase::BundleProtocolContactTestCase ()
+  : BundleProtocolChainTestCase ("Test that bundles are held until a contact opens and released within its volume"),
+    m_heldBytes (0)
+{
+  m_receivedBefore[0] = 0;
+  m_receivedBefore[1] = 0;
+}
+
+BundleProtocolContactTestCase::~BundleProtocolContactTestCase ()
+{
+}
+
+void
+BundleProtocolContactTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BundleProtocol::L4Type", StringValue ("Tcp"));
+  Config::SetDefault ("ns3::BundleProtocol::BundleSize", UintegerValue (1000));
+  Build (2);
+
+  // the first contact carries 625 bytes, one of the two bundles
+  AddContact (0, 1, Seconds (0.6), Seconds (0.61));
+  AddContact (0, 1, Seconds (1.0), Seconds (5.0));
+
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolContactTestCase::Send, this, 0, 500, GetEid (1));
+  Simulator::Schedule (Seconds (0.2), &BundleProtocolContactTestCase::Send, this, 0, 500, GetEid (1));
+  Simulator::Schedule (Seconds (0.5), &BundleProtocolContactTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.5), &BundleProtocolContactTestCase::Check, this, 0);
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolContactTestCase::Receive, this, 1, GetEid (1));
+  Simulator::Schedule (Seconds (0.9), &BundleProtocolContactTestCase::Check, this, 1);
+  Simulator::Schedule (Seconds (1.4), &BundleProtocolContactTestCase::Receive, this, 1, GetEid (1));
+  Run (Seconds (1.5));
+
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBefore[0], 0, "Nothing is sent before the first contact");
+  NS_TEST_EXPECT_MSG_GT (m_heldBytes, 1000, "Both bundles are held until the first contact");
+  NS_TEST_EXPECT_MSG_EQ (m_receivedBefore[1], 1, "The first contact carries one bundle");
+  NS_TEST_EXPECT_MSG_EQ (m_received[1].size (), 2, "The second contact carries the other one");
+}
+
+void
+BundleProtocolContactTestCase::Check (uint32_t index)
+{
+  m_receivedBefore[index] = m_received[1].size ();
+  if (index == 0)
+    {
+      Ptr<BpTcpClaProtocol> cla = DynamicCast<BpTcpClaProtocol> (m_bps[0]->GetCla ("Tcp"));
+      m_heldBytes = cla->GetContactScheduler ()->GetHeldBytes ();
+    }
+}